@@ -1,7 +1,35 @@
 #include "BuiltInCommand.h"
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <fnmatch.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <thread>
+
 BuiltInCommand::BuiltInCommand(std::string cmd_line) : Command(cmd_line) {}
 
+SmallShellNextState BuiltInCommand::runAsExternalCommand() {
+    if (execute_without_fork) {
+        // already in a son of its own, e.g. a side of a pipe
+        useSinksAsStdio();
+        execCommandLine(original_cmd_line);
+    }
+    // like a command a wrapper runs, the job list may keep it
+    Command* cmd = new ExternalCommand(original_cmd_line);
+    cmd->out = out;
+    cmd->err = err;
+    cmd->in_fd = in_fd;
+    return cmd->execute();
+}
+
 //-----------------------------------------------------------------------------
 
 // constructors of inheriting classes
@@ -22,24 +50,160 @@ JobsCommand::JobsCommand(std::string cmd_line)
         : BuiltInCommand(cmd_line) {}
 
 KillCommand::KillCommand(std::string cmd_line)
-        : BuiltInCommand(cmd_line), sig_num(0), jobID(0) {}
+        : BuiltInCommand(cmd_line), sig_num(0), jobID(0), hasSelector(false),
+          verbose(false) {}
 
 ForegroundCommand::ForegroundCommand(std::string cmd_line)
-    : BuiltInCommand(cmd_line), jobID(-1), noJobIDFromUser(false) {}
+    : BuiltInCommand(cmd_line), jobID(-1), noJobIDFromUser(false),
+      hasSelector(false) {}
 
 BackgroundCommand::BackgroundCommand(std::string cmd_line)
-    : BuiltInCommand(cmd_line), jobID(-1), noJobIDFromUser(false) {}
+    : BuiltInCommand(cmd_line), jobID(-1), noJobIDFromUser(false),
+      hasCpusFromUser(false), hasSelector(false) {
+    CPU_ZERO(&cpus);
+}
+
+TaskSetCommand::TaskSetCommand(std::string cmd_line)
+    : BuiltInCommand(cmd_line), jobID(-1), hasCpusFromUser(false) {
+    CPU_ZERO(&cpus);
+}
+
+JobPolicyCommand::JobPolicyCommand(std::string cmd_line)
+    : BuiltInCommand(cmd_line) {}
+
+TimeoutCommand::TimeoutCommand(std::string cmd_line)
+    : BuiltInCommand(cmd_line), timeout_ms(0),
+      kill_grace_ms(default_kill_grace_ms), inner_cmd_line("") {}
+
+TimeCommand::TimeCommand(std::string cmd_line)
+    : BuiltInCommand(cmd_line), inner_cmd_line("") {}
+
+StatsCommand::StatsCommand(std::string cmd_line)
+    : BuiltInCommand(cmd_line), is_resetting(false), is_json(false) {}
+
+TraceCommand::TraceCommand(std::string cmd_line)
+    : BuiltInCommand(cmd_line), action(""), file_path("") {}
+
+CaptureCommand::CaptureCommand(std::string cmd_line)
+    : BuiltInCommand(cmd_line), capture_size(default_capture_size),
+      inner_cmd_line("") {}
+
+JobLogCommand::JobLogCommand(std::string cmd_line)
+    : BuiltInCommand(cmd_line), jobID(0), tail_lines_count(0), follow(false) {}
+
+ScheduleCommand::ScheduleCommand(std::string cmd_line, std::string name)
+    : BuiltInCommand(cmd_line), name(name), scheduled_cmd_line(""),
+      when_str(""), scheduleID_to_remove(SCHEDULE_DOESNT_EXIST) {}
+
+EveryCommand::EveryCommand(std::string cmd_line)
+    : ScheduleCommand(cmd_line, "every") {}
+
+AtCommand::AtCommand(std::string cmd_line)
+    : ScheduleCommand(cmd_line, "at") {}
+
+WaitCommand::WaitCommand(std::string cmd_line)
+    : BuiltInCommand(cmd_line), waitForAnyJob(false), timeout_ms(WAIT_FOREVER) {}
+
+ExportCommand::ExportCommand(std::string cmd_line)
+        : BuiltInCommand(cmd_line) {}
+
+UnsetCommand::UnsetCommand(std::string cmd_line)
+        : BuiltInCommand(cmd_line) {}
+
+AssignCommand::AssignCommand(std::string cmd_line)
+        : BuiltInCommand(cmd_line) {}
+
+WordCountCommand::WordCountCommand(std::string cmd_line)
+        : BuiltInCommand(cmd_line), count_lines(false), count_words(false),
+          count_bytes(false) {}
+
+GrepCommand::GrepCommand(std::string cmd_line)
+        : BuiltInCommand(cmd_line), options() {}
+
+SortCommand::SortCommand(std::string cmd_line)
+        : BuiltInCommand(cmd_line), options(),
+          memory_budget(sort_default_memory_budget), is_showing_stats(false),
+          stats() {}
+
+SortCommand::~SortCommand() {
+    for (int fd : run_fds) {
+        close(fd);
+    }
+}
+
+SumCommand::SumCommand(std::string cmd_line)
+        : BuiltInCommand(cmd_line), algorithm(SHA256), has_algorithm(false),
+          is_tree_mode(false), is_checking(false) {}
+
+DiskUsageCommand::DiskUsageCommand(std::string cmd_line)
+        : BuiltInCommand(cmd_line), is_summarizing(false),
+          is_human_readable(false), has_grand_total(false),
+          is_showing_stats(false) {}
+
+FindCommand::FindCommand(std::string cmd_line)
+        : BuiltInCommand(cmd_line), has_name_pattern(false),
+          is_name_case_folded(false), type('\0'), size_sign(0), size(0),
+          size_unit(512), has_size(false), mtime_sign(0), mtime_days(0),
+          has_mtime(false), max_depth(-1), is_showing_stats(false) {}
+
+RemoveCommand::RemoveCommand(std::string cmd_line)
+        : BuiltInCommand(cmd_line), is_recursive(false), is_forced(false),
+          is_showing_stats(false) {}
 
 QuitCommand::QuitCommand(std::string cmd_line)
         : BuiltInCommand(cmd_line) {}
 
 //-----------------------------------------------------------------------------
 
+// built-ins that only print, a pipe of them runs inside smash
+
+bool ShowPidCommand::hasNoSideEffects() {
+    return true;
+}
+
+bool GetCurrDirCommand::hasNoSideEffects() {
+    return true;
+}
+
+bool JobsCommand::hasNoSideEffects() {
+    return true;
+}
+
+bool JobLogCommand::hasNoSideEffects() {
+    return true;
+}
+
+bool WordCountCommand::hasNoSideEffects() {
+    return true;
+}
+
+bool GrepCommand::hasNoSideEffects() {
+    return true;
+}
+
+bool SortCommand::hasNoSideEffects() {
+    return true;
+}
+
+bool SumCommand::hasNoSideEffects() {
+    return true;
+}
+
+bool DiskUsageCommand::hasNoSideEffects() {
+    return true;
+}
+
+bool FindCommand::hasNoSideEffects() {
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
 // implementations of execute method
 
 std::string ChangePromptCommand::getNewPrompt() {
     _removeBackgroundSign(cmd_line);
-    auto cmd_args = _parseCommandLine(cmd_line);
+    auto cmd_args = getArgs();
     std::string new_prompt;
 
     if (cmd_args.size() == 1) {
@@ -58,8 +222,8 @@ SmallShellNextState ChangePromptCommand::execute() {
 }
 
 SmallShellNextState ShowPidCommand::execute() {
-    pid_t pid = SmallShell::getInstance().smash_pid;
-    std::cout << "smash pid is " << pid << std::endl;
+    SmallShell& smash = SmallShell::getInstance();
+    *out << "smash pid is " << smash.smash_pid << '\n';
     return CONTINUE_RUNNING;
 }
 
@@ -70,18 +234,18 @@ SmallShellNextState GetCurrDirCommand::execute() {
         throw SystemCallFail();
     }
 
-    std::cout << std::string(cwd_path) << std::endl;
+    *out << cwd_path << '\n';
 
     return CONTINUE_RUNNING;
 }
 
 bool ChangeDirCommand::isValidCommand() {
     _removeBackgroundSign(cmd_line);
-    auto args = _parseCommandLine(cmd_line);
+    auto args = getArgs();
 
     if (args.size() > 2) {
-        std::cerr << "smash error: cd: too many arguments" << std::endl;
-        return false;
+        *err << "smash error: cd: too many arguments" << '\n';
+        throw CommandFail();
     }
     if (args.size() == 1) {
         // command is only "cd"
@@ -93,7 +257,7 @@ bool ChangeDirCommand::isValidCommand() {
 
 std::string ChangeDirCommand::calculateNewPath() {
     _removeBackgroundSign(cmd_line);
-    auto args = _parseCommandLine(cmd_line);
+    auto args = getArgs();
 
     std::string& new_path = args[1];
 
@@ -105,7 +269,7 @@ std::string ChangeDirCommand::calculateNewPath() {
     SmallShell& smash = SmallShell::getInstance();
 
     if (smash.prev_wd_path.empty()) {
-        std::cerr << "smash error: cd: OLDPWD not set" << std::endl;
+        *err << "smash error: cd: OLDPWD not set" << '\n';
         throw CommandFail();
     } else {
         return smash.prev_wd_path;
@@ -140,39 +304,116 @@ SmallShellNextState ChangeDirCommand::execute() {
     return CONTINUE_RUNNING;
 }
 
+bool JobsCommand::areArgsValid() {
+    _removeBackgroundSign(cmd_line);
+    auto args = getArgs();
+
+    // "jobs [%spec ...]", arguments that are not job specs are ignored
+    for (size_t i = 1; i < args.size(); i++) {
+        if (isJobSpec(args[i]) && !selector.addJobSpec(args[i])) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 SmallShellNextState JobsCommand::execute() {
+    if (!areArgsValid()) {
+        *err << "smash error: jobs: invalid arguments" << '\n';
+        throw CommandFail();
+    }
+
     SmallShell& smash = SmallShell::getInstance();
-    smash.jobs.printJobsList();
+    if (selector.isEmpty()) {
+        smash.jobs.printJobsList(*out);
+    } else {
+        smash.jobs.printJobsList(selector, *out);
+    }
     return CONTINUE_RUNNING;
 }
 
 bool KillCommand::areArgsValid() {
     _removeBackgroundSign(cmd_line);
-    auto args = _parseCommandLine(cmd_line);
+    auto args = getArgs();
 
-    // valid cmd format is kill -signum jobID bla
-    if (args.size() != 3 || args[1][0] != '-' || args[1].size() == 1) {
+    // valid cmd format is kill -signum jobID bla, or
+    // kill -signum [-v] jobspec [jobspec ...] for a batch of jobs
+    if (args.size() < 3 || args[1][0] != '-' || args[1].size() == 1) {
         return false;
     }
 
     // get the signal number without the character '-' at the beginning
     auto signal_str = args[1].substr(1);
-    auto& jobID_str = args[2];
 
-    // convert the strings into numbers
+    if (args.size() == 3 && !isJobSpec(args[2])) {
+        auto& jobID_str = args[2];
+
+        // convert the strings into numbers
+        try {
+            sig_num = std::stoi(signal_str, nullptr);
+            jobID = std::stoi(jobID_str, nullptr);
+        } catch (const std::invalid_argument& ia) {
+            return false;
+        }
+
+        return true;
+    }
+
     try {
         sig_num = std::stoi(signal_str, nullptr);
-        jobID = std::stoi(jobID_str, nullptr);
     } catch (const std::invalid_argument& ia) {
         return false;
     }
+    for (size_t i = 2; i < args.size(); i++) {
+        if (args[i] == "-v") {
+            verbose = true;
+        } else if (!selector.addJobSpec(args[i])) {
+            return false;
+        }
+    }
+    if (selector.isEmpty()) {
+        return false;
+    }
+    // a single "%N" gets the messages of "kill -signum N", like fg and bg
+    hasSelector = !selector.isSingleJobID(jobID);
 
     return true;
 }
 
+void KillCommand::killSelectedJobs() {
+    SmallShell& smash = SmallShell::getInstance();
+
+    auto selected_jobs = smash.jobs.selectJobs(selector);
+    if (selected_jobs.empty()) {
+        *err << "smash error: kill: no jobs match the job specs"
+             << '\n';
+        throw CommandFail();
+    }
+
+    int signaled_jobs_count = smash.jobs.sendSignalToJobs(selected_jobs,
+                                                          sig_num);
+
+    // a line per job only if asked, tearing down thousands of jobs
+    // shouldn't print thousands of lines
+    if (verbose) {
+        for (auto job : selected_jobs) {
+            *out << "signal number " << sig_num << " was sent to pid "
+                 << job->job_pid << '\n';
+        }
+    }
+    *out << "signal number " << sig_num << " was sent to "
+         << signaled_jobs_count << " jobs" << '\n';
+}
+
 SmallShellNextState KillCommand::execute() {
     if (!areArgsValid()) {
-        std::cerr << "smash error: kill: invalid arguments" << std::endl;
+        *err << "smash error: kill: invalid arguments" << '\n';
+        throw CommandFail();
+    }
+
+    if (hasSelector) {
+        killSelectedJobs();
         return CONTINUE_RUNNING;
     }
 
@@ -181,23 +422,23 @@ SmallShellNextState KillCommand::execute() {
     // here jobID might be negative
     // here sig_num may be invalid and then kill call will fail
     if (smash.jobs.sendSignalToJob(jobID, sig_num) == JOB_DOESNT_EXIST){
-        std::cerr << "smash error: kill: job-id " << jobID
-                  << " does not exist" << std::endl;
-        return CONTINUE_RUNNING;
+        *err << "smash error: kill: job-id " << jobID
+             << " does not exist" << '\n';
+        throw CommandFail();
     }
 
     // if we get here it means that the job exists
     // if the job should be removed from the job list, it will be done before
     // executing the next command
-    std::cout << "signal number " << sig_num << " was sent to pid "
-              << smash.jobs.getJobById(jobID)->job_pid << std::endl;
+    *out << "signal number " << sig_num << " was sent to pid "
+         << smash.jobs.getJobById(jobID)->job_pid << '\n';
 
     return CONTINUE_RUNNING;
 }
 
 bool ForegroundCommand::areArgsValid() {
     _removeBackgroundSign(cmd_line);
-    auto args = _parseCommandLine(cmd_line);
+    auto args = getArgs();
 
     // valid cmd is "fg jobID" or "fg"
     if (args.size() > 2) {
@@ -211,6 +452,14 @@ bool ForegroundCommand::areArgsValid() {
 
     // here args.size() >= 2
     auto& jobID_str = args[1];
+    if (isJobSpec(jobID_str)) {
+        // "fg %spec", the most recent of the matched jobs is brought to fg
+        if (!selector.addJobSpec(jobID_str)) {
+            return false;
+        }
+        hasSelector = !selector.isSingleJobID(jobID);
+        return true;
+    }
     if ( ( jobID_str[0] == '-' && isStringOnlyDigits(jobID_str.substr(1))
         && !jobID_str.substr(1).empty() ) || isStringOnlyDigits(jobID_str)) {
         // jobID is negative or 0 or positive
@@ -234,16 +483,26 @@ JobList::JobEntry* ForegroundCommand::getJobToBringToFg() {
         // command is only "fg"
         job = smash.jobs.getLastJob();
         if (job == nullptr) {
-            std::cerr << "smash error: fg: jobs list is empty" << std::endl;
+            *err << "smash error: fg: jobs list is empty" << '\n';
             return nullptr;
         }
         jobID = job->jobID;
+    } else if (hasSelector) {
+        // command is "fg %spec"
+        auto selected_jobs = smash.jobs.selectJobs(selector);
+        if (selected_jobs.empty()) {
+            *err << "smash error: fg: no jobs match the job spec"
+                 << '\n';
+            return nullptr;
+        }
+        job = selected_jobs.back();
+        jobID = job->jobID;
     } else {
         // command is "fg <jobID>"
         job = smash.jobs.getJobById(jobID);
         if (job == nullptr) {
-            std::cerr << "smash error: fg: job-id " << jobID
-                      << " does not exist" << std::endl;
+            *err << "smash error: fg: job-id " << jobID
+                 << " does not exist" << '\n';
             return nullptr;
         }
     }
@@ -253,20 +512,21 @@ JobList::JobEntry* ForegroundCommand::getJobToBringToFg() {
 
 SmallShellNextState ForegroundCommand::execute() {
     if (!areArgsValid()) {
-        std::cerr << "smash error: fg: invalid arguments" << std::endl;
-        return CONTINUE_RUNNING;
+        *err << "smash error: fg: invalid arguments" << '\n';
+        throw CommandFail();
     }
 
     JobList::JobEntry* job = getJobToBringToFg();
     if (job == nullptr) {
-        return CONTINUE_RUNNING;
+        throw CommandFail();
     }
 
     // printing job details
-    std::cout << job->getJobCmdLine() << " : " << job->job_pid << std::endl;
+    SmallShell& smash = SmallShell::getInstance();
+    *out << job->getJobCmdLine() << " : " << job->job_pid << '\n';
 
     // run job in fg
-    SmallShell& smash = SmallShell::getInstance();
+    smash.sched_policy.applyOnTransition(*job, false);
     if (smash.updateFgCommand(job->cmd, job->job_pid, job->jobID) == FG_COMMAND_COMPLETED) {
         smash.jobs.removeJobById(jobID);
         return CONTINUE_RUNNING;
@@ -277,7 +537,21 @@ SmallShellNextState ForegroundCommand::execute() {
 
 bool BackgroundCommand::areArgsValid() {
     _removeBackgroundSign(cmd_line);
-    auto args = _parseCommandLine(cmd_line);
+    auto args = getArgs();
+
+    // "bg --cpus=LIST [jobID]" pins the resumed job to the cpus
+    const std::string cpus_option = "--cpus=";
+    for (auto it = args.begin(); it != args.end(); ++it) {
+        if (it->find(cpus_option) != 0) {
+            continue;
+        }
+        if (!parseCpuList(it->substr(cpus_option.size()), cpus)) {
+            return false;
+        }
+        hasCpusFromUser = true;
+        args.erase(it);
+        break;
+    }
 
     if (args.size() > 2) {
         return false;
@@ -289,6 +563,14 @@ bool BackgroundCommand::areArgsValid() {
 
     // here args.size() >= 2
     auto& jobID_str = args[1];
+    if (isJobSpec(jobID_str)) {
+        // "bg %spec", every stopped job among the matched jobs is resumed
+        if (!selector.addJobSpec(jobID_str)) {
+            return false;
+        }
+        hasSelector = !selector.isSingleJobID(jobID);
+        return true;
+    }
     if ( ( jobID_str[0] == '-' && isStringOnlyDigits(jobID_str.substr(1))
            && !jobID_str.substr(1).empty() ) || isStringOnlyDigits(jobID_str)) {
         // jobID is negative or 0 or positive
@@ -311,8 +593,8 @@ JobList::JobEntry *BackgroundCommand::getStoppedJobToBringToBg() {
         // command is only "bg"
         job = smash.jobs.getLastStoppedJob();
         if (job == nullptr) {
-            std::cerr << "smash error: bg: there is no stopped jobs to resume"
-                      << std::endl;
+            *err << "smash error: bg: there is no stopped jobs to resume"
+                 << '\n';
             return nullptr;
         }
         jobID = job->jobID;
@@ -320,13 +602,13 @@ JobList::JobEntry *BackgroundCommand::getStoppedJobToBringToBg() {
         // command is "bg <jobID>"
         job = smash.jobs.getJobById(jobID);
         if (job == nullptr) {
-            std::cerr << "smash error: bg: job-id " << jobID
-                      << " does not exist" << std::endl;
+            *err << "smash error: bg: job-id " << jobID
+                 << " does not exist" << '\n';
             return nullptr;
         }
         if (job->job_state == BG) {
-            std::cerr << "smash error: bg: job-id " << jobID
-                      << " is already running in the background" << std::endl;
+            *err << "smash error: bg: job-id " << jobID
+                 << " is already running in the background" << '\n';
             return nullptr;
         }
     }
@@ -336,28 +618,2573 @@ JobList::JobEntry *BackgroundCommand::getStoppedJobToBringToBg() {
 
 SmallShellNextState BackgroundCommand::execute() {
     if (!areArgsValid()) {
-        std:: cerr << "smash error: bg: invalid arguments" << std::endl;
+        *err << "smash error: bg: invalid arguments" << '\n';
+        return CONTINUE_RUNNING;
+    }
+
+    if (hasSelector) {
+        resumeSelectedJobs();
         return CONTINUE_RUNNING;
     }
 
     JobList::JobEntry* job = getStoppedJobToBringToBg();
     if (job == nullptr) {
-        return CONTINUE_RUNNING;
+        throw CommandFail();
     }
 
-    // printing job details
-    std::cout << job->getJobCmdLine() << " : " << job->job_pid << std::endl;
+    resumeJob(job);
 
+    return CONTINUE_RUNNING;
+}
+
+void BackgroundCommand::resumeJob(JobList::JobEntry* job) {
+    // printing job details
     SmallShell& smash = SmallShell::getInstance();
+    *out << job->getJobCmdLine() << " : " << job->job_pid << '\n';
+
+    if (hasCpusFromUser) {
+        smash.sched_policy.pinJob(*job, cpus);
+    } else {
+        smash.sched_policy.applyOnTransition(*job, true);
+    }
     smash.jobs.updateJobState(job, BG);
     smash.jobs.sendSignalToJob(job->jobID, SIGCONT);
+}
+
+void BackgroundCommand::resumeSelectedJobs() {
+    SmallShell& smash = SmallShell::getInstance();
+
+    bool resumed_any_job = false;
+    for (auto job : smash.jobs.selectJobs(selector)) {
+        if (job->job_state != STOPPED) {
+            continue;
+        }
+        resumeJob(job);
+        resumed_any_job = true;
+    }
+
+    if (!resumed_any_job) {
+        *err << "smash error: bg: there is no stopped jobs to resume"
+             << '\n';
+        throw CommandFail();
+    }
+}
+
+bool TaskSetCommand::areArgsValid() {
+    _removeBackgroundSign(cmd_line);
+    auto args = getArgs();
+
+    // valid cmd format is "taskset [-c LIST] jobID"
+    if (args.size() == 4 && args[1] == "-c") {
+        if (!parseCpuList(args[2], cpus)) {
+            return false;
+        }
+        hasCpusFromUser = true;
+    } else if (args.size() != 2) {
+        return false;
+    }
+
+    auto& jobID_str = args.back();
+    if (jobID_str.empty() || !isStringOnlyDigits(jobID_str)
+        || jobID_str.size() > 9) {
+        return false;
+    }
+    jobID = std::stoi(jobID_str, nullptr);
+
+    return true;
+}
+
+SmallShellNextState TaskSetCommand::execute() {
+    if (!areArgsValid()) {
+        // not a job, e.g. "taskset -c 0 cmd" for taskset(1) to run
+        return runAsExternalCommand();
+    }
+
+    SmallShell& smash = SmallShell::getInstance();
+    JobList::JobEntry* job = smash.jobs.getJobById(jobID);
+    if (job == nullptr) {
+        *err << "smash error: taskset: job-id " << jobID
+             << " does not exist" << '\n';
+        throw CommandFail();
+    }
+
+    if (hasCpusFromUser) {
+        smash.sched_policy.pinJob(*job, cpus);
+    }
+
+    // the actual affinity of the group leader, placed by smash or not
+    cpu_set_t job_cpus;
+    if (sched_getaffinity(job->job_pid, sizeof(job_cpus), &job_cpus) == -1) {
+        perror("smash error: sched_getaffinity failed");
+        throw SystemCallFail();
+    }
+    *out << "job-id " << jobID << " cpus: " << cpuListToString(job_cpus)
+         << '\n';
+
+    return CONTINUE_RUNNING;
+}
+
+bool JobPolicyCommand::areArgsValid() {
+    _removeBackgroundSign(cmd_line);
+    auto args = getArgs();
+    SmallShell& smash = SmallShell::getInstance();
+    SchedulingPolicy new_policy = smash.sched_policy;
+
+    // valid cmd format is "jobpolicy [--fg-cpus=LIST|all] [--bg-cpus=LIST|all]
+    // [--bg-nice=N|off] [--bg-io=be|idle|off]"
+    const std::string fg_cpus_option = "--fg-cpus=";
+    const std::string bg_cpus_option = "--bg-cpus=";
+    const std::string bg_nice_option = "--bg-nice=";
+    const std::string bg_io_option = "--bg-io=";
+    for (size_t i = 1; i < args.size(); i++) {
+        if (args[i].find(bg_nice_option) == 0) {
+            std::string nice_str = args[i].substr(bg_nice_option.size());
+            if (nice_str == "off") {
+                new_policy.demote_bg_nice = false;
+                continue;
+            }
+            if (nice_str.empty() || nice_str.size() > 2
+                || !isStringOnlyDigits(nice_str)
+                || std::stoi(nice_str, nullptr) > 19) {
+                return false;
+            }
+            new_policy.demote_bg_nice = true;
+            new_policy.bg_nice = std::stoi(nice_str, nullptr);
+            continue;
+        }
+        if (args[i].find(bg_io_option) == 0) {
+            std::string io_class = args[i].substr(bg_io_option.size());
+            if (io_class == "be") {
+                new_policy.bg_ioprio_class = IOPRIO_CLASS_BE_VALUE;
+            } else if (io_class == "idle") {
+                new_policy.bg_ioprio_class = IOPRIO_CLASS_IDLE_VALUE;
+            } else if (io_class == "off") {
+                new_policy.bg_ioprio_class = IOPRIO_CLASS_NONE_VALUE;
+            } else {
+                return false;
+            }
+            continue;
+        }
+
+        bool is_fg_option = (args[i].find(fg_cpus_option) == 0);
+        bool is_bg_option = (args[i].find(bg_cpus_option) == 0);
+        if (!is_fg_option && !is_bg_option) {
+            return false;
+        }
+
+        std::string cpu_list = args[i].substr(fg_cpus_option.size());
+        bool& has_cpus = is_fg_option ? new_policy.has_fg_cpus
+                                      : new_policy.has_bg_cpus;
+        cpu_set_t& cpus = is_fg_option ? new_policy.fg_cpus
+                                       : new_policy.bg_cpus;
+        if (cpu_list == "all") {
+            has_cpus = false;
+            CPU_ZERO(&cpus);
+        } else if (parseCpuList(cpu_list, cpus)) {
+            has_cpus = true;
+        } else {
+            return false;
+        }
+    }
+
+    // the policy changes only if all of the options are valid
+    smash.sched_policy = new_policy;
+    return true;
+}
+
+SmallShellNextState JobPolicyCommand::execute() {
+    if (!areArgsValid()) {
+        *err << "smash error: jobpolicy: invalid arguments" << '\n';
+        throw CommandFail();
+    }
+
+    SmallShell& smash = SmallShell::getInstance();
+    SchedulingPolicy& policy = smash.sched_policy;
+    *out << "fg cpus: " << (policy.has_fg_cpus
+                                 ? cpuListToString(policy.fg_cpus) : "all")
+         << '\n';
+    *out << "bg cpus: " << (policy.has_bg_cpus
+                                 ? cpuListToString(policy.bg_cpus) : "all")
+         << '\n';
+    *out << "bg nice: " << (policy.demote_bg_nice
+                                 ? std::to_string(policy.bg_nice) : "off")
+         << '\n';
+    *out << "bg io: "
+         << (policy.bg_ioprio_class == IOPRIO_CLASS_BE_VALUE ? "be"
+                  : policy.bg_ioprio_class == IOPRIO_CLASS_IDLE_VALUE ? "idle"
+                  : "off") << '\n';
+
+    return CONTINUE_RUNNING;
+}
+
+bool WaitCommand::parseTimeout(const std::string& timeout_str) {
+    // timeout is given in seconds, fractions are allowed
+    if (timeout_str.empty()
+        || timeout_str.find_first_not_of("0123456789.") != std::string::npos) {
+        return false;
+    }
+    try {
+        timeout_ms = static_cast<long long>(std::stod(timeout_str) * 1000);
+    } catch (const std::exception& e) {
+        return false;
+    }
+    return true;
+}
+
+bool WaitCommand::areArgsValid() {
+    _removeBackgroundSign(cmd_line);
+    auto args = getArgs();
+
+    // valid cmd format is "wait [-n] [--timeout SECS] [jobID ...]", a jobID
+    // may also be given as %jobID
+    const std::string timeout_option = "--timeout";
+    for (size_t i = 1; i < args.size(); i++) {
+        std::string& arg = args[i];
+        if (arg == "-n") {
+            waitForAnyJob = true;
+        } else if (arg == timeout_option) {
+            if (i + 1 >= args.size() || !parseTimeout(args[i + 1])) {
+                return false;
+            }
+            i++;
+        } else if (arg.find(timeout_option + "=") == 0) {
+            if (!parseTimeout(arg.substr(timeout_option.size() + 1))) {
+                return false;
+            }
+        } else {
+            std::string jobID_str = (arg[0] == '%') ? arg.substr(1) : arg;
+            if (jobID_str.empty() || !isStringOnlyDigits(jobID_str)
+                || jobID_str.size() > 9) {
+                return false;
+            }
+            jobIDs.push_back(std::stoi(jobID_str, nullptr));
+        }
+    }
+
+    return true;
+}
+
+void WaitCommand::printJobExitStatus(int jobID, int status) {
+    if (WIFSIGNALED(status)) {
+        *out << "smash: job-id " << jobID << " was killed by signal "
+             << WTERMSIG(status) << '\n';
+    } else {
+        *out << "smash: job-id " << jobID << " exited with status "
+             << WEXITSTATUS(status) << '\n';
+    }
+}
+
+SmallShellNextState WaitCommand::execute() {
+    if (!areArgsValid()) {
+        *err << "smash error: wait: invalid arguments" << '\n';
+        throw CommandFail();
+    }
+
+    SmallShell& smash = SmallShell::getInstance();
+
+    if (jobIDs.empty()) {
+        // plain "wait" waits for every running job, stopped jobs would
+        // never finish by themselves
+        int jobID = 0;
+        JobList::JobEntry* job;
+        while ((job = smash.jobs.getNextJob(jobID)) != nullptr) {
+            jobID = job->jobID;
+            if (job->job_state == BG) {
+                jobIDs.push_back(jobID);
+            }
+        }
+    }
+    for (int jobID : jobIDs) {
+        if (smash.jobs.getJobById(jobID) == nullptr
+            && !smash.jobs.hasFinishedJobStatus(jobID)) {
+            *err << "smash error: wait: job-id " << jobID
+                 << " does not exist" << '\n';
+            throw CommandFail();
+        }
+    }
+
+    long long deadline_ms = monotonicTimeMs() + timeout_ms;
+    smash.events.clearInterrupt();
+
+    // sleeps on SIGCHLD between checks, so waiting costs no cpu
+    while (!jobIDs.empty()) {
+        for (auto it = jobIDs.begin(); it != jobIDs.end(); ) {
+            int status;
+            smash.jobs.reapJobIfFinished(*it);
+            if (!smash.jobs.takeFinishedJobStatus(*it, status)) {
+                ++it;
+                continue;
+            }
+            printJobExitStatus(*it, status);
+            smash.setExitStatus(getExitStatus(status));
+            if (waitForAnyJob) {
+                return CONTINUE_RUNNING;
+            }
+            it = jobIDs.erase(it);
+        }
+        if (jobIDs.empty()) {
+            break;
+        }
+
+        int wait_ms = WAIT_FOREVER;
+        if (timeout_ms != WAIT_FOREVER) {
+            long long remaining_ms = deadline_ms - monotonicTimeMs();
+            if (remaining_ms <= 0) {
+                *err << "smash error: wait: timeout expired" << '\n';
+                throw CommandFail();
+            }
+            wait_ms = static_cast<int>(remaining_ms);
+        }
+
+        smash.out.flush();
+        if (smash.events.waitForEvents(wait_ms) == EVENT_INTERRUPTED) {
+            smash.setExitStatus(128 + SIGINT);
+            return CONTINUE_RUNNING;
+        }
+    }
+
+    return CONTINUE_RUNNING;
+}
 
+bool TimeoutCommand::areArgsValid() {
+    auto args = getArgs();
+
+    // valid cmd format is "timeout [-k GRACE] DURATION cmd"
+    size_t duration_idx = 1;
+    if (args.size() > 2 && args[1] == "-k") {
+        if (!parseDuration(args[2], kill_grace_ms)) {
+            return false;
+        }
+        duration_idx = 3;
+    }
+    if (args.size() <= duration_idx + 1
+        || !parseDuration(args[duration_idx], timeout_ms)) {
+        return false;
+    }
+
+    inner_cmd_line = _removeFirstWords(cmd_line, duration_idx + 1);
+
+    return !inner_cmd_line.empty();
+}
+
+SmallShellNextState TimeoutCommand::execute() {
+    if (!areArgsValid()) {
+        // e.g. -s or --preserve-status, which only timeout(1) has
+        return runAsExternalCommand();
+    }
+
+    SmallShell& smash = SmallShell::getInstance();
+    Command* cmd = smash.createCommand(inner_cmd_line);
+    if (cmd == nullptr) {
+        return CONTINUE_RUNNING;
+    }
+    // the inner cmd prints where this one was told to
+    cmd->out = out;
+    cmd->err = err;
+    cmd->in_fd = in_fd;
+
+    // the job launched by the inner cmd picks the deadline up. A zero
+    // duration means no timeout, like in timeout(1)
+    smash.next_job_timeout_ms = timeout_ms;
+    smash.next_job_kill_grace_ms = kill_grace_ms;
+
+    SmallShellNextState smash_next_state;
+    try {
+        smash_next_state = cmd->execute();
+    } catch (ExecutionFail& execution_fail) {
+        smash.next_job_timeout_ms = 0;
+        throw execution_fail;
+    }
+    smash.next_job_timeout_ms = 0;
+
+    return smash_next_state;
+}
+
+bool TimeCommand::areArgsValid() {
+    // valid cmd format is "time cmd"
+    inner_cmd_line = _removeFirstWords(cmd_line, 1);
+    return !inner_cmd_line.empty();
+}
+
+// "0m0.005s", like bash's time
+static std::string formatTimeval(const struct timeval& time) {
+    char formatted[64];
+    snprintf(formatted, sizeof(formatted), "%ldm%ld.%03lds",
+             (long)time.tv_sec / 60, (long)time.tv_sec % 60,
+             (long)time.tv_usec / 1000);
+    return formatted;
+}
+
+void TimeCommand::printTimes(long long wall_ns,
+                             const struct rusage& smash_start_usage) {
+    SmallShell& smash = SmallShell::getInstance();
+    // the cmd's proccesses, and smash's own share, e.g. a built-in's
+    struct rusage usage, smash_usage;
+    bool has_children_usage = smash.launch_timer.getChildrenUsage(usage);
+    getrusage(RUSAGE_SELF, &smash_usage);
+    struct timeval smash_time;
+    timersub(&smash_usage.ru_utime, &smash_start_usage.ru_utime, &smash_time);
+    timeradd(&usage.ru_utime, &smash_time, &usage.ru_utime);
+    timersub(&smash_usage.ru_stime, &smash_start_usage.ru_stime, &smash_time);
+    timeradd(&usage.ru_stime, &smash_time, &usage.ru_stime);
+    if (!has_children_usage) {
+        usage.ru_maxrss = smash_usage.ru_maxrss;
+    }
+
+    struct timeval wall_time;
+    wall_time.tv_sec = wall_ns / 1000000000;
+    wall_time.tv_usec = wall_ns % 1000000000 / 1000;
+    out->flush();
+    *err << '\n' << "real	" << formatTimeval(wall_time) << '\n'
+         << "user	" << formatTimeval(usage.ru_utime) << '\n'
+         << "sys	" << formatTimeval(usage.ru_stime) << '\n'
+         << "maxrss	" << usage.ru_maxrss << "K" << '\n';
+
+    // what is left of the wall time was spent in smash, e.g. by a built-in
+    long long phases_ns = 0;
+    for (int phase = 0; phase < LAUNCH_PHASES_COUNT; phase++) {
+        long long phase_ns = smash.launch_timer.getPhaseNs(
+                (LaunchPhase)phase);
+        phases_ns += phase_ns;
+        if (phase_ns == 0 && (phase == LAUNCH_FORK || phase == LAUNCH_EXEC
+                              || phase == LAUNCH_WAIT)) {
+            continue;
+        }
+        char formatted[64];
+        snprintf(formatted, sizeof(formatted), "%.3f ms", phase_ns / 1e6);
+        *err << getLaunchPhaseName((LaunchPhase)phase) << "	" << formatted;
+        if (phase == LAUNCH_FORK) {
+            *err << " (" << smash.launch_timer.getForksCount() << ")";
+        } else if (phase == LAUNCH_EXEC) {
+            *err << (smash.launch_timer.hasBashExec() ? " (bash -c)"
+                                                      : " (direct)");
+        }
+        *err << '\n';
+    }
+    char formatted[64];
+    snprintf(formatted, sizeof(formatted), "%.3f ms",
+             std::max(wall_ns - phases_ns, 0LL) / 1e6);
+    *err << "smash	" << formatted << '\n';
+}
+
+SmallShellNextState TimeCommand::execute() {
+    if (!areArgsValid()) {
+        *err << "smash error: time: invalid arguments" << '\n';
+        throw CommandFail();
+    }
+
+    SmallShell& smash = SmallShell::getInstance();
+    struct rusage smash_start_usage;
+    getrusage(RUSAGE_SELF, &smash_start_usage);
+    long long start_ns = monotonicTimeNs();
+    smash.launch_timer.start();
+    Command* cmd = smash.createCommand(inner_cmd_line);
+    if (cmd == nullptr) {
+        smash.launch_timer.stop();
+        return CONTINUE_RUNNING;
+    }
+    // the inner cmd prints where this one was told to
+    cmd->out = out;
+    cmd->err = err;
+    cmd->in_fd = in_fd;
+
+    SmallShellNextState smash_next_state;
+    try {
+        smash_next_state = cmd->execute();
+    } catch (ExecutionFail& execution_fail) {
+        smash.launch_timer.stop();
+        printTimes(monotonicTimeNs() - start_ns, smash_start_usage);
+        throw execution_fail;
+    }
+    smash.launch_timer.stop();
+    printTimes(monotonicTimeNs() - start_ns, smash_start_usage);
+
+    return smash_next_state;
+}
+
+bool StatsCommand::areArgsValid() {
+    _removeBackgroundSign(cmd_line);
+    auto args = getArgs();
+
+    // valid cmd format is "stats [--reset] [--json]"
+    for (size_t i = 1; i < args.size(); i++) {
+        if (args[i] == "--reset") {
+            is_resetting = true;
+        } else if (args[i] == "--json") {
+            is_json = true;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+// one row of the latencies table, in ms
+static void printLatencyRow(OutputSink& out, const std::string& name,
+                            const LatencyHistogram& histogram) {
+    char row[256];
+    snprintf(row, sizeof(row), "%-16s %10llu %10.3f %10.3f %10.3f %10.3f",
+             name.c_str(), histogram.getCount(),
+             histogram.getPercentile(50) / 1e6,
+             histogram.getPercentile(99) / 1e6,
+             histogram.getPercentile(99.9) / 1e6, histogram.getMax() / 1e6);
+    out << row << '\n';
+}
+
+void StatsCommand::printText() {
+    SmallShell& smash = SmallShell::getInstance();
+    char header[256];
+    snprintf(header, sizeof(header), "%-16s %10s %10s %10s %10s %10s",
+             "command", "count", "p50 ms", "p99 ms", "p999 ms", "max ms");
+    *out << header << '\n';
+    for (auto& command : smash.stats.getCommandHistograms()) {
+        printLatencyRow(*out, command.first, command.second);
+    }
+    *out << '\n';
+    snprintf(header, sizeof(header), "%-16s %10s %10s %10s %10s %10s",
+             "path", "count", "p50 ms", "p99 ms", "p999 ms", "max ms");
+    *out << header << '\n';
+    for (int path = 0; path < EXEC_PATHS_COUNT; path++) {
+        printLatencyRow(*out, getExecutionPathName((ExecutionPath)path),
+                        smash.stats.getPathHistogram((ExecutionPath)path));
+    }
+    *out << '\n';
+    for (int counter = 0; counter < STATS_COUNTERS_COUNT; counter++) {
+        char row[128];
+        snprintf(row, sizeof(row), "%-16s %10llu",
+                 getCounterName((ShellCounter)counter),
+                 smash.stats.getCounter((ShellCounter)counter));
+        *out << row << '\n';
+    }
+}
+
+// {"count":N,"p50_ns":N,...}
+static std::string toJsonObject(const LatencyHistogram& histogram) {
+    return "{\"count\":" + std::to_string(histogram.getCount())
+           + ",\"p50_ns\":" + std::to_string(histogram.getPercentile(50))
+           + ",\"p99_ns\":" + std::to_string(histogram.getPercentile(99))
+           + ",\"p999_ns\":" + std::to_string(histogram.getPercentile(99.9))
+           + ",\"max_ns\":" + std::to_string(histogram.getMax()) + "}";
+}
+
+void StatsCommand::printJson() {
+    SmallShell& smash = SmallShell::getInstance();
+    *out << "{\"commands\":{";
+    bool is_first = true;
+    for (auto& command : smash.stats.getCommandHistograms()) {
+        *out << (is_first ? "" : ",") << toJsonString(command.first) << ":"
+             << toJsonObject(command.second);
+        is_first = false;
+    }
+    *out << "},\"paths\":{";
+    for (int path = 0; path < EXEC_PATHS_COUNT; path++) {
+        *out << (path == 0 ? "" : ",") << "\""
+             << getExecutionPathName((ExecutionPath)path) << "\":"
+             << toJsonObject(smash.stats.getPathHistogram(
+                     (ExecutionPath)path));
+    }
+    *out << "},\"counters\":{";
+    for (int counter = 0; counter < STATS_COUNTERS_COUNT; counter++) {
+        *out << (counter == 0 ? "" : ",") << "\""
+             << getCounterName((ShellCounter)counter) << "\":"
+             << smash.stats.getCounter((ShellCounter)counter);
+    }
+    *out << "}}" << '\n';
+}
+
+SmallShellNextState StatsCommand::execute() {
+    if (!areArgsValid()) {
+        *err << "smash error: stats: invalid arguments" << '\n';
+        throw CommandFail();
+    }
+
+    if (is_json) {
+        printJson();
+    } else {
+        printText();
+    }
+    if (is_resetting) {
+        SmallShell::getInstance().stats.reset();
+    }
+    return CONTINUE_RUNNING;
+}
+
+bool TraceCommand::areArgsValid() {
+    _removeBackgroundSign(cmd_line);
+    auto args = getArgs();
+
+    // valid cmd format is "trace start|stop|dump file"
+    if (args.size() == 2 && (args[1] == "start" || args[1] == "stop")) {
+        action = args[1];
+        return true;
+    }
+    if (args.size() == 3 && args[1] == "dump") {
+        action = args[1];
+        file_path = args[2];
+        return true;
+    }
+    return false;
+}
+
+SmallShellNextState TraceCommand::execute() {
+    if (!areArgsValid()) {
+        *err << "smash error: trace: invalid arguments" << '\n';
+        throw CommandFail();
+    }
+#ifndef SMASH_TRACING
+    *err << "smash error: trace: smash was built without tracing" << '\n';
+    throw CommandFail();
+#endif
+
+    Tracer& tracer = Tracer::getInstance();
+    if (action == "start") {
+        tracer.start();
+        return CONTINUE_RUNNING;
+    }
+    if (action == "stop") {
+        tracer.stop();
+        return CONTINUE_RUNNING;
+    }
+
+    int fd = open(file_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                  0666);
+    if (fd == -1) {
+        perror("smash error: open failed");
+        throw SystemCallFail();
+    }
+    bool is_written = tracer.dump(fd);
+    if (close(fd) == -1 || !is_written) {
+        perror("smash error: write failed");
+        throw SystemCallFail();
+    }
+    return CONTINUE_RUNNING;
+}
+
+bool CaptureCommand::areArgsValid() {
+    auto args = getArgs();
+
+    // valid cmd format is "capture [-s SIZE[K|M]] cmd&", only bg jobs are
+    // captured, a fg job's output is for the terminal
+    if (!_isBackgroundCommand(cmd_line)) {
+        return false;
+    }
+
+    size_t inner_cmd_idx = 1;
+    if (args.size() > 2 && args[1] == "-s") {
+        std::string& size_str = args[2];
+        size_t digits_end = size_str.find_first_not_of("0123456789");
+        std::string suffix = (digits_end == std::string::npos)
+                             ? "" : size_str.substr(digits_end);
+        std::string digits = size_str.substr(0, digits_end);
+        if (digits.empty() || digits.size() > 9
+            || (suffix != "" && suffix != "K" && suffix != "M")) {
+            return false;
+        }
+        capture_size = std::stoul(digits, nullptr);
+        if (suffix == "K") {
+            capture_size *= 1024;
+        } else if (suffix == "M") {
+            capture_size *= 1024 * 1024;
+        }
+        if (capture_size == 0) {
+            return false;
+        }
+        inner_cmd_idx = 3;
+    }
+
+    inner_cmd_line = _removeFirstWords(cmd_line, inner_cmd_idx);
+    return !inner_cmd_line.empty();
+}
+
+void CaptureCommand::dropPendingCapture() {
+    // happens if the inner cmd launched no bg job
+    SmallShell& smash = SmallShell::getInstance();
+    delete smash.next_job_capture;
+    smash.next_job_capture = nullptr;
+}
+
+SmallShellNextState CaptureCommand::execute() {
+    if (!areArgsValid()) {
+        *err << "smash error: capture: invalid arguments" << '\n';
+        throw CommandFail();
+    }
+
+    SmallShell& smash = SmallShell::getInstance();
+    Command* cmd = smash.createCommand(inner_cmd_line);
+    if (cmd == nullptr) {
+        return CONTINUE_RUNNING;
+    }
+    // the inner cmd prints where this one was told to
+    cmd->out = out;
+    cmd->err = err;
+    cmd->in_fd = in_fd;
+
+    OutputCapture* capture = new OutputCapture();
+    if (!capture->create(capture_size)) {
+        delete capture;
+        throw SystemCallFail();
+    }
+    // the bg job launched by the inner cmd picks the capture up
+    smash.next_job_capture = capture;
+
+    SmallShellNextState smash_next_state;
+    try {
+        smash_next_state = cmd->execute();
+    } catch (ExecutionFail& execution_fail) {
+        dropPendingCapture();
+        throw execution_fail;
+    }
+    dropPendingCapture();
+
+    return smash_next_state;
+}
+
+bool JobLogCommand::areArgsValid() {
+    _removeBackgroundSign(cmd_line);
+    auto args = getArgs();
+
+    // valid cmd format is "joblog jobID [--tail K] [--follow]", the jobID
+    // may also be given as %jobID
+    if (args.size() < 2) {
+        return false;
+    }
+    std::string jobID_str = isJobSpec(args[1]) ? args[1].substr(1) : args[1];
+    if (jobID_str.empty() || jobID_str.size() > 9
+        || !isStringOnlyDigits(jobID_str)) {
+        return false;
+    }
+    jobID = std::stoi(jobID_str, nullptr);
+
+    for (size_t i = 2; i < args.size(); i++) {
+        if (args[i] == "--follow") {
+            follow = true;
+        } else if (args[i] == "--tail" && i + 1 < args.size()
+                   && !args[i + 1].empty() && args[i + 1].size() <= 9
+                   && isStringOnlyDigits(args[i + 1])) {
+            tail_lines_count = std::stoul(args[++i], nullptr);
+            if (tail_lines_count == 0) {
+                return false;
+            }
+        } else {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+SmallShellNextState JobLogCommand::execute() {
+    if (!areArgsValid()) {
+        *err << "smash error: joblog: invalid arguments" << '\n';
+        throw CommandFail();
+    }
+
+    SmallShell& smash = SmallShell::getInstance();
+    auto it = smash.job_captures.find(jobID);
+    if (it == smash.job_captures.end()) {
+        *err << "smash error: joblog: job-id " << jobID
+             << " has no captured output" << '\n';
+        throw CommandFail();
+    }
+    OutputCapture* capture = it->second;
+
+    unsigned long long offset = (tail_lines_count > 0)
+                                ? capture->getTailOffset(tail_lines_count) : 0;
+    // the captured bytes go straight to where the sink writes, after it
+    out->flush();
+    offset = capture->writeTo(out->getFd(), offset);
+
+    // keeps printing what the job writes until it is done or ctrl-C
+    smash.events.clearInterrupt();
+    while (follow && capture->isOpen()) {
+        if (smash.events.waitForEvents(WAIT_FOREVER) == EVENT_INTERRUPTED) {
+            break;
+        }
+        offset = capture->writeTo(out->getFd(), offset);
+    }
+
+    return CONTINUE_RUNNING;
+}
+
+bool ScheduleCommand::areArgsValid() {
+    // scheduled cmds always run in the bg
+    _removeBackgroundSign(cmd_line);
+    auto args = getArgs();
+
+    if (args.size() == 1) {
+        return true;
+    }
+    if (args[1] == "-d") {
+        if (args.size() != 3 || args[2].empty() || args[2].size() > 9
+            || !isStringOnlyDigits(args[2])) {
+            return false;
+        }
+        scheduleID_to_remove = std::stoi(args[2], nullptr);
+        return true;
+    }
+
+    when_str = args[1];
+    scheduled_cmd_line = _removeFirstWords(cmd_line, 2);
+    return !scheduled_cmd_line.empty();
+}
+
+SmallShellNextState ScheduleCommand::execute() {
+    if (!areArgsValid()) {
+        *err << "smash error: " << name << ": invalid arguments"
+             << '\n';
+        throw CommandFail();
+    }
+
+    Scheduler& scheduler = SmallShell::getInstance().scheduler;
+
+    if (scheduleID_to_remove != SCHEDULE_DOESNT_EXIST) {
+        if (!scheduler.removeSchedule(scheduleID_to_remove)) {
+            *err << "smash error: " << name << ": schedule-id "
+                 << scheduleID_to_remove << " does not exist"
+                 << '\n';
+            throw CommandFail();
+        }
+        return CONTINUE_RUNNING;
+    }
+    if (scheduled_cmd_line.empty()) {
+        scheduler.printSchedules(*out);
+        return CONTINUE_RUNNING;
+    }
+
+    long long first_run_ms;
+    long long interval_ms;
+    if (!parseWhen(when_str, first_run_ms, interval_ms)) {
+        *err << "smash error: " << name << ": invalid arguments"
+             << '\n';
+        throw CommandFail();
+    }
+
+    scheduler.addSchedule(scheduled_cmd_line, when_str, first_run_ms,
+                          interval_ms);
+    return CONTINUE_RUNNING;
+}
+
+bool EveryCommand::parseWhen(const std::string& when_str,
+                             long long& first_run_ms, long long& interval_ms) {
+    if (!parseDuration(when_str, interval_ms) || interval_ms <= 0) {
+        return false;
+    }
+    // like a "while true; do cmd; sleep INTERVAL; done" loop, the first
+    // run is right away
+    first_run_ms = monotonicTimeMs();
+    return true;
+}
+
+bool AtCommand::parseWhen(const std::string& when_str,
+                          long long& first_run_ms, long long& interval_ms) {
+    interval_ms = 0;
+
+    // "+DURATION" is relative to now
+    if (!when_str.empty() && when_str[0] == '+') {
+        long long delay_ms;
+        if (!parseDuration(when_str.substr(1), delay_ms)) {
+            return false;
+        }
+        first_run_ms = monotonicTimeMs() + delay_ms;
+        return true;
+    }
+
+    // "HH:MM[:SS]" is the next time the wall clock shows it
+    int hours;
+    int minutes;
+    int seconds = 0;
+    // %n is only set if the format matched up to it, and the match must
+    // take the whole string, e.g. "12:30x" is not 12:30
+    int when_size = static_cast<int>(when_str.size());
+    int parsed_size = -1;
+    sscanf(when_str.c_str(), "%d:%d%n", &hours, &minutes, &parsed_size);
+    if (parsed_size != when_size) {
+        parsed_size = -1;
+        sscanf(when_str.c_str(), "%d:%d:%d%n", &hours, &minutes, &seconds,
+               &parsed_size);
+    }
+    if (parsed_size != when_size || hours < 0 || hours > 23
+        || minutes < 0 || minutes > 59 || seconds < 0 || seconds > 59) {
+        return false;
+    }
+
+    time_t now = time(NULL);
+    struct tm run_time;
+    localtime_r(&now, &run_time);
+    run_time.tm_hour = hours;
+    run_time.tm_min = minutes;
+    run_time.tm_sec = seconds;
+    time_t run_at = mktime(&run_time);
+    if (run_at <= now) {
+        // the time already passed today
+        run_time.tm_mday++;
+        run_at = mktime(&run_time);
+    }
+
+    // the timers run on the monotonic clock
+    first_run_ms = monotonicTimeMs()
+                   + static_cast<long long>(difftime(run_at, now)) * 1000;
+    return true;
+}
+
+SmallShellNextState ExportCommand::execute() {
+    _removeBackgroundSign(cmd_line);
+    std::vector<std::string> assignments, args;
+    if (!expandCommandLine(cmd_line, assignments, args)) {
+        *err << "smash error: export: invalid arguments" << '\n';
+        throw CommandFail();
+    }
+
+    SmallShell& smash = SmallShell::getInstance();
+    if (args.size() == 1) {
+        for (auto& variable : smash.env.getExportedVars()) {
+            size_t equal_sign = variable.find('=');
+            *out << "export " << variable.substr(0, equal_sign) << "=\""
+                 << variable.substr(equal_sign + 1) << "\"" << '\n';
+        }
+        return CONTINUE_RUNNING;
+    }
+
+    bool are_all_names_valid = true;
+    for (size_t i = 1; i < args.size(); i++) {
+        size_t equal_sign = args[i].find('=');
+        std::string name = args[i].substr(0, equal_sign);
+        if (!isValidVariableName(name)) {
+            *err << "smash error: export: " << name
+                 << " is not a valid variable name" << '\n';
+            are_all_names_valid = false;
+            continue;
+        }
+        if (equal_sign == std::string::npos) {
+            smash.env.exportVar(name);
+        } else {
+            smash.env.set(name, args[i].substr(equal_sign + 1), true);
+        }
+    }
+    if (!are_all_names_valid) {
+        throw CommandFail();
+    }
+
+    return CONTINUE_RUNNING;
+}
+
+SmallShellNextState UnsetCommand::execute() {
+    _removeBackgroundSign(cmd_line);
+    auto args = getArgs();
+
+    SmallShell& smash = SmallShell::getInstance();
+    bool are_all_names_valid = true;
+    for (size_t i = 1; i < args.size(); i++) {
+        if (!isValidVariableName(args[i])) {
+            *err << "smash error: unset: " << args[i]
+                 << " is not a valid variable name" << '\n';
+            are_all_names_valid = false;
+            continue;
+        }
+        smash.env.unset(args[i]);
+    }
+    if (!are_all_names_valid) {
+        throw CommandFail();
+    }
+
+    return CONTINUE_RUNNING;
+}
+
+SmallShellNextState AssignCommand::execute() {
+    _removeBackgroundSign(cmd_line);
+    std::vector<std::string> assignments, args;
+    expandCommandLine(cmd_line, assignments, args);
+
+    // an exported variable stays exported with the new value
+    SmallShell& smash = SmallShell::getInstance();
+    for (auto& assignment : assignments) {
+        size_t equal_sign = assignment.find('=');
+        smash.env.set(assignment.substr(0, equal_sign),
+                      assignment.substr(equal_sign + 1));
+    }
+
+    return CONTINUE_RUNNING;
+}
+
+bool WordCountCommand::areArgsValid() {
+    _removeBackgroundSign(cmd_line);
+    auto args = getArgs();
+
+    // valid cmd format is "wc [-lwc] [file...]", options may be combined
+    bool is_in_options = true;
+    for (size_t i = 1; i < args.size(); i++) {
+        if (is_in_options && args[i] == "--") {
+            is_in_options = false;
+        } else if (is_in_options && args[i].size() > 1 && args[i][0] == '-') {
+            for (size_t j = 1; j < args[i].size(); j++) {
+                if (args[i][j] == 'l') {
+                    count_lines = true;
+                } else if (args[i][j] == 'w') {
+                    count_words = true;
+                } else if (args[i][j] == 'c') {
+                    count_bytes = true;
+                } else {
+                    return false;
+                }
+            }
+        } else {
+            is_in_options = false;
+            file_names.push_back(args[i]);
+        }
+    }
+
+    if (!count_lines && !count_words && !count_bytes) {
+        count_lines = count_words = count_bytes = true;
+    }
+    return true;
+}
+
+bool WordCountCommand::countFd(int fd, WordCounts& counts,
+                               bool& is_regular_file) {
+    struct stat fd_stat;
+    is_regular_file = (fstat(fd, &fd_stat) == 0 && S_ISREG(fd_stat.st_mode));
+
+    // a big file is counted right in the page cache, with no copying
+    size_t file_size = is_regular_file ? fd_stat.st_size : 0;
+    if (file_size >= wc_map_min_size) {
+        void* data = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            madvise(data, file_size, MADV_SEQUENTIAL | MADV_WILLNEED);
+            countWordsInParallel(static_cast<const char*>(data), file_size,
+                                 counts);
+            munmap(data, file_size);
+            return true;
+        }
+    }
+
+    SmallShell& smash = SmallShell::getInstance();
+    std::vector<char> buff(wc_read_size);
+    bool is_in_word = false;
+    while (!smash.events.isInterrupted()) {
+        ssize_t bytes_read_count = read(fd, buff.data(), buff.size());
+        if (bytes_read_count == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("smash error: read failed");
+            return false;
+        }
+        if (bytes_read_count == 0) {
+            return true;
+        }
+        countWords(buff.data(), bytes_read_count, is_in_word, counts);
+    }
+    return false;
+}
+
+static int getDigitsCount(unsigned long long number) {
+    int digits_count = 1;
+    while (number >= 10) {
+        number /= 10;
+        digits_count++;
+    }
+    return digits_count;
+}
+
+void WordCountCommand::printCounts(const WordCounts& counts,
+                                   const std::string& name, int width) {
+    std::string line;
+    const unsigned long long values[] = {counts.lines, counts.words,
+                                         counts.bytes};
+    const bool is_printed[] = {count_lines, count_words, count_bytes};
+    for (int i = 0; i < 3; i++) {
+        if (!is_printed[i]) {
+            continue;
+        }
+        std::string value_str = std::to_string(values[i]);
+        if (!line.empty()) {
+            line += ' ';
+        }
+        if ((int)value_str.size() < width) {
+            line.append(width - value_str.size(), ' ');
+        }
+        line += value_str;
+    }
+    if (!name.empty()) {
+        line += ' ';
+        line += name;
+    }
+    *out << line << '\n';
+}
+
+SmallShellNextState WordCountCommand::execute() {
+    if (!areArgsValid()) {
+        return runAsExternalCommand();
+    }
+
+    SmallShell& smash = SmallShell::getInstance();
+    smash.events.clearInterrupt();
+    bool is_from_input = file_names.empty();
+    if (is_from_input) {
+        file_names.push_back("");
+    }
+
+    std::vector<WordCounts> file_counts;
+    std::vector<bool> is_counted;
+    WordCounts total_counts = {0, 0, 0};
+    bool has_failed = false;
+    bool has_non_regular_file = false;
+    for (auto& file_name : file_names) {
+        WordCounts counts = {0, 0, 0};
+        int fd = is_from_input ? in_fd : open(file_name.c_str(), O_RDONLY);
+        if (fd == -1) {
+            perror("smash error: open failed");
+            has_failed = true;
+            file_counts.push_back(counts);
+            is_counted.push_back(false);
+            continue;
+        }
+        bool is_regular_file;
+        if (!countFd(fd, counts, is_regular_file)) {
+            has_failed = true;
+        }
+        if (!is_from_input) {
+            close(fd);
+        }
+        has_non_regular_file = has_non_regular_file || !is_regular_file;
+        file_counts.push_back(counts);
+        is_counted.push_back(true);
+        total_counts.lines += counts.lines;
+        total_counts.words += counts.words;
+        total_counts.bytes += counts.bytes;
+        if (smash.events.isInterrupted()) {
+            break;
+        }
+    }
+
+    // columns are as wide as the biggest number, like in wc(1). A single
+    // number is not padded, a stream's size isn't known in advance
+    int width = getDigitsCount(std::max(total_counts.lines,
+                    std::max(total_counts.words, total_counts.bytes)));
+    int counts_printed = count_lines + count_words + count_bytes;
+    if (counts_printed == 1 && file_names.size() == 1) {
+        width = 1;
+    } else if (has_non_regular_file) {
+        width = std::max(width, 7);
+    }
+    for (size_t i = 0; i < file_counts.size(); i++) {
+        if (is_counted[i]) {
+            printCounts(file_counts[i], file_names[i], width);
+        }
+    }
+    if (file_names.size() > 1) {
+        printCounts(total_counts, "total", width);
+    }
+
+    if (smash.events.isInterrupted()) {
+        smash.setExitStatus(128 + SIGINT);
+        throw CommandFail();
+    }
+    if (has_failed) {
+        throw CommandFail();
+    }
+    return CONTINUE_RUNNING;
+}
+
+bool GrepCommand::areArgsValid() {
+    _removeBackgroundSign(cmd_line);
+    // expanded here, a quoted pattern may have spaces
+    std::vector<std::string> assignments, args;
+    if (!expandCommandLine(cmd_line, assignments, args)
+        || !assignments.empty()) {
+        return false;
+    }
+
+    // valid cmd format is "grep [-FEGivclqnHh] [-e] pattern [file...]",
+    // options may be combined
+    bool has_pattern = false;
+    int file_names_option = 0;
+    bool is_in_options = true;
+    for (size_t i = 1; i < args.size(); i++) {
+        if (is_in_options && args[i] == "--") {
+            is_in_options = false;
+        } else if (is_in_options && args[i].size() > 1 && args[i][0] == '-') {
+            for (size_t j = 1; j < args[i].size(); j++) {
+                char option = args[i][j];
+                if (option == 'e') {
+                    // the rest of the arg, or the next one, is the pattern
+                    if (has_pattern) {
+                        return false;
+                    }
+                    if (j + 1 < args[i].size()) {
+                        pattern = args[i].substr(j + 1);
+                    } else if (i + 1 < args.size()) {
+                        pattern = args[++i];
+                    } else {
+                        return false;
+                    }
+                    has_pattern = true;
+                    break;
+                } else if (option == 'F') {
+                    options.is_fixed_string = true;
+                } else if (option == 'E') {
+                    options.is_extended = true;
+                    options.is_fixed_string = false;
+                } else if (option == 'G') {
+                    options.is_extended = false;
+                    options.is_fixed_string = false;
+                } else if (option == 'i') {
+                    options.is_ignoring_case = true;
+                } else if (option == 'v') {
+                    options.is_inverted = true;
+                } else if (option == 'c') {
+                    options.is_counting = true;
+                } else if (option == 'l') {
+                    options.is_listing_files = true;
+                } else if (option == 'q') {
+                    options.is_quiet = true;
+                } else if (option == 'n') {
+                    options.has_line_numbers = true;
+                } else if (option == 'H' || option == 'h') {
+                    file_names_option = option;
+                } else {
+                    return false;
+                }
+            }
+        } else if (!has_pattern) {
+            is_in_options = false;
+            pattern = args[i];
+            has_pattern = true;
+        } else {
+            is_in_options = false;
+            file_names.push_back(args[i]);
+        }
+    }
+
+    if (file_names_option == 0) {
+        options.has_file_names = file_names.size() > 1;
+    } else {
+        options.has_file_names = (file_names_option == 'H');
+    }
+    return has_pattern;
+}
+
+bool GrepCommand::searchFd(int fd, const std::string& name,
+                           const LineMatcher& matcher, OutputSink* sink,
+                           std::string& output,
+                           unsigned long long& selected_count,
+                           int& error_number) {
+    SmallShell& smash = SmallShell::getInstance();
+    bool is_stopping_at_first = options.is_listing_files || options.is_quiet;
+    unsigned long long line_number = 0;
+    auto search = [&](const char* data, size_t size) {
+        selected_count += matcher.searchLines(data, size, name, line_number,
+                                              output);
+        if (sink != nullptr && !output.empty()) {
+            sink->write(output.data(), output.size());
+            sink->flush();
+            output.clear();
+        }
+        return !(is_stopping_at_first && selected_count > 0);
+    };
+
+    struct stat fd_stat;
+    bool is_regular_file = (fstat(fd, &fd_stat) == 0
+                            && S_ISREG(fd_stat.st_mode));
+    size_t file_size = is_regular_file ? fd_stat.st_size : 0;
+    if (file_size >= grep_map_min_size) {
+        void* mapping = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd,
+                             0);
+        if (mapping != MAP_FAILED) {
+            madvise(mapping, file_size, MADV_SEQUENTIAL | MADV_WILLNEED);
+            // searched a window of whole lines at a time, so output and
+            // ctrl-C don't wait for the whole file
+            const char* data = static_cast<const char*>(mapping);
+            size_t pos = 0;
+            bool is_searching = true;
+            while (is_searching && pos < file_size
+                   && !smash.events.isInterrupted()) {
+                size_t window_end = std::min(pos + grep_read_size, file_size);
+                if (window_end < file_size) {
+                    const void* newline = memrchr(data + pos, '\n',
+                                                  window_end - pos);
+                    if (newline == nullptr) {
+                        newline = memchr(data + window_end, '\n',
+                                         file_size - window_end);
+                    }
+                    window_end = newline
+                            ? static_cast<const char*>(newline) - data + 1
+                            : file_size;
+                }
+                is_searching = search(data + pos, window_end - pos);
+                pos = window_end;
+            }
+            munmap(mapping, file_size);
+            error_number = 0;
+            return !smash.events.isInterrupted();
+        }
+    }
+
+    // the partial last line of a block waits for the next one
+    std::string lines;
+    std::vector<char> buff(grep_read_size);
+    while (!smash.events.isInterrupted()) {
+        ssize_t bytes_read_count = read(fd, buff.data(), buff.size());
+        if (bytes_read_count == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            error_number = errno;
+            return false;
+        }
+        if (bytes_read_count == 0) {
+            if (!lines.empty()) {
+                search(lines.data(), lines.size());
+            }
+            return true;
+        }
+        lines.append(buff.data(), bytes_read_count);
+        size_t last_newline = lines.rfind('\n');
+        if (last_newline == std::string::npos) {
+            continue;
+        }
+        if (!search(lines.data(), last_newline + 1)) {
+            return true;
+        }
+        lines.erase(0, last_newline + 1);
+    }
+    error_number = 0;
+    return false;
+}
+
+void GrepCommand::appendFileSummary(const std::string& name,
+                                    unsigned long long selected_count,
+                                    std::string& output) {
+    if (options.is_quiet) {
+        return;
+    }
+    if (options.is_listing_files) {
+        if (selected_count > 0) {
+            output += name;
+            output += '\n';
+        }
+    } else if (options.is_counting) {
+        if (options.has_file_names) {
+            output += name;
+            output += ':';
+        }
+        output += std::to_string(selected_count);
+        output += '\n';
+    }
+}
+
+unsigned long long GrepCommand::searchFilesInParallel(bool& has_failed) {
+    SmallShell& smash = SmallShell::getInstance();
+    std::vector<FileResult> results(file_names.size());
+    std::atomic<size_t> next_file_index(0);
+    std::atomic<bool> is_stopping(false);
+    std::mutex lock;
+    std::condition_variable has_done;
+
+    // each worker has its own matcher, regexec locks a shared regex
+    auto work = [&]() {
+        LineMatcher matcher(pattern, options);
+        std::string error;
+        matcher.compile(error);
+        size_t i;
+        while ((i = next_file_index++) < file_names.size()) {
+            FileResult& result = results[i];
+            result.selected_count = 0;
+            result.error_number = 0;
+            if (!is_stopping && !smash.events.isInterrupted()) {
+                int fd = open(file_names[i].c_str(), O_RDONLY);
+                result.failed_call = "smash error: open failed";
+                if (fd == -1) {
+                    result.error_number = errno;
+                } else {
+                    result.failed_call = "smash error: read failed";
+                    searchFd(fd, file_names[i], matcher, nullptr,
+                             result.output, result.selected_count,
+                             result.error_number);
+                    close(fd);
+                }
+                appendFileSummary(file_names[i], result.selected_count,
+                                  result.output);
+            }
+            std::lock_guard<std::mutex> guard(lock);
+            result.is_done = true;
+            has_done.notify_all();
+        }
+    };
+
+    int threads_count = std::min<int>(std::thread::hardware_concurrency(),
+                                      grep_max_threads);
+    threads_count = std::min<int>(std::max(threads_count, 1),
+                                  file_names.size());
+    std::vector<std::thread> workers;
+    try {
+        for (int i = 0; i < threads_count; i++) {
+            workers.emplace_back(work);
+        }
+    } catch (std::system_error& e) {
+        // the files that are left are searched by the threads that started
+    }
+    if (workers.empty()) {
+        work();
+    }
+
+    // printed in the order of the files, each one once it is done
+    unsigned long long selected_count = 0;
+    for (size_t i = 0; i < results.size(); i++) {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            has_done.wait(guard, [&]() { return results[i].is_done; });
+        }
+        FileResult& result = results[i];
+        if (result.error_number != 0) {
+            out->flush();
+            errno = result.error_number;
+            perror(result.failed_call);
+            has_failed = true;
+        }
+        out->write(result.output.data(), result.output.size());
+        out->flush();
+        std::string().swap(result.output);
+        selected_count += result.selected_count;
+        if (options.is_quiet && selected_count > 0) {
+            is_stopping = true;
+        }
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    return selected_count;
+}
+
+SmallShellNextState GrepCommand::execute() {
+    if (!areArgsValid()) {
+        return runAsExternalCommand();
+    }
+    SmallShell& smash = SmallShell::getInstance();
+    LineMatcher matcher(pattern, options);
+    std::string error;
+    if (!matcher.compile(error)) {
+        *err << "smash error: grep: " << error << '\n';
+        smash.setExitStatus(2);
+        throw CommandFail();
+    }
+
+    smash.events.clearInterrupt();
+    unsigned long long selected_count = 0;
+    bool has_failed = false;
+    if (file_names.size() > 1) {
+        selected_count = searchFilesInParallel(has_failed);
+    } else {
+        // a single file or the input is written out as it is searched
+        bool is_from_input = file_names.empty();
+        std::string name = is_from_input ? "(standard input)" : file_names[0];
+        int fd = is_from_input ? in_fd : open(name.c_str(), O_RDONLY);
+        if (fd == -1) {
+            perror("smash error: open failed");
+            has_failed = true;
+        } else {
+            std::string output;
+            int error_number = 0;
+            if (!searchFd(fd, name, matcher, out, output, selected_count,
+                          error_number) && error_number != 0) {
+                errno = error_number;
+                perror("smash error: read failed");
+                has_failed = true;
+            }
+            if (!is_from_input) {
+                close(fd);
+            }
+            appendFileSummary(name, selected_count, output);
+            *out << output;
+        }
+    }
+
+    if (smash.events.isInterrupted()) {
+        smash.setExitStatus(128 + SIGINT);
+        throw CommandFail();
+    }
+    // like grep(1), 0 if a line was selected, 1 if none, 2 on errors
+    if (has_failed && !(options.is_quiet && selected_count > 0)) {
+        smash.setExitStatus(2);
+        throw CommandFail();
+    }
+    if (selected_count == 0) {
+        smash.setExitStatus(1);
+    }
+    return CONTINUE_RUNNING;
+}
+
+bool SortCommand::areArgsValid() {
+    _removeBackgroundSign(cmd_line);
+    auto args = getArgs();
+
+    // valid cmd format is "sort [-ru] [-S size] [-T dir] [--stats]
+    // [file...]", -r and -u may be combined
+    const char* tmpdir = getenv("TMPDIR");
+    temp_dir = (tmpdir != nullptr && *tmpdir != '\0') ? tmpdir : "/tmp";
+    bool is_in_options = true;
+    for (size_t i = 1; i < args.size(); i++) {
+        if (is_in_options && args[i] == "--") {
+            is_in_options = false;
+        } else if (is_in_options && args[i] == "--stats") {
+            is_showing_stats = true;
+        } else if (is_in_options && (args[i] == "-S" || args[i] == "-T")) {
+            if (i + 1 == args.size()) {
+                return false;
+            }
+            if (args[i] == "-T") {
+                temp_dir = args[++i];
+            } else if (!parseSize(args[++i], memory_budget)
+                       || memory_budget < sort_min_memory_budget) {
+                return false;
+            }
+        } else if (is_in_options && args[i].size() > 1 && args[i][0] == '-') {
+            for (size_t j = 1; j < args[i].size(); j++) {
+                if (args[i][j] == 'r') {
+                    options.is_reversed = true;
+                } else if (args[i][j] == 'u') {
+                    options.is_unique = true;
+                } else {
+                    return false;
+                }
+            }
+        } else {
+            is_in_options = false;
+            file_names.push_back(args[i]);
+        }
+    }
+    return true;
+}
+
+bool SortCommand::readFd(int fd) {
+    SmallShell& smash = SmallShell::getInstance();
+    // half of the budget is for the data, the rest for its lines and the
+    // buffer the threads merge into
+    size_t chunk_budget = memory_budget / 2;
+    // reserved once, growing it would double the memory
+    chunk.reserve(chunk_budget + sort_read_size);
+    std::vector<char> buff(sort_read_size);
+    while (!smash.events.isInterrupted()) {
+        ssize_t bytes_read_count = read(fd, buff.data(), buff.size());
+        if (bytes_read_count == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("smash error: read failed");
+            return false;
+        }
+        if (bytes_read_count == 0) {
+            // the last line of a file ends with it
+            if (!chunk.empty() && chunk.back() != '\n') {
+                chunk += '\n';
+            }
+            return true;
+        }
+        chunk.append(buff.data(), bytes_read_count);
+        stats.bytes_count += bytes_read_count;
+
+        size_t last_newline;
+        if (chunk.size() >= chunk_budget
+            && (last_newline = chunk.rfind('\n')) != std::string::npos) {
+            // the partial line after the run starts the next one
+            std::string partial_line = chunk.substr(last_newline + 1);
+            chunk.resize(last_newline + 1);
+            if (!spillChunk()) {
+                return false;
+            }
+            chunk.assign(partial_line);
+        }
+    }
+    return false;
+}
+
+static int getSortThreadsCount() {
+    int cores_count = std::thread::hardware_concurrency();
+    return std::max(1, std::min(cores_count, sort_max_threads));
+}
+
+void SortCommand::sortChunk() {
+    chunk_lines.clear();
+    size_t pos = 0;
+    while (pos < chunk.size()) {
+        const char* newline = static_cast<const char*>(
+                memchr(chunk.data() + pos, '\n', chunk.size() - pos));
+        size_t line_end = newline ? newline - chunk.data() : chunk.size();
+        SortLine line;
+        makeSortLine(chunk.data() + pos, line_end - pos, line);
+        chunk_lines.push_back(line);
+        pos = line_end + 1;
+    }
+    stats.lines_count += chunk_lines.size();
+
+    long long start_ms = monotonicTimeMs();
+    sortLinesInParallel(chunk_lines, options, getSortThreadsCount());
+    stats.sort_ms += monotonicTimeMs() - start_ms;
+}
+
+bool SortCommand::spillChunk() {
+    sortChunk();
+    long long start_ms = monotonicTimeMs();
+    int fd = openTemporaryFile(temp_dir);
+    if (fd == -1) {
+        perror("smash error: mkstemp failed");
+        return false;
+    }
+    run_fds.push_back(fd);
+
+    // the lines are copied in sorted order into blocks, written whole
+    std::string block;
+    block.reserve(sort_read_size);
+    for (size_t i = 0; i <= chunk_lines.size(); i++) {
+        bool is_last = (i == chunk_lines.size());
+        if (!is_last) {
+            block.append(chunk_lines[i].data, chunk_lines[i].size);
+            block += '\n';
+        }
+        if (block.size() < sort_read_size && !is_last) {
+            continue;
+        }
+        size_t written_size = 0;
+        while (written_size < block.size()) {
+            ssize_t bytes_written_count = write(fd,
+                    block.data() + written_size, block.size() - written_size);
+            if (bytes_written_count == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                perror("smash error: write failed");
+                return false;
+            }
+            written_size += bytes_written_count;
+        }
+        stats.spilled_bytes_count += block.size();
+        block.clear();
+    }
+    if (lseek(fd, 0, SEEK_SET) == -1) {
+        perror("smash error: lseek failed");
+        return false;
+    }
+
+    stats.runs_count++;
+    chunk.clear();
+    chunk_lines.clear();
+    stats.spill_ms += monotonicTimeMs() - start_ms;
+    return true;
+}
+
+bool SortCommand::mergeRuns() {
+    SmallShell& smash = SmallShell::getInstance();
+    sortChunk();
+    long long start_ms = monotonicTimeMs();
+
+    // with nothing spilled the chunk is the only run
+    std::vector<SortedRun*> runs;
+    for (int fd : run_fds) {
+        runs.push_back(new FileRun(fd));
+    }
+    run_fds.clear();
+    runs.push_back(new MemoryRun(chunk_lines));
+    LoserTree merger(runs, options);
+
+    std::string block;
+    std::string prev_line;
+    bool has_prev_line = false;
+    bool has_failed = false;
+    unsigned long long lines_count = 0;
+    SortLine line;
+    while (merger.next(line)) {
+        if (options.is_unique) {
+            if (has_prev_line && prev_line.size() == line.size
+                && memcmp(prev_line.data(), line.data, line.size) == 0) {
+                continue;
+            }
+            prev_line.assign(line.data, line.size);
+            has_prev_line = true;
+        }
+        block.append(line.data, line.size);
+        block += '\n';
+        if (block.size() >= sort_read_size) {
+            out->write(block.data(), block.size());
+            block.clear();
+        }
+        if (++lines_count % 65536 == 0 && smash.events.isInterrupted()) {
+            has_failed = true;
+            break;
+        }
+    }
+    out->write(block.data(), block.size());
+
+    for (auto run : runs) {
+        if (run->hasFailed()) {
+            perror("smash error: read failed");
+            has_failed = true;
+        }
+        delete run;
+    }
+    stats.merge_ms += monotonicTimeMs() - start_ms;
+    return !has_failed;
+}
+
+void SortCommand::printStats() {
+    out->flush();
+    *err << "sort: " << stats.lines_count << " lines, " << stats.bytes_count
+         << " bytes, " << stats.runs_count << " runs spilled ("
+         << stats.spilled_bytes_count << " bytes), " << getSortThreadsCount()
+         << " threads" << '\n';
+    *err << "sort: read " << stats.read_ms << " ms, sort " << stats.sort_ms
+         << " ms, spill " << stats.spill_ms << " ms, merge "
+         << stats.merge_ms << " ms" << '\n';
+}
+
+SmallShellNextState SortCommand::execute() {
+    if (!areArgsValid()) {
+        return runAsExternalCommand();
+    }
+
+    SmallShell& smash = SmallShell::getInstance();
+    smash.events.clearInterrupt();
+    long long start_ms = monotonicTimeMs();
+    bool has_failed = false;
+    if (file_names.empty()) {
+        has_failed = !readFd(in_fd);
+    }
+    for (auto& file_name : file_names) {
+        int fd = open(file_name.c_str(), O_RDONLY);
+        if (fd == -1) {
+            perror("smash error: open failed");
+            has_failed = true;
+            break;
+        }
+        has_failed = !readFd(fd);
+        close(fd);
+        if (has_failed) {
+            break;
+        }
+    }
+    // reading includes the sorting and spilling of the runs on the way
+    stats.read_ms = monotonicTimeMs() - start_ms - stats.sort_ms
+                    - stats.spill_ms;
+
+    // like sort(1), nothing is printed unless all the input was read
+    if (!has_failed) {
+        has_failed = !mergeRuns();
+    }
+    if (is_showing_stats) {
+        printStats();
+    }
+
+    if (smash.events.isInterrupted()) {
+        smash.setExitStatus(128 + SIGINT);
+        throw CommandFail();
+    }
+    if (has_failed) {
+        smash.setExitStatus(2);
+        throw CommandFail();
+    }
+    return CONTINUE_RUNNING;
+}
+
+bool SumCommand::areArgsValid() {
+    _removeBackgroundSign(cmd_line);
+    auto args = getArgs();
+
+    // valid cmd format is "sum [-a crc32c|xxh3|sha256] [--tree] [-c]
+    // [file...]"
+    bool is_in_options = true;
+    for (size_t i = 1; i < args.size(); i++) {
+        if (is_in_options && args[i] == "--") {
+            is_in_options = false;
+        } else if (is_in_options && args[i] == "--tree") {
+            is_tree_mode = true;
+        } else if (is_in_options && args[i] == "-c") {
+            is_checking = true;
+        } else if (is_in_options && args[i] == "-a") {
+            if (i + 1 == args.size()
+                || !parseChecksumAlgorithm(args[++i], algorithm)) {
+                return false;
+            }
+            has_algorithm = true;
+        } else if (is_in_options && args[i].size() > 1 && args[i][0] == '-') {
+            return false;
+        } else {
+            is_in_options = false;
+            file_names.push_back(args[i]);
+        }
+    }
+    return true;
+}
+
+bool SumCommand::hashFd(int fd, FileDigest& file_digest, int threads_count) {
+    SmallShell& smash = SmallShell::getInstance();
+    struct stat fd_stat;
+    bool is_regular_file = (fstat(fd, &fd_stat) == 0
+                            && S_ISREG(fd_stat.st_mode));
+    size_t file_size = is_regular_file ? fd_stat.st_size : 0;
+    // parts of a big file are hashed in parallel where the algorithm
+    // allows it. Otherwise it is hashed in place a window at a time, so
+    // ctrl-C doesn't wait for the whole file
+    bool is_hashed_by_parts = is_tree_mode
+                              || file_digest.algorithm == CRC32C;
+    if (file_size >= checksum_map_min_size) {
+        void* mapping = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd,
+                             0);
+        if (mapping != MAP_FAILED) {
+            madvise(mapping, file_size, MADV_SEQUENTIAL | MADV_WILLNEED);
+            const char* data = static_cast<const char*>(mapping);
+            if (is_hashed_by_parts) {
+                file_digest.hex = toHex(hashBuffer(file_digest.algorithm,
+                        data, file_size, is_tree_mode, threads_count));
+            } else {
+                Hasher* hasher = createHasher(file_digest.algorithm);
+                for (size_t pos = 0; pos < file_size
+                     && !smash.events.isInterrupted();
+                     pos += checksum_part_min_size) {
+                    hasher->update(data + pos, std::min(
+                            checksum_part_min_size, file_size - pos));
+                }
+                file_digest.hex = toHex(hasher->finish());
+                delete hasher;
+            }
+            munmap(mapping, file_size);
+            return !smash.events.isInterrupted();
+        }
+    }
+
+    Hasher* hasher = createHasher(file_digest.algorithm, is_tree_mode);
+    std::vector<char> buff(checksum_read_size);
+    bool is_done = false;
+    while (!is_done && !smash.events.isInterrupted()) {
+        ssize_t bytes_read_count = read(fd, buff.data(), buff.size());
+        if (bytes_read_count == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            file_digest.error_number = errno;
+            file_digest.failed_call = "smash error: read failed";
+            break;
+        }
+        is_done = (bytes_read_count == 0);
+        hasher->update(buff.data(), bytes_read_count);
+    }
+    if (is_done) {
+        file_digest.hex = toHex(hasher->finish());
+    }
+    delete hasher;
+    return is_done;
+}
+
+void SumCommand::hashFiles(std::vector<FileDigest>& file_digests,
+                           const std::function<void(FileDigest&)>& on_done) {
+    SmallShell& smash = SmallShell::getInstance();
+    int threads_count = getChecksumThreadsCount();
+    // a single file gets all the threads, several files one each
+    int file_threads_count = (file_digests.size() == 1) ? threads_count : 1;
+    std::atomic<size_t> next_file_index(0);
+    std::mutex lock;
+    std::condition_variable has_done;
+
+    auto work = [&]() {
+        size_t i;
+        while ((i = next_file_index++) < file_digests.size()) {
+            FileDigest& file_digest = file_digests[i];
+            if (!smash.events.isInterrupted()) {
+                // "-" is the input, like in sha256sum(1)
+                bool is_from_input = (file_digest.name == "-");
+                int fd = is_from_input
+                         ? in_fd : open(file_digest.name.c_str(), O_RDONLY);
+                if (fd == -1) {
+                    file_digest.error_number = errno;
+                    file_digest.failed_call = "smash error: open failed";
+                } else {
+                    hashFd(fd, file_digest, file_threads_count);
+                    if (!is_from_input) {
+                        close(fd);
+                    }
+                }
+            }
+            std::lock_guard<std::mutex> guard(lock);
+            file_digest.is_done = true;
+            has_done.notify_all();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    if (file_digests.size() > 1) {
+        int workers_count = std::min<int>(threads_count, file_digests.size());
+        try {
+            for (int i = 0; i < workers_count; i++) {
+                workers.emplace_back(work);
+            }
+        } catch (std::system_error& e) {
+            // the files that are left are hashed by the threads that started
+        }
+    }
+    if (workers.empty()) {
+        work();
+    }
+
+    for (auto& file_digest : file_digests) {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            has_done.wait(guard, [&]() { return file_digest.is_done; });
+        }
+        if (file_digest.error_number != 0) {
+            out->flush();
+            errno = file_digest.error_number;
+            perror(file_digest.failed_call);
+        }
+        on_done(file_digest);
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+bool SumCommand::printFileDigests() {
+    if (file_names.empty()) {
+        file_names.push_back("-");
+    }
+    std::vector<FileDigest> file_digests;
+    for (auto& file_name : file_names) {
+        FileDigest file_digest = {file_name, algorithm, "", 0, nullptr,
+                                  false};
+        file_digests.push_back(file_digest);
+    }
+
+    bool has_failed = false;
+    hashFiles(file_digests, [&](FileDigest& file_digest) {
+        if (file_digest.hex.empty()) {
+            has_failed = true;
+            return;
+        }
+        *out << file_digest.hex << "  " << file_digest.name << '\n';
+    });
+    return !has_failed;
+}
+
+bool SumCommand::readCheckList(int fd, std::vector<FileDigest>& file_digests,
+                               std::vector<std::string>& expected_hexes,
+                               int& bad_lines_count) {
+    std::string list;
+    std::vector<char> buff(checksum_read_size);
+    while (true) {
+        ssize_t bytes_read_count = read(fd, buff.data(), buff.size());
+        if (bytes_read_count == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("smash error: read failed");
+            return false;
+        }
+        if (bytes_read_count == 0) {
+            break;
+        }
+        list.append(buff.data(), bytes_read_count);
+    }
+
+    // "<checksum>  <name>", or "<checksum> *<name>" for binary mode. The
+    // algorithm goes by the checksum's length unless -a is given
+    std::istringstream lines(list);
+    std::string line;
+    while (std::getline(lines, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        size_t hex_size = line.find(' ');
+        ChecksumAlgorithm line_algorithm = algorithm;
+        bool is_known_size = false;
+        for (ChecksumAlgorithm candidate : {CRC32C, XXH3, SHA256}) {
+            if ((has_algorithm ? algorithm : candidate) == candidate
+                && hex_size == getDigestHexSize(candidate)) {
+                line_algorithm = candidate;
+                is_known_size = true;
+            }
+        }
+        if (!is_known_size || hex_size + 2 >= line.size()
+            || (line[hex_size + 1] != ' ' && line[hex_size + 1] != '*')
+            || line.find_first_not_of("0123456789abcdefABCDEF")
+               != hex_size) {
+            bad_lines_count++;
+            continue;
+        }
+        std::string expected_hex = line.substr(0, hex_size);
+        std::transform(expected_hex.begin(), expected_hex.end(),
+                       expected_hex.begin(), ::tolower);
+        FileDigest file_digest = {line.substr(hex_size + 2), line_algorithm,
+                                  "", 0, nullptr, false};
+        file_digests.push_back(file_digest);
+        expected_hexes.push_back(expected_hex);
+    }
+    return true;
+}
+
+bool SumCommand::checkFileDigests() {
+    if (file_names.empty()) {
+        file_names.push_back("-");
+    }
+    std::vector<FileDigest> file_digests;
+    std::vector<std::string> expected_hexes;
+    int bad_lines_count = 0;
+    for (auto& file_name : file_names) {
+        bool is_from_input = (file_name == "-");
+        int fd = is_from_input ? in_fd : open(file_name.c_str(), O_RDONLY);
+        if (fd == -1) {
+            perror("smash error: open failed");
+            return false;
+        }
+        bool is_read = readCheckList(fd, file_digests, expected_hexes,
+                                     bad_lines_count);
+        if (!is_from_input) {
+            close(fd);
+        }
+        if (!is_read) {
+            return false;
+        }
+    }
+    if (file_digests.empty()) {
+        *err << "smash error: sum: no properly formatted checksum lines found"
+             << '\n';
+        return false;
+    }
+
+    // like sha256sum -c
+    int unread_count = 0;
+    int mismatch_count = 0;
+    size_t i = 0;
+    hashFiles(file_digests, [&](FileDigest& file_digest) {
+        const std::string& expected_hex = expected_hexes[i++];
+        if (file_digest.hex.empty()) {
+            *out << file_digest.name << ": FAILED open or read" << '\n';
+            unread_count++;
+        } else if (file_digest.hex != expected_hex) {
+            *out << file_digest.name << ": FAILED" << '\n';
+            mismatch_count++;
+        } else {
+            *out << file_digest.name << ": OK" << '\n';
+        }
+    });
+
+    out->flush();
+    if (bad_lines_count > 0) {
+        *err << "sum: WARNING: " << bad_lines_count
+             << (bad_lines_count == 1 ? " line is" : " lines are")
+             << " improperly formatted" << '\n';
+    }
+    if (unread_count > 0) {
+        *err << "sum: WARNING: " << unread_count << " listed "
+             << (unread_count == 1 ? "file" : "files")
+             << " could not be read" << '\n';
+    }
+    if (mismatch_count > 0) {
+        *err << "sum: WARNING: " << mismatch_count << " computed "
+             << (mismatch_count == 1 ? "checksum" : "checksums")
+             << " did NOT match" << '\n';
+    }
+    return bad_lines_count == 0 && unread_count == 0 && mismatch_count == 0;
+}
+
+SmallShellNextState SumCommand::execute() {
+    if (!areArgsValid()) {
+        return runAsExternalCommand();
+    }
+
+    SmallShell& smash = SmallShell::getInstance();
+    smash.events.clearInterrupt();
+    bool is_ok = is_checking ? checkFileDigests() : printFileDigests();
+    if (smash.events.isInterrupted()) {
+        smash.setExitStatus(128 + SIGINT);
+        throw CommandFail();
+    }
+    if (!is_ok) {
+        throw CommandFail();
+    }
+    return CONTINUE_RUNNING;
+}
+
+static void printWalkStats(OutputSink& err, const std::string& command_name,
+                           const TreeWalker& walker, long long elapsed_ms) {
+    unsigned long long entries_count = walker.getEntriesCount();
+    unsigned long long entries_per_sec = entries_count * 1000
+                                         / std::max(elapsed_ms, 1LL);
+    err << command_name << ": " << entries_count << " entries, "
+        << walker.getDirectoriesCount() << " directories in " << elapsed_ms
+        << " ms, " << entries_per_sec << " entries/s, "
+        << walker.getThreadsCount() << " threads" << '\n';
+}
+
+bool DiskUsageCommand::areArgsValid() {
+    _removeBackgroundSign(cmd_line);
+    // expanded here, a quoted path may have spaces
+    std::vector<std::string> assignments, args;
+    if (!expandCommandLine(cmd_line, assignments, args)
+        || !assignments.empty()) {
+        return false;
+    }
+
+    // valid cmd format is "du [-shc] [--stats] [path...]", options may be
+    // combined
+    bool is_in_options = true;
+    for (size_t i = 1; i < args.size(); i++) {
+        if (is_in_options && args[i] == "--") {
+            is_in_options = false;
+        } else if (is_in_options && args[i] == "--stats") {
+            is_showing_stats = true;
+        } else if (is_in_options && args[i].size() > 1 && args[i][0] == '-') {
+            for (size_t j = 1; j < args[i].size(); j++) {
+                if (args[i][j] == 's') {
+                    is_summarizing = true;
+                } else if (args[i][j] == 'h') {
+                    is_human_readable = true;
+                } else if (args[i][j] == 'c') {
+                    has_grand_total = true;
+                } else {
+                    return false;
+                }
+            }
+        } else {
+            paths.push_back(args[i]);
+        }
+    }
+    if (paths.empty()) {
+        paths.push_back(".");
+    }
+    return true;
+}
+
+std::string DiskUsageCommand::formatSize(unsigned long long size) {
+    if (!is_human_readable) {
+        // 1K blocks, rounded up
+        return std::to_string((size + 1023) / 1024);
+    }
+    // like du -h, rounded up and with one decimal below 10
+    if (size < 1024) {
+        return std::to_string(size);
+    }
+    const char units[] = "KMGTPE";
+    int unit = 0;
+    double value = size / 1024.0;
+    while (std::ceil(value) >= 1024 && units[unit + 1] != '\0') {
+        value /= 1024;
+        unit++;
+    }
+    char formatted[32];
+    if (std::ceil(value * 10) < 100) {
+        snprintf(formatted, sizeof(formatted), "%.1f%c",
+                 std::ceil(value * 10) / 10, units[unit]);
+    } else {
+        snprintf(formatted, sizeof(formatted), "%.0f%c", std::ceil(value),
+                 units[unit]);
+    }
+    return formatted;
+}
+
+SmallShellNextState DiskUsageCommand::execute() {
+    if (!areArgsValid()) {
+        return runAsExternalCommand();
+    }
+
+    SmallShell& smash = SmallShell::getInstance();
+    smash.events.clearInterrupt();
+    long long start_ms = monotonicTimeMs();
+    TreeWalker walker(STATX_BLOCKS | STATX_NLINK | STATX_INO,
+                      getWalkThreadsCount(), [this](const std::string& text) {
+                          out->write(text.data(), text.size());
+                      });
+    walker.should_stop = [&smash]() { return smash.events.isInterrupted(); };
+
+    // a file with many links is counted once, like in du(1)
+    std::mutex linked_files_lock;
+    std::set<std::pair<dev_t, unsigned long long>> linked_files;
+    std::atomic<unsigned long long> grand_total(0);
+    walker.on_entry = [&](const WalkEntry& entry) {
+        // a directory adds itself up once it is done
+        if (entry.type == DT_DIR) {
+            return true;
+        }
+        if (entry.stat->stx_nlink > 1) {
+            dev_t device = makedev(entry.stat->stx_dev_major,
+                                   entry.stat->stx_dev_minor);
+            std::lock_guard<std::mutex> guard(linked_files_lock);
+            if (!linked_files.insert(std::make_pair(device,
+                                                    entry.stat->stx_ino))
+                    .second) {
+                return true;
+            }
+        }
+        unsigned long long size = entry.stat->stx_blocks * 512;
+        if (entry.directory != nullptr) {
+            entry.directory->total += size;
+        } else {
+            grand_total += size;
+            entry.output += formatSize(size) + "\t" + entry.name + "\n";
+        }
+        return true;
+    };
+    walker.on_directory_done = [&](WalkDirectory& directory,
+                                   std::string& output) {
+        unsigned long long size = directory.total
+                                  + directory.stat.stx_blocks * 512;
+        if (directory.parent) {
+            directory.parent->total += size;
+        } else {
+            grand_total += size;
+        }
+        if (!is_summarizing || !directory.parent) {
+            output += formatSize(size) + "\t" + directory.path + "\n";
+        }
+    };
+    walker.walk(paths);
+
+    if (has_grand_total) {
+        *out << formatSize(grand_total) << "\ttotal" << '\n';
+    }
+    if (is_showing_stats) {
+        out->flush();
+        printWalkStats(*err, "du", walker, monotonicTimeMs() - start_ms);
+    }
+    if (smash.events.isInterrupted()) {
+        smash.setExitStatus(128 + SIGINT);
+        throw CommandFail();
+    }
+    if (walker.getErrorsCount() > 0) {
+        throw CommandFail();
+    }
+    return CONTINUE_RUNNING;
+}
+
+// "[+-]N[suffix]" into the sign of N, N and the suffix. Returns false if
+// there are no digits
+static bool parseSignedNumber(const std::string& number_str, int& sign,
+                              unsigned long long& number,
+                              std::string& suffix) {
+    size_t digits_start = 0;
+    sign = 0;
+    if (!number_str.empty()
+        && (number_str[0] == '+' || number_str[0] == '-')) {
+        sign = (number_str[0] == '+') ? 1 : -1;
+        digits_start = 1;
+    }
+    size_t digits_end = number_str.find_first_not_of("0123456789",
+                                                     digits_start);
+    if (digits_end == std::string::npos) {
+        digits_end = number_str.size();
+    }
+    if (digits_end == digits_start || digits_end - digits_start > 18) {
+        return false;
+    }
+    number = std::stoull(number_str.substr(digits_start,
+                                           digits_end - digits_start));
+    suffix = number_str.substr(digits_end);
+    return true;
+}
+
+bool FindCommand::areArgsValid() {
+    _removeBackgroundSign(cmd_line);
+    // expanded here, a quoted -name pattern isn't globbed
+    std::vector<std::string> assignments, args;
+    if (!expandCommandLine(cmd_line, assignments, args)
+        || !assignments.empty()) {
+        return false;
+    }
+
+    // valid cmd format is "find [path...] [test...]", the paths are the args
+    // before the first that starts with "-"
+    size_t i = 1;
+    for (; i < args.size() && (args[i].empty() || args[i][0] != '-'); i++) {
+        paths.push_back(args[i]);
+    }
+    if (paths.empty()) {
+        paths.push_back(".");
+    }
+    for (; i < args.size(); i++) {
+        const std::string& test = args[i];
+        if (test == "--stats") {
+            is_showing_stats = true;
+            continue;
+        }
+        if (test == "-print") {
+            continue;
+        }
+        if (i + 1 == args.size()) {
+            return false;
+        }
+        const std::string& value = args[++i];
+        int sign;
+        unsigned long long number;
+        std::string suffix;
+        if (test == "-name" || test == "-iname") {
+            name_pattern = value;
+            has_name_pattern = true;
+            is_name_case_folded = (test == "-iname");
+        } else if (test == "-type") {
+            if (value != "f" && value != "d" && value != "l") {
+                return false;
+            }
+            type = value[0];
+        } else if (test == "-size") {
+            if (!parseSignedNumber(value, size_sign, size, suffix)) {
+                return false;
+            }
+            // 512 byte blocks by default, like in find(1)
+            const std::string units = "cwbkMG";
+            const unsigned long long unit_sizes[] = {1, 2, 512, 1024,
+                                                     1024 * 1024,
+                                                     1024 * 1024 * 1024};
+            if (suffix.size() > 1 || (suffix.size() == 1
+                && units.find(suffix[0]) == std::string::npos)) {
+                return false;
+            }
+            size_unit = suffix.empty() ? 512 : unit_sizes[units.find(suffix)];
+            has_size = true;
+        } else if (test == "-mtime") {
+            if (!parseSignedNumber(value, mtime_sign, number, suffix)
+                || !suffix.empty()) {
+                return false;
+            }
+            mtime_days = number;
+            has_mtime = true;
+        } else if (test == "-maxdepth") {
+            if (!parseSignedNumber(value, sign, number, suffix) || sign != 0
+                || !suffix.empty() || number > INT_MAX) {
+                return false;
+            }
+            max_depth = number;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+unsigned int FindCommand::getStatMask() {
+    // the listing already has the types
+    unsigned int stat_mask = 0;
+    if (has_size) {
+        stat_mask |= STATX_SIZE;
+    }
+    if (has_mtime) {
+        stat_mask |= STATX_MTIME;
+    }
+    return stat_mask;
+}
+
+// -1, 0 or 1 as value is below, at or above reference
+static int compareToReference(long long value, long long reference) {
+    return (value < reference) ? -1 : (value > reference) ? 1 : 0;
+}
+
+bool FindCommand::isMatching(const WalkEntry& entry, long long now) {
+    if (type != '\0') {
+        unsigned char wanted_type = (type == 'f') ? DT_REG
+                                    : (type == 'd') ? DT_DIR : DT_LNK;
+        if (entry.type != wanted_type) {
+            return false;
+        }
+    }
+    if (has_name_pattern) {
+        // a root is matched by its last component
+        std::string name = entry.name;
+        if (entry.depth == 0) {
+            while (name.size() > 1 && name.back() == '/') {
+                name.pop_back();
+            }
+            size_t last_slash = name.rfind('/');
+            if (last_slash != std::string::npos && name.size() > 1) {
+                name = name.substr(last_slash + 1);
+            }
+        }
+        if (fnmatch(name_pattern.c_str(), name.c_str(),
+                    is_name_case_folded ? FNM_CASEFOLD : 0) != 0) {
+            return false;
+        }
+    }
+    if (has_size) {
+        // in units, rounded up
+        long long units = (entry.stat->stx_size + size_unit - 1) / size_unit;
+        if (compareToReference(units, size) != size_sign) {
+            return false;
+        }
+    }
+    if (has_mtime) {
+        long long age_days = (now - entry.stat->stx_mtime.tv_sec) / 86400;
+        if (compareToReference(age_days, mtime_days) != mtime_sign) {
+            return false;
+        }
+    }
+    return true;
+}
+
+SmallShellNextState FindCommand::execute() {
+    if (!areArgsValid()) {
+        return runAsExternalCommand();
+    }
+
+    SmallShell& smash = SmallShell::getInstance();
+    smash.events.clearInterrupt();
+    long long start_ms = monotonicTimeMs();
+    long long now = time(nullptr);
+    TreeWalker walker(getStatMask(), getWalkThreadsCount(),
+                      [this](const std::string& text) {
+                          out->write(text.data(), text.size());
+                      });
+    walker.should_stop = [&smash]() { return smash.events.isInterrupted(); };
+    walker.on_entry = [&](const WalkEntry& entry) {
+        if (isMatching(entry, now)) {
+            entry.output += entry.getPath() + "\n";
+        }
+        return max_depth == -1 || entry.depth < max_depth;
+    };
+    walker.walk(paths);
+
+    if (is_showing_stats) {
+        out->flush();
+        printWalkStats(*err, "find", walker, monotonicTimeMs() - start_ms);
+    }
+    if (smash.events.isInterrupted()) {
+        smash.setExitStatus(128 + SIGINT);
+        throw CommandFail();
+    }
+    if (walker.getErrorsCount() > 0) {
+        throw CommandFail();
+    }
+    return CONTINUE_RUNNING;
+}
+
+bool RemoveCommand::areArgsValid() {
+    _removeBackgroundSign(cmd_line);
+    // expanded here, a quoted path may have spaces
+    std::vector<std::string> assignments, args;
+    if (!expandCommandLine(cmd_line, assignments, args)
+        || !assignments.empty()) {
+        return false;
+    }
+
+    // valid cmd format is "rm [-rRf] [--stats] path...", options may be
+    // combined
+    bool is_in_options = true;
+    for (size_t i = 1; i < args.size(); i++) {
+        if (is_in_options && args[i] == "--") {
+            is_in_options = false;
+        } else if (is_in_options && args[i] == "--stats") {
+            is_showing_stats = true;
+        } else if (is_in_options && args[i].size() > 1 && args[i][0] == '-') {
+            for (size_t j = 1; j < args[i].size(); j++) {
+                if (args[i][j] == 'r' || args[i][j] == 'R') {
+                    is_recursive = true;
+                } else if (args[i][j] == 'f') {
+                    is_forced = true;
+                } else {
+                    return false;
+                }
+            }
+        } else {
+            paths.push_back(args[i]);
+        }
+    }
+    return !paths.empty() || is_forced;
+}
+
+SmallShellNextState RemoveCommand::execute() {
+    if (!areArgsValid()) {
+        return runAsExternalCommand();
+    }
+
+    // what rm(1) refuses, and what -f lets go of
+    std::vector<std::string> roots;
+    bool has_failed = false;
+    for (auto& path : paths) {
+        size_t last_char = path.find_last_not_of('/');
+        std::string last_component = (last_char == std::string::npos) ? "/"
+                : path.substr(0, last_char + 1);
+        size_t last_slash = last_component.rfind('/');
+        if (last_slash != std::string::npos && last_component != "/") {
+            last_component = last_component.substr(last_slash + 1);
+        }
+        if (last_component == "/" || last_component == "."
+            || last_component == "..") {
+            *err << "smash error: rm: refusing to remove '" << path << "'"
+                 << '\n';
+            has_failed = true;
+            continue;
+        }
+        // the failures name the path, like rm(1), since there may be many
+        std::string failure = "smash error: rm: cannot remove '" + path + "'";
+        struct stat path_stat;
+        if (lstat(path.c_str(), &path_stat) == -1) {
+            if (errno != ENOENT || !is_forced) {
+                perror(failure.c_str());
+                has_failed = true;
+            }
+            continue;
+        }
+        if (!is_recursive) {
+            if (unlink(path.c_str()) == -1) {
+                perror(failure.c_str());
+                has_failed = true;
+            }
+            continue;
+        }
+        roots.push_back(path);
+    }
+    if (roots.empty()) {
+        if (has_failed) {
+            throw CommandFail();
+        }
+        return CONTINUE_RUNNING;
+    }
+
+    SmallShell& smash = SmallShell::getInstance();
+    smash.events.clearInterrupt();
+    long long start_ms = monotonicTimeMs();
+    TreeWalker walker(0, getWalkThreadsCount(),
+                      [this](const std::string& text) {
+                          out->write(text.data(), text.size());
+                      });
+    walker.should_stop = [&smash]() { return smash.events.isInterrupted(); };
+    // the walker prints its own failures, and these are printed the same way
+    std::atomic<unsigned long long> failures_count(0);
+    std::mutex error_lock;
+    auto reportFailure = [&](const std::string& path) {
+        failures_count++;
+        std::string failure = "smash error: rm: cannot remove '" + path + "'";
+        std::lock_guard<std::mutex> guard(error_lock);
+        perror(failure.c_str());
+    };
+    // a directory is removed once all below it is, by on_directory_done
+    walker.on_entry = [&](const WalkEntry& entry) {
+        if (entry.type == DT_DIR) {
+            return true;
+        }
+        if (unlinkat(entry.dir_fd, entry.name, 0) == -1) {
+            reportFailure(entry.getPath());
+        }
+        return true;
+    };
+    walker.on_directory_done = [&](WalkDirectory& directory, std::string&) {
+        int parent_fd = directory.parent ? directory.parent->fd : AT_FDCWD;
+        if (unlinkat(parent_fd, directory.name.c_str(), AT_REMOVEDIR) == -1) {
+            reportFailure(directory.path);
+        }
+    };
+    walker.walk(roots);
+
+    if (is_showing_stats) {
+        out->flush();
+        printWalkStats(*err, "rm", walker, monotonicTimeMs() - start_ms);
+    }
+    if (smash.events.isInterrupted()) {
+        smash.setExitStatus(128 + SIGINT);
+        throw CommandFail();
+    }
+    if (has_failed || walker.getErrorsCount() > 0 || failures_count > 0) {
+        throw CommandFail();
+    }
     return CONTINUE_RUNNING;
 }
 
 SmallShellNextState QuitCommand::execute() {
     _removeBackgroundSign(cmd_line);
-    auto args = _parseCommandLine(cmd_line);
+    auto args = getArgs();
 
     SmallShell& smash = SmallShell::getInstance();
 
@@ -372,7 +3199,7 @@ SmallShellNextState QuitCommand::execute() {
 
     if (quit_and_kill) {
         try {
-            smash.jobs.killAllJobs();
+            smash.jobs.killAllJobs(*out);
         } catch (SystemCallFail& system_call_fail) {
             return QUIT;
         }
@@ -1,11 +1,23 @@
 #ifndef HW1_BUILTINCOMMAND_H
 #define HW1_BUILTINCOMMAND_H
 
+#include <functional>
+
 #include "Command.h"
 #include "JobList.h"
 #include "SmallShell.h"
+#include "WordCount.h"
+#include "Grep.h"
+#include "Sort.h"
+#include "Checksum.h"
+#include "TreeWalk.h"
 
 class BuiltInCommand: public Command {
+protected:
+    // runs the line as the system tool the built-in stands in for, e.g.
+    // for options the built-in doesn't support
+    SmallShellNextState runAsExternalCommand();
+
 public:
     // constructor
     explicit BuiltInCommand(std::string cmd_line);
@@ -31,6 +43,8 @@ public:
     explicit ShowPidCommand(std::string cmd_line);
 
     SmallShellNextState execute() override;
+
+    bool hasNoSideEffects() override;
 };
 
 class GetCurrDirCommand : public BuiltInCommand {
@@ -39,6 +53,8 @@ public:
     explicit GetCurrDirCommand(std::string cmd_line);
 
     SmallShellNextState execute() override;
+
+    bool hasNoSideEffects() override;
 };
 
 class ChangeDirCommand : public BuiltInCommand {
@@ -57,18 +73,29 @@ public:
 // inheriting classes that need the jobs list
 
 class JobsCommand : public BuiltInCommand {
+    JobSelector selector;
+
+    bool areArgsValid();
+
 public:
     // constructor
     explicit JobsCommand(std::string cmd_line);
 
     SmallShellNextState execute() override;
+
+    bool hasNoSideEffects() override;
 };
 
 class KillCommand : public BuiltInCommand {
     int sig_num;
     int jobID;
+    // set when jobs are given by job specs instead of a single jobID
+    bool hasSelector;
+    JobSelector selector;
+    bool verbose;
 
     bool areArgsValid();
+    void killSelectedJobs();
 
 public:
     // constructor
@@ -80,6 +107,8 @@ public:
 class ForegroundCommand : public BuiltInCommand {
     int jobID;
     bool noJobIDFromUser;
+    bool hasSelector;
+    JobSelector selector;
 
     bool areArgsValid();
     JobList::JobEntry* getJobToBringToFg();
@@ -94,9 +123,16 @@ public:
 class BackgroundCommand : public BuiltInCommand {
     int jobID;
     bool noJobIDFromUser;
+    // cpus given with --cpus=LIST to pin the job to
+    bool hasCpusFromUser;
+    cpu_set_t cpus;
+    bool hasSelector;
+    JobSelector selector;
 
     bool areArgsValid();
     JobList::JobEntry* getStoppedJobToBringToBg();
+    void resumeJob(JobList::JobEntry* job);
+    void resumeSelectedJobs();
 
 public:
     // constructor
@@ -105,6 +141,433 @@ public:
     SmallShellNextState execute() override;
 };
 
+class TaskSetCommand : public BuiltInCommand {
+    int jobID;
+    bool hasCpusFromUser;
+    cpu_set_t cpus;
+
+    bool areArgsValid();
+
+public:
+    // constructor
+    explicit TaskSetCommand(std::string cmd_line);
+
+    SmallShellNextState execute() override;
+};
+
+class JobPolicyCommand : public BuiltInCommand {
+    bool areArgsValid();
+
+public:
+    // constructor
+    explicit JobPolicyCommand(std::string cmd_line);
+
+    SmallShellNextState execute() override;
+};
+
+class WaitCommand : public BuiltInCommand {
+    std::vector<int> jobIDs;
+    bool waitForAnyJob;
+    long long timeout_ms;
+
+    bool areArgsValid();
+    bool parseTimeout(const std::string& timeout_str);
+    void printJobExitStatus(int jobID, int status);
+
+public:
+    // constructor
+    explicit WaitCommand(std::string cmd_line);
+
+    SmallShellNextState execute() override;
+};
+
+class TimeoutCommand : public BuiltInCommand {
+    long long timeout_ms;
+    long long kill_grace_ms;
+    std::string inner_cmd_line;
+
+    bool areArgsValid();
+
+public:
+    // constructor
+    explicit TimeoutCommand(std::string cmd_line);
+
+    SmallShellNextState execute() override;
+};
+
+// "time cmd" like bash's, plus the max RSS of the cmd and the time smash
+// spent in each phase of launching it
+class TimeCommand : public BuiltInCommand {
+    std::string inner_cmd_line;
+
+    bool areArgsValid();
+    void printTimes(long long wall_ns, const struct rusage& smash_start_usage);
+
+public:
+    // constructor
+    explicit TimeCommand(std::string cmd_line);
+
+    SmallShellNextState execute() override;
+};
+
+// "stats [--reset] [--json]" prints the p50/p99/p999 latencies of the
+// commands run by name and by how they were run, and smash's counters.
+// --reset clears them once printed
+class StatsCommand : public BuiltInCommand {
+    bool is_resetting;
+    bool is_json;
+
+    bool areArgsValid();
+    void printText();
+    void printJson();
+
+public:
+    // constructor
+    explicit StatsCommand(std::string cmd_line);
+
+    SmallShellNextState execute() override;
+};
+
+// "trace start|stop|dump file.json". The spans recorded from start until
+// stop are dumped as Chrome trace-event JSON, which Perfetto opens
+class TraceCommand : public BuiltInCommand {
+    std::string action;
+    std::string file_path;
+
+    bool areArgsValid();
+
+public:
+    // constructor
+    explicit TraceCommand(std::string cmd_line);
+
+    SmallShellNextState execute() override;
+};
+
+class CaptureCommand : public BuiltInCommand {
+    size_t capture_size;
+    std::string inner_cmd_line;
+
+    bool areArgsValid();
+    void dropPendingCapture();
+
+public:
+    // constructor
+    explicit CaptureCommand(std::string cmd_line);
+
+    SmallShellNextState execute() override;
+};
+
+class JobLogCommand : public BuiltInCommand {
+    int jobID;
+    size_t tail_lines_count;
+    bool follow;
+
+    bool areArgsValid();
+
+public:
+    // constructor
+    explicit JobLogCommand(std::string cmd_line);
+
+    SmallShellNextState execute() override;
+
+    bool hasNoSideEffects() override;
+};
+
+// "every INTERVAL cmd" and "at TIME cmd" add a schedule, without arguments
+// they print the schedules and "-d scheduleID" removes one
+class ScheduleCommand : public BuiltInCommand {
+    std::string name;
+    std::string scheduled_cmd_line;
+    std::string when_str;
+    int scheduleID_to_remove;
+
+    bool areArgsValid();
+
+protected:
+    virtual bool parseWhen(const std::string& when_str, long long& first_run_ms,
+                           long long& interval_ms) = 0;
+
+public:
+    // constructor
+    ScheduleCommand(std::string cmd_line, std::string name);
+
+    SmallShellNextState execute() override;
+};
+
+class EveryCommand : public ScheduleCommand {
+protected:
+    bool parseWhen(const std::string& when_str, long long& first_run_ms,
+                   long long& interval_ms) override;
+
+public:
+    // constructor
+    explicit EveryCommand(std::string cmd_line);
+};
+
+class AtCommand : public ScheduleCommand {
+protected:
+    bool parseWhen(const std::string& when_str, long long& first_run_ms,
+                   long long& interval_ms) override;
+
+public:
+    // constructor
+    explicit AtCommand(std::string cmd_line);
+};
+
+// "export [NAME[=VALUE]]...", without args prints the exported variables
+class ExportCommand : public BuiltInCommand {
+public:
+    // constructor
+    explicit ExportCommand(std::string cmd_line);
+
+    SmallShellNextState execute() override;
+};
+
+class UnsetCommand : public BuiltInCommand {
+public:
+    // constructor
+    explicit UnsetCommand(std::string cmd_line);
+
+    SmallShellNextState execute() override;
+};
+
+// a line of only "NAME=VALUE" words, sets shell variables
+class AssignCommand : public BuiltInCommand {
+public:
+    // constructor
+    explicit AssignCommand(std::string cmd_line);
+
+    SmallShellNextState execute() override;
+};
+
+//-----------------------------------------------------------------------------
+
+// inheriting classes that read files, or their input when given none
+
+// "wc [-lwc] [file...]" like wc(1)
+class WordCountCommand : public BuiltInCommand {
+    bool count_lines;
+    bool count_words;
+    bool count_bytes;
+    std::vector<std::string> file_names;
+
+    bool areArgsValid();
+    // returns false if reading failed or ctrl-C stopped it
+    bool countFd(int fd, WordCounts& counts, bool& is_regular_file);
+    void printCounts(const WordCounts& counts, const std::string& name,
+                     int width);
+
+public:
+    // constructor
+    explicit WordCountCommand(std::string cmd_line);
+
+    SmallShellNextState execute() override;
+
+    bool hasNoSideEffects() override;
+};
+
+// "grep [-FEGivclqnHh] [-e] pattern [file...]" like grep(1). Several files
+// are searched in parallel, and printed in order
+class GrepCommand : public BuiltInCommand {
+    // what a worker found in one of the files
+    struct FileResult {
+        std::string output;
+        unsigned long long selected_count;
+        // errno of the failed open or read, 0 if none
+        int error_number;
+        const char* failed_call;
+        bool is_done;
+    };
+
+    GrepOptions options;
+    std::string pattern;
+    std::vector<std::string> file_names;
+
+    bool areArgsValid();
+    // searches the lines fd reads. With a sink the output is written into it
+    // as the search goes, otherwise it is all appended to output. Returns
+    // false if reading failed, with its errno, or ctrl-C stopped it
+    bool searchFd(int fd, const std::string& name, const LineMatcher& matcher,
+                  OutputSink* sink, std::string& output,
+                  unsigned long long& selected_count, int& error_number);
+    void appendFileSummary(const std::string& name,
+                           unsigned long long selected_count,
+                           std::string& output);
+    // searches the files on a pool of threads. Returns the number of
+    // selected lines, has_failed is set if a file couldn't be searched
+    unsigned long long searchFilesInParallel(bool& has_failed);
+
+public:
+    // constructor
+    explicit GrepCommand(std::string cmd_line);
+
+    SmallShellNextState execute() override;
+
+    bool hasNoSideEffects() override;
+};
+
+// "sort [-ru] [-S size] [-T dir] [--stats] [file...]" like LC_ALL=C
+// sort(1). Input beyond the memory budget is sorted a run at a time, the
+// runs spilled to temporary files and merged at the end
+class SortCommand : public BuiltInCommand {
+    SortOptions options;
+    size_t memory_budget;
+    std::string temp_dir;
+    bool is_showing_stats;
+    std::vector<std::string> file_names;
+    SortStats stats;
+    // the lines read and not sorted yet, whole lines only
+    std::string chunk;
+    std::vector<SortLine> chunk_lines;
+    // the fds of the spilled runs
+    std::vector<int> run_fds;
+
+    bool areArgsValid();
+    // reads fd into the chunk, spilling it whenever it gets over the budget.
+    // Returns false if reading or spilling failed, or ctrl-C stopped it
+    bool readFd(int fd);
+    // splits the chunk into lines and sorts them
+    void sortChunk();
+    // sorts the chunk and writes it into a temporary file as a run
+    bool spillChunk();
+    // merges the runs and the chunk that is left into the output
+    bool mergeRuns();
+    void printStats();
+
+public:
+    // constructor
+    explicit SortCommand(std::string cmd_line);
+
+    // destructor
+    ~SortCommand();
+
+    SmallShellNextState execute() override;
+
+    bool hasNoSideEffects() override;
+};
+
+// "sum [-a crc32c|xxh3|sha256] [--tree] [-c] [file...]" prints checksums
+// like sha256sum(1), and checks them with -c. Several files are hashed in
+// parallel, and a single big one by parts
+class SumCommand : public BuiltInCommand {
+    // the checksum of one of the files, or why there is none
+    struct FileDigest {
+        std::string name;
+        ChecksumAlgorithm algorithm;
+        std::string hex;
+        // errno of the failed open or read, 0 if none
+        int error_number;
+        const char* failed_call;
+        bool is_done;
+    };
+
+    ChecksumAlgorithm algorithm;
+    bool has_algorithm;
+    bool is_tree_mode;
+    bool is_checking;
+    std::vector<std::string> file_names;
+
+    bool areArgsValid();
+    // hashes what fd reads, a mapped file on up to threads_count threads.
+    // Returns false if reading failed, or ctrl-C stopped it
+    bool hashFd(int fd, FileDigest& file_digest, int threads_count);
+    // hashes the files on a pool of threads, handing each digest to
+    // on_done in the order of the files
+    void hashFiles(std::vector<FileDigest>& file_digests,
+                   const std::function<void(FileDigest&)>& on_done);
+    // reads the "<checksum>  <name>" lines of a list, the files to hash
+    // and the checksums they should have. Returns false if it couldn't be
+    // read
+    bool readCheckList(int fd, std::vector<FileDigest>& file_digests,
+                       std::vector<std::string>& expected_hexes,
+                       int& bad_lines_count);
+    // both return false if a file couldn't be hashed or didn't match
+    bool printFileDigests();
+    bool checkFileDigests();
+
+public:
+    // constructor
+    explicit SumCommand(std::string cmd_line);
+
+    SmallShellNextState execute() override;
+
+    bool hasNoSideEffects() override;
+};
+
+//-----------------------------------------------------------------------------
+
+// inheriting classes that walk directory trees, in parallel
+
+// "du [-shc] [--stats] [path...]" like du(1), in 1K blocks
+class DiskUsageCommand : public BuiltInCommand {
+    bool is_summarizing;
+    bool is_human_readable;
+    bool has_grand_total;
+    bool is_showing_stats;
+    std::vector<std::string> paths;
+
+    bool areArgsValid();
+    std::string formatSize(unsigned long long size);
+
+public:
+    // constructor
+    explicit DiskUsageCommand(std::string cmd_line);
+
+    SmallShellNextState execute() override;
+
+    bool hasNoSideEffects() override;
+};
+
+// "find [path...] [-name|-iname pattern] [-type f|d|l] [-size [+-]N[ckMG]]
+// [-mtime [+-]N] [-maxdepth N] [--stats]" like find(1), all the tests must
+// pass. Paths are printed as they are found, not in find(1)'s order
+class FindCommand : public BuiltInCommand {
+    std::vector<std::string> paths;
+    std::string name_pattern;
+    bool has_name_pattern;
+    bool is_name_case_folded;
+    char type;
+    // -1, 0 or 1 for -N, N or +N
+    int size_sign;
+    unsigned long long size;
+    unsigned long long size_unit;
+    bool has_size;
+    int mtime_sign;
+    long long mtime_days;
+    bool has_mtime;
+    int max_depth;
+    bool is_showing_stats;
+
+    bool areArgsValid();
+    unsigned int getStatMask();
+    bool isMatching(const WalkEntry& entry, long long now);
+
+public:
+    // constructor
+    explicit FindCommand(std::string cmd_line);
+
+    SmallShellNextState execute() override;
+
+    bool hasNoSideEffects() override;
+};
+
+// "rm [-rRf] [--stats] path..." like rm(1). A tree is removed by many
+// threads, each directory once all below it is gone
+class RemoveCommand : public BuiltInCommand {
+    bool is_recursive;
+    bool is_forced;
+    bool is_showing_stats;
+    std::vector<std::string> paths;
+
+    bool areArgsValid();
+
+public:
+    // constructor
+    explicit RemoveCommand(std::string cmd_line);
+
+    SmallShellNextState execute() override;
+};
+
 class QuitCommand : public BuiltInCommand {
 public:
     // constructor
@@ -0,0 +1,767 @@
+#include "Checksum.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+static inline uint32_t readLE32(const char* data) {
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static inline uint64_t readLE64(const char* data) {
+    uint64_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static void appendBE64(std::string& digest, uint64_t value) {
+    for (int shift = 56; shift >= 0; shift -= 8) {
+        digest += static_cast<char>(value >> shift);
+    }
+}
+
+//----------------------------------------------------------------------------
+
+// the table of the reflected crc-32c polynomial, by the low byte
+struct Crc32cTable {
+    uint32_t entries[256];
+
+    Crc32cTable() {
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t crc = n;
+            for (int k = 0; k < 8; k++) {
+                crc = (crc & 1) ? (crc >> 1) ^ 0x82f63b78U : crc >> 1;
+            }
+            entries[n] = crc;
+        }
+    }
+};
+
+static uint32_t updateCrc32cTable(uint32_t crc, const char* data,
+                                  size_t size) {
+    static const Crc32cTable table;
+    for (size_t i = 0; i < size; i++) {
+        crc = table.entries[(crc ^ static_cast<unsigned char>(data[i]))
+                            & 0xff] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+#if defined(__x86_64__)
+
+__attribute__((target("sse4.2")))
+static uint32_t updateCrc32cSse42(uint32_t crc, const char* data,
+                                  size_t size) {
+    uint64_t crc64 = crc;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        crc64 = _mm_crc32_u64(crc64, readLE64(data + i));
+    }
+    crc = static_cast<uint32_t>(crc64);
+    for (; i < size; i++) {
+        crc = _mm_crc32_u8(crc, data[i]);
+    }
+    return crc;
+}
+
+static bool hasSse42() {
+    static const bool has_sse42 = __builtin_cpu_supports("sse4.2");
+    return has_sse42;
+}
+
+#endif
+
+Crc32cHasher::Crc32cHasher() : crc(0xffffffffU) {}
+
+void Crc32cHasher::update(const char* data, size_t size) {
+#if defined(__x86_64__)
+    if (hasSse42()) {
+        crc = updateCrc32cSse42(crc, data, size);
+        return;
+    }
+#endif
+    crc = updateCrc32cTable(crc, data, size);
+}
+
+uint32_t Crc32cHasher::getCrc() const {
+    return crc;
+}
+
+std::string Crc32cHasher::finish() {
+    uint32_t value = crc ^ 0xffffffffU;
+    std::string digest;
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        digest += static_cast<char>(value >> shift);
+    }
+    return digest;
+}
+
+static uint32_t gf2MatrixTimes(const uint32_t* matrix, uint32_t vec) {
+    uint32_t sum = 0;
+    for (; vec != 0; vec >>= 1, matrix++) {
+        if (vec & 1) {
+            sum ^= *matrix;
+        }
+    }
+    return sum;
+}
+
+static void gf2MatrixSquare(uint32_t* square, const uint32_t* matrix) {
+    for (int n = 0; n < 32; n++) {
+        square[n] = gf2MatrixTimes(matrix, matrix[n]);
+    }
+}
+
+// the crc-32c of two buffers one after the other, from the crc of each,
+// the way zlib's crc32_combine does it for crc-32
+static uint32_t combineCrc32c(uint32_t crc1, uint32_t crc2, size_t size2) {
+    if (size2 == 0) {
+        return crc1;
+    }
+    uint32_t even[32];
+    uint32_t odd[32];
+    odd[0] = 0x82f63b78U;
+    uint32_t row = 1;
+    for (int n = 1; n < 32; n++) {
+        odd[n] = row;
+        row <<= 1;
+    }
+    // two and then four zero bits
+    gf2MatrixSquare(even, odd);
+    gf2MatrixSquare(odd, even);
+
+    uint32_t crc = crc1;
+    do {
+        gf2MatrixSquare(even, odd);
+        if (size2 & 1) {
+            crc = gf2MatrixTimes(even, crc);
+        }
+        size2 >>= 1;
+        if (size2 == 0) {
+            break;
+        }
+        gf2MatrixSquare(odd, even);
+        if (size2 & 1) {
+            crc = gf2MatrixTimes(odd, crc);
+        }
+        size2 >>= 1;
+    } while (size2 != 0);
+
+    return crc ^ crc2;
+}
+
+//----------------------------------------------------------------------------
+
+static const uint32_t xxh_prime32_1 = 0x9e3779b1U;
+static const uint32_t xxh_prime32_2 = 0x85ebca77U;
+static const uint32_t xxh_prime32_3 = 0xc2b2ae3dU;
+static const uint64_t xxh_prime64_1 = 0x9e3779b185ebca87ULL;
+static const uint64_t xxh_prime64_2 = 0xc2b2ae3d27d4eb4fULL;
+static const uint64_t xxh_prime64_3 = 0x165667b19e3779f9ULL;
+static const uint64_t xxh_prime64_4 = 0x85ebca77c2b2ae63ULL;
+static const uint64_t xxh_prime64_5 = 0x27d4eb2f165667c5ULL;
+static const uint64_t xxh_prime_mx1 = 0x165667919e3779f9ULL;
+static const uint64_t xxh_prime_mx2 = 0x9fb21c651e98df25ULL;
+
+static const size_t xxh3_stripe_size = 64;
+static const size_t xxh3_secret_size = 192;
+// a block is as many stripes as the secret has 8 byte steps for
+static const size_t xxh3_stripes_per_block =
+        (xxh3_secret_size - xxh3_stripe_size) / 8;
+static const size_t xxh3_block_size =
+        xxh3_stripe_size * xxh3_stripes_per_block;
+
+static const unsigned char xxh3_secret[xxh3_secret_size] = {
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c,
+    0xf7, 0x21, 0xad, 0x1c, 0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb,
+    0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f, 0xcb, 0x79, 0xe6, 0x4e,
+    0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6,
+    0x81, 0x3a, 0x26, 0x4c, 0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb,
+    0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3, 0x71, 0x64, 0x48, 0x97,
+    0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+    0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7,
+    0xc7, 0x0b, 0x4f, 0x1d, 0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31,
+    0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64, 0xea, 0xc5, 0xac, 0x83,
+    0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+    0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26,
+    0x29, 0xd4, 0x68, 0x9e, 0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc,
+    0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce, 0x45, 0xcb, 0x3a, 0x8f,
+    0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+static inline const char* getSecret(size_t offset) {
+    return reinterpret_cast<const char*>(xxh3_secret) + offset;
+}
+
+static inline uint64_t rotateLeft64(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+static inline uint64_t multiplyFold64(uint64_t first, uint64_t second) {
+    unsigned __int128 product = static_cast<unsigned __int128>(first)
+                                * second;
+    return static_cast<uint64_t>(product)
+           ^ static_cast<uint64_t>(product >> 64);
+}
+
+static inline uint64_t xxh64Avalanche(uint64_t hash) {
+    hash ^= hash >> 33;
+    hash *= xxh_prime64_2;
+    hash ^= hash >> 29;
+    hash *= xxh_prime64_3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+static inline uint64_t xxh3Avalanche(uint64_t hash) {
+    hash ^= hash >> 37;
+    hash *= xxh_prime_mx1;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+static inline uint64_t xxh3Mix16(const char* data, const char* secret) {
+    return multiplyFold64(readLE64(data) ^ readLE64(secret),
+                          readLE64(data + 8) ^ readLE64(secret + 8));
+}
+
+// the whole hash of an input up to 240 bytes
+static uint64_t xxh3Short(const char* data, size_t size) {
+    if (size == 0) {
+        return xxh64Avalanche(readLE64(getSecret(56))
+                              ^ readLE64(getSecret(64)));
+    }
+    if (size <= 3) {
+        uint32_t combined = (static_cast<uint32_t>(
+                                static_cast<unsigned char>(data[0])) << 16)
+                | (static_cast<uint32_t>(
+                        static_cast<unsigned char>(data[size >> 1])) << 24)
+                | static_cast<unsigned char>(data[size - 1])
+                | static_cast<uint32_t>(size << 8);
+        uint64_t bitflip = readLE32(getSecret(0)) ^ readLE32(getSecret(4));
+        return xxh64Avalanche(combined ^ bitflip);
+    }
+    if (size <= 8) {
+        uint64_t bitflip = readLE64(getSecret(8)) ^ readLE64(getSecret(16));
+        uint64_t input = readLE32(data + size - 4)
+                         + (static_cast<uint64_t>(readLE32(data)) << 32);
+        uint64_t hash = input ^ bitflip;
+        hash ^= rotateLeft64(hash, 49) ^ rotateLeft64(hash, 24);
+        hash *= xxh_prime_mx2;
+        hash ^= (hash >> 35) + size;
+        hash *= xxh_prime_mx2;
+        return hash ^ (hash >> 28);
+    }
+    if (size <= 16) {
+        uint64_t low = readLE64(data)
+                ^ (readLE64(getSecret(24)) ^ readLE64(getSecret(32)));
+        uint64_t high = readLE64(data + size - 8)
+                ^ (readLE64(getSecret(40)) ^ readLE64(getSecret(48)));
+        uint64_t acc = size + __builtin_bswap64(low) + high
+                       + multiplyFold64(low, high);
+        return xxh3Avalanche(acc);
+    }
+    uint64_t acc = size * xxh_prime64_1;
+    if (size <= 128) {
+        // pairs from both ends toward the middle
+        if (size > 32) {
+            if (size > 64) {
+                if (size > 96) {
+                    acc += xxh3Mix16(data + 48, getSecret(96));
+                    acc += xxh3Mix16(data + size - 64, getSecret(112));
+                }
+                acc += xxh3Mix16(data + 32, getSecret(64));
+                acc += xxh3Mix16(data + size - 48, getSecret(80));
+            }
+            acc += xxh3Mix16(data + 16, getSecret(32));
+            acc += xxh3Mix16(data + size - 32, getSecret(48));
+        }
+        acc += xxh3Mix16(data, getSecret(0));
+        acc += xxh3Mix16(data + size - 16, getSecret(16));
+        return xxh3Avalanche(acc);
+    }
+    for (size_t i = 0; i < 8; i++) {
+        acc += xxh3Mix16(data + 16 * i, getSecret(16 * i));
+    }
+    acc = xxh3Avalanche(acc);
+    for (size_t i = 8; i < size / 16; i++) {
+        acc += xxh3Mix16(data + 16 * i, getSecret(16 * (i - 8) + 3));
+    }
+    acc += xxh3Mix16(data + size - 16, getSecret(136 - 17));
+    return xxh3Avalanche(acc);
+}
+
+static inline void xxh3AccumulateStripe(uint64_t* accs, const char* stripe,
+                                        const char* secret) {
+    for (int i = 0; i < 8; i++) {
+        uint64_t value = readLE64(stripe + 8 * i);
+        uint64_t key = value ^ readLE64(secret + 8 * i);
+        accs[i ^ 1] += value;
+        accs[i] += (key & 0xffffffffULL) * (key >> 32);
+    }
+}
+
+static void xxh3Accumulate(uint64_t* accs, const char* data,
+                           size_t stripes_count) {
+    for (size_t i = 0; i < stripes_count; i++) {
+        xxh3AccumulateStripe(accs, data + i * xxh3_stripe_size,
+                             getSecret(i * 8));
+    }
+}
+
+Xxh3Hasher::Xxh3Hasher() : total_size(0), buffered_size(0) {
+    const uint64_t initial_accs[8] = {xxh_prime32_3, xxh_prime64_1,
+            xxh_prime64_2, xxh_prime64_3, xxh_prime64_4, xxh_prime32_2,
+            xxh_prime64_5, xxh_prime32_1};
+    memcpy(accs, initial_accs, sizeof(accs));
+}
+
+void Xxh3Hasher::consumeBlock(const char* block) {
+    xxh3Accumulate(accs, block, xxh3_stripes_per_block);
+    const char* secret = getSecret(xxh3_secret_size - xxh3_stripe_size);
+    for (int i = 0; i < 8; i++) {
+        uint64_t acc = accs[i];
+        acc ^= acc >> 47;
+        acc ^= readLE64(secret + 8 * i);
+        acc *= xxh_prime32_1;
+        accs[i] = acc;
+    }
+    memcpy(last_stripe, block + xxh3_block_size - xxh3_stripe_size,
+           xxh3_stripe_size);
+}
+
+void Xxh3Hasher::update(const char* data, size_t size) {
+    total_size += size;
+    if (buffered_size + size <= xxh3_block_size) {
+        memcpy(buff + buffered_size, data, size);
+        buffered_size += size;
+        return;
+    }
+    // a block is consumed only once more input follows it
+    if (buffered_size > 0) {
+        size_t fill_size = xxh3_block_size - buffered_size;
+        memcpy(buff + buffered_size, data, fill_size);
+        consumeBlock(buff);
+        data += fill_size;
+        size -= fill_size;
+    }
+    while (size > xxh3_block_size) {
+        consumeBlock(data);
+        data += xxh3_block_size;
+        size -= xxh3_block_size;
+    }
+    memcpy(buff, data, size);
+    buffered_size = size;
+}
+
+std::string Xxh3Hasher::finish() {
+    std::string digest;
+    if (total_size <= 240) {
+        appendBE64(digest, xxh3Short(buff, buffered_size));
+        return digest;
+    }
+
+    uint64_t final_accs[8];
+    memcpy(final_accs, accs, sizeof(accs));
+    xxh3Accumulate(final_accs, buff,
+                   (buffered_size - 1) / xxh3_stripe_size);
+    // the last stripe ends with the input, and may start in the block
+    // before
+    char stripe[xxh3_stripe_size];
+    if (buffered_size >= xxh3_stripe_size) {
+        memcpy(stripe, buff + buffered_size - xxh3_stripe_size,
+               xxh3_stripe_size);
+    } else {
+        size_t catch_up_size = xxh3_stripe_size - buffered_size;
+        memcpy(stripe, last_stripe + xxh3_stripe_size - catch_up_size,
+               catch_up_size);
+        memcpy(stripe + catch_up_size, buff, buffered_size);
+    }
+    xxh3AccumulateStripe(final_accs, stripe,
+            getSecret(xxh3_secret_size - xxh3_stripe_size - 7));
+
+    uint64_t hash = total_size * xxh_prime64_1;
+    for (int i = 0; i < 4; i++) {
+        hash += multiplyFold64(
+                final_accs[2 * i] ^ readLE64(getSecret(11 + 16 * i)),
+                final_accs[2 * i + 1] ^ readLE64(getSecret(11 + 16 * i + 8)));
+    }
+    appendBE64(digest, xxh3Avalanche(hash));
+    return digest;
+}
+
+//----------------------------------------------------------------------------
+
+static const uint32_t sha256_round_constants[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static inline uint32_t rotateRight32(uint32_t value, int bits) {
+    return (value >> bits) | (value << (32 - bits));
+}
+
+static void sha256BlocksScalar(uint32_t* state, const unsigned char* data,
+                               size_t blocks_count) {
+    for (; blocks_count > 0; blocks_count--, data += 64) {
+        uint32_t schedule[64];
+        for (int i = 0; i < 16; i++) {
+            schedule[i] = (static_cast<uint32_t>(data[4 * i]) << 24)
+                          | (static_cast<uint32_t>(data[4 * i + 1]) << 16)
+                          | (static_cast<uint32_t>(data[4 * i + 2]) << 8)
+                          | data[4 * i + 3];
+        }
+        for (int i = 16; i < 64; i++) {
+            uint32_t s0 = rotateRight32(schedule[i - 15], 7)
+                          ^ rotateRight32(schedule[i - 15], 18)
+                          ^ (schedule[i - 15] >> 3);
+            uint32_t s1 = rotateRight32(schedule[i - 2], 17)
+                          ^ rotateRight32(schedule[i - 2], 19)
+                          ^ (schedule[i - 2] >> 10);
+            schedule[i] = schedule[i - 16] + s0 + schedule[i - 7] + s1;
+        }
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int i = 0; i < 64; i++) {
+            uint32_t s1 = rotateRight32(e, 6) ^ rotateRight32(e, 11)
+                          ^ rotateRight32(e, 25);
+            uint32_t choice = (e & f) ^ (~e & g);
+            uint32_t temp1 = h + s1 + choice + sha256_round_constants[i]
+                             + schedule[i];
+            uint32_t s0 = rotateRight32(a, 2) ^ rotateRight32(a, 13)
+                          ^ rotateRight32(a, 22);
+            uint32_t majority = (a & b) ^ (a & c) ^ (b & c);
+            uint32_t temp2 = s0 + majority;
+            h = g;
+            g = f;
+            f = e;
+            e = d + temp1;
+            d = c;
+            c = b;
+            b = a;
+            a = temp1 + temp2;
+        }
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+    }
+}
+
+#if defined(__x86_64__)
+
+// the SHA extensions keep the state as ABEF and CDGH, and run two rounds
+// per instruction
+__attribute__((target("sha,sse4.1")))
+static void sha256BlocksShaNi(uint32_t* state, const unsigned char* data,
+                              size_t blocks_count) {
+    const __m128i byte_swap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+                                             0x0405060700010203ULL);
+    __m128i dcba = _mm_loadu_si128(reinterpret_cast<__m128i*>(state));
+    __m128i hgfe = _mm_loadu_si128(reinterpret_cast<__m128i*>(state + 4));
+    __m128i cdab = _mm_shuffle_epi32(dcba, 0xb1);
+    __m128i efgh = _mm_shuffle_epi32(hgfe, 0x1b);
+    __m128i abef = _mm_alignr_epi8(cdab, efgh, 8);
+    __m128i cdgh = _mm_blend_epi16(efgh, cdab, 0xf0);
+
+    for (; blocks_count > 0; blocks_count--, data += 64) {
+        __m128i saved_abef = abef;
+        __m128i saved_cdgh = cdgh;
+        // the last four words of the schedule, by index % 4
+        __m128i words[4];
+        for (int i = 0; i < 16; i++) {
+            if (i < 4) {
+                words[i] = _mm_shuffle_epi8(_mm_loadu_si128(
+                        reinterpret_cast<const __m128i*>(data + 16 * i)),
+                        byte_swap);
+            } else {
+                __m128i& oldest = words[i & 3];
+                const __m128i& prev = words[(i + 3) & 3];
+                __m128i sum = _mm_add_epi32(
+                        _mm_sha256msg1_epu32(oldest, words[(i + 1) & 3]),
+                        _mm_alignr_epi8(prev, words[(i + 2) & 3], 4));
+                oldest = _mm_sha256msg2_epu32(sum, prev);
+            }
+            __m128i message = _mm_add_epi32(words[i & 3], _mm_loadu_si128(
+                    reinterpret_cast<const __m128i*>(
+                            sha256_round_constants + 4 * i)));
+            cdgh = _mm_sha256rnds2_epu32(cdgh, abef, message);
+            message = _mm_shuffle_epi32(message, 0x0e);
+            abef = _mm_sha256rnds2_epu32(abef, cdgh, message);
+        }
+        abef = _mm_add_epi32(abef, saved_abef);
+        cdgh = _mm_add_epi32(cdgh, saved_cdgh);
+    }
+
+    __m128i feba = _mm_shuffle_epi32(abef, 0x1b);
+    __m128i dchg = _mm_shuffle_epi32(cdgh, 0xb1);
+    dcba = _mm_blend_epi16(feba, dchg, 0xf0);
+    hgfe = _mm_alignr_epi8(dchg, feba, 8);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state), dcba);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state + 4), hgfe);
+}
+
+static bool hasShaExtensions() {
+    static const bool has_sha = []() {
+        unsigned int eax, ebx, ecx, edx;
+        if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+            return false;
+        }
+        return (ebx & bit_SHA) != 0 && __builtin_cpu_supports("sse4.1");
+    }();
+    return has_sha;
+}
+
+#endif
+
+static void sha256Blocks(uint32_t* state, const unsigned char* data,
+                         size_t blocks_count) {
+#if defined(__x86_64__)
+    if (hasShaExtensions()) {
+        sha256BlocksShaNi(state, data, blocks_count);
+        return;
+    }
+#endif
+    sha256BlocksScalar(state, data, blocks_count);
+}
+
+Sha256Hasher::Sha256Hasher() : total_size(0), buffered_size(0) {
+    const uint32_t initial_state[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372,
+            0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    memcpy(state, initial_state, sizeof(state));
+}
+
+void Sha256Hasher::update(const char* data, size_t size) {
+    const unsigned char* input = reinterpret_cast<const unsigned char*>(data);
+    total_size += size;
+    if (buffered_size > 0) {
+        size_t fill_size = std::min(size, sizeof(buff) - buffered_size);
+        memcpy(buff + buffered_size, input, fill_size);
+        buffered_size += fill_size;
+        input += fill_size;
+        size -= fill_size;
+        if (buffered_size < sizeof(buff)) {
+            return;
+        }
+        sha256Blocks(state, buff, 1);
+        buffered_size = 0;
+    }
+    size_t blocks_count = size / sizeof(buff);
+    sha256Blocks(state, input, blocks_count);
+    input += blocks_count * sizeof(buff);
+    size -= blocks_count * sizeof(buff);
+    memcpy(buff, input, size);
+    buffered_size = size;
+}
+
+std::string Sha256Hasher::finish() {
+    unsigned long long bits_count = total_size * 8;
+    // a 1 bit, zeros up to 8 bytes before a block's end, and the length
+    char padding[72] = {'\x80'};
+    size_t padding_size = ((buffered_size < 56) ? 56 : 120) - buffered_size;
+    update(padding, padding_size);
+    char length[8];
+    for (int i = 0; i < 8; i++) {
+        length[i] = static_cast<char>(bits_count >> (56 - 8 * i));
+    }
+    update(length, sizeof(length));
+
+    std::string digest;
+    for (uint32_t word : state) {
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            digest += static_cast<char>(word >> shift);
+        }
+    }
+    return digest;
+}
+
+//----------------------------------------------------------------------------
+
+bool parseChecksumAlgorithm(const std::string& name,
+                            ChecksumAlgorithm& algorithm) {
+    if (name == "crc32c") {
+        algorithm = CRC32C;
+    } else if (name == "xxh3") {
+        algorithm = XXH3;
+    } else if (name == "sha256") {
+        algorithm = SHA256;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+Hasher* createHasher(ChecksumAlgorithm algorithm, bool is_tree_mode) {
+    if (is_tree_mode && algorithm != CRC32C) {
+        return new TreeHasher(algorithm);
+    }
+    if (algorithm == CRC32C) {
+        return new Crc32cHasher();
+    }
+    if (algorithm == XXH3) {
+        return new Xxh3Hasher();
+    }
+    return new Sha256Hasher();
+}
+
+size_t getDigestHexSize(ChecksumAlgorithm algorithm) {
+    if (algorithm == CRC32C) {
+        return 8;
+    }
+    return (algorithm == XXH3) ? 16 : 64;
+}
+
+std::string toHex(const std::string& digest) {
+    static const char hex_digits[] = "0123456789abcdef";
+    std::string hex;
+    for (unsigned char c : digest) {
+        hex += hex_digits[c >> 4];
+        hex += hex_digits[c & 0xf];
+    }
+    return hex;
+}
+
+int getChecksumThreadsCount() {
+    int cores_count = std::thread::hardware_concurrency();
+    return std::max(1, std::min(cores_count, checksum_max_threads));
+}
+
+// runs task(0) to task(count - 1) on up to threads_count threads, the
+// calling one included
+template <typename Task>
+static void runInParallel(size_t count, int threads_count, Task task) {
+    std::atomic<size_t> next_index(0);
+    auto work = [&]() {
+        size_t i;
+        while ((i = next_index++) < count) {
+            task(i);
+        }
+    };
+    std::vector<std::thread> threads;
+    try {
+        for (int i = 1; i < threads_count && i < (int)count; i++) {
+            threads.emplace_back(work);
+        }
+    } catch (std::system_error& e) {
+        // the threads that started, and this one, do it all
+    }
+    work();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+std::string hashBuffer(ChecksumAlgorithm algorithm, const char* data,
+                       size_t size, bool is_tree_mode, int threads_count) {
+    if (algorithm == CRC32C) {
+        size_t parts_count = std::max<size_t>(1, std::min<size_t>(
+                threads_count, size / checksum_part_min_size));
+        std::vector<uint32_t> part_crcs(parts_count);
+        auto get_part_start = [size, parts_count](size_t part) {
+            return size / parts_count * part;
+        };
+        runInParallel(parts_count, threads_count, [&](size_t part) {
+            size_t start = get_part_start(part);
+            size_t end = (part + 1 == parts_count)
+                         ? size : get_part_start(part + 1);
+            Crc32cHasher hasher;
+            hasher.update(data + start, end - start);
+            part_crcs[part] = hasher.getCrc() ^ 0xffffffffU;
+        });
+        uint32_t crc = part_crcs[0];
+        for (size_t part = 1; part < parts_count; part++) {
+            size_t part_size = ((part + 1 == parts_count)
+                                ? size : get_part_start(part + 1))
+                               - get_part_start(part);
+            crc = combineCrc32c(crc, part_crcs[part], part_size);
+        }
+        std::string digest;
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            digest += static_cast<char>(crc >> shift);
+        }
+        return digest;
+    }
+
+    Hasher* hasher = createHasher(algorithm);
+    if (is_tree_mode) {
+        size_t leaves_count = (size + checksum_tree_leaf_size - 1)
+                              / checksum_tree_leaf_size;
+        std::vector<std::string> leaf_digests(leaves_count);
+        runInParallel(leaves_count, threads_count, [&](size_t leaf) {
+            size_t start = leaf * checksum_tree_leaf_size;
+            Hasher* leaf_hasher = createHasher(algorithm);
+            leaf_hasher->update(data + start, std::min(
+                    checksum_tree_leaf_size, size - start));
+            leaf_digests[leaf] = leaf_hasher->finish();
+            delete leaf_hasher;
+        });
+        for (auto& leaf_digest : leaf_digests) {
+            hasher->update(leaf_digest.data(), leaf_digest.size());
+        }
+    } else {
+        hasher->update(data, size);
+    }
+    std::string digest = hasher->finish();
+    delete hasher;
+    return digest;
+}
+
+TreeHasher::TreeHasher(ChecksumAlgorithm algorithm)
+    : algorithm(algorithm), leaf_hasher(createHasher(algorithm)),
+      leaf_size(0), root_hasher(createHasher(algorithm)) {}
+
+TreeHasher::~TreeHasher() {
+    delete leaf_hasher;
+    delete root_hasher;
+}
+
+void TreeHasher::update(const char* data, size_t size) {
+    while (size > 0) {
+        size_t update_size = std::min(size,
+                                      checksum_tree_leaf_size - leaf_size);
+        leaf_hasher->update(data, update_size);
+        leaf_size += update_size;
+        data += update_size;
+        size -= update_size;
+        if (leaf_size == checksum_tree_leaf_size) {
+            std::string leaf_digest = leaf_hasher->finish();
+            root_hasher->update(leaf_digest.data(), leaf_digest.size());
+            delete leaf_hasher;
+            leaf_hasher = createHasher(algorithm);
+            leaf_size = 0;
+        }
+    }
+}
+
+std::string TreeHasher::finish() {
+    if (leaf_size > 0) {
+        std::string leaf_digest = leaf_hasher->finish();
+        root_hasher->update(leaf_digest.data(), leaf_digest.size());
+    }
+    return root_hasher->finish();
+}
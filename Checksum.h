@@ -0,0 +1,139 @@
+#ifndef HW1_CHECKSUM_H
+#define HW1_CHECKSUM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// files at least this big are mapped instead of read
+const size_t checksum_map_min_size = 1024 * 1024;
+const size_t checksum_read_size = 1024 * 1024;
+// a mapped file is cut into parts of at least this size, hashed in parallel
+const size_t checksum_part_min_size = 16 * 1024 * 1024;
+// the leaves of a tree mode hash
+const size_t checksum_tree_leaf_size = 4 * 1024 * 1024;
+const int checksum_max_threads = 16;
+
+typedef enum {
+    CRC32C = 0,
+    XXH3 = 1,
+    SHA256 = 2
+} ChecksumAlgorithm;
+
+/* A running hash of a stream */
+class Hasher {
+public:
+    // destructor
+    virtual ~Hasher() {}
+
+    virtual void update(const char* data, size_t size) = 0;
+
+    // the digest in bytes, big-endian like its hex form
+    virtual std::string finish() = 0;
+};
+
+/* CRC-32C, with the SSE4.2 crc32 instruction when the cpu has it */
+class Crc32cHasher : public Hasher {
+    uint32_t crc;
+
+public:
+    // constructor
+    Crc32cHasher();
+
+    void update(const char* data, size_t size) override;
+
+    std::string finish() override;
+
+    // the crc so far, before the final xor
+    uint32_t getCrc() const;
+};
+
+/* XXH3, 64 bit, with no seed and the default secret. The last block is
+ * kept until finish, the last stripe is read from the end of the input */
+class Xxh3Hasher : public Hasher {
+    uint64_t accs[8];
+    unsigned long long total_size;
+    // the block that isn't consumed yet, 1 to 1024 bytes once there is data
+    char buff[1024];
+    size_t buffered_size;
+    // the last bytes of the last block consumed
+    char last_stripe[64];
+
+    void consumeBlock(const char* block);
+
+public:
+    // constructor
+    Xxh3Hasher();
+
+    void update(const char* data, size_t size) override;
+
+    std::string finish() override;
+};
+
+/* SHA-256, with the SHA extensions when the cpu has them */
+class Sha256Hasher : public Hasher {
+    uint32_t state[8];
+    unsigned long long total_size;
+    unsigned char buff[64];
+    size_t buffered_size;
+
+public:
+    // constructor
+    Sha256Hasher();
+
+    void update(const char* data, size_t size) override;
+
+    std::string finish() override;
+};
+
+/* "crc32c", "xxh3" or "sha256" */
+bool parseChecksumAlgorithm(const std::string& name,
+                            ChecksumAlgorithm& algorithm);
+
+/* a new hasher of the algorithm, for the caller to delete. CRC-32C has no
+ * tree mode, its parts combine exactly */
+Hasher* createHasher(ChecksumAlgorithm algorithm, bool is_tree_mode = false);
+
+/* the length of the algorithm's digests in hex */
+size_t getDigestHexSize(ChecksumAlgorithm algorithm);
+
+std::string toHex(const std::string& digest);
+
+/* Hashes a buffer that is all there, on up to threads_count threads. A
+ * CRC-32C of parts is combined into the CRC-32C of the whole. In tree mode
+ * the leaves are hashed in parallel and the digest is the hash of their
+ * digests, otherwise XXH3 and SHA-256 run on a single thread */
+std::string hashBuffer(ChecksumAlgorithm algorithm, const char* data,
+                       size_t size, bool is_tree_mode, int threads_count);
+
+/* Hashes a stream in tree mode, a leaf at a time. Its digests are the
+ * ones hashBuffer gives in tree mode */
+class TreeHasher : public Hasher {
+    ChecksumAlgorithm algorithm;
+    Hasher* leaf_hasher;
+    size_t leaf_size;
+    Hasher* root_hasher;
+
+public:
+    // constructor
+    explicit TreeHasher(ChecksumAlgorithm algorithm);
+
+    // destructor
+    ~TreeHasher();
+
+    // disable copy ctor
+    TreeHasher(TreeHasher const&) = delete;
+
+    // disable = operator
+    void operator=(TreeHasher const&) = delete;
+
+    void update(const char* data, size_t size) override;
+
+    std::string finish() override;
+};
+
+/* the number of threads to hash with, one per core up to
+ * checksum_max_threads */
+int getChecksumThreadsCount();
+
+#endif //HW1_CHECKSUM_H
@@ -1,9 +1,39 @@
 #include "Command.h"
+#include "SmallShell.h"
 
 Command::Command(std::string cmd_line)
-        : execute_without_fork(false), cmd_line(cmd_line), original_cmd_line(cmd_line)
+        : execute_without_fork(false),
+          out(&SmallShell::getInstance().out),
+          err(&SmallShell::getInstance().err), in_fd(STDIN_FILENO),
+          cmd_line(cmd_line), original_cmd_line(cmd_line)
 {}
 
-std::string Command::getCmdLine() {
+const std::string& Command::getCmdLine() {
     return original_cmd_line;
-}
\ No newline at end of file
+}
+
+void Command::setExpandedArgs(const std::vector<std::string>& args) {
+    expanded_args = args;
+}
+
+std::vector<std::string> Command::getArgs() {
+    if (expanded_args.empty()) {
+        return _parseCommandLine(cmd_line);
+    }
+    return expanded_args;
+}
+
+bool Command::hasNoSideEffects() {
+    return false;
+}
+
+void Command::useSinksAsStdio() {
+    if ((in_fd != STDIN_FILENO && dup2(in_fd, STDIN_FILENO) == -1)
+        || (out->getFd() != STDOUT_FILENO
+         && dup2(out->getFd(), STDOUT_FILENO) == -1)
+        || (err->getFd() != STDERR_FILENO
+            && dup2(err->getFd(), STDERR_FILENO) == -1)) {
+        perror("smash error: dup2 failed");
+        _exit(DUP2_FAILED);
+    }
+}
@@ -13,6 +13,8 @@
 const int bash_path_length = 10;
 const int bash_flag_length = 3;
 
+class OutputSink;
+
 typedef enum {
     QUIT = 0,
     CONTINUE_RUNNING = 1
@@ -21,10 +23,23 @@ typedef enum {
 class Command {
 public:
     bool execute_without_fork;
+    // where the command prints, smash's stdout and stderr unless it is
+    // redirected. Proccesses it starts get them as their stdout and stderr
+    OutputSink* out;
+    OutputSink* err;
+    // where the command reads, smash's stdin unless it is the right side of
+    // a pipe that runs inside smash
+    int in_fd;
 
 protected:
     std::string cmd_line;
     std::string original_cmd_line;
+    // the words of the line as createCommand expanded them, without a
+    // trailing "&". Empty if it left the line for the command to parse
+    std::vector<std::string> expanded_args;
+
+    // the args of the command, the expanded ones if there are any
+    std::vector<std::string> getArgs();
 
 public:
     // constructor
@@ -35,7 +50,19 @@ public:
 
     virtual SmallShellNextState execute() = 0;
 
-    std::string getCmdLine();
+    const std::string& getCmdLine();
+
+    // the command takes these args instead of parsing its line. The line
+    // is never rebuilt from them, so quoted operators stay quoted
+    void setExpandedArgs(const std::vector<std::string>& args);
+
+    // nothing in smash changes when the command runs, so in a pipe it can
+    // run inside smash instead of in a son of its own
+    virtual bool hasNoSideEffects();
+
+    // called in a proccess started by the command, before exec. Its sinks
+    // and in_fd become the proccess's stdio
+    void useSinksAsStdio();
 };
 
 
@@ -0,0 +1,539 @@
+#include "Compression.h"
+
+#include <unistd.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <system_error>
+
+#ifdef SMASH_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+// gzip member header: magic, deflate, no flags, no mtime, unix
+static const char gzip_header[] = {'\x1f', '\x8b', 8, 0, 0, 0, 0, 0, 0, 3};
+const size_t compress_read_size = 64 * 1024;
+
+#ifdef SMASH_HAVE_ZLIB
+
+static unsigned long getBlockCrc(const std::string& data) {
+    return crc32(0, reinterpret_cast<const Bytef*>(data.data()),
+                 data.size());
+}
+
+static unsigned long combineCrc(unsigned long crc1, unsigned long crc2,
+                                size_t size2) {
+    return crc32_combine(crc1, crc2, size2);
+}
+
+static bool deflateBlock(const std::string& dictionary,
+                         const std::string& input, bool is_last,
+                         std::string& output) {
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    // negative window bits for raw deflate, the gzip framing is ours
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8,
+                     Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+    if (!dictionary.empty()) {
+        deflateSetDictionary(&stream,
+                reinterpret_cast<const Bytef*>(dictionary.data()),
+                dictionary.size());
+    }
+
+    stream.next_in = reinterpret_cast<Bytef*>(
+            const_cast<char*>(input.data()));
+    stream.avail_in = input.size();
+    // room for the sync flush marker too
+    output.resize(deflateBound(&stream, input.size()) + 64);
+    size_t used = 0;
+    int flush = is_last ? Z_FINISH : Z_SYNC_FLUSH;
+    int result;
+    while (true) {
+        stream.next_out = reinterpret_cast<Bytef*>(&output[used]);
+        stream.avail_out = output.size() - used;
+        result = deflate(&stream, flush);
+        used = output.size() - stream.avail_out;
+        if (result == Z_STREAM_ERROR) {
+            break;
+        }
+        if (is_last ? result == Z_STREAM_END : stream.avail_out != 0) {
+            break;
+        }
+        output.resize(output.size() * 2);
+    }
+    output.resize(used);
+    deflateEnd(&stream);
+    return result != Z_STREAM_ERROR;
+}
+
+#else
+
+// the table of the reflected crc-32 polynomial, by the low byte
+struct CrcTable {
+    uint32_t entries[256];
+
+    CrcTable() {
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t crc = n;
+            for (int k = 0; k < 8; k++) {
+                crc = (crc & 1) ? (crc >> 1) ^ 0xedb88320U : crc >> 1;
+            }
+            entries[n] = crc;
+        }
+    }
+};
+
+static unsigned long getBlockCrc(const std::string& data) {
+    static const CrcTable table;
+    uint32_t crc = 0xffffffffU;
+    for (unsigned char c : data) {
+        crc = table.entries[(crc ^ c) & 0xff] ^ (crc >> 8);
+    }
+    return crc ^ 0xffffffffU;
+}
+
+static uint32_t gf2MatrixTimes(const uint32_t* matrix, uint32_t vec) {
+    uint32_t sum = 0;
+    for (; vec != 0; vec >>= 1, matrix++) {
+        if (vec & 1) {
+            sum ^= *matrix;
+        }
+    }
+    return sum;
+}
+
+static void gf2MatrixSquare(uint32_t* square, const uint32_t* matrix) {
+    for (int n = 0; n < 32; n++) {
+        square[n] = gf2MatrixTimes(matrix, matrix[n]);
+    }
+}
+
+// the crc of two buffers one after the other, from the crc of each, like
+// zlib's crc32_combine: crc1 is run through size2 zero bytes by squaring
+// the one zero bit operator
+static unsigned long combineCrc(unsigned long crc1, unsigned long crc2,
+                                size_t size2) {
+    if (size2 == 0) {
+        return crc1;
+    }
+    uint32_t even[32];
+    uint32_t odd[32];
+    odd[0] = 0xedb88320U;
+    uint32_t row = 1;
+    for (int n = 1; n < 32; n++) {
+        odd[n] = row;
+        row <<= 1;
+    }
+    // two and then four zero bits
+    gf2MatrixSquare(even, odd);
+    gf2MatrixSquare(odd, even);
+
+    uint32_t crc = crc1;
+    do {
+        gf2MatrixSquare(even, odd);
+        if (size2 & 1) {
+            crc = gf2MatrixTimes(even, crc);
+        }
+        size2 >>= 1;
+        if (size2 == 0) {
+            break;
+        }
+        gf2MatrixSquare(odd, even);
+        if (size2 & 1) {
+            crc = gf2MatrixTimes(odd, crc);
+        }
+        size2 >>= 1;
+    } while (size2 != 0);
+
+    return crc ^ crc2;
+}
+
+static const int length_base[] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17,
+        19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227,
+        258};
+static const int length_extra_bits[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1,
+        2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const int distance_base[] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33,
+        49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073,
+        4097, 6145, 8193, 12289, 16385, 24577};
+static const int distance_extra_bits[] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4,
+        4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+const int min_match_length = 3;
+const int max_match_length = 258;
+const int match_hash_bits = 15;
+// candidates tried per position, like a low zlib level
+const int max_match_chain = 32;
+
+// deflate's bit order, least significant bit first
+class BitWriter {
+    std::string& output;
+    uint64_t bits;
+    int bits_count;
+
+public:
+    explicit BitWriter(std::string& output)
+        : output(output), bits(0), bits_count(0) {}
+
+    void put(uint32_t value, int count) {
+        bits |= static_cast<uint64_t>(value) << bits_count;
+        bits_count += count;
+        while (bits_count >= 8) {
+            output.push_back(static_cast<char>(bits & 0xff));
+            bits >>= 8;
+            bits_count -= 8;
+        }
+    }
+
+    // huffman codes are packed starting from their most significant bit
+    void putCode(uint32_t code, int length) {
+        uint32_t reversed = 0;
+        for (int i = 0; i < length; i++) {
+            reversed = (reversed << 1) | ((code >> i) & 1);
+        }
+        put(reversed, length);
+    }
+
+    void alignToByte() {
+        if (bits_count > 0) {
+            put(0, 8 - bits_count);
+        }
+    }
+};
+
+// a literal/length symbol in the fixed huffman code of RFC 1951
+static void putFixedSymbol(BitWriter& writer, int symbol) {
+    if (symbol < 144) {
+        writer.putCode(0x30 + symbol, 8);
+    } else if (symbol < 256) {
+        writer.putCode(0x190 + symbol - 144, 9);
+    } else if (symbol < 280) {
+        writer.putCode(symbol - 256, 7);
+    } else {
+        writer.putCode(0xc0 + symbol - 280, 8);
+    }
+}
+
+static void putMatch(BitWriter& writer, int length, int distance) {
+    int length_code = std::upper_bound(length_base, length_base + 29,
+                                       length) - length_base - 1;
+    putFixedSymbol(writer, 257 + length_code);
+    writer.put(length - length_base[length_code],
+               length_extra_bits[length_code]);
+
+    int distance_code = std::upper_bound(distance_base, distance_base + 30,
+                                         distance) - distance_base - 1;
+    writer.putCode(distance_code, 5);
+    writer.put(distance - distance_base[distance_code],
+               distance_extra_bits[distance_code]);
+}
+
+static int getMatchHash(const unsigned char* p) {
+    return ((p[0] << 10) ^ (p[1] << 5) ^ p[2]) & ((1 << match_hash_bits) - 1);
+}
+
+// a single fixed huffman block with greedy hash chain matching. Slower
+// and looser than zlib, but plain C++ and still several times smaller
+// than the input for text
+static bool deflateBlock(const std::string& dictionary,
+                         const std::string& input, bool is_last,
+                         std::string& output) {
+    std::string window = dictionary + input;
+    const unsigned char* data =
+            reinterpret_cast<const unsigned char*>(window.data());
+    int window_size = window.size();
+    std::vector<int> head(1 << match_hash_bits, -1);
+    std::vector<int> prev(window_size, -1);
+
+    auto insert = [&](int pos) {
+        if (pos + min_match_length > window_size) {
+            return;
+        }
+        int hash = getMatchHash(data + pos);
+        prev[pos] = head[hash];
+        head[hash] = pos;
+    };
+
+    for (int pos = 0; pos < (int)dictionary.size(); pos++) {
+        insert(pos);
+    }
+
+    output.clear();
+    output.reserve(input.size() / 2 + 64);
+    BitWriter writer(output);
+    writer.put(is_last ? 1 : 0, 1);
+    // fixed huffman codes
+    writer.put(1, 2);
+
+    int pos = dictionary.size();
+    while (pos < window_size) {
+        int best_length = 0;
+        int best_distance = 0;
+        if (pos + min_match_length <= window_size) {
+            int max_length = std::min(max_match_length, window_size - pos);
+            int candidate = head[getMatchHash(data + pos)];
+            int chain_left = max_match_chain;
+            while (candidate >= 0 && pos - candidate <= (int)deflate_window_size
+                   && chain_left-- > 0) {
+                if (data[candidate + best_length] == data[pos + best_length]) {
+                    int length = 0;
+                    while (length < max_length
+                           && data[candidate + length] == data[pos + length]) {
+                        length++;
+                    }
+                    if (length > best_length) {
+                        best_length = length;
+                        best_distance = pos - candidate;
+                        if (length == max_length) {
+                            break;
+                        }
+                    }
+                }
+                candidate = prev[candidate];
+            }
+        }
+
+        if (best_length >= min_match_length) {
+            putMatch(writer, best_length, best_distance);
+            for (int i = 0; i < best_length; i++) {
+                insert(pos + i);
+            }
+            pos += best_length;
+        } else {
+            putFixedSymbol(writer, data[pos]);
+            insert(pos);
+            pos++;
+        }
+    }
+    // end of block
+    putFixedSymbol(writer, 256);
+
+    if (!is_last) {
+        // sync flush: an empty stored block leaves the stream byte aligned
+        writer.put(0, 3);
+        writer.alignToByte();
+        output.append("\x00\x00\xff\xff", 4);
+    } else {
+        writer.alignToByte();
+    }
+    return true;
+}
+
+#endif
+
+//----------------------------------------------------------------------------
+
+ParallelGzipWriter::ParallelGzipWriter(int fd, int threads_count)
+    : fd(fd), max_pending(2 * threads_count), is_stopping(false),
+      curr_block(nullptr), stream_crc(0), stream_size(0),
+      is_header_written(false), has_failed(false) {
+    try {
+        for (int i = 0; i < threads_count; i++) {
+            workers.push_back(std::thread(&ParallelGzipWriter::workerLoop,
+                                          this));
+        }
+    } catch (std::system_error& error) {
+        // with no threads at all blocks are compressed by the caller
+    }
+}
+
+ParallelGzipWriter::~ParallelGzipWriter() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        is_stopping = true;
+    }
+    has_work.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    for (Block* block : pending) {
+        delete block;
+    }
+    delete curr_block;
+}
+
+void ParallelGzipWriter::workerLoop() {
+    std::unique_lock<std::mutex> guard(lock);
+    while (true) {
+        has_work.wait(guard, [this] {
+            return is_stopping || !todo.empty();
+        });
+        if (todo.empty()) {
+            return;
+        }
+        Block* block = todo.front();
+        todo.pop_front();
+
+        guard.unlock();
+        block->has_failed = !deflateBlock(block->dictionary, block->input,
+                                          block->is_last, block->output);
+        block->crc = getBlockCrc(block->input);
+        guard.lock();
+
+        block->is_done = true;
+        has_done.notify_one();
+    }
+}
+
+void ParallelGzipWriter::submitBlock(bool is_last) {
+    Block* block = curr_block;
+    curr_block = nullptr;
+    if (block == nullptr) {
+        block = new Block();
+    }
+    block->dictionary = last_window;
+    block->is_last = is_last;
+    block->is_done = false;
+    block->has_failed = false;
+
+    // the next block's dictionary is the tail of everything so far
+    last_window.append(block->input);
+    if (last_window.size() > deflate_window_size) {
+        last_window.erase(0, last_window.size() - deflate_window_size);
+    }
+
+    if (workers.empty()) {
+        block->has_failed = !deflateBlock(block->dictionary, block->input,
+                                          block->is_last, block->output);
+        block->crc = getBlockCrc(block->input);
+        block->is_done = true;
+        writeBlock(block);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        todo.push_back(block);
+        pending.push_back(block);
+    }
+    has_work.notify_one();
+    writeDoneBlocks(is_last);
+}
+
+void ParallelGzipWriter::writeDoneBlocks(bool wait_for_all) {
+    while (true) {
+        Block* block;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            if (pending.empty()) {
+                return;
+            }
+            bool must_wait = wait_for_all || pending.size() >= max_pending;
+            if (!pending.front()->is_done) {
+                if (!must_wait) {
+                    return;
+                }
+                has_done.wait(guard, [this] {
+                    return pending.front()->is_done;
+                });
+            }
+            block = pending.front();
+            pending.pop_front();
+        }
+        // the rest of the blocks keep compressing meanwhile
+        writeBlock(block);
+    }
+}
+
+void ParallelGzipWriter::writeBlock(Block* block) {
+    if (block->has_failed) {
+        has_failed = true;
+    }
+    if (!is_header_written) {
+        is_header_written = true;
+        if (!writeAll(gzip_header, sizeof(gzip_header))) {
+            has_failed = true;
+        }
+    }
+    if (!has_failed && !writeAll(block->output.data(),
+                                 block->output.size())) {
+        has_failed = true;
+    }
+    stream_crc = combineCrc(stream_crc, block->crc, block->input.size());
+    stream_size += block->input.size();
+    delete block;
+}
+
+bool ParallelGzipWriter::writeAll(const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = ::write(fd, data, size);
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+bool ParallelGzipWriter::write(const char* data, size_t size) {
+    while (size > 0 && !has_failed) {
+        if (curr_block == nullptr) {
+            curr_block = new Block();
+            curr_block->input.reserve(gzip_block_size);
+        }
+        size_t room = gzip_block_size - curr_block->input.size();
+        size_t taken = std::min(room, size);
+        curr_block->input.append(data, taken);
+        data += taken;
+        size -= taken;
+        if (curr_block->input.size() == gzip_block_size) {
+            submitBlock(false);
+        }
+    }
+    return !has_failed;
+}
+
+bool ParallelGzipWriter::finish() {
+    // even an empty stream needs its final block
+    submitBlock(true);
+    if (has_failed) {
+        return false;
+    }
+
+    // crc and size mod 2^32, little endian
+    char trailer[8];
+    for (int i = 0; i < 4; i++) {
+        trailer[i] = static_cast<char>((stream_crc >> (8 * i)) & 0xff);
+        trailer[4 + i] = static_cast<char>((stream_size >> (8 * i)) & 0xff);
+    }
+    return writeAll(trailer, sizeof(trailer));
+}
+
+//----------------------------------------------------------------------------
+
+int getCompressorThreadsCount() {
+    int threads_count = std::thread::hardware_concurrency();
+    if (threads_count <= 0) {
+        return 1;
+    }
+    return std::min(threads_count, max_compressor_threads);
+}
+
+bool compressStream(int in_fd, int out_fd) {
+    ParallelGzipWriter writer(out_fd, getCompressorThreadsCount());
+    std::vector<char> buff(compress_read_size);
+
+    while (true) {
+        ssize_t bytes_read = read(in_fd, buff.data(), buff.size());
+        if (bytes_read == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        if (bytes_read == 0) {
+            break;
+        }
+        if (!writer.write(buff.data(), bytes_read)) {
+            return false;
+        }
+    }
+    return writer.finish();
+}
@@ -0,0 +1,93 @@
+#ifndef HW1_COMPRESSION_H
+#define HW1_COMPRESSION_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// prefix of a redirection target that is written gzip compressed
+const std::string compressed_target_prefix = "gz:";
+// input is cut into blocks of this size, compressed in parallel
+const size_t gzip_block_size = 128 * 1024;
+// how far back a deflate match can look
+const size_t deflate_window_size = 32 * 1024;
+const int max_compressor_threads = 16;
+
+/* Writes a gzip stream into fd, pigz style. The input is cut into blocks
+ * that a pool of threads deflates in parallel, each block primed with the
+ * last window of the one before it so the ratio is close to a single
+ * deflate stream. Blocks end byte aligned with a sync flush, so they are
+ * simply written one after the other, in order, by the calling thread.
+ * Uses zlib when smash is built with SMASH_HAVE_ZLIB, and a built-in
+ * deflate otherwise */
+class ParallelGzipWriter {
+    struct Block {
+        std::string input;
+        // the input just before this block, matches may refer to it
+        std::string dictionary;
+        bool is_last;
+        std::string output;
+        unsigned long crc;
+        bool is_done;
+        bool has_failed;
+    };
+
+    int fd;
+    std::vector<std::thread> workers;
+    std::mutex lock;
+    std::condition_variable has_work;
+    std::condition_variable has_done;
+    // blocks waiting for a worker
+    std::deque<Block*> todo;
+    // blocks not written yet, in stream order
+    std::deque<Block*> pending;
+    size_t max_pending;
+    bool is_stopping;
+    Block* curr_block;
+    std::string last_window;
+    unsigned long stream_crc;
+    unsigned long long stream_size;
+    bool is_header_written;
+    bool has_failed;
+
+    void workerLoop();
+    void submitBlock(bool is_last);
+    // writes the blocks that are done, from the front. Waits for all of
+    // them if wait_for_all, otherwise only until there is room for more
+    void writeDoneBlocks(bool wait_for_all);
+    void writeBlock(Block* block);
+    bool writeAll(const char* data, size_t size);
+
+public:
+    // constructor
+    ParallelGzipWriter(int fd, int threads_count);
+
+    // destructor
+    ~ParallelGzipWriter();
+
+    // disable copy ctor
+    ParallelGzipWriter(ParallelGzipWriter const&) = delete;
+
+    // disable = operator
+    void operator=(ParallelGzipWriter const&) = delete;
+
+    // returns false once a write into fd failed
+    bool write(const char* data, size_t size);
+
+    // compresses and writes what is left and the gzip trailer
+    bool finish();
+};
+
+/* the number of threads to compress with, one per core up to
+ * max_compressor_threads */
+int getCompressorThreadsCount();
+
+/* reads in_fd up to its end and writes it gzip compressed into out_fd.
+ * Returns false if a read or a write failed */
+bool compressStream(int in_fd, int out_fd);
+
+#endif //HW1_COMPRESSION_H
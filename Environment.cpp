@@ -0,0 +1,134 @@
+#include "Environment.h"
+
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <unistd.h>
+
+extern char** environ;
+
+Environment::Environment() {
+    for (char** entry = environ; entry != nullptr && *entry != nullptr;
+         entry++) {
+        const char* equal_sign = strchr(*entry, '=');
+        if (equal_sign == nullptr) {
+            continue;
+        }
+        std::string name(*entry, equal_sign - *entry);
+        if (!isValidVariableName(name) || variables.count(name) > 0) {
+            continue;
+        }
+        set(name, equal_sign + 1, true);
+    }
+    if (envp.empty()) {
+        envp.push_back(nullptr);
+    }
+    environ = envp.data();
+}
+
+Environment::~Environment() {
+    for (char* entry : envp) {
+        free(entry);
+    }
+}
+
+void Environment::putInEnvp(const std::string& name,
+                            const std::string& value) {
+    std::string entry_str = name + "=" + value;
+    char* entry = strdup(entry_str.c_str());
+
+    auto it = envp_index.find(name);
+    if (it != envp_index.end()) {
+        free(envp[it->second]);
+        envp[it->second] = entry;
+        return;
+    }
+
+    // the new entry takes the place of the null terminator
+    if (envp.empty()) {
+        envp.push_back(nullptr);
+    }
+    envp_index[name] = envp.size() - 1;
+    envp.back() = entry;
+    envp.push_back(nullptr);
+    // pushing may have moved the array
+    environ = envp.data();
+}
+
+void Environment::removeFromEnvp(const std::string& name) {
+    auto it = envp_index.find(name);
+    if (it == envp_index.end()) {
+        return;
+    }
+
+    // the last entry fills the hole, envp order doesn't matter
+    size_t idx = it->second;
+    size_t last_idx = envp.size() - 2;
+    free(envp[idx]);
+    envp[idx] = envp[last_idx];
+    if (idx != last_idx) {
+        const char* last_entry = envp[idx];
+        std::string last_name(last_entry, strchr(last_entry, '=') - last_entry);
+        envp_index[last_name] = idx;
+    }
+    envp[last_idx] = nullptr;
+    envp.pop_back();
+    envp_index.erase(it);
+}
+
+bool Environment::get(const std::string& name, std::string& value) const {
+    auto it = variables.find(name);
+    if (it == variables.end()) {
+        return false;
+    }
+    value = it->second.value;
+    return true;
+}
+
+void Environment::set(const std::string& name, const std::string& value,
+                      bool exported) {
+    Variable& variable = variables[name];
+    variable.value = value;
+    variable.exported = variable.exported || exported;
+    if (variable.exported) {
+        putInEnvp(name, value);
+    }
+}
+
+void Environment::exportVar(const std::string& name) {
+    Variable& variable = variables[name];
+    variable.exported = true;
+    putInEnvp(name, variable.value);
+}
+
+void Environment::unset(const std::string& name) {
+    removeFromEnvp(name);
+    variables.erase(name);
+}
+
+std::vector<std::string> Environment::getExportedVars() const {
+    std::vector<std::string> exported_vars;
+    for (auto& variable : variables) {
+        if (variable.second.exported) {
+            exported_vars.push_back(variable.first + "="
+                                    + variable.second.value);
+        }
+    }
+    return exported_vars;
+}
+
+char** Environment::getEnvp() {
+    return envp.data();
+}
+
+bool isValidVariableName(const std::string& name) {
+    if (name.empty() || isdigit(name[0])) {
+        return false;
+    }
+    for (char c : name) {
+        if (!isalnum(c) && c != '_') {
+            return false;
+        }
+    }
+    return true;
+}
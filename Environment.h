@@ -0,0 +1,61 @@
+#ifndef HW1_ENVIRONMENT_H
+#define HW1_ENVIRONMENT_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+/* Shell variables of smash, exported or not.
+ * Exported variables are also kept as a ready "NAME=VALUE" envp array that
+ * environ points to, so changing one replaces a single pointer in place and
+ * a child gets its environment by the fork itself, with nothing rebuilt
+ * before exec */
+class Environment {
+    struct Variable {
+        std::string value;
+        bool exported;
+    };
+    std::map<std::string, Variable> variables;
+    // exported "NAME=VALUE" strings, null terminated, environ points here
+    std::vector<char*> envp;
+    // index of each exported variable in envp
+    std::map<std::string, size_t> envp_index;
+
+    void putInEnvp(const std::string& name, const std::string& value);
+    void removeFromEnvp(const std::string& name);
+
+public:
+    // constructor, takes over the environment smash started with
+    Environment();
+
+    // destructor
+    ~Environment();
+
+    // disable copy ctor
+    Environment(Environment const&) = delete;
+
+    // disable = operator
+    void operator=(Environment const&) = delete;
+
+    // returns false if the variable is not set
+    bool get(const std::string& name, std::string& value) const;
+
+    // sets a variable, a new one is exported only if exported is true
+    void set(const std::string& name, const std::string& value,
+             bool exported = false);
+
+    // exports a variable, creating it empty if it is not set
+    void exportVar(const std::string& name);
+
+    void unset(const std::string& name);
+
+    // "NAME=VALUE" of every exported variable, sorted by name
+    std::vector<std::string> getExportedVars() const;
+
+    char** getEnvp();
+};
+
+/* determining if the string is a valid variable name, e.g. "_PATH2" */
+bool isValidVariableName(const std::string& name);
+
+#endif //HW1_ENVIRONMENT_H
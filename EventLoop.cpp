@@ -0,0 +1,190 @@
+#include "EventLoop.h"
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/timerfd.h>
+#include <errno.h>
+#include <time.h>
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+
+EventLoop::EventLoop()
+        : got_interrupt(0), timers(monotonicTimeMs()), armed_ms(-1) {
+    if (pipe2(sigchld_pipe, O_NONBLOCK | O_CLOEXEC) == -1) {
+        perror("smash error: pipe failed");
+        sigchld_pipe[0] = -1;
+        sigchld_pipe[1] = -1;
+    }
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timer_fd == -1) {
+        perror("smash error: timerfd_create failed");
+    }
+}
+
+EventLoop::~EventLoop() {
+    if (sigchld_pipe[0] != -1) {
+        close(sigchld_pipe[0]);
+        close(sigchld_pipe[1]);
+    }
+    if (timer_fd != -1) {
+        close(timer_fd);
+    }
+}
+
+void EventLoop::notifyChildChanged() {
+    int saved_errno = errno;
+    char byte = 0;
+    // if the pipe is full a wakeup is already pending, so failing is fine
+    ssize_t ignored = write(sigchld_pipe[1], &byte, 1);
+    (void)ignored;
+    errno = saved_errno;
+}
+
+void EventLoop::notifyInterrupt() {
+    got_interrupt = 1;
+}
+
+void EventLoop::clearInterrupt() {
+    got_interrupt = 0;
+}
+
+bool EventLoop::isInterrupted() {
+    return got_interrupt != 0;
+}
+
+void EventLoop::drainSigchldPipe() {
+    char buff[64];
+    while (read(sigchld_pipe[0], buff, sizeof(buff)) > 0) {}
+}
+
+EventLoopResult EventLoop::waitForEvents(int timeout_ms, int watch_fd) {
+    if (got_interrupt) {
+        got_interrupt = 0;
+        return EVENT_INTERRUPTED;
+    }
+
+    // sigchld pipe, timerfd, the caller's fd and then the watched fds.
+    // a negative fd is ignored by poll
+    std::vector<struct pollfd> poll_fds(3 + fd_watches.size());
+    poll_fds[0].fd = sigchld_pipe[0];
+    poll_fds[1].fd = timer_fd;
+    poll_fds[2].fd = watch_fd;
+    size_t i = 3;
+    for (auto& fd_watch : fd_watches) {
+        poll_fds[i++].fd = fd_watch.first;
+    }
+    for (auto& poll_fd : poll_fds) {
+        poll_fd.events = POLLIN;
+        poll_fd.revents = 0;
+    }
+
+    int result = poll(poll_fds.data(), poll_fds.size(), timeout_ms);
+    if (result == -1 && errno != EINTR) {
+        perror("smash error: poll failed");
+    }
+    if (got_interrupt) {
+        got_interrupt = 0;
+        return EVENT_INTERRUPTED;
+    }
+    if (result == 0) {
+        return EVENT_TIMEOUT;
+    }
+
+    if (poll_fds[1].revents & POLLIN) {
+        runExpiredTimers();
+    }
+    bool served_watch = false;
+    for (i = 3; i < poll_fds.size(); i++) {
+        // a callback may remove its own watch or others
+        auto it = fd_watches.find(poll_fds[i].fd);
+        if (poll_fds[i].revents != 0 && it != fd_watches.end()) {
+            FdCallback callback = it->second;
+            callback();
+            served_watch = true;
+        }
+    }
+    if (poll_fds[0].revents & POLLIN) {
+        drainSigchldPipe();
+        return EVENT_CHILD_CHANGED;
+    }
+    if (poll_fds[2].revents != 0) {
+        // readable, or hung up which the reader sees as end of file
+        return EVENT_FD_READY;
+    }
+    if (poll_fds[1].revents & POLLIN) {
+        return EVENT_TIMER_FIRED;
+    }
+    if (served_watch) {
+        return EVENT_WATCH_SERVED;
+    }
+
+    // interrupted by another signal, like ctrl-Z
+    return EVENT_CHILD_CHANGED;
+}
+
+int EventLoop::addTimer(long long expire_ms, TimerCallback callback) {
+    int timer_id = timers.add(expire_ms, callback);
+
+    long long wakeup_ms = timers.nextWakeupMs();
+    if (armed_ms == -1 || wakeup_ms < armed_ms) {
+        armTimerFd();
+    }
+
+    return timer_id;
+}
+
+void EventLoop::cancelTimer(int timer_id) {
+    // the timerfd is left armed, an early wakeup finds nothing expired
+    timers.cancel(timer_id);
+}
+
+void EventLoop::addFdWatch(int fd, FdCallback callback) {
+    fd_watches[fd] = callback;
+}
+
+void EventLoop::removeFdWatch(int fd) {
+    fd_watches.erase(fd);
+}
+
+void EventLoop::armTimerFd() {
+    struct itimerspec timer_spec = {};
+    armed_ms = timers.nextWakeupMs();
+    if (armed_ms != -1) {
+        long long expire_ms = armed_ms;
+        timer_spec.it_value.tv_sec = expire_ms / 1000;
+        timer_spec.it_value.tv_nsec = (expire_ms % 1000) * 1000000;
+        if (timer_spec.it_value.tv_sec == 0 && timer_spec.it_value.tv_nsec == 0) {
+            // zero would disarm the timerfd
+            timer_spec.it_value.tv_nsec = 1;
+        }
+    }
+
+    if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &timer_spec, nullptr)
+        == -1) {
+        perror("smash error: timerfd_settime failed");
+    }
+}
+
+void EventLoop::runExpiredTimers() {
+    uint64_t expirations;
+    ssize_t ignored = read(timer_fd, &expirations, sizeof(expirations));
+    (void)ignored;
+
+    // the callbacks may add or cancel timers, so they run after the wheel
+    // is done turning
+    std::vector<TimerCallback> expired_callbacks;
+    timers.advance(monotonicTimeMs(), expired_callbacks);
+    for (auto& callback : expired_callbacks) {
+        callback();
+    }
+
+    armTimerFd();
+}
+
+long long monotonicTimeMs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<long long>(now.tv_sec) * 1000 + now.tv_nsec / 1000000;
+}
@@ -0,0 +1,90 @@
+#ifndef HW1_EVENTLOOP_H
+#define HW1_EVENTLOOP_H
+
+#include <signal.h>
+#include <functional>
+#include <map>
+
+#include "TimerWheel.h"
+
+typedef enum {
+    EVENT_CHILD_CHANGED = 1,
+    EVENT_TIMEOUT = 2,
+    EVENT_INTERRUPTED = 3,
+    EVENT_TIMER_FIRED = 4,
+    EVENT_FD_READY = 5,
+    EVENT_WATCH_SERVED = 6
+} EventLoopResult;
+
+const int WAIT_FOREVER = -1;
+const int NO_FD = -1;
+
+typedef TimerWheel::Callback TimerCallback;
+typedef std::function<void()> FdCallback;
+
+/* Lets smash sleep until something it waits for happens, instead of polling.
+ * The SIGCHLD handler writes into a self-pipe, so a single poll call wakes
+ * up on a child state change, a timer, a timeout or ctrl-C.
+ * All of the timers live in one timer wheel, which is turned by a single
+ * timerfd armed for its next event, and their callbacks run from
+ * waitForEvents in smash's main flow. So do the callbacks of watched fds,
+ * which smash drains in the background */
+class EventLoop {
+    int sigchld_pipe[2];
+    int timer_fd;
+    volatile sig_atomic_t got_interrupt;
+    TimerWheel timers;
+    // the time timer_fd is armed for, -1 if disarmed
+    long long armed_ms;
+    std::map<int, FdCallback> fd_watches;
+
+    void drainSigchldPipe();
+    void armTimerFd();
+    void runExpiredTimers();
+
+public:
+    // constructor
+    EventLoop();
+
+    // destructor
+    ~EventLoop();
+
+    // disable copy ctor
+    EventLoop(EventLoop const&) = delete;
+
+    // disable = operator
+    void operator=(EventLoop const&) = delete;
+
+    // called from the SIGCHLD handler, async-signal-safe
+    void notifyChildChanged();
+
+    // called from the SIGINT handler, async-signal-safe
+    void notifyInterrupt();
+
+    // forgets a ctrl-C that arrived before the caller started waiting
+    void clearInterrupt();
+
+    // a ctrl-C arrived since clearInterrupt, for built-ins that run long
+    // and check it on the way
+    bool isInterrupted();
+
+    // blocks until a child changed state, ctrl-C, a timer fired,
+    // watch_fd became readable or timeout_ms passed
+    EventLoopResult waitForEvents(int timeout_ms, int watch_fd = NO_FD);
+
+    // runs callback once CLOCK_MONOTONIC reaches expire_ms, returns an ID
+    // for cancelTimer
+    int addTimer(long long expire_ms, TimerCallback callback);
+
+    void cancelTimer(int timer_id);
+
+    // runs callback whenever fd is readable or hung up, until removed
+    void addFdWatch(int fd, FdCallback callback);
+
+    void removeFdWatch(int fd);
+};
+
+/* milliseconds of CLOCK_MONOTONIC, for computing deadlines */
+long long monotonicTimeMs();
+
+#endif //HW1_EVENTLOOP_H
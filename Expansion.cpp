@@ -0,0 +1,786 @@
+#include "Expansion.h"
+#include "SmallShell.h"
+#include "utilities.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fcntl.h>
+#include <pwd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <dirent.h>
+
+// the record getdents64 fills, glibc only wraps it in newer versions
+struct LinuxDirent64 {
+    ino64_t d_ino;
+    off64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+GlobPattern::GlobPattern(const std::string& pattern,
+                         const std::vector<bool>& is_glob_char)
+        : has_wildcards(false) {
+    for (size_t i = 0; i < pattern.size(); i++) {
+        Token token;
+        token.type = LITERAL_CHAR;
+        token.c = pattern[i];
+
+        if (is_glob_char[i]) {
+            if (pattern[i] == '*') {
+                token.type = ANY_STRING;
+                // "**" matches the same as "*"
+                if (!tokens.empty() && tokens.back().type == ANY_STRING) {
+                    continue;
+                }
+            } else if (pattern[i] == '?') {
+                token.type = ANY_CHAR;
+            } else if (pattern[i] == '[') {
+                size_t class_end = i;
+                if (compileCharClass(pattern, class_end, token)) {
+                    i = class_end;
+                }
+            }
+        }
+
+        has_wildcards = has_wildcards || token.type != LITERAL_CHAR;
+        tokens.push_back(token);
+    }
+}
+
+static bool matchesNamedClass(const std::string& class_name, int c) {
+    if (class_name == "alpha") return isalpha(c);
+    if (class_name == "digit") return isdigit(c);
+    if (class_name == "alnum") return isalnum(c);
+    if (class_name == "upper") return isupper(c);
+    if (class_name == "lower") return islower(c);
+    if (class_name == "space") return isspace(c);
+    if (class_name == "punct") return ispunct(c);
+    if (class_name == "xdigit") return isxdigit(c);
+    return false;
+}
+
+bool GlobPattern::compileCharClass(const std::string& pattern, size_t& i,
+                                   Token& token) {
+    size_t pos = i + 1;
+    bool negate = false;
+    if (pos < pattern.size() && (pattern[pos] == '!' || pattern[pos] == '^')) {
+        negate = true;
+        pos++;
+    }
+
+    std::bitset<256> chars;
+    bool is_first = true;
+    while (pos < pattern.size() && (pattern[pos] != ']' || is_first)) {
+        is_first = false;
+        unsigned char c = pattern[pos];
+
+        if (c == '[' && pos + 1 < pattern.size() && pattern[pos + 1] == ':') {
+            size_t name_end = pattern.find(":]", pos + 2);
+            if (name_end != std::string::npos) {
+                std::string class_name = pattern.substr(pos + 2,
+                                                        name_end - pos - 2);
+                for (int ch = 0; ch < 256; ch++) {
+                    if (matchesNamedClass(class_name, ch)) {
+                        chars.set(ch);
+                    }
+                }
+                pos = name_end + 2;
+                continue;
+            }
+        }
+
+        if (pos + 2 < pattern.size() && pattern[pos + 1] == '-'
+            && pattern[pos + 2] != ']') {
+            unsigned char range_end = pattern[pos + 2];
+            for (int ch = c; ch <= range_end; ch++) {
+                chars.set(ch);
+            }
+            pos += 3;
+            continue;
+        }
+
+        chars.set(c);
+        pos++;
+    }
+    if (pos >= pattern.size()) {
+        // no closing "]", the "[" is literal
+        return false;
+    }
+
+    token.type = CHAR_CLASS;
+    token.chars = negate ? ~chars : chars;
+    i = pos;
+    return true;
+}
+
+bool GlobPattern::matchesChar(const Token& token, char c) const {
+    switch (token.type) {
+        case LITERAL_CHAR:
+            return token.c == c;
+        case ANY_CHAR:
+            return true;
+        case CHAR_CLASS:
+            return token.chars.test(static_cast<unsigned char>(c));
+        default:
+            return false;
+    }
+}
+
+bool GlobPattern::matches(const std::string& name) const {
+    // on a mismatch, the last "*" takes one more char and matching goes on
+    // from there. No deeper backtracking is ever needed
+    size_t token_idx = 0, name_idx = 0;
+    size_t star_token_idx = std::string::npos, star_name_idx = 0;
+
+    while (name_idx < name.size()) {
+        if (token_idx < tokens.size()
+            && tokens[token_idx].type == ANY_STRING) {
+            star_token_idx = token_idx++;
+            star_name_idx = name_idx;
+            continue;
+        }
+        if (token_idx < tokens.size()
+            && matchesChar(tokens[token_idx], name[name_idx])) {
+            token_idx++;
+            name_idx++;
+            continue;
+        }
+        if (star_token_idx == std::string::npos) {
+            return false;
+        }
+        token_idx = star_token_idx + 1;
+        name_idx = ++star_name_idx;
+    }
+
+    while (token_idx < tokens.size() && tokens[token_idx].type == ANY_STRING) {
+        token_idx++;
+    }
+    return token_idx == tokens.size();
+}
+
+bool GlobPattern::hasWildcards() const {
+    return has_wildcards;
+}
+
+bool GlobPattern::matchesHiddenNames() const {
+    return !tokens.empty() && tokens[0].type == LITERAL_CHAR
+           && tokens[0].c == '.';
+}
+
+//----------------------------------------------------------------------------
+
+static long long timespecToNs(const struct timespec& time) {
+    return static_cast<long long>(time.tv_sec) * 1000 * 1000 * 1000
+           + time.tv_nsec;
+}
+
+bool DirectoryCache::readListing(const std::string& dir_path,
+                                 Listing& listing) {
+    int fd = open(dir_path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd == -1) {
+        return false;
+    }
+
+    // the mtime is taken before reading, so a change during the read shows
+    // up as a newer mtime next time
+    struct stat dir_stat;
+    if (fstat(fd, &dir_stat) == -1) {
+        close(fd);
+        return false;
+    }
+    listing.dev = dir_stat.st_dev;
+    listing.ino = dir_stat.st_ino;
+    listing.mtime = dir_stat.st_mtim;
+    listing.entries.clear();
+
+    char buff[32 * 1024];
+    long bytes_read_count;
+    while ((bytes_read_count = syscall(SYS_getdents64, fd, buff,
+                                       sizeof(buff))) > 0) {
+        for (long offset = 0; offset < bytes_read_count; ) {
+            auto dirent = reinterpret_cast<LinuxDirent64*>(buff + offset);
+            offset += dirent->d_reclen;
+            if (strcmp(dirent->d_name, ".") == 0
+                || strcmp(dirent->d_name, "..") == 0) {
+                continue;
+            }
+            DirEntry entry;
+            entry.name = dirent->d_name;
+            entry.type = dirent->d_type;
+            listing.entries.push_back(entry);
+        }
+    }
+    close(fd);
+    if (bytes_read_count == -1) {
+        return false;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    listing.is_racy = timespecToNs(now) - timespecToNs(listing.mtime)
+                      < racy_listing_window_ns;
+    return true;
+}
+
+const std::vector<DirectoryCache::DirEntry>* DirectoryCache::list(
+        const std::string& dir_path) {
+    auto it = listings.find(dir_path);
+    if (it != listings.end()) {
+        struct stat dir_stat;
+        const Listing& listing = it->second;
+        if (!listing.is_racy && stat(dir_path.c_str(), &dir_stat) == 0
+            && dir_stat.st_dev == listing.dev
+            && dir_stat.st_ino == listing.ino
+            && timespecToNs(dir_stat.st_mtim)
+               == timespecToNs(listing.mtime)) {
+            return &listing.entries;
+        }
+    }
+
+    if (it == listings.end() && listings.size() >= max_cached_directories) {
+        listings.clear();
+    }
+    Listing& listing = listings[dir_path];
+    if (!readListing(dir_path, listing)) {
+        listings.erase(dir_path);
+        return nullptr;
+    }
+    return &listing.entries;
+}
+
+//----------------------------------------------------------------------------
+
+namespace {
+
+// a word while it is being expanded, quoted chars are never glob chars
+struct ExpandedWord {
+    std::string text;
+    std::vector<bool> is_glob_char;
+    bool is_assignment;
+
+    void append(const std::string& str, bool is_glob) {
+        text += str;
+        is_glob_char.insert(is_glob_char.end(), str.size(), is_glob);
+    }
+    void append(char c, bool is_glob) {
+        text += c;
+        is_glob_char.push_back(is_glob);
+    }
+};
+
+class CommandLineExpander {
+    const std::string& cmd_line;
+    size_t pos;
+    std::vector<ExpandedWord> expanded_words;
+    ExpandedWord word;
+    bool is_in_word;
+    // still in the leading NAME=value words
+    bool is_in_assignments;
+    // unquoted expansions are split into words, not in a single word
+    bool is_splitting_words;
+
+    void startWordIfNeeded();
+    void endWord();
+    bool expandParameter(bool is_quoted);
+    bool expandSingleQuotes();
+    bool expandDoubleQuotes();
+    void expandTilde();
+    bool isBraceExpansion();
+    bool scanWords();
+
+public:
+    explicit CommandLineExpander(const std::string& cmd_line)
+            : cmd_line(cmd_line), pos(0), is_in_word(false),
+              is_in_assignments(true), is_splitting_words(true) {}
+
+    bool expand(std::vector<std::string>& assignments,
+                std::vector<std::string>& words);
+
+    bool expandWord(std::string& expanded);
+
+    bool expandHereDocument(std::string& expanded);
+};
+
+}
+
+void CommandLineExpander::startWordIfNeeded() {
+    if (is_in_word) {
+        return;
+    }
+    is_in_word = true;
+    word = ExpandedWord();
+
+    // NAME=value before the command name sets a variable
+    word.is_assignment = false;
+    if (is_in_assignments) {
+        size_t name_end = cmd_line.find('=', pos);
+        if (name_end != std::string::npos
+            && isValidVariableName(cmd_line.substr(pos, name_end - pos))) {
+            word.is_assignment = true;
+        } else {
+            is_in_assignments = false;
+        }
+    }
+}
+
+void CommandLineExpander::endWord() {
+    if (!is_in_word) {
+        return;
+    }
+    expanded_words.push_back(word);
+    is_in_word = false;
+}
+
+bool CommandLineExpander::expandParameter(bool is_quoted) {
+    // pos is on the "$"
+    SmallShell& smash = SmallShell::getInstance();
+    size_t name_start = pos + 1;
+    if (name_start >= cmd_line.size()) {
+        startWordIfNeeded();
+        word.append('$', false);
+        pos++;
+        return true;
+    }
+
+    std::string name;
+    char c = cmd_line[name_start];
+    if (c == '{') {
+        size_t name_end = cmd_line.find('}', name_start);
+        if (name_end == std::string::npos) {
+            return false;
+        }
+        name = cmd_line.substr(name_start + 1, name_end - name_start - 1);
+        pos = name_end + 1;
+        // ${VAR:-x}, ${#VAR}, ${VAR%x} and the like are bash's
+        if (!isValidVariableName(name) && name != "?" && name != "$"
+            && name != "!") {
+            return false;
+        }
+    } else if (c == '?' || c == '$' || c == '!') {
+        name = std::string(1, c);
+        pos = name_start + 1;
+    } else if (isalpha(c) || c == '_') {
+        size_t name_end = name_start;
+        while (name_end < cmd_line.size()
+               && (isalnum(cmd_line[name_end]) || cmd_line[name_end] == '_')) {
+            name_end++;
+        }
+        name = cmd_line.substr(name_start, name_end - name_start);
+        pos = name_end;
+    } else if (c == '(' || isdigit(c) || c == '@' || c == '*' || c == '#'
+               || c == '-') {
+        // command substitution, arithmetic and positional parameters
+        return false;
+    } else {
+        // a lone "$" is literal
+        startWordIfNeeded();
+        word.append('$', false);
+        pos++;
+        return true;
+    }
+
+    std::string value;
+    if (name == "?") {
+        value = std::to_string(smash.last_exit_status);
+    } else if (name == "$") {
+        value = std::to_string(smash.smash_pid);
+    } else if (name == "!") {
+        value = smash.last_bg_pid ? std::to_string(smash.last_bg_pid) : "";
+    } else {
+        smash.env.get(name, value);
+    }
+
+    // the value of an unquoted expansion is split into words and globbed,
+    // but not in an assignment
+    if (is_quoted || !is_splitting_words
+        || (is_in_word && word.is_assignment)) {
+        startWordIfNeeded();
+        word.append(value, false);
+        return true;
+    }
+    for (char value_char : value) {
+        if (isspace(value_char)) {
+            endWord();
+            continue;
+        }
+        startWordIfNeeded();
+        word.append(value_char, value_char == '*' || value_char == '?'
+                                || value_char == '[');
+    }
+    return true;
+}
+
+bool CommandLineExpander::expandSingleQuotes() {
+    size_t quote_end = cmd_line.find('\'', pos + 1);
+    if (quote_end == std::string::npos) {
+        return false;
+    }
+    startWordIfNeeded();
+    word.append(cmd_line.substr(pos + 1, quote_end - pos - 1), false);
+    pos = quote_end + 1;
+    return true;
+}
+
+bool CommandLineExpander::expandDoubleQuotes() {
+    startWordIfNeeded();
+    pos++;
+    while (pos < cmd_line.size() && cmd_line[pos] != '"') {
+        char c = cmd_line[pos];
+        if (c == '`') {
+            return false;
+        }
+        if (c == '$') {
+            if (!expandParameter(true)) {
+                return false;
+            }
+            continue;
+        }
+        if (c == '\\' && pos + 1 < cmd_line.size()
+            && strchr("$`\"\\", cmd_line[pos + 1]) != nullptr) {
+            pos++;
+            c = cmd_line[pos];
+        }
+        word.append(c, false);
+        pos++;
+    }
+    if (pos >= cmd_line.size()) {
+        return false;
+    }
+    pos++;
+    return true;
+}
+
+void CommandLineExpander::expandTilde() {
+    // pos is on the "~" at a word start, "~" or "~user" up to the first "/"
+    size_t prefix_end = pos + 1;
+    while (prefix_end < cmd_line.size()
+           && (isalnum(cmd_line[prefix_end]) || cmd_line[prefix_end] == '_'
+               || cmd_line[prefix_end] == '-'
+               || cmd_line[prefix_end] == '.')) {
+        prefix_end++;
+    }
+    if (prefix_end < cmd_line.size() && cmd_line[prefix_end] != '/'
+        && !isspace(cmd_line[prefix_end])) {
+        // e.g. "~'x'", not a tilde prefix
+        startWordIfNeeded();
+        word.append('~', false);
+        pos++;
+        return;
+    }
+
+    std::string user_name = cmd_line.substr(pos + 1, prefix_end - pos - 1);
+    std::string home_dir;
+    bool is_known_home = false;
+    if (user_name.empty()) {
+        is_known_home = SmallShell::getInstance().env.get("HOME", home_dir);
+    } else {
+        struct passwd* user_info = getpwnam(user_name.c_str());
+        if (user_info != nullptr) {
+            home_dir = user_info->pw_dir;
+            is_known_home = true;
+        }
+    }
+
+    startWordIfNeeded();
+    if (is_known_home) {
+        word.append(home_dir, false);
+    } else {
+        word.append(cmd_line.substr(pos, prefix_end - pos), false);
+    }
+    pos = prefix_end;
+}
+
+bool CommandLineExpander::isBraceExpansion() {
+    // pos is on an unquoted "{", "{a,b}" and "{1..3}" are bash's
+    for (size_t i = pos + 1; i < cmd_line.size(); i++) {
+        char c = cmd_line[i];
+        if (c == '}' || isspace(c)) {
+            return false;
+        }
+        if (c == ',' || (c == '.' && i + 1 < cmd_line.size()
+                         && cmd_line[i + 1] == '.')) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool CommandLineExpander::scanWords() {
+    while (pos < cmd_line.size()) {
+        char c = cmd_line[pos];
+
+        if (isspace(c)) {
+            endWord();
+            pos++;
+            continue;
+        }
+        if (strchr(";&|<>()`", c) != nullptr || (c == '#' && !is_in_word)) {
+            return false;
+        }
+
+        if (c == '\\') {
+            startWordIfNeeded();
+            if (pos + 1 < cmd_line.size()) {
+                pos++;
+            }
+            word.append(cmd_line[pos], false);
+            pos++;
+        } else if (c == '\'') {
+            if (!expandSingleQuotes()) {
+                return false;
+            }
+        } else if (c == '"') {
+            if (!expandDoubleQuotes()) {
+                return false;
+            }
+        } else if (c == '$') {
+            if (!expandParameter(false)) {
+                return false;
+            }
+        } else if (c == '~' && !is_in_word) {
+            expandTilde();
+        } else if (c == '{' && isBraceExpansion()) {
+            return false;
+        } else {
+            startWordIfNeeded();
+            bool is_glob = (c == '*' || c == '?' || c == '[')
+                           && !word.is_assignment;
+            word.append(c, is_glob);
+            pos++;
+        }
+    }
+    endWord();
+    return true;
+}
+
+bool CommandLineExpander::expand(std::vector<std::string>& assignments,
+                                 std::vector<std::string>& words) {
+    if (!scanWords()) {
+        return false;
+    }
+
+    assignments.clear();
+    words.clear();
+    for (auto& expanded_word : expanded_words) {
+        if (expanded_word.is_assignment) {
+            assignments.push_back(expanded_word.text);
+            continue;
+        }
+        for (auto& path : expandGlob(expanded_word.text,
+                                     expanded_word.is_glob_char)) {
+            words.push_back(path);
+        }
+    }
+    return true;
+}
+
+bool CommandLineExpander::expandWord(std::string& expanded) {
+    is_in_assignments = false;
+    is_splitting_words = false;
+    if (!scanWords()) {
+        return false;
+    }
+    expanded.clear();
+    for (auto& expanded_word : expanded_words) {
+        if (!expanded.empty()) {
+            expanded += ' ';
+        }
+        expanded += expanded_word.text;
+    }
+    return true;
+}
+
+bool CommandLineExpander::expandHereDocument(std::string& expanded) {
+    // quotes are plain text here, only "$" and backslashes are special
+    is_in_assignments = false;
+    startWordIfNeeded();
+    while (pos < cmd_line.size()) {
+        char c = cmd_line[pos];
+        if (c == '`') {
+            return false;
+        }
+        if (c == '$') {
+            if (!expandParameter(true)) {
+                return false;
+            }
+            continue;
+        }
+        if (c == '\\' && pos + 1 < cmd_line.size()) {
+            char next_char = cmd_line[pos + 1];
+            if (next_char == '\n') {
+                // a line continuation
+                pos += 2;
+                continue;
+            }
+            if (strchr("$`\\", next_char) != nullptr) {
+                pos++;
+                c = next_char;
+            }
+        }
+        word.append(c, false);
+        pos++;
+    }
+    expanded = word.text;
+    return true;
+}
+
+bool expandCommandLine(const std::string& cmd_line,
+                       std::vector<std::string>& assignments,
+                       std::vector<std::string>& words) {
+    CommandLineExpander expander(cmd_line);
+    return expander.expand(assignments, words);
+}
+
+bool expandWord(const std::string& raw_word, std::string& expanded) {
+    CommandLineExpander expander(raw_word);
+    return expander.expandWord(expanded);
+}
+
+bool expandHereDocument(const std::string& body, std::string& expanded) {
+    CommandLineExpander expander(body);
+    return expander.expandHereDocument(expanded);
+}
+
+//----------------------------------------------------------------------------
+
+static bool isDirEntryDirectory(const DirectoryCache::DirEntry& entry,
+                                 const std::string& path) {
+    if (entry.type == DT_DIR) {
+        return true;
+    }
+    if (entry.type != DT_LNK && entry.type != DT_UNKNOWN) {
+        return false;
+    }
+    // a symlink to a directory counts, some filesystems give no type
+    struct stat path_stat;
+    return stat(path.c_str(), &path_stat) == 0 && S_ISDIR(path_stat.st_mode);
+}
+
+std::vector<std::string> expandGlob(const std::string& word,
+                                    const std::vector<bool>& is_glob_char) {
+    if (std::find(is_glob_char.begin(), is_glob_char.end(), true)
+        == is_glob_char.end()) {
+        return std::vector<std::string>(1, word);
+    }
+
+    // matching goes one path component at a time, e.g. "src/*/*.c"
+    std::vector<std::string> prefixes(1, "");
+    DirectoryCache& dir_cache = SmallShell::getInstance().dir_cache;
+    size_t component_start = 0;
+    bool is_word_globbed = false;
+    bool has_literal_after_glob = false;
+
+    while (component_start <= word.size()) {
+        size_t component_end = word.find('/', component_start);
+        bool is_last = (component_end == std::string::npos);
+        if (is_last) {
+            component_end = word.size();
+        }
+        std::string component = word.substr(component_start,
+                                            component_end - component_start);
+        std::vector<bool> component_glob_chars(
+                is_glob_char.begin() + component_start,
+                is_glob_char.begin() + component_end);
+        std::string separator = is_last ? "" : "/";
+
+        GlobPattern pattern(component, component_glob_chars);
+        std::vector<std::string> next_prefixes;
+        for (auto& prefix : prefixes) {
+            if (!pattern.hasWildcards()) {
+                next_prefixes.push_back(prefix + component + separator);
+                continue;
+            }
+            auto entries = dir_cache.list(prefix.empty() ? "." : prefix);
+            if (entries == nullptr) {
+                continue;
+            }
+            for (auto& entry : *entries) {
+                if ((entry.name[0] == '.' && !pattern.matchesHiddenNames())
+                    || !pattern.matches(entry.name)) {
+                    continue;
+                }
+                std::string path = prefix + entry.name;
+                if (!is_last && !isDirEntryDirectory(entry, path)) {
+                    continue;
+                }
+                next_prefixes.push_back(path + separator);
+            }
+        }
+        is_word_globbed = is_word_globbed || pattern.hasWildcards();
+        has_literal_after_glob = is_word_globbed && !pattern.hasWildcards();
+        prefixes.swap(next_prefixes);
+
+        if (is_last || prefixes.empty()) {
+            break;
+        }
+        component_start = component_end + 1;
+    }
+
+    // literal components after the last glob must exist too, the rest were
+    // found in their directories
+    std::vector<std::string> paths;
+    for (auto& path : prefixes) {
+        struct stat path_stat;
+        if (!has_literal_after_glob || lstat(path.c_str(), &path_stat) == 0) {
+            paths.push_back(path);
+        }
+    }
+    if (!is_word_globbed || paths.empty()) {
+        // like bash, a glob that matches nothing is left as is
+        return std::vector<std::string>(1, word);
+    }
+    std::sort(paths.begin(), paths.end());
+    return paths;
+}
+
+bool isAssignmentCommand(const std::string& cmd_line) {
+    if (cmd_line.find('=') == std::string::npos) {
+        return false;
+    }
+    std::vector<std::string> assignments, words;
+    return expandCommandLine(cmd_line, assignments, words)
+           && !assignments.empty() && words.empty();
+}
+
+std::string quoteWord(const std::string& word) {
+    // nothing is special inside single quotes, a single quote itself is
+    // closed, escaped and reopened
+    std::string quoted_word = "'";
+    for (char c : word) {
+        if (c == '\'') {
+            quoted_word += "'\\''";
+        } else {
+            quoted_word += c;
+        }
+    }
+    return quoted_word + "'";
+}
+
+void execExpandedCommand(const std::vector<std::string>& assignments,
+                         const std::vector<std::string>& words) {
+    // only the new proccess sees these, smash's copy is untouched
+    Environment& env = SmallShell::getInstance().env;
+    for (auto& assignment : assignments) {
+        size_t equal_sign = assignment.find('=');
+        env.set(assignment.substr(0, equal_sign),
+                assignment.substr(equal_sign + 1), true);
+    }
+    if (words.empty()) {
+        _exit(0);
+    }
+
+    std::vector<char*> argv;
+    for (auto& word : words) {
+        argv.push_back(const_cast<char*>(word.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    SmallShell::getInstance().stats.count(STATS_DIRECT_EXECS);
+    TRACE_INSTANT("execvp");
+    execvp(argv[0], argv.data());
+    perror("smash error: execvp failed");
+    _exit(COMMAND_NOT_RUNNABLE);
+}
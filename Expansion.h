@@ -0,0 +1,117 @@
+#ifndef HW1_EXPANSION_H
+#define HW1_EXPANSION_H
+
+#include <bitset>
+#include <map>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+#include <time.h>
+
+/* A glob pattern such as "*.log" or "file[0-9]?", compiled once into tokens
+ * so matching it against every name of a directory is a plain scan with no
+ * reparsing. Only characters marked in is_glob_char are wildcards, quoted
+ * ones are literal */
+class GlobPattern {
+    typedef enum {
+        LITERAL_CHAR = 0,
+        ANY_CHAR = 1,       // ?
+        ANY_STRING = 2,     // *
+        CHAR_CLASS = 3      // [a-z], [!0-9], [[:alpha:]]
+    } TokenType;
+
+    struct Token {
+        TokenType type;
+        char c;
+        std::bitset<256> chars;
+    };
+    std::vector<Token> tokens;
+    bool has_wildcards;
+
+    // parses a [...] class that starts at pattern[i], returns false if it
+    // isn't closed
+    bool compileCharClass(const std::string& pattern, size_t& i, Token& token);
+    bool matchesChar(const Token& token, char c) const;
+
+public:
+    // constructor
+    GlobPattern(const std::string& pattern,
+                const std::vector<bool>& is_glob_char);
+
+    bool matches(const std::string& name) const;
+
+    bool hasWildcards() const;
+
+    // a leading "." must be matched explicitly, "*" doesn't match it
+    bool matchesHiddenNames() const;
+};
+
+/* Directory listings read with getdents64, kept while the directory's mtime
+ * shows it didn't change, so globbing the same directories again costs a
+ * stat instead of a full read */
+class DirectoryCache {
+public:
+    struct DirEntry {
+        std::string name;
+        unsigned char type;     // DT_DIR, DT_REG, ... or DT_UNKNOWN
+    };
+
+private:
+    struct Listing {
+        dev_t dev;
+        ino_t ino;
+        struct timespec mtime;
+        // listed too close to its last change, so a change right after the
+        // listing could have kept the same mtime
+        bool is_racy;
+        std::vector<DirEntry> entries;
+    };
+    std::map<std::string, Listing> listings;
+
+    bool readListing(const std::string& dir_path, Listing& listing);
+
+public:
+    // the entries of the directory without "." and "..", nullptr if it
+    // can't be read
+    const std::vector<DirEntry>* list(const std::string& dir_path);
+};
+
+const size_t max_cached_directories = 256;
+// coarse filesystem timestamps tick every few ms
+const long long racy_listing_window_ns = 50LL * 1000 * 1000;
+
+/* expanding the command line like bash does for a simple command: quotes,
+ * backslashes, $VAR, ${VAR}, $?, $$, $!, ~, ~user and globs, with field
+ * splitting of unquoted expansions. Leading NAME=value words go into
+ * assignments, the rest into words. Returns false if the line needs bash,
+ * e.g. for operators, command substitution, brace expansion or ${VAR:-x} */
+bool expandCommandLine(const std::string& cmd_line,
+                       std::vector<std::string>& assignments,
+                       std::vector<std::string>& words);
+
+/* expanding a single word with no field splitting or globbing, like the
+ * word of a here-string. Returns false if it needs bash */
+bool expandWord(const std::string& raw_word, std::string& expanded);
+
+/* expanding $VAR and backslashes in the body of a here document, quotes are
+ * kept as is. Returns false if it needs bash, e.g. for `cmd` */
+bool expandHereDocument(const std::string& body, std::string& expanded);
+
+/* expanding a single glob word into the sorted paths it matches, or into
+ * itself if it matches nothing */
+std::vector<std::string> expandGlob(const std::string& word,
+                                    const std::vector<bool>& is_glob_char);
+
+/* quoting a word so that expandCommandLine and bash both read it back as
+ * the same single word, e.g. for pasting an item into a command line */
+std::string quoteWord(const std::string& word);
+
+/* determining if the command line only sets variables, e.g. "A=1 B=$A" */
+bool isAssignmentCommand(const std::string& cmd_line);
+
+/* replacing the current proccess image with an expanded command, the
+ * assignments go into its environment. Never returns */
+void execExpandedCommand(const std::vector<std::string>& assignments,
+                         const std::vector<std::string>& words);
+
+#endif //HW1_EXPANSION_H
@@ -1,26 +1,32 @@
 #include "ExternalCommand.h"
 
 ExternalCommand::ExternalCommand(std::string cmd_line)
-    : Command(cmd_line), isBgCommand(_isBackgroundCommand(cmd_line)),
-      bash_path("/bin/bash"), bash_flag("-c") {}
+    : Command(cmd_line), isBgCommand(_isBackgroundCommand(cmd_line)) {}
 
 
 void ExternalCommand::handleChildProccess(pid_t child_pid) {
     SmallShell& smash = SmallShell::getInstance();
     int status;
 
+    // the child also does it, whichever runs first. Otherwise a signal sent
+    // to the new job right away could miss its proccess group
+    setpgid(child_pid, child_pid);
+    smash.armJobDeadline(child_pid);
+
     if (isBgCommand) {
         if (waitpid(child_pid, &status, WNOHANG) == child_pid){
             // child proccess failed
             checkChildExitStatus(status);
         }
         // new job, never been in job list before
-        smash.jobs.addJob(this, child_pid, BG);
+        smash.last_bg_pid = child_pid;
+        int jobID = smash.jobs.addJob(this, child_pid, BG);
+        smash.attachJobCapture(jobID);
         return;
     }
     // otherwise the child runs in fg and smash waits
     smash.updateFgCommandInfo(this, child_pid);
-    int result = waitpid(smash.fg_pid, &status, WUNTRACED);
+    int result = smash.waitForFgProccess(smash.fg_pid, &status);
     if (result == -1){ // waitpid failed
         perror("smash error: waitpid failed");
         throw SystemCallFail();
@@ -34,6 +40,7 @@ void ExternalCommand::handleChildProccess(pid_t child_pid) {
     }
 
     // we get here if child and waitpid were successful
+    smash.clearJobDeadline(child_pid);
     smash.resetFgCommandInfo();
 }
 
@@ -42,23 +49,40 @@ SmallShellNextState ExternalCommand::execute() {
         _removeBackgroundSign(cmd_line);
     }
 
-    char* cmd_line_for_bash = const_cast<char*>(cmd_line.c_str());
-    char* const args[] = {bash_path, bash_flag, cmd_line_for_bash, NULL};
+    SmallShell& smash = SmallShell::getInstance();
+    // expanding in smash keeps the glob cache warm for the next commands
+    long long parse_start_ns = monotonicTimeNs();
+    std::vector<std::string> assignments, words;
+    bool is_expanded = expandCommandLine(cmd_line, assignments, words);
+    smash.launch_timer.addPhase(LAUNCH_PARSE, parse_start_ns);
+    smash.stats.curr_execution_path = is_expanded ? EXEC_PATH_DIRECT
+                                                  : EXEC_PATH_BASH;
 
+    smash.launch_timer.openExecReport();
+    long long fork_start_ns = monotonicTimeNs();
+    smash.stats.count(STATS_FORKS);
     pid_t pid = fork();
 
     if (pid == -1) {
+        smash.launch_timer.closeExecReport();
         perror("smash error: fork failed");
         throw SystemCallFail();
     }
     if (pid == 0){ // child proccess
         changeGroupID();
-        execv(args[0], args);
-        perror("smash error: execv failed");
-        _exit(COMMAND_NOT_RUNNABLE);
+        smash.prepareJobProccess(isBgCommand);
+        useSinksAsStdio();
+        // lines smash could expand skip bash and are exec'd directly
+        if (is_expanded) {
+            execExpandedCommand(assignments, words);
+        }
+        execCommandLine(cmd_line);
     }
 
     // smash proccess
+    TRACE_SINCE("fork", fork_start_ns);
+    smash.launch_timer.addPhase(LAUNCH_FORK, fork_start_ns);
+    smash.launch_timer.waitForExecs(monotonicTimeNs());
     handleChildProccess(pid);
 
     return CONTINUE_RUNNING;
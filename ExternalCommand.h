@@ -6,8 +6,6 @@
 
 class ExternalCommand: public Command {
     bool isBgCommand;
-    char bash_path[bash_path_length];
-    char bash_flag[bash_flag_length];
 
     void handleChildProccess(pid_t child_pid);
 public:
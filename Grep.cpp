@@ -0,0 +1,478 @@
+#include "Grep.h"
+
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+// the bytes that are common in text and code, most common first
+static const char common_bytes[] =
+        " etaoinsrhldcumfpgwybvk\n_(),;.=*/\"ETAOINSRHLDCUMFPGWYBV0123456789";
+
+// how common c is, the rank of a byte that isn't listed is 0
+static size_t getByteRank(unsigned char c) {
+    const char* found = static_cast<const char*>(
+            memchr(common_bytes, c, sizeof(common_bytes) - 1));
+    return found ? sizeof(common_bytes) - (found - common_bytes) : 0;
+}
+
+LiteralFinder::LiteralFinder(const std::string& literal, bool is_ignoring_case)
+    : literal(literal), is_ignoring_case(is_ignoring_case),
+      rare_byte_offset(std::string::npos) {
+    if (is_ignoring_case) {
+        for (auto& c : this->literal) {
+            c = tolower(static_cast<unsigned char>(c));
+        }
+    }
+    // memchr finds one byte only, which a letter isn't when ignoring case
+    size_t rarest_rank = sizeof(common_bytes);
+    for (size_t i = 0; i < this->literal.size(); i++) {
+        unsigned char c = this->literal[i];
+        size_t rank = getByteRank(c);
+        if (rank < rarest_rank && !(is_ignoring_case && isalpha(c))) {
+            rarest_rank = rank;
+            rare_byte_offset = i;
+        }
+    }
+    if (rarest_rank > getByteRank('0')) {
+        // as common as a letter, the vector compares do better
+        rare_byte_offset = std::string::npos;
+    }
+}
+
+bool LiteralFinder::isEmpty() const {
+    return literal.empty();
+}
+
+bool LiteralFinder::isMatchAt(const char* data) const {
+    if (!is_ignoring_case) {
+        return memcmp(data, literal.data(), literal.size()) == 0;
+    }
+    for (size_t i = 0; i < literal.size(); i++) {
+        if (tolower(static_cast<unsigned char>(data[i]))
+            != static_cast<unsigned char>(literal[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+#if defined(__x86_64__)
+
+// pos is where to look from, it is left where the vectors ended. Returns
+// the match, or size if there is none up to pos
+template <typename MatchFunc>
+static size_t findCandidatesSse2(const char* data, size_t size,
+                                 size_t literal_size, const char first[2],
+                                 const char last[2], size_t& pos,
+                                 MatchFunc is_match_at) {
+    const __m128i first_0 = _mm_set1_epi8(first[0]);
+    const __m128i first_1 = _mm_set1_epi8(first[1]);
+    const __m128i last_0 = _mm_set1_epi8(last[0]);
+    const __m128i last_1 = _mm_set1_epi8(last[1]);
+    for (; pos + literal_size - 1 + 16 <= size; pos += 16) {
+        __m128i heads = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(data + pos));
+        __m128i tails = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(data + pos + literal_size - 1));
+        __m128i is_first = _mm_or_si128(_mm_cmpeq_epi8(heads, first_0),
+                                        _mm_cmpeq_epi8(heads, first_1));
+        __m128i is_last = _mm_or_si128(_mm_cmpeq_epi8(tails, last_0),
+                                       _mm_cmpeq_epi8(tails, last_1));
+        uint32_t candidates = _mm_movemask_epi8(_mm_and_si128(is_first,
+                                                              is_last));
+        while (candidates != 0) {
+            size_t candidate = pos + __builtin_ctz(candidates);
+            if (is_match_at(data + candidate)) {
+                return candidate;
+            }
+            candidates &= candidates - 1;
+        }
+    }
+    return size;
+}
+
+template <typename MatchFunc>
+__attribute__((target("avx2")))
+static size_t findCandidatesAvx2(const char* data, size_t size,
+                                 size_t literal_size, const char first[2],
+                                 const char last[2], size_t& pos,
+                                 MatchFunc is_match_at) {
+    const __m256i first_0 = _mm256_set1_epi8(first[0]);
+    const __m256i first_1 = _mm256_set1_epi8(first[1]);
+    const __m256i last_0 = _mm256_set1_epi8(last[0]);
+    const __m256i last_1 = _mm256_set1_epi8(last[1]);
+    for (; pos + literal_size - 1 + 32 <= size; pos += 32) {
+        __m256i heads = _mm256_loadu_si256(
+                reinterpret_cast<const __m256i*>(data + pos));
+        __m256i tails = _mm256_loadu_si256(
+                reinterpret_cast<const __m256i*>(data + pos + literal_size - 1));
+        __m256i is_first = _mm256_or_si256(_mm256_cmpeq_epi8(heads, first_0),
+                                           _mm256_cmpeq_epi8(heads, first_1));
+        __m256i is_last = _mm256_or_si256(_mm256_cmpeq_epi8(tails, last_0),
+                                          _mm256_cmpeq_epi8(tails, last_1));
+        uint32_t candidates = _mm256_movemask_epi8(
+                _mm256_and_si256(is_first, is_last));
+        while (candidates != 0) {
+            size_t candidate = pos + __builtin_ctz(candidates);
+            if (is_match_at(data + candidate)) {
+                return candidate;
+            }
+            candidates &= candidates - 1;
+        }
+    }
+    return size;
+}
+
+static bool hasAvx2() {
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    return has_avx2;
+}
+
+#endif
+
+size_t LiteralFinder::find(const char* data, size_t size) const {
+    size_t literal_size = literal.size();
+    if (literal_size == 0) {
+        return 0;
+    }
+    if (size < literal_size) {
+        return size;
+    }
+    if (literal_size == 1 && !is_ignoring_case) {
+        const void* found = memchr(data, literal[0], size);
+        return found ? static_cast<const char*>(found) - data : size;
+    }
+
+    size_t pos = 0;
+    if (rare_byte_offset != std::string::npos) {
+        char rare_byte = literal[rare_byte_offset];
+        size_t last_pos = size - literal_size;
+        while (pos <= last_pos) {
+            const void* found = memchr(data + pos + rare_byte_offset,
+                                       rare_byte, last_pos - pos + 1);
+            if (found == nullptr) {
+                return size;
+            }
+            pos = static_cast<const char*>(found) - data - rare_byte_offset;
+            if (isMatchAt(data + pos)) {
+                return pos;
+            }
+            pos++;
+        }
+        return size;
+    }
+#if defined(__x86_64__)
+    // the literal is lowercase already when ignoring case
+    char first[2] = {literal[0], literal[0]};
+    char last[2] = {literal[literal_size - 1], literal[literal_size - 1]};
+    if (is_ignoring_case) {
+        first[1] = toupper(static_cast<unsigned char>(first[0]));
+        last[1] = toupper(static_cast<unsigned char>(last[0]));
+    }
+    auto is_match_at = [this](const char* candidate) {
+        return isMatchAt(candidate);
+    };
+    size_t found;
+    if (hasAvx2()) {
+        found = findCandidatesAvx2(data, size, literal_size, first, last, pos,
+                                   is_match_at);
+    } else {
+        found = findCandidatesSse2(data, size, literal_size, first, last, pos,
+                                   is_match_at);
+    }
+    if (found != size) {
+        return found;
+    }
+#endif
+    for (; pos + literal_size <= size; pos++) {
+        if (isMatchAt(data + pos)) {
+            return pos;
+        }
+    }
+    return size;
+}
+
+//----------------------------------------------------------------------------
+
+// skips the bracket expression that starts at pattern[i], e.g.
+// "[^]a-z[:digit:]]", i ends on its "]". Returns false if it isn't closed
+static bool skipBracketExpression(const std::string& pattern, size_t& i) {
+    size_t j = i + 1;
+    if (j < pattern.size() && pattern[j] == '^') {
+        j++;
+    }
+    if (j < pattern.size() && pattern[j] == ']') {
+        j++;
+    }
+    while (j < pattern.size() && pattern[j] != ']') {
+        if (pattern[j] == '[' && j + 1 < pattern.size()
+            && strchr(":.=", pattern[j + 1]) != nullptr) {
+            size_t close = pattern.find(std::string(1, pattern[j + 1]) + "]",
+                                        j + 2);
+            if (close == std::string::npos) {
+                return false;
+            }
+            j = close + 2;
+        } else {
+            j++;
+        }
+    }
+    i = j;
+    return j < pattern.size();
+}
+
+// the length of the group opener or closer at pattern[i], 0 if none
+static size_t getGroupTokenSize(const std::string& pattern, size_t i,
+                                bool is_extended, char paren) {
+    if (is_extended) {
+        return pattern[i] == paren ? 1 : 0;
+    }
+    return (pattern[i] == '\\' && i + 1 < pattern.size()
+            && pattern[i + 1] == paren) ? 2 : 0;
+}
+
+// the length of the quantifier at pattern[i], 0 if there is none
+static size_t getQuantifierSize(const std::string& pattern, size_t i,
+                                bool is_extended) {
+    if (i >= pattern.size()) {
+        return 0;
+    }
+    if (pattern[i] == '*') {
+        return 1;
+    }
+    if (is_extended) {
+        if (pattern[i] == '?' || pattern[i] == '+') {
+            return 1;
+        }
+        if (pattern[i] == '{') {
+            size_t close = pattern.find('}', i);
+            return (close == std::string::npos) ? 1 : close - i + 1;
+        }
+        return 0;
+    }
+    if (pattern[i] == '\\' && i + 1 < pattern.size()) {
+        if (pattern[i + 1] == '?' || pattern[i + 1] == '+') {
+            return 2;
+        }
+        if (pattern[i + 1] == '{') {
+            size_t close = pattern.find("\\}", i);
+            return (close == std::string::npos) ? 2 : close - i + 2;
+        }
+    }
+    return 0;
+}
+
+std::string getRequiredLiteral(const std::string& pattern, bool is_extended) {
+    std::string best_run;
+    std::string curr_run;
+    auto end_run = [&]() {
+        if (curr_run.size() > best_run.size()) {
+            best_run = curr_run;
+        }
+        curr_run.clear();
+    };
+
+    size_t i = 0;
+    while (i < pattern.size()) {
+        char c = pattern[i];
+        // the atom that starts at i
+        bool is_literal = false;
+        char literal_char = c;
+        size_t atom_end = i + 1;
+
+        if (getGroupTokenSize(pattern, i, is_extended, '(') != 0) {
+            // a group may be optional or repeated, it is skipped whole
+            int depth = 0;
+            size_t j = i;
+            while (j < pattern.size()) {
+                size_t open_size = getGroupTokenSize(pattern, j, is_extended,
+                                                     '(');
+                size_t close_size = getGroupTokenSize(pattern, j, is_extended,
+                                                      ')');
+                if (open_size != 0) {
+                    depth++;
+                    j += open_size;
+                } else if (close_size != 0) {
+                    j += close_size;
+                    if (--depth == 0) {
+                        break;
+                    }
+                } else {
+                    j += (pattern[j] == '\\') ? 2 : 1;
+                }
+            }
+            if (depth != 0) {
+                return "";
+            }
+            atom_end = j;
+        } else if (c == '\\' && i + 1 < pattern.size()) {
+            char escaped = pattern[i + 1];
+            if (!is_extended && escaped == '|') {
+                // alternation, no literal has to be there
+                return "";
+            }
+            is_literal = strchr(".[]*^$\\/", escaped) != nullptr
+                    || (is_extended && strchr("(){}|+?", escaped) != nullptr);
+            literal_char = escaped;
+            atom_end = i + 2;
+        } else if (c == '[') {
+            if (!skipBracketExpression(pattern, i)) {
+                return "";
+            }
+            atom_end = i + 1;
+        } else if (is_extended && c == '|') {
+            return "";
+        } else if (c != '.' && c != '^' && c != '$' && c != '*'
+                   && !(is_extended && strchr("?+{)", c) != nullptr)) {
+            is_literal = true;
+        }
+
+        size_t quantifier_size = getQuantifierSize(pattern, atom_end,
+                                                   is_extended);
+        if (is_literal && quantifier_size == 0) {
+            curr_run += literal_char;
+        } else {
+            // an optional or repeated char can't be relied on
+            end_run();
+        }
+        i = atom_end + quantifier_size;
+    }
+    end_run();
+    return best_run;
+}
+
+//----------------------------------------------------------------------------
+
+LineMatcher::LineMatcher(const std::string& pattern, const GrepOptions& options)
+    : pattern(pattern), options(options),
+      finder(options.is_fixed_string ? pattern
+                : getRequiredLiteral(pattern, options.is_extended),
+             options.is_ignoring_case),
+      has_regex(false) {}
+
+LineMatcher::~LineMatcher() {
+    if (has_regex) {
+        regfree(&regex);
+    }
+}
+
+bool LineMatcher::compile(std::string& error) {
+    if (options.is_fixed_string) {
+        // the finder is all it takes
+        return true;
+    }
+    int flags = REG_NOSUB | REG_NEWLINE;
+    if (options.is_extended) {
+        flags |= REG_EXTENDED;
+    }
+    if (options.is_ignoring_case) {
+        flags |= REG_ICASE;
+    }
+    int result = regcomp(&regex, pattern.c_str(), flags);
+    if (result != 0) {
+        char message[256];
+        regerror(result, &regex, message, sizeof(message));
+        error = message;
+        return false;
+    }
+    has_regex = true;
+    return true;
+}
+
+bool LineMatcher::isMatchingLine(const char* line, size_t size) const {
+    if (!has_regex) {
+        return finder.find(line, size) != size || finder.isEmpty();
+    }
+    // REG_STARTEND: the line is matched in place, with no copy to end it
+    regmatch_t bounds;
+    bounds.rm_so = 0;
+    bounds.rm_eo = size;
+    return regexec(&regex, line, 1, &bounds, REG_STARTEND) == 0;
+}
+
+void LineMatcher::appendLine(const char* line, size_t size,
+                             const std::string& name,
+                             unsigned long long line_number,
+                             std::string& output) const {
+    if (options.has_file_names) {
+        output += name;
+        output += ':';
+    }
+    if (options.has_line_numbers) {
+        output += std::to_string(line_number);
+        output += ':';
+    }
+    output.append(line, size);
+    output += '\n';
+}
+
+unsigned long long LineMatcher::searchLines(const char* data, size_t size,
+                                            const std::string& name,
+                                            unsigned long long& line_number,
+                                            std::string& output) const {
+    unsigned long long selected_count = 0;
+    bool is_printing = !options.is_counting && !options.is_listing_files
+                       && !options.is_quiet;
+    bool is_stopping_at_first = options.is_listing_files || options.is_quiet;
+    bool has_prefilter = !finder.isEmpty();
+    size_t pos = 0;
+
+    while (pos < size) {
+        // lines before the one with the next literal can't match
+        size_t candidate = has_prefilter
+                           ? pos + finder.find(data + pos, size - pos) : pos;
+        size_t candidate_line_start = size;
+        if (candidate < size) {
+            const void* prev_newline = memrchr(data + pos, '\n',
+                                               candidate - pos);
+            candidate_line_start = prev_newline
+                    ? static_cast<const char*>(prev_newline) - data + 1 : pos;
+        }
+
+        while (pos < candidate_line_start) {
+            const void* newline = memchr(data + pos, '\n',
+                                         candidate_line_start - pos);
+            size_t line_end = newline
+                    ? static_cast<const char*>(newline) - data : size;
+            line_number++;
+            if (options.is_inverted) {
+                selected_count++;
+                if (is_printing) {
+                    appendLine(data + pos, line_end - pos, name, line_number,
+                               output);
+                }
+                if (is_stopping_at_first) {
+                    return selected_count;
+                }
+            }
+            pos = line_end + 1;
+        }
+        if (pos >= size) {
+            break;
+        }
+
+        const void* newline = memchr(data + pos, '\n', size - pos);
+        size_t line_end = newline
+                ? static_cast<const char*>(newline) - data : size;
+        line_number++;
+        // with no regex the literal found is the match
+        bool is_match = (has_prefilter && options.is_fixed_string)
+                        || isMatchingLine(data + pos, line_end - pos);
+        if (is_match != options.is_inverted) {
+            selected_count++;
+            if (is_printing) {
+                appendLine(data + pos, line_end - pos, name, line_number,
+                           output);
+            }
+            if (is_stopping_at_first) {
+                return selected_count;
+            }
+        }
+        pos = line_end + 1;
+    }
+    return selected_count;
+}
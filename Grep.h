@@ -0,0 +1,96 @@
+#ifndef HW1_GREP_H
+#define HW1_GREP_H
+
+#include <cstddef>
+#include <string>
+#include <regex.h>
+
+// files at least this big are mapped instead of read
+const size_t grep_map_min_size = 64 * 1024;
+const size_t grep_read_size = 1024 * 1024;
+const int grep_max_threads = 16;
+
+struct GrepOptions {
+    bool is_fixed_string;       // -F
+    bool is_extended;           // -E
+    bool is_ignoring_case;      // -i
+    bool is_inverted;           // -v
+    bool is_counting;           // -c
+    bool is_listing_files;      // -l
+    bool is_quiet;              // -q
+    bool has_line_numbers;      // -n
+    bool has_file_names;        // -H, or more than one file
+};
+
+/* Finds a literal in a buffer. A literal with an uncommon byte jumps from
+ * one occurrence of that byte to the next with memchr. Otherwise the
+ * candidates are the positions where both the literal's first and last
+ * bytes match, found a whole vector at a time with AVX2 or SSE2 compares.
+ * Only candidates are compared in full. With ignore_case both cases of the
+ * bytes are candidates */
+class LiteralFinder {
+    std::string literal;
+    bool is_ignoring_case;
+    // where the uncommon byte is in the literal, npos if it has none
+    size_t rare_byte_offset;
+
+    bool isMatchAt(const char* data) const;
+
+public:
+    // constructor
+    LiteralFinder(const std::string& literal, bool is_ignoring_case);
+
+    // the position of the first occurrence in data, size if there is none
+    size_t find(const char* data, size_t size) const;
+
+    bool isEmpty() const;
+};
+
+/* the longest literal every match of the pattern must contain, used to
+ * skip lines that can't match without running the regex on them. "" if
+ * there is none, e.g. with alternation */
+std::string getRequiredLiteral(const std::string& pattern, bool is_extended);
+
+/* Selects lines like grep(1). The lines with the required literal are
+ * found by a LiteralFinder, and only they are run through a POSIX regex.
+ * A fixed string needs no regex at all, unless case is ignored. One
+ * matcher per thread, glibc serializes regexec calls on the same regex */
+class LineMatcher {
+    std::string pattern;
+    GrepOptions options;
+    LiteralFinder finder;
+    regex_t regex;
+    bool has_regex;
+
+    bool isMatchingLine(const char* line, size_t size) const;
+    void appendLine(const char* line, size_t size, const std::string& name,
+                    unsigned long long line_number, std::string& output) const;
+
+public:
+    // constructor
+    LineMatcher(const std::string& pattern, const GrepOptions& options);
+
+    // destructor
+    ~LineMatcher();
+
+    // disable copy ctor
+    LineMatcher(LineMatcher const&) = delete;
+
+    // disable = operator
+    void operator=(LineMatcher const&) = delete;
+
+    // returns false with regcomp's message in error if the pattern is bad
+    bool compile(std::string& error);
+
+    // searches the lines of data, the last one may have no newline. The
+    // selected lines are appended to output, unless only counting or
+    // listing. line_number is the number of the line before data, and is
+    // updated. Returns the number of selected lines, stops after the first
+    // one with -l or -q
+    unsigned long long searchLines(const char* data, size_t size,
+                                   const std::string& name,
+                                   unsigned long long& line_number,
+                                   std::string& output) const;
+};
+
+#endif //HW1_GREP_H
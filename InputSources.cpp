@@ -0,0 +1,276 @@
+#include "InputSources.h"
+#include "SmallShell.h"
+
+#include <sys/mman.h>
+#include <cerrno>
+#include <cstring>
+
+// skips the quoted part that starts at cmd_line[pos], pos ends after it.
+// Returns false if it isn't closed
+static bool skipQuoted(const std::string& cmd_line, size_t& pos) {
+    char quote = cmd_line[pos];
+    pos++;
+    while (pos < cmd_line.size() && cmd_line[pos] != quote) {
+        if (quote == '"' && cmd_line[pos] == '\\') {
+            pos++;
+        }
+        pos++;
+    }
+    if (pos >= cmd_line.size()) {
+        return false;
+    }
+    pos++;
+    return true;
+}
+
+// reads the word after the blanks at pos, e.g. the delimiter of
+// "<< 'EOF'". raw_word keeps its quotes, unquoted_word doesn't
+static bool readWord(const std::string& cmd_line, size_t& pos,
+                     std::string& raw_word, std::string& unquoted_word,
+                     bool& is_quoted) {
+    while (pos < cmd_line.size() && isblank(cmd_line[pos])) {
+        pos++;
+    }
+    size_t word_start = pos;
+    unquoted_word.clear();
+    is_quoted = false;
+    while (pos < cmd_line.size() && !isspace(cmd_line[pos])
+           && strchr(";&|<>()", cmd_line[pos]) == nullptr) {
+        char c = cmd_line[pos];
+        if (c == '\\' && pos + 1 < cmd_line.size()) {
+            is_quoted = true;
+            unquoted_word += cmd_line[pos + 1];
+            pos += 2;
+        } else if (c == '\'' || c == '"') {
+            is_quoted = true;
+            size_t quote_start = pos;
+            if (!skipQuoted(cmd_line, pos)) {
+                return false;
+            }
+            unquoted_word += cmd_line.substr(quote_start + 1,
+                                             pos - quote_start - 2);
+        } else {
+            unquoted_word += c;
+            pos++;
+        }
+    }
+    raw_word = cmd_line.substr(word_start, pos - word_start);
+    return !raw_word.empty();
+}
+
+// pos is right after "<(", it ends on the matching ")"
+static bool findClosingParen(const std::string& cmd_line, size_t& pos) {
+    int depth = 1;
+    while (pos < cmd_line.size()) {
+        char c = cmd_line[pos];
+        if (c == '\\') {
+            pos += 2;
+            continue;
+        }
+        if (c == '\'' || c == '"') {
+            if (!skipQuoted(cmd_line, pos)) {
+                return false;
+            }
+            continue;
+        }
+        if (c == '(') {
+            depth++;
+        } else if (c == ')' && --depth == 0) {
+            return true;
+        }
+        pos++;
+    }
+    return false;
+}
+
+bool findInputSources(const std::string& cmd_line,
+                      std::vector<InputSource>& sources) {
+    sources.clear();
+    size_t pos = 0;
+    while (pos < cmd_line.size()) {
+        char c = cmd_line[pos];
+        if (c == '\\') {
+            pos += 2;
+            continue;
+        }
+        if (c == '\'' || c == '"') {
+            if (!skipQuoted(cmd_line, pos)) {
+                return false;
+            }
+            continue;
+        }
+        if (c != '<') {
+            pos++;
+            continue;
+        }
+
+        InputSource source;
+        source.start = pos;
+        source.is_tab_stripped = false;
+        source.is_delimiter_quoted = false;
+        std::string unquoted_word;
+        if (cmd_line.compare(pos, 2, "<(") == 0) {
+            size_t inner_start = pos + 2;
+            pos = inner_start;
+            if (!findClosingParen(cmd_line, pos)) {
+                return false;
+            }
+            source.type = InputSource::PROCESS_SUBSTITUTION;
+            source.text = cmd_line.substr(inner_start, pos - inner_start);
+            pos++;
+        } else if (cmd_line.compare(pos, 3, "<<<") == 0) {
+            pos += 3;
+            bool is_quoted;
+            if (!readWord(cmd_line, pos, source.text, unquoted_word,
+                          is_quoted)) {
+                return false;
+            }
+            source.type = InputSource::HERE_STRING;
+        } else if (cmd_line.compare(pos, 2, "<<") == 0) {
+            pos += 2;
+            if (pos < cmd_line.size() && cmd_line[pos] == '-') {
+                source.is_tab_stripped = true;
+                pos++;
+            }
+            std::string raw_word;
+            if (!readWord(cmd_line, pos, raw_word, source.text,
+                          source.is_delimiter_quoted)) {
+                return false;
+            }
+            source.type = InputSource::HERE_DOCUMENT;
+        } else {
+            // a plain input redirection, left for bash
+            pos++;
+            continue;
+        }
+        source.end = pos;
+        sources.push_back(source);
+    }
+    return true;
+}
+
+// runs cmd with its stdout on a pipe, returns the pipe's read end
+static int startProcessSubstitution(const std::string& cmd) {
+    int pipe_fd[2];
+    if (pipe(pipe_fd) == -1) {
+        perror("smash error: pipe failed");
+        _exit(PIPE_FAILED);
+    }
+
+    SmallShell::getInstance().stats.count(STATS_FORKS);
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("smash error: fork failed");
+        _exit(FORK_FAILED);
+    }
+    if (pid == 0) {
+        if (dup2(pipe_fd[1], STDOUT_FILENO) == -1) {
+            perror("smash error: dup2 failed");
+            _exit(DUP2_FAILED);
+        }
+        if (close(pipe_fd[0]) == -1 || close(pipe_fd[1]) == -1) {
+            perror("smash error: close failed");
+            _exit(CLOSE_FAILED);
+        }
+        std::string cmd_line = cmd;
+        execCommandLine(cmd_line);
+    }
+
+    close(pipe_fd[1]);
+    return pipe_fd[0];
+}
+
+// stdin becomes a memfd holding data, nothing touches the disk
+static void setStdinData(const std::string& data) {
+    int memfd = memfd_create("smash-here-document", MFD_CLOEXEC);
+    if (memfd == -1) {
+        perror("smash error: memfd_create failed");
+        _exit(OPEN_FAILED);
+    }
+    const char* curr_data = data.data();
+    size_t size_left = data.size();
+    while (size_left > 0) {
+        ssize_t written = write(memfd, curr_data, size_left);
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("smash error: write failed");
+            _exit(WRITE_FAILED);
+        }
+        curr_data += written;
+        size_left -= written;
+    }
+    if (lseek(memfd, 0, SEEK_SET) == -1) {
+        perror("smash error: lseek failed");
+        _exit(OPEN_FAILED);
+    }
+    if (dup2(memfd, STDIN_FILENO) == -1) {
+        perror("smash error: dup2 failed");
+        _exit(DUP2_FAILED);
+    }
+    if (close(memfd) == -1) {
+        perror("smash error: close failed");
+        _exit(CLOSE_FAILED);
+    }
+}
+
+void substituteInputSources(std::string& cmd_line) {
+    std::vector<InputSource> sources;
+    if (!findInputSources(cmd_line, sources) || sources.empty()) {
+        return;
+    }
+
+    SmallShell& smash = SmallShell::getInstance();
+    size_t here_doc_idx = 0;
+    std::string new_cmd_line;
+    size_t copied_pos = 0;
+    // like in bash, the last input redirection is the one that counts
+    std::string stdin_data;
+    bool has_stdin_data = false;
+    std::string here_docs_for_bash;
+
+    for (auto& source : sources) {
+        new_cmd_line += cmd_line.substr(copied_pos, source.start - copied_pos);
+        copied_pos = source.end;
+        std::string construct = cmd_line.substr(source.start,
+                                                source.end - source.start);
+
+        if (source.type == InputSource::PROCESS_SUBSTITUTION) {
+            int read_fd = startProcessSubstitution(source.text);
+            new_cmd_line += "/dev/fd/" + std::to_string(read_fd);
+        } else if (source.type == InputSource::HERE_STRING) {
+            std::string word;
+            if (!expandWord(source.text, word)) {
+                new_cmd_line += construct;
+                continue;
+            }
+            stdin_data = word + '\n';
+            has_stdin_data = true;
+        } else {
+            HereDocument here_doc = {"", false};
+            if (here_doc_idx < smash.here_documents.size()) {
+                here_doc = smash.here_documents[here_doc_idx];
+            }
+            here_doc_idx++;
+            std::string body = here_doc.body;
+            if (here_doc.is_expanded
+                && !expandHereDocument(here_doc.body, body)) {
+                new_cmd_line += construct;
+                here_docs_for_bash += here_doc.body + source.text + '\n';
+                continue;
+            }
+            stdin_data = body;
+            has_stdin_data = true;
+        }
+    }
+    new_cmd_line += cmd_line.substr(copied_pos);
+    if (!here_docs_for_bash.empty()) {
+        new_cmd_line += '\n' + here_docs_for_bash;
+    }
+
+    if (has_stdin_data) {
+        setStdinData(stdin_data);
+    }
+    cmd_line = new_cmd_line;
+}
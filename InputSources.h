@@ -0,0 +1,46 @@
+#ifndef HW1_INPUTSOURCES_H
+#define HW1_INPUTSOURCES_H
+
+#include <string>
+#include <vector>
+
+/* A "<(cmd)", "<<< word" or "<< DELIM" in a command line */
+struct InputSource {
+    typedef enum {
+        PROCESS_SUBSTITUTION = 0,
+        HERE_STRING = 1,
+        HERE_DOCUMENT = 2
+    } SourceType;
+
+    SourceType type;
+    // the construct is cmd_line[start, end)
+    size_t start;
+    size_t end;
+    // the cmd, the unexpanded word or the delimiter
+    std::string text;
+    // "<<-" strips the leading tabs of the body lines
+    bool is_tab_stripped;
+    // a quoted delimiter leaves the body unexpanded
+    bool is_delimiter_quoted;
+};
+
+/* The body of a here document, read from the lines after its command line */
+struct HereDocument {
+    std::string body;
+    bool is_expanded;
+};
+
+/* finding the unquoted input sources of the command line, in order. Returns
+ * false if one of them isn't closed */
+bool findInputSources(const std::string& cmd_line,
+                      std::vector<InputSource>& sources);
+
+/* setting up the input sources of the command line, in the proccess that is
+ * about to exec it. "<(cmd)" starts cmd writing into a pipe and is replaced
+ * by "/dev/fd/N" of the pipe's read end. The data of a here-string or a here
+ * document is written once into a memfd, which becomes stdin, and the
+ * construct is removed. What needs bash is left in the line, with the here
+ * document's body appended for "bash -c" to read */
+void substituteInputSources(std::string& cmd_line);
+
+#endif //HW1_INPUTSOURCES_H
@@ -8,7 +8,10 @@
 
 JobList::JobEntry::JobEntry(int jobID, JobState job_state, Command *cmd,
                             pid_t job_pid)
-        : jobID(jobID), job_state(job_state), cmd(cmd), job_pid(job_pid) {
+        : jobID(jobID), job_state(job_state), cmd(cmd), job_pid(job_pid),
+          has_cpus(false), is_pinned(false), is_demoted(false), orig_nice(0),
+          orig_ioprio(0), deadline_ms(0) {
+    CPU_ZERO(&cpus);
     addition_time = time(NULL);
     if (addition_time == -1) {
         perror("smash error: time failed");
@@ -16,7 +19,7 @@ JobList::JobEntry::JobEntry(int jobID, JobState job_state, Command *cmd,
     }
 }
 
-std::string JobList::JobEntry::getJobCmdLine() {
+const std::string& JobList::JobEntry::getJobCmdLine() {
     return cmd->getCmdLine();
 }
 
@@ -27,19 +30,19 @@ std::string JobList::JobEntry::getJobCmdLine() {
 JobList::JobList()
     :  max_jobID(0), max_stopped_jobID(0) {}
 
-void JobList::addJob(Command *cmd, pid_t pid, JobState job_state,
-                int originalJobID) {
+int JobList::addJob(Command *cmd, pid_t pid, JobState job_state,
+                    int originalJobID) {
     if (originalJobID != FG_COMMAND_WASNT_IN_JOBLIST_BEFORE) {
         /* means that job (stopped/bg) was in list, then brought to fg with fg
          * command and then sent to job list again because of ctrl-z that
          * stopped it */
         if (jobs_map.count(originalJobID) == 0) {
-            return;
+            return originalJobID;
         }
         updateJobState(&jobs_map[originalJobID], STOPPED);
         // restart addition time
         jobs_map[originalJobID].addition_time = time(NULL);
-        return;
+        return originalJobID;
     }
 
     // otherwise. it's a new job
@@ -50,35 +53,83 @@ void JobList::addJob(Command *cmd, pid_t pid, JobState job_state,
         max_stopped_jobID = max_jobID;
     }
     jobs_map[new_jobID] = JobEntry(new_jobID, job_state, cmd, pid);
+    // the status and output of a previous job with the same ID are not
+    // the new job's
+    finished_jobs_status.erase(new_jobID);
+    SmallShell& smash = SmallShell::getInstance();
+    smash.dropJobCapture(new_jobID);
+
+    JobEntry& new_job = jobs_map[new_jobID];
+    new_job.deadline_ms = smash.getJobDeadline(pid);
+    smash.sched_policy.recordLaunchPlacement(new_job, job_state == BG);
+
+    return new_jobID;
 }
 
-void JobList::printJobDetails(JobEntry& job) {
+void JobList::printJobDetails(JobEntry& job, OutputSink& out) {
     int seconds_elapsed = static_cast<int>(difftime(time(NULL),
             job.addition_time));
 
-    std::string jobID = "[" + std::to_string(job.jobID) + "] ";
-    std::string details = jobID + job.getJobCmdLine() + " : "
-                          + std::to_string(job.job_pid) + " "
-                          + std::to_string(seconds_elapsed) + " secs";
+    // formatted straight into the output buffer
+    out << '[' << job.jobID << "] " << job.getJobCmdLine() << " : "
+        << job.job_pid << ' ' << seconds_elapsed << " secs";
     if (job.job_state == STOPPED) {
-        details += " (stopped)";
+        out << " (stopped)";
+    }
+    if (job.has_cpus) {
+        out << " [cpus " << cpuListToString(job.cpus) << ']';
     }
+    out << '\n';
+}
 
-    std::cout << details << std::endl;
+void JobList::printJobsList(OutputSink& out) {
+    removeFinishedJobs();
+    for (auto& job : jobs_map) {
+        printJobDetails(job.second, out);
+    }
 }
 
-void JobList::printJobsList() {
+void JobList::printJobsList(JobSelector& selector, OutputSink& out) {
     removeFinishedJobs();
     for (auto& job : jobs_map) {
-        printJobDetails(job.second);
+        if (selector.matches(job.second)) {
+            printJobDetails(job.second, out);
+        }
+    }
+}
+
+std::vector<JobList::JobEntry*> JobList::selectJobs(JobSelector& selector) {
+    std::vector<JobEntry*> selected_jobs;
+    for (auto& job : jobs_map) {
+        if (selector.matches(job.second)) {
+            selected_jobs.push_back(&job.second);
+        }
+    }
+    return selected_jobs;
+}
+
+int JobList::sendSignalToJobs(std::vector<JobEntry*>& jobs, int sig_num) {
+    int signaled_jobs_count = 0;
+    bool kill_failed = false;
+
+    for (auto job : jobs) {
+        if (killpg(job->job_pid, sig_num) == 0) {
+            signaled_jobs_count++;
+        } else if (errno != ESRCH && !kill_failed) {
+            // report once, not once per job, and keep signaling the rest
+            perror("smash error: kill failed");
+            kill_failed = true;
+        }
     }
+
+    return signaled_jobs_count;
 }
 
-void JobList::killAllJobs() {
+void JobList::killAllJobs(OutputSink& out) {
     removeFinishedJobs();
 
-    std::cout << "smash: sending SIGKILL signal to " <<  jobs_map.size()
-        << " jobs:" << std::endl;
+    out << "smash: sending SIGKILL signal to " << jobs_map.size()
+        << " jobs:" << '\n';
 
     for (auto& job : jobs_map) {
         int jobID = job.first;
@@ -86,23 +137,68 @@ void JobList::killAllJobs() {
         if (sendSignalToJob(jobID, SIGKILL) == JOB_DOESNT_EXIST) {
             continue;
         }
-        std::cout << job_entry.job_pid << ": " << job_entry.getJobCmdLine()
-                    << std::endl;
+        out << job_entry.job_pid << ": " << job_entry.getJobCmdLine() << '\n';
     }
 }
 
 void JobList::removeFinishedJobs() {
-    for (auto& job : jobs_map) {
-        int jobID = job.first;
-        JobEntry& job_entry = job.second;
-        if (waitpid(job_entry.job_pid, NULL, WNOHANG) == job_entry.job_pid) {
-            // state of job changed to "terminated"
-            removeJobById(jobID);
+    TRACE_SPAN("JobList::removeFinishedJobs");
+    // a job brought to the fg is reaped by the fg wait, also when a timer
+    // adds a job while smash waits for it
+    SmallShell& smash = SmallShell::getInstance();
+    pid_t fg_pid = smash.fg_pid;
+    smash.stats.count(STATS_JOB_SCANS);
+    smash.stats.count(STATS_SCANNED_JOBS, jobs_map.size());
+
+    for (auto it = jobs_map.begin(); it != jobs_map.end(); ) {
+        int jobID = it->first;
+        pid_t job_pid = it->second.job_pid;
+        // advance before the entry may be erased
+        ++it;
+        if (job_pid != fg_pid) {
+            reapJobIfFinished(jobID);
         }
-        if (jobs_map.empty()) {
-            break;
+    }
+}
+
+bool JobList::reapJobIfFinished(int jobID) {
+    JobEntry* job = getJobById(jobID);
+    if (job == nullptr) {
+        return false;
+    }
+
+    int status;
+    if (waitpid(job->job_pid, &status, WNOHANG) != job->job_pid) {
+        return false;
+    }
+
+    // state of job changed to "terminated"
+    if (job->deadline_ms != 0) {
+        SmallShell& smash = SmallShell::getInstance();
+        smash.clearJobDeadline(job->job_pid);
+        if (smash.takeExpiredDeadline(job->job_pid, status)) {
+            // wait reports it like timeout(1) would exit
+            status = W_EXITCODE(timeout_exit_status, 0);
         }
     }
+    finished_jobs_status[jobID] = status;
+    removeJobById(jobID);
+    SmallShell::getInstance().stats.count(STATS_REAPED_JOBS);
+    return true;
+}
+
+bool JobList::takeFinishedJobStatus(int jobID, int& status) {
+    auto it = finished_jobs_status.find(jobID);
+    if (it == finished_jobs_status.end()) {
+        return false;
+    }
+    status = it->second;
+    finished_jobs_status.erase(it);
+    return true;
+}
+
+bool JobList::hasFinishedJobStatus(int jobID) {
+    return finished_jobs_status.count(jobID) == 1;
 }
 
 JobList::JobEntry* JobList::getJobById(int jobId) {
@@ -139,6 +235,14 @@ JobList::JobEntry *JobList::getLastJob() {
     return nullptr;
 }
 
+JobList::JobEntry *JobList::getNextJob(int jobID) {
+    auto it = jobs_map.upper_bound(jobID);
+    if (it == jobs_map.end()) {
+        return nullptr;
+    }
+    return &it->second;
+}
+
 JobList::JobEntry *JobList::getLastStoppedJob() {
     removeFinishedJobs();
     if (jobs_map.count(max_stopped_jobID) == 1) {
@@ -231,3 +335,99 @@ void JobList::freeJobsCmdObj() {
         job_entry.cmd = nullptr;
     }
 }
+
+// ----------------------------------------------------------------------------
+
+// JobSelector implementation
+
+bool isJobSpec(const std::string& arg) {
+    return !arg.empty() && arg[0] == '%';
+}
+
+bool JobSelector::parseJobID(const std::string& jobID_str, int& jobID) {
+    if (jobID_str.empty() || jobID_str.size() > 9
+        || !isStringOnlyDigits(jobID_str)) {
+        return false;
+    }
+    jobID = std::stoi(jobID_str, nullptr);
+    return true;
+}
+
+bool JobSelector::addJobSpec(const std::string& job_spec) {
+    JobSpec spec;
+    spec.type = JOB_ID_RANGE;
+    spec.first_jobID = 0;
+    spec.last_jobID = 0;
+    spec.job_state = BG;
+
+    std::string spec_str = isJobSpec(job_spec) ? job_spec.substr(1) : job_spec;
+
+    if (spec_str == "all") {
+        spec.type = ALL_JOBS;
+    } else if (spec_str == "running") {
+        spec.type = JOB_STATE;
+        spec.job_state = BG;
+    } else if (spec_str == "stopped") {
+        spec.type = JOB_STATE;
+        spec.job_state = STOPPED;
+    } else if (spec_str.size() > 1 && spec_str[0] == '?') {
+        spec.type = CMD_LINE_PATTERN;
+        spec.pattern = spec_str.substr(1);
+    } else {
+        // "N" or "N-M" or "N-%M"
+        size_t dash_pos = spec_str.find('-');
+        std::string last_str = (dash_pos == std::string::npos)
+                               ? spec_str : spec_str.substr(dash_pos + 1);
+        if (isJobSpec(last_str)) {
+            last_str = last_str.substr(1);
+        }
+        if (!parseJobID(spec_str.substr(0, dash_pos), spec.first_jobID)
+            || !parseJobID(last_str, spec.last_jobID)
+            || spec.first_jobID > spec.last_jobID) {
+            return false;
+        }
+    }
+
+    job_specs.push_back(spec);
+    return true;
+}
+
+bool JobSelector::matches(JobList::JobEntry& job) {
+    for (auto& spec : job_specs) {
+        switch (spec.type) {
+            case JOB_ID_RANGE:
+                if (job.jobID >= spec.first_jobID
+                    && job.jobID <= spec.last_jobID) {
+                    return true;
+                }
+                break;
+            case CMD_LINE_PATTERN:
+                if (job.getJobCmdLine().find(spec.pattern)
+                    != std::string::npos) {
+                    return true;
+                }
+                break;
+            case JOB_STATE:
+                if (job.job_state == spec.job_state) {
+                    return true;
+                }
+                break;
+            case ALL_JOBS:
+                return true;
+        }
+    }
+    return false;
+}
+
+bool JobSelector::isEmpty() {
+    return job_specs.empty();
+}
+
+bool JobSelector::isSingleJobID(int& jobID) {
+    if (job_specs.size() != 1 || job_specs[0].type != JOB_ID_RANGE
+        || job_specs[0].first_jobID != job_specs[0].last_jobID) {
+        return false;
+    }
+    jobID = job_specs[0].first_jobID;
+    return true;
+}
@@ -2,6 +2,8 @@
 #define HW1_JOBLIST_H
 
 #include <map>
+#include <vector>
+#include <sched.h>
 #include "Command.h"
 
 typedef enum {
@@ -14,6 +16,8 @@ typedef enum {
     JOB_EXISTS = 2
 } JobListResult;
 
+class JobSelector;
+
 class JobList {
 public:
     class JobEntry {
@@ -23,18 +27,30 @@ public:
         Command* cmd;
         pid_t job_pid;
         time_t addition_time;
+        // cpus the job's proccess group is placed on, if it was placed
+        bool has_cpus;
+        bool is_pinned;
+        cpu_set_t cpus;
+        // priorities the job had before it was demoted as a bg job
+        bool is_demoted;
+        int orig_nice;
+        int orig_ioprio;
+        // CLOCK_MONOTONIC ms the job is timed out at, 0 if it has none
+        long long deadline_ms;
 
         // constructor
         explicit JobEntry(int jobID=0, JobState job_state=STOPPED,
                 Command* cmd= nullptr, pid_t job_pid=0);
 
-        std::string getJobCmdLine();
+        const std::string& getJobCmdLine();
     };
 
 private:
     int max_jobID;
     int max_stopped_jobID;
     std::map<int, JobEntry> jobs_map;
+    // wait status of reaped jobs that nobody waited for yet, by jobID
+    std::map<int, int> finished_jobs_status;
 
     int findNewMaxStoppedJobID();
     int findNewMaxJobID();
@@ -43,21 +59,43 @@ public:
     // constructor
     JobList();
 
-    void addJob(Command* cmd, pid_t pid, JobState job_state,
-                int originalJobID = 0);
+    // returns the jobID the job got
+    int addJob(Command* cmd, pid_t pid, JobState job_state,
+               int originalJobID = 0);
+
+    void printJobsList(OutputSink& out);
+
+    // print only the jobs matched by the selector
+    void printJobsList(JobSelector& selector, OutputSink& out);
 
-    void printJobsList();
+    // all of the jobs matched by the selector, in one pass over the jobs
+    std::vector<JobEntry*> selectJobs(JobSelector& selector);
 
-    void killAllJobs();
+    // sends the signal to every given job, jobs that already exited are
+    // skipped. Returns the number of jobs that got the signal
+    int sendSignalToJobs(std::vector<JobEntry*>& jobs, int sig_num);
+
+    void killAllJobs(OutputSink& out);
 
     void removeFinishedJobs();
 
+    // reaps the job if it finished, keeping its wait status
+    bool reapJobIfFinished(int jobID);
+
+    // hands over (and forgets) the wait status of a reaped job
+    bool takeFinishedJobStatus(int jobID, int& status);
+
+    bool hasFinishedJobStatus(int jobID);
+
     JobEntry* getJobById(int jobId);
 
     void removeJobById(int jobId);
 
     JobEntry* getLastJob();
 
+    // the job with the smallest jobID bigger than jobID, for iterating
+    JobEntry* getNextJob(int jobID);
+
     JobEntry* getLastStoppedJob();
 
     JobListResult sendSignalToJob(int jobID, int sig_num);
@@ -67,7 +105,45 @@ public:
     void freeJobsCmdObj();
 
     // print job details for jobs command
-    void printJobDetails(JobEntry& job);
+    void printJobDetails(JobEntry& job, OutputSink& out);
+};
+
+/* Matches jobs by job specs: "N" or "%N" for a single job, "%N-%M" for a
+ * range of job IDs, "%?pattern" for jobs whose command line contains
+ * pattern, and "%running", "%stopped", "%all" */
+class JobSelector {
+    typedef enum {
+        JOB_ID_RANGE = 1,
+        CMD_LINE_PATTERN = 2,
+        JOB_STATE = 3,
+        ALL_JOBS = 4
+    } JobSpecType;
+
+    struct JobSpec {
+        JobSpecType type;
+        int first_jobID;
+        int last_jobID;
+        std::string pattern;
+        JobState job_state;
+    };
+
+    std::vector<JobSpec> job_specs;
+
+    bool parseJobID(const std::string& jobID_str, int& jobID);
+
+public:
+    // adds a job spec, returns false if it is malformed
+    bool addJobSpec(const std::string& job_spec);
+
+    bool matches(JobList::JobEntry& job);
+
+    bool isEmpty();
+
+    // true if the only spec is a single jobID, e.g. "3" or "%3"
+    bool isSingleJobID(int& jobID);
 };
 
+/* determining if the argument is a job spec (starts with '%') */
+bool isJobSpec(const std::string& arg);
+
 #endif //HW1_JOBLIST_H
@@ -0,0 +1,314 @@
+#include "JobScheduling.h"
+
+#include <dirent.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "SmallShell.h"
+
+bool parseCpuList(const std::string& cpu_list, cpu_set_t& cpus) {
+    CPU_ZERO(&cpus);
+    if (cpu_list.empty()) {
+        return false;
+    }
+
+    std::istringstream iss(cpu_list);
+    for (std::string range; std::getline(iss, range, ','); ) {
+        size_t dash_pos = range.find('-');
+        std::string first_str = range.substr(0, dash_pos);
+        std::string last_str = (dash_pos == std::string::npos)
+                               ? first_str : range.substr(dash_pos + 1);
+        if (first_str.empty() || last_str.empty()
+            || !isStringOnlyDigits(first_str)
+            || !isStringOnlyDigits(last_str)
+            || first_str.size() > 5 || last_str.size() > 5) {
+            return false;
+        }
+
+        int first = std::stoi(first_str, nullptr);
+        int last = std::stoi(last_str, nullptr);
+        if (first > last || last >= CPU_SETSIZE) {
+            return false;
+        }
+        for (int cpu = first; cpu <= last; cpu++) {
+            CPU_SET(cpu, &cpus);
+        }
+    }
+
+    return CPU_COUNT(&cpus) > 0;
+}
+
+std::string cpuListToString(const cpu_set_t& cpus) {
+    std::string cpu_list;
+
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &cpus)) {
+            continue;
+        }
+        int last = cpu;
+        while (last + 1 < CPU_SETSIZE && CPU_ISSET(last + 1, &cpus)) {
+            last++;
+        }
+        if (!cpu_list.empty()) {
+            cpu_list += ",";
+        }
+        cpu_list += std::to_string(cpu);
+        if (last != cpu) {
+            cpu_list += "-" + std::to_string(last);
+        }
+        cpu = last;
+    }
+
+    return cpu_list;
+}
+
+/* reading the proccess group of pid from /proc/<pid>/stat. Returns -1 if the
+ * proccess is gone */
+static pid_t getProcessGroupOf(const char* pid_str) {
+    char stat_path[64];
+    snprintf(stat_path, sizeof(stat_path), "/proc/%s/stat", pid_str);
+
+    FILE* stat_file = fopen(stat_path, "r");
+    if (stat_file == nullptr) {
+        return -1;
+    }
+    char stat_line[1024];
+    size_t line_length = fread(stat_line, 1, sizeof(stat_line) - 1, stat_file);
+    fclose(stat_file);
+    stat_line[line_length] = '\0';
+
+    // the command name may contain spaces, the fields after it don't.
+    // the fields after it are: state ppid pgrp
+    char* comm_end = strrchr(stat_line, ')');
+    char state;
+    int ppid;
+    int pgrp;
+    if (comm_end == nullptr
+        || sscanf(comm_end + 1, " %c %d %d", &state, &ppid, &pgrp) != 3) {
+        return -1;
+    }
+
+    return pgrp;
+}
+
+// see linux/ioprio.h
+const int IOPRIO_CLASS_SHIFT = 13;
+const int IOPRIO_WHO_PROCESS = 1;
+const int IOPRIO_WHO_PGRP = 2;
+
+static int ioprioValue(int ioprio_class, int level) {
+    return (ioprio_class << IOPRIO_CLASS_SHIFT) | level;
+}
+
+int ioprioGet(int which, int who) {
+    return static_cast<int>(syscall(SYS_ioprio_get, which, who));
+}
+
+int ioprioSet(int which, int who, int ioprio) {
+    return static_cast<int>(syscall(SYS_ioprio_set, which, who, ioprio));
+}
+
+// nice values go from -20 to 19, RLIMIT_NICE allows down to 20 - limit
+const int nice_rlimit_base = 20;
+
+/* checking if smash may set a nice value lower than the current one, e.g.
+ * to restore a demoted job. Without root that needs RLIMIT_NICE */
+static bool canLowerNiceTo(int nice) {
+    if (geteuid() == 0) {
+        return true;
+    }
+    struct rlimit nice_limit;
+    if (getrlimit(RLIMIT_NICE, &nice_limit) == -1) {
+        return false;
+    }
+    return nice_limit.rlim_cur == RLIM_INFINITY
+           || nice_rlimit_base - static_cast<long long>(nice_limit.rlim_cur)
+              <= nice;
+}
+
+int setProcessGroupAffinity(pid_t pgid, const cpu_set_t& cpus) {
+    DIR* proc_dir = opendir("/proc");
+    if (proc_dir == nullptr) {
+        return -1;
+    }
+
+    int threads_count = 0;
+    struct dirent* proc_entry;
+    while ((proc_entry = readdir(proc_dir)) != nullptr) {
+        if (!isStringOnlyDigits(proc_entry->d_name)
+            || getProcessGroupOf(proc_entry->d_name) != pgid) {
+            continue;
+        }
+
+        // affinity is per thread, so every thread of the proccess is moved
+        std::string task_path = std::string("/proc/") + proc_entry->d_name
+                                + "/task";
+        DIR* task_dir = opendir(task_path.c_str());
+        if (task_dir == nullptr) {
+            continue;
+        }
+        struct dirent* task_entry;
+        while ((task_entry = readdir(task_dir)) != nullptr) {
+            if (!isStringOnlyDigits(task_entry->d_name)) {
+                continue;
+            }
+            pid_t tid = static_cast<pid_t>(atoi(task_entry->d_name));
+            if (sched_setaffinity(tid, sizeof(cpus), &cpus) == -1) {
+                if (errno == ESRCH) {
+                    // thread exited meanwhile
+                    continue;
+                }
+                closedir(task_dir);
+                closedir(proc_dir);
+                return -1;
+            }
+            threads_count++;
+        }
+        closedir(task_dir);
+    }
+    closedir(proc_dir);
+
+    return threads_count;
+}
+
+//----------------------------------------------------------------------------
+
+SchedulingPolicy::SchedulingPolicy()
+        : has_fg_cpus(false), has_bg_cpus(false), demote_bg_nice(true),
+          bg_nice(default_bg_nice), bg_ioprio_class(IOPRIO_CLASS_BE_VALUE) {
+    CPU_ZERO(&fg_cpus);
+    CPU_ZERO(&bg_cpus);
+    CPU_ZERO(&smash_cpus);
+    if (sched_getaffinity(0, sizeof(smash_cpus), &smash_cpus) == -1) {
+        perror("smash error: sched_getaffinity failed");
+    }
+}
+
+void SchedulingPolicy::applyOnLaunch(bool is_bg_job) {
+    bool has_cpus = is_bg_job ? has_bg_cpus : has_fg_cpus;
+    if (has_cpus) {
+        cpu_set_t& cpus = is_bg_job ? bg_cpus : fg_cpus;
+        if (sched_setaffinity(0, sizeof(cpus), &cpus) == -1) {
+            // the job still runs, only without the placement
+            perror("smash error: sched_setaffinity failed");
+        }
+    }
+
+    if (!is_bg_job) {
+        return;
+    }
+    // a nice value that can't be restored on fg is left alone
+    int orig_nice = getpriority(PRIO_PROCESS, 0);
+    if (demote_bg_nice && orig_nice < bg_nice && canLowerNiceTo(orig_nice)
+        && setpriority(PRIO_PROCESS, 0, bg_nice) == -1) {
+        perror("smash error: setpriority failed");
+    }
+    if (bg_ioprio_class != IOPRIO_CLASS_NONE_VALUE
+        && ioprioSet(IOPRIO_WHO_PROCESS, 0, ioprioValue(bg_ioprio_class,
+                     lowest_be_ioprio_level)) == -1) {
+        perror("smash error: ioprio_set failed");
+    }
+}
+
+void SchedulingPolicy::recordLaunchPlacement(JobList::JobEntry& job,
+        bool is_bg_job) {
+    job.has_cpus = is_bg_job ? has_bg_cpus : has_fg_cpus;
+    if (job.has_cpus) {
+        job.cpus = is_bg_job ? bg_cpus : fg_cpus;
+    }
+
+    // the job started with smash's priorities before it demoted itself
+    job.is_demoted = is_bg_job && (demote_bg_nice
+                     || bg_ioprio_class != IOPRIO_CLASS_NONE_VALUE);
+    if (job.is_demoted) {
+        job.orig_nice = getpriority(PRIO_PROCESS, 0);
+        job.orig_ioprio = ioprioGet(IOPRIO_WHO_PROCESS, 0);
+    }
+}
+
+void SchedulingPolicy::moveJobCpus(JobList::JobEntry& job, bool to_bg) {
+    if (job.is_pinned) {
+        return;
+    }
+
+    bool has_cpus = to_bg ? has_bg_cpus : has_fg_cpus;
+    if (!has_cpus && !job.has_cpus) {
+        // neither the old nor the new state is partitioned
+        return;
+    }
+
+    const cpu_set_t& cpus = has_cpus ? (to_bg ? bg_cpus : fg_cpus)
+                                     : smash_cpus;
+    if (setProcessGroupAffinity(job.job_pid, cpus) == -1) {
+        perror("smash error: sched_setaffinity failed");
+        return;
+    }
+    job.has_cpus = has_cpus;
+    job.cpus = cpus;
+}
+
+void SchedulingPolicy::moveJobPriority(JobList::JobEntry& job, bool to_bg) {
+    if (!to_bg) {
+        if (!job.is_demoted) {
+            return;
+        }
+        // the nice value was only demoted if it can be restored, otherwise
+        // it is already the original one
+        bool is_restored = true;
+        if (setpriority(PRIO_PGRP, job.job_pid, job.orig_nice) == -1) {
+            perror("smash error: setpriority failed");
+            is_restored = false;
+        }
+        if (ioprioSet(IOPRIO_WHO_PGRP, job.job_pid, job.orig_ioprio) == -1) {
+            perror("smash error: ioprio_set failed");
+            is_restored = false;
+        }
+        job.is_demoted = !is_restored;
+        return;
+    }
+
+    if (job.is_demoted || (!demote_bg_nice
+        && bg_ioprio_class == IOPRIO_CLASS_NONE_VALUE)) {
+        return;
+    }
+
+    // -1 is a valid nice value, errno tells if getpriority failed
+    errno = 0;
+    int orig_nice = getpriority(PRIO_PGRP, job.job_pid);
+    if (orig_nice == -1 && errno != 0) {
+        perror("smash error: getpriority failed");
+        return;
+    }
+    job.orig_nice = orig_nice;
+    job.orig_ioprio = ioprioGet(IOPRIO_WHO_PGRP, job.job_pid);
+    job.is_demoted = true;
+
+    if (demote_bg_nice && orig_nice < bg_nice && canLowerNiceTo(orig_nice)
+        && setpriority(PRIO_PGRP, job.job_pid, bg_nice) == -1) {
+        perror("smash error: setpriority failed");
+    }
+    if (bg_ioprio_class != IOPRIO_CLASS_NONE_VALUE
+        && ioprioSet(IOPRIO_WHO_PGRP, job.job_pid, ioprioValue(
+                     bg_ioprio_class, lowest_be_ioprio_level)) == -1) {
+        perror("smash error: ioprio_set failed");
+    }
+}
+
+void SchedulingPolicy::applyOnTransition(JobList::JobEntry& job, bool to_bg) {
+    moveJobCpus(job, to_bg);
+    moveJobPriority(job, to_bg);
+}
+
+void SchedulingPolicy::pinJob(JobList::JobEntry& job, const cpu_set_t& cpus) {
+    if (setProcessGroupAffinity(job.job_pid, cpus) == -1) {
+        perror("smash error: sched_setaffinity failed");
+        throw SystemCallFail();
+    }
+    job.has_cpus = true;
+    job.is_pinned = true;
+    job.cpus = cpus;
+}
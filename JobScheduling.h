@@ -0,0 +1,67 @@
+#ifndef HW1_JOBSCHEDULING_H
+#define HW1_JOBSCHEDULING_H
+
+#include <sched.h>
+#include <string>
+
+#include "JobList.h"
+
+/* parsing a cpu list such as "0-3,8,10-11" into cpus. Returns false if the
+ * list is malformed or empty */
+bool parseCpuList(const std::string& cpu_list, cpu_set_t& cpus);
+
+/* formatting cpus back into the compact "0-3,8,10-11" form */
+std::string cpuListToString(const cpu_set_t& cpus);
+
+/* getting and setting io priority, glibc has no wrappers for them */
+int ioprioGet(int which, int who);
+int ioprioSet(int which, int who, int ioprio);
+
+/* setting the cpu affinity of every thread of every proccess in the proccess
+ * group. Returns the number of threads updated, or -1 if a
+ * sched_setaffinity call failed */
+int setProcessGroupAffinity(pid_t pgid, const cpu_set_t& cpus);
+
+// io priority classes of ioprio_set(2)
+const int IOPRIO_CLASS_NONE_VALUE = 0;
+const int IOPRIO_CLASS_BE_VALUE = 2;
+const int IOPRIO_CLASS_IDLE_VALUE = 3;
+
+const int default_bg_nice = 10;
+const int lowest_be_ioprio_level = 7;
+
+class SchedulingPolicy {
+    void moveJobCpus(JobList::JobEntry& job, bool to_bg);
+    void moveJobPriority(JobList::JobEntry& job, bool to_bg);
+
+public:
+    bool has_fg_cpus;
+    cpu_set_t fg_cpus;
+    bool has_bg_cpus;
+    cpu_set_t bg_cpus;
+    // affinity smash started with, given back to jobs leaving a partition
+    cpu_set_t smash_cpus;
+    // bg jobs are demoted to this nice value and io class, and get their
+    // original priorities back when brought to the fg
+    bool demote_bg_nice;
+    int bg_nice;
+    int bg_ioprio_class;
+
+    // constructor
+    SchedulingPolicy();
+
+    // called in a new job's proccess before exec, descendants inherit it
+    void applyOnLaunch(bool is_bg_job);
+
+    // records in the job entry the placement and priorities it got on launch
+    void recordLaunchPlacement(JobList::JobEntry& job, bool is_bg_job);
+
+    // moves a job to the partition of its new state, unless it was pinned,
+    // and demotes or restores its priorities
+    void applyOnTransition(JobList::JobEntry& job, bool to_bg);
+
+    // pins a job to cpus, policy transitions won't move it anymore
+    void pinJob(JobList::JobEntry& job, const cpu_set_t& cpus);
+};
+
+#endif //HW1_JOBSCHEDULING_H
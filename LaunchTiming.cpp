@@ -0,0 +1,146 @@
+#include "LaunchTiming.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+
+// what a child writes into the exec report before it execs "bash -c"
+const char bash_exec_mark = 'b';
+
+LaunchTimer::LaunchTimer()
+        : is_active(false), forks_count(0), has_bash_exec(false),
+          has_children_usage(false) {
+    memset(phase_ns, 0, sizeof(phase_ns));
+    memset(&children_usage, 0, sizeof(children_usage));
+    exec_report_fd[0] = -1;
+    exec_report_fd[1] = -1;
+}
+
+LaunchTimer::~LaunchTimer() {
+    closeExecReport();
+}
+
+void LaunchTimer::start() {
+    memset(phase_ns, 0, sizeof(phase_ns));
+    memset(&children_usage, 0, sizeof(children_usage));
+    forks_count = 0;
+    has_bash_exec = false;
+    has_children_usage = false;
+    is_active = true;
+}
+
+void LaunchTimer::stop() {
+    is_active = false;
+    closeExecReport();
+}
+
+bool LaunchTimer::isActive() const {
+    return is_active;
+}
+
+void LaunchTimer::addPhase(LaunchPhase phase, long long start_ns) {
+    if (!is_active) {
+        return;
+    }
+    phase_ns[phase] += monotonicTimeNs() - start_ns;
+    if (phase == LAUNCH_FORK) {
+        forks_count++;
+    }
+}
+
+void LaunchTimer::addChildUsage(const struct rusage& usage) {
+    if (!is_active) {
+        return;
+    }
+    timeradd(&children_usage.ru_utime, &usage.ru_utime,
+             &children_usage.ru_utime);
+    timeradd(&children_usage.ru_stime, &usage.ru_stime,
+             &children_usage.ru_stime);
+    if (usage.ru_maxrss > children_usage.ru_maxrss) {
+        children_usage.ru_maxrss = usage.ru_maxrss;
+    }
+    has_children_usage = true;
+}
+
+void LaunchTimer::openExecReport() {
+    if (!is_active || exec_report_fd[0] != -1) {
+        return;
+    }
+    if (pipe2(exec_report_fd, O_CLOEXEC) == -1) {
+        // the exec phase is just not timed
+        perror("smash error: pipe failed");
+        exec_report_fd[0] = -1;
+        exec_report_fd[1] = -1;
+    }
+}
+
+void LaunchTimer::waitForExecs(long long fork_end_ns) {
+    if (exec_report_fd[0] == -1) {
+        return;
+    }
+    close(exec_report_fd[1]);
+    exec_report_fd[1] = -1;
+    char mark;
+    while (true) {
+        ssize_t bytes_read_count = read(exec_report_fd[0], &mark, 1);
+        if (bytes_read_count == 1) {
+            has_bash_exec = has_bash_exec || (mark == bash_exec_mark);
+            continue;
+        }
+        if (bytes_read_count == -1 && errno == EINTR) {
+            continue;
+        }
+        break;
+    }
+    close(exec_report_fd[0]);
+    exec_report_fd[0] = -1;
+    addPhase(LAUNCH_EXEC, fork_end_ns);
+}
+
+void LaunchTimer::closeExecReport() {
+    for (int& fd : exec_report_fd) {
+        if (fd != -1) {
+            close(fd);
+            fd = -1;
+        }
+    }
+}
+
+void LaunchTimer::reportBashExec() {
+    if (exec_report_fd[1] != -1) {
+        ssize_t written_count = write(exec_report_fd[1], &bash_exec_mark, 1);
+        (void)written_count;
+    }
+}
+
+long long LaunchTimer::getPhaseNs(LaunchPhase phase) const {
+    return phase_ns[phase];
+}
+
+int LaunchTimer::getForksCount() const {
+    return forks_count;
+}
+
+bool LaunchTimer::hasBashExec() const {
+    return has_bash_exec;
+}
+
+bool LaunchTimer::getChildrenUsage(struct rusage& usage) const {
+    usage = children_usage;
+    return has_children_usage;
+}
+
+long long monotonicTimeNs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<long long>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+const char* getLaunchPhaseName(LaunchPhase phase) {
+    const char* names[LAUNCH_PHASES_COUNT] = {"parse", "dispatch", "fork",
+                                              "exec", "wait"};
+    return names[phase];
+}
@@ -0,0 +1,91 @@
+#ifndef HW1_LAUNCHTIMING_H
+#define HW1_LAUNCHTIMING_H
+
+#include <sys/resource.h>
+#include <sys/time.h>
+
+// the phases smash goes through to run a command
+typedef enum {
+    // splitting and expanding the line
+    LAUNCH_PARSE = 0,
+    // picking the Command for it in createCommand
+    LAUNCH_DISPATCH = 1,
+    // fork returning in smash
+    LAUNCH_FORK = 2,
+    // from the fork until the children exec'd, or exited without it
+    LAUNCH_EXEC = 3,
+    // waiting for the fg proccess
+    LAUNCH_WAIT = 4,
+    LAUNCH_PHASES_COUNT = 5
+} LaunchPhase;
+
+/* Times the phases of launching a command, for the time built-in. The code
+ * paths take CLOCK_MONOTONIC around themselves and hand the phase over,
+ * which is dropped unless the timer was started.
+ * The exec phase ends once a close-on-exec pipe opened before the fork is
+ * closed in every child, by their exec or by their exit */
+class LaunchTimer {
+    bool is_active;
+    long long phase_ns[LAUNCH_PHASES_COUNT];
+    int forks_count;
+    // a child exec'd "bash -c" instead of the command itself
+    bool has_bash_exec;
+    // of the children smash waited for
+    struct rusage children_usage;
+    bool has_children_usage;
+    int exec_report_fd[2];
+
+public:
+    // constructor
+    LaunchTimer();
+
+    // destructor
+    ~LaunchTimer();
+
+    // disable copy ctor
+    LaunchTimer(LaunchTimer const&) = delete;
+
+    // disable = operator
+    void operator=(LaunchTimer const&) = delete;
+
+    // zeroes the phases and starts collecting them
+    void start();
+
+    void stop();
+
+    bool isActive() const;
+
+    // adds the time since start_ns to the phase
+    void addPhase(LaunchPhase phase, long long start_ns);
+
+    void addChildUsage(const struct rusage& usage);
+
+    // in smash, just before a fork whose child execs
+    void openExecReport();
+
+    // in smash, just after the fork. Waits for the children to exec
+    void waitForExecs(long long fork_end_ns);
+
+    // in a child that runs on without exec, so smash doesn't wait for it
+    void closeExecReport();
+
+    // in a child, just before it execs "bash -c"
+    void reportBashExec();
+
+    long long getPhaseNs(LaunchPhase phase) const;
+
+    int getForksCount() const;
+
+    bool hasBashExec() const;
+
+    // returns false if no child was waited for
+    bool getChildrenUsage(struct rusage& usage) const;
+};
+
+/* nanoseconds of CLOCK_MONOTONIC */
+long long monotonicTimeNs();
+
+/* the name of the phase, as the time built-in prints it */
+const char* getLaunchPhaseName(LaunchPhase phase);
+
+#endif //HW1_LAUNCHTIMING_H
@@ -0,0 +1,64 @@
+#include "ListCommand.h"
+
+ListCommand::ListCommand(std::string cmd_line) : Command(cmd_line) {}
+
+void ListCommand::prepare() {
+    std::vector<std::string> elements_cmd_lines, operators;
+    _splitCommandList(cmd_line, elements_cmd_lines, operators);
+
+    elements.clear();
+    for (size_t i = 0; i < elements_cmd_lines.size(); i++) {
+        ListElement element;
+        element.cmd_line = elements_cmd_lines[i];
+        element.run_condition = RUN_ALWAYS;
+        if (i > 0 && operators[i - 1] == "&&") {
+            element.run_condition = RUN_IF_SUCCEEDED;
+        } else if (i > 0 && operators[i - 1] == "||") {
+            element.run_condition = RUN_IF_FAILED;
+        }
+        elements.push_back(element);
+    }
+}
+
+bool ListCommand::shouldRunElement(const ListElement& element) {
+    int last_exit_status = SmallShell::getInstance().last_exit_status;
+
+    switch (element.run_condition) {
+        case RUN_IF_SUCCEEDED:
+            return last_exit_status == 0;
+        case RUN_IF_FAILED:
+            return last_exit_status != 0;
+        default:
+            return true;
+    }
+}
+
+SmallShellNextState ListCommand::execute() {
+    prepare();
+    SmallShell& smash = SmallShell::getInstance();
+
+    for (auto& element : elements) {
+        // a skipped element keeps the status of the last one that ran, so
+        // "a && b || c" runs c if a failed
+        if (!shouldRunElement(element)) {
+            smash.dropHereDocuments(element.cmd_line);
+            continue;
+        }
+
+        smash.fg_got_signal = false;
+        try {
+            if (smash.executeCommand(element.cmd_line) == QUIT) {
+                return QUIT;
+            }
+        } catch (ExecutionFail& execution_fail) {
+            // the error was printed, the status tells the next element
+        }
+
+        // ctrl-C or ctrl-Z stops the rest of the list too
+        if (smash.fg_got_signal) {
+            break;
+        }
+    }
+
+    return CONTINUE_RUNNING;
+}
@@ -0,0 +1,34 @@
+#ifndef HW1_LISTCOMMAND_H
+#define HW1_LISTCOMMAND_H
+
+#include "Command.h"
+#include "SmallShell.h"
+
+typedef enum {
+    RUN_ALWAYS = 0,         // after ";"
+    RUN_IF_SUCCEEDED = 1,   // after "&&"
+    RUN_IF_FAILED = 2       // after "||"
+} ListRunCondition;
+
+/* "cmd1 ; cmd2 && cmd3 || cmd4", run by smash itself: every element is
+ * dispatched like a line of its own, so built-ins run in smash and externals
+ * are exec'd directly, and "&&"/"||" look at the exit status of the last
+ * element that ran */
+class ListCommand : public Command {
+    struct ListElement {
+        std::string cmd_line;
+        ListRunCondition run_condition;
+    };
+    std::vector<ListElement> elements;
+
+    void prepare();
+    bool shouldRunElement(const ListElement& element);
+
+public:
+    // constructor
+    explicit ListCommand(std::string cmd_line);
+
+    SmallShellNextState execute() override;
+};
+
+#endif //HW1_LISTCOMMAND_H
@@ -0,0 +1,154 @@
+#include "OutputCapture.h"
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <errno.h>
+#include <cstdio>
+
+OutputCapture::OutputCapture()
+        : ring(nullptr), ring_size(0), total_written(0) {
+    pipe_fd[0] = -1;
+    pipe_fd[1] = -1;
+}
+
+OutputCapture::~OutputCapture() {
+    if (ring != nullptr) {
+        munmap(ring, 2 * ring_size);
+    }
+    if (pipe_fd[0] != -1) {
+        close(pipe_fd[0]);
+    }
+    if (pipe_fd[1] != -1) {
+        close(pipe_fd[1]);
+    }
+}
+
+bool OutputCapture::create(size_t size) {
+    size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    ring_size = (size + page_size - 1) / page_size * page_size;
+
+    int memfd = memfd_create("smash-joblog", MFD_CLOEXEC);
+    if (memfd == -1) {
+        perror("smash error: memfd_create failed");
+        return false;
+    }
+    if (ftruncate(memfd, static_cast<off_t>(ring_size)) == -1) {
+        perror("smash error: ftruncate failed");
+        close(memfd);
+        return false;
+    }
+
+    // reserve twice the size, then map the memfd onto both halves
+    void* area = mmap(nullptr, 2 * ring_size, PROT_NONE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (area == MAP_FAILED) {
+        perror("smash error: mmap failed");
+        close(memfd);
+        return false;
+    }
+    ring = static_cast<char*>(area);
+    for (int half = 0; half < 2; half++) {
+        if (mmap(ring + half * ring_size, ring_size, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_FIXED, memfd, 0) == MAP_FAILED) {
+            perror("smash error: mmap failed");
+            close(memfd);
+            return false;
+        }
+    }
+    // the mappings keep the memory alive
+    close(memfd);
+
+    if (pipe2(pipe_fd, O_CLOEXEC) == -1) {
+        perror("smash error: pipe failed");
+        return false;
+    }
+    // smash drains without blocking, the job writes blocking as usual
+    if (fcntl(pipe_fd[0], F_SETFL, O_NONBLOCK) == -1) {
+        perror("smash error: fcntl failed");
+        return false;
+    }
+
+    return true;
+}
+
+bool OutputCapture::drain() {
+    while (true) {
+        // a whole ring in one read, the double mapping makes the space
+        // after the head contiguous
+        char* head = ring + total_written % ring_size;
+        ssize_t bytes_read_count = read(pipe_fd[0], head, ring_size);
+        if (bytes_read_count > 0) {
+            total_written += static_cast<unsigned long long>(bytes_read_count);
+            continue;
+        }
+        if (bytes_read_count == -1 && errno == EINTR) {
+            continue;
+        }
+        if (bytes_read_count == -1 && errno == EAGAIN) {
+            return true;
+        }
+
+        // end of file, or the pipe broke
+        close(pipe_fd[0]);
+        pipe_fd[0] = -1;
+        return false;
+    }
+}
+
+bool OutputCapture::isOpen() {
+    return pipe_fd[0] != -1;
+}
+
+unsigned long long OutputCapture::getTotalWritten() {
+    return total_written;
+}
+
+unsigned long long OutputCapture::writeTo(int fd, unsigned long long offset) {
+    unsigned long long oldest_offset = (total_written > ring_size)
+                                       ? total_written - ring_size : 0;
+    if (offset < oldest_offset) {
+        // overwritten already
+        offset = oldest_offset;
+    }
+
+    while (offset < total_written) {
+        const char* data = ring + offset % ring_size;
+        ssize_t bytes_written_count = write(fd, data,
+                static_cast<size_t>(total_written - offset));
+        if (bytes_written_count == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("smash error: write failed");
+            break;
+        }
+        offset += static_cast<unsigned long long>(bytes_written_count);
+    }
+
+    return offset;
+}
+
+unsigned long long OutputCapture::getTailOffset(size_t lines_count) {
+    unsigned long long oldest_offset = (total_written > ring_size)
+                                       ? total_written - ring_size : 0;
+    unsigned long long offset = total_written;
+    if (lines_count == 0) {
+        return offset;
+    }
+
+    // a newline ending the output doesn't start another line
+    if (offset > oldest_offset && ring[(offset - 1) % ring_size] == '\n') {
+        offset--;
+    }
+    while (offset > oldest_offset) {
+        if (ring[(offset - 1) % ring_size] == '\n') {
+            if (--lines_count == 0) {
+                return offset;
+            }
+        }
+        offset--;
+    }
+
+    return oldest_offset;
+}
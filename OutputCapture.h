@@ -0,0 +1,57 @@
+#ifndef HW1_OUTPUTCAPTURE_H
+#define HW1_OUTPUTCAPTURE_H
+
+#include <cstddef>
+#include <string>
+
+const size_t default_capture_size = 1024 * 1024;
+
+/* Captured stdout/stderr of a bg job. smash drains the job's pipe into a
+ * fixed size ring buffer, so memory stays capped no matter how much the job
+ * writes, and only the newest output is kept.
+ * The ring is a memfd mapped twice back to back, so reads from the pipe go
+ * straight into it even when they wrap around its end */
+class OutputCapture {
+    char* ring;
+    size_t ring_size;
+    // bytes ever written, the ring holds the last ring_size of them
+    unsigned long long total_written;
+
+public:
+    // the job writes into pipe_fd[1], smash drains pipe_fd[0]
+    int pipe_fd[2];
+
+    // constructor
+    OutputCapture();
+
+    // destructor
+    ~OutputCapture();
+
+    // disable copy ctor
+    OutputCapture(OutputCapture const&) = delete;
+
+    // disable = operator
+    void operator=(OutputCapture const&) = delete;
+
+    // maps the ring (size is rounded up to whole pages) and creates the
+    // pipe. Returns false if a system call failed
+    bool create(size_t size);
+
+    // reads whatever the pipe has into the ring. Returns false once the
+    // job closed its end, then the read end is closed too
+    bool drain();
+
+    // the read end is still open, the job may write more
+    bool isOpen();
+
+    unsigned long long getTotalWritten();
+
+    // writes the captured bytes written from offset on (clamped to what the
+    // ring still holds) to fd, returns the offset written up to
+    unsigned long long writeTo(int fd, unsigned long long offset);
+
+    // the offset the last lines_count lines start at
+    unsigned long long getTailOffset(size_t lines_count);
+};
+
+#endif //HW1_OUTPUTCAPTURE_H
@@ -0,0 +1,172 @@
+#include "OutputSink.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <sys/uio.h>
+#include <unistd.h>
+
+OutputSink::OutputSink(int fd)
+        : fd(fd), is_line_buffered(isatty(fd) == 1), curr_chunk(0),
+          curr_chunk_used(0) {}
+
+OutputSink::OutputSink(int fd, bool is_line_buffered)
+        : fd(fd), is_line_buffered(is_line_buffered), curr_chunk(0),
+          curr_chunk_used(0) {}
+
+OutputSink::~OutputSink() {
+    for (char* chunk : chunks) {
+        delete[] chunk;
+    }
+}
+
+void OutputSink::write(const char* data, size_t size) {
+    const char* data_end = data + size;
+    while (data < data_end) {
+        if (curr_chunk == chunks.size()) {
+            chunks.push_back(new char[output_sink_chunk_size]);
+        }
+        size_t copy_size = std::min(static_cast<size_t>(data_end - data),
+                                    output_sink_chunk_size - curr_chunk_used);
+        memcpy(chunks[curr_chunk] + curr_chunk_used, data, copy_size);
+        curr_chunk_used += copy_size;
+        data += copy_size;
+
+        if (curr_chunk_used == output_sink_chunk_size) {
+            curr_chunk++;
+            curr_chunk_used = 0;
+            if (curr_chunk == output_sink_max_chunks) {
+                flush();
+            }
+        }
+    }
+
+    if (is_line_buffered && memchr(data_end - size, '\n', size) != nullptr) {
+        flush();
+    }
+}
+
+OutputSink& OutputSink::operator<<(const std::string& str) {
+    write(str.data(), str.size());
+    return *this;
+}
+
+OutputSink& OutputSink::operator<<(const char* str) {
+    write(str, strlen(str));
+    return *this;
+}
+
+OutputSink& OutputSink::operator<<(char c) {
+    write(&c, 1);
+    return *this;
+}
+
+OutputSink& OutputSink::appendUnsigned(unsigned long long number,
+                                       bool is_negative) {
+    // digits are formatted from the end of a local buffer, no strings
+    char digits[24];
+    char* digits_start = digits + sizeof(digits);
+    do {
+        *--digits_start = static_cast<char>('0' + number % 10);
+        number /= 10;
+    } while (number > 0);
+    if (is_negative) {
+        *--digits_start = '-';
+    }
+
+    write(digits_start, digits + sizeof(digits) - digits_start);
+    return *this;
+}
+
+OutputSink& OutputSink::operator<<(int number) {
+    return *this << static_cast<long long>(number);
+}
+
+OutputSink& OutputSink::operator<<(long number) {
+    return *this << static_cast<long long>(number);
+}
+
+OutputSink& OutputSink::operator<<(long long number) {
+    // negating in unsigned keeps LLONG_MIN right
+    unsigned long long magnitude = static_cast<unsigned long long>(number);
+    return appendUnsigned(number < 0 ? 0 - magnitude : magnitude, number < 0);
+}
+
+OutputSink& OutputSink::operator<<(unsigned number) {
+    return appendUnsigned(number, false);
+}
+
+OutputSink& OutputSink::operator<<(unsigned long number) {
+    return appendUnsigned(number, false);
+}
+
+OutputSink& OutputSink::operator<<(unsigned long long number) {
+    return appendUnsigned(number, false);
+}
+
+bool OutputSink::flush() {
+    std::vector<struct iovec> iovs;
+    for (size_t i = 0; i <= curr_chunk && i < chunks.size(); i++) {
+        size_t chunk_used = (i < curr_chunk) ? output_sink_chunk_size
+                                             : curr_chunk_used;
+        if (chunk_used > 0) {
+            struct iovec iov;
+            iov.iov_base = chunks[i];
+            iov.iov_len = chunk_used;
+            iovs.push_back(iov);
+        }
+    }
+
+    bool is_written = true;
+    size_t first_iov = 0;
+    while (first_iov < iovs.size()) {
+        int iov_count = static_cast<int>(std::min(iovs.size() - first_iov,
+                                                  static_cast<size_t>(IOV_MAX)));
+        ssize_t written_count = writev(fd, &iovs[first_iov], iov_count);
+        if (written_count == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("smash error: writev failed");
+            is_written = false;
+            break;
+        }
+
+        // a partial write continues from where it stopped
+        size_t written_size = static_cast<size_t>(written_count);
+        while (first_iov < iovs.size()
+               && written_size >= iovs[first_iov].iov_len) {
+            written_size -= iovs[first_iov].iov_len;
+            first_iov++;
+        }
+        if (first_iov < iovs.size()) {
+            iovs[first_iov].iov_base =
+                    static_cast<char*>(iovs[first_iov].iov_base) + written_size;
+            iovs[first_iov].iov_len -= written_size;
+        }
+    }
+
+    discard();
+    return is_written;
+}
+
+void OutputSink::discard() {
+    curr_chunk = 0;
+    curr_chunk_used = 0;
+
+    // a command that printed a lot doesn't keep its memory
+    while (chunks.size() > output_sink_kept_chunks) {
+        delete[] chunks.back();
+        chunks.pop_back();
+    }
+}
+
+bool OutputSink::isEmpty() const {
+    return curr_chunk == 0 && curr_chunk_used == 0;
+}
+
+int OutputSink::getFd() const {
+    return fd;
+}
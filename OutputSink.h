@@ -0,0 +1,69 @@
+#ifndef HW1_OUTPUTSINK_H
+#define HW1_OUTPUTSINK_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+const size_t output_sink_chunk_size = 16 * 1024;
+// chunks kept allocated between flushes
+const size_t output_sink_kept_chunks = 4;
+// a command that prints more than this flushes on the way
+const size_t output_sink_max_chunks = 64;
+
+/* Buffered output of smash's own messages. Text and numbers are formatted
+ * straight into reused chunks and written with a single writev when the
+ * command is done, so a jobs list of thousands of lines is one syscall
+ * instead of one per line. When fd is a tty every line is written right
+ * away instead, like stdio's line buffering */
+class OutputSink {
+    int fd;
+    bool is_line_buffered;
+    // the filled chunks and then the one being filled
+    std::vector<char*> chunks;
+    size_t curr_chunk;
+    size_t curr_chunk_used;
+
+    OutputSink& appendUnsigned(unsigned long long number, bool is_negative);
+
+public:
+    // constructor
+    explicit OutputSink(int fd);
+
+    // constructor, error messages are line buffered even into a file
+    OutputSink(int fd, bool is_line_buffered);
+
+    // destructor
+    ~OutputSink();
+
+    // disable copy ctor
+    OutputSink(OutputSink const&) = delete;
+
+    // disable = operator
+    void operator=(OutputSink const&) = delete;
+
+    void write(const char* data, size_t size);
+
+    OutputSink& operator<<(const std::string& str);
+    OutputSink& operator<<(const char* str);
+    OutputSink& operator<<(char c);
+    OutputSink& operator<<(int number);
+    OutputSink& operator<<(long number);
+    OutputSink& operator<<(long long number);
+    OutputSink& operator<<(unsigned number);
+    OutputSink& operator<<(unsigned long number);
+    OutputSink& operator<<(unsigned long long number);
+
+    // writes everything buffered with one writev, returns false if it failed
+    bool flush();
+
+    // drops what is buffered, e.g. in a new proccess that must not write
+    // its parent's output again
+    void discard();
+
+    bool isEmpty() const;
+
+    int getFd() const;
+};
+
+#endif //HW1_OUTPUTSINK_H
@@ -0,0 +1,99 @@
+#include "Scheduler.h"
+
+#include "SmallShell.h"
+
+Scheduler::Scheduler() : max_scheduleID(SCHEDULE_DOESNT_EXIST) {}
+
+int Scheduler::addSchedule(const std::string& cmd_line,
+                           const std::string& when_str,
+                           long long first_run_ms, long long interval_ms) {
+    Schedule schedule;
+    schedule.cmd_line = cmd_line;
+    schedule.when_str = when_str;
+    schedule.interval_ms = interval_ms;
+    schedule.next_run_ms = first_run_ms;
+    schedule.timer_id = 0;
+    schedule.last_job_pid = 0;
+    schedule.runs_count = 0;
+    schedule.skipped_runs_count = 0;
+
+    int scheduleID = ++max_scheduleID;
+    schedules_map[scheduleID] = schedule;
+    armSchedule(scheduleID);
+
+    return scheduleID;
+}
+
+bool Scheduler::removeSchedule(int scheduleID) {
+    auto it = schedules_map.find(scheduleID);
+    if (it == schedules_map.end()) {
+        return false;
+    }
+
+    SmallShell::getInstance().events.cancelTimer(it->second.timer_id);
+    schedules_map.erase(it);
+    return true;
+}
+
+void Scheduler::printSchedules(OutputSink& out) {
+    for (auto& schedule_pair : schedules_map) {
+        Schedule& schedule = schedule_pair.second;
+        out << '[' << schedule_pair.first << "] "
+                  << (schedule.interval_ms > 0 ? "every " : "at ")
+                  << schedule.when_str << " : " << schedule.cmd_line
+                  << " (runs " << schedule.runs_count << ", skipped "
+                  << schedule.skipped_runs_count << ")\n";
+    }
+}
+
+void Scheduler::armSchedule(int scheduleID) {
+    Schedule& schedule = schedules_map[scheduleID];
+    schedule.timer_id = SmallShell::getInstance().events.addTimer(
+            schedule.next_run_ms,
+            [this, scheduleID]() { runSchedule(scheduleID); });
+}
+
+void Scheduler::runSchedule(int scheduleID) {
+    auto it = schedules_map.find(scheduleID);
+    if (it == schedules_map.end()) {
+        return;
+    }
+    Schedule& schedule = it->second;
+
+    if (schedule.interval_ms > 0) {
+        // runs missed while smash was busy are skipped, not run in a burst
+        long long now_ms = monotonicTimeMs();
+        do {
+            schedule.next_run_ms += schedule.interval_ms;
+        } while (schedule.next_run_ms <= now_ms);
+        armSchedule(scheduleID);
+    }
+
+    // overrun protection, the job of the previous run is still going
+    if (schedule.last_job_pid != 0 && isChildRunning(schedule.last_job_pid)) {
+        schedule.skipped_runs_count++;
+        return;
+    }
+
+    // launched through the same path as a bg cmd the user typed
+    SmallShell& smash = SmallShell::getInstance();
+    std::string bg_cmd_line = schedule.cmd_line + "&";
+    Command* cmd = smash.createCommand(bg_cmd_line);
+    smash.last_bg_pid = 0;
+    try {
+        if (cmd != nullptr) {
+            cmd->execute();
+        }
+    } catch (ExecutionFail& execution_fail) {}
+
+    // the schedule may not exist anymore if the cmd removed it
+    it = schedules_map.find(scheduleID);
+    if (it == schedules_map.end()) {
+        return;
+    }
+    it->second.runs_count++;
+    it->second.last_job_pid = smash.last_bg_pid;
+    if (it->second.interval_ms == 0) {
+        schedules_map.erase(it);
+    }
+}
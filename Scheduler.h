@@ -0,0 +1,50 @@
+#ifndef HW1_SCHEDULER_H
+#define HW1_SCHEDULER_H
+
+#include <map>
+#include <string>
+#include <unistd.h>
+
+#include "OutputSink.h"
+
+const int SCHEDULE_DOESNT_EXIST = 0;
+
+/* Command lines run periodically (every) or once at a given time (at). The
+ * schedules are timers in smash's event loop, no proccess waits for them.
+ * Every firing launches the command line as a bg job, unless the job of the
+ * previous firing is still running */
+class Scheduler {
+    struct Schedule {
+        std::string cmd_line;
+        // the interval or time as the user gave it, for printing
+        std::string when_str;
+        // 0 for a schedule that runs once
+        long long interval_ms;
+        long long next_run_ms;
+        int timer_id;
+        pid_t last_job_pid;
+        int runs_count;
+        int skipped_runs_count;
+    };
+
+    int max_scheduleID;
+    std::map<int, Schedule> schedules_map;
+
+    void armSchedule(int scheduleID);
+    void runSchedule(int scheduleID);
+
+public:
+    // constructor
+    Scheduler();
+
+    // returns the ID of the new schedule
+    int addSchedule(const std::string& cmd_line, const std::string& when_str,
+                    long long first_run_ms, long long interval_ms);
+
+    // returns false if the schedule doesn't exist
+    bool removeSchedule(int scheduleID);
+
+    void printSchedules(OutputSink& out);
+};
+
+#endif //HW1_SCHEDULER_H
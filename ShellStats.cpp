@@ -0,0 +1,148 @@
+#include "ShellStats.h"
+
+#include <cmath>
+#include <new>
+#include <sys/mman.h>
+
+LatencyHistogram::LatencyHistogram() : count(0), max_ns(0) {}
+
+int LatencyHistogram::getBucketIndex(long long value_ns) {
+    unsigned long long value = (value_ns < 0) ? 0 : value_ns;
+    if (value < (unsigned long long)histogram_sub_buckets_count) {
+        return (int)value;
+    }
+    // the top bits of the value pick the bucket in its power of two
+    int shift = 63 - __builtin_clzll(value) - histogram_sub_bucket_bits;
+    return (shift + 1) * histogram_sub_buckets_count
+           + (int)((value >> shift) & (histogram_sub_buckets_count - 1));
+}
+
+long long LatencyHistogram::getBucketMax(int index) {
+    if (index < histogram_sub_buckets_count) {
+        return index;
+    }
+    int shift = index / histogram_sub_buckets_count - 1;
+    long long bucket_min = (long long)(histogram_sub_buckets_count
+            + index % histogram_sub_buckets_count) << shift;
+    return bucket_min + (1LL << shift) - 1;
+}
+
+void LatencyHistogram::record(long long value_ns) {
+    size_t index = getBucketIndex(value_ns);
+    if (index >= buckets.size()) {
+        buckets.resize(index + 1, 0);
+    }
+    buckets[index]++;
+    count++;
+    if (value_ns > max_ns) {
+        max_ns = value_ns;
+    }
+}
+
+void LatencyHistogram::reset() {
+    buckets.clear();
+    count = 0;
+    max_ns = 0;
+}
+
+unsigned long long LatencyHistogram::getCount() const {
+    return count;
+}
+
+long long LatencyHistogram::getMax() const {
+    return max_ns;
+}
+
+long long LatencyHistogram::getPercentile(double percentile) const {
+    if (count == 0) {
+        return 0;
+    }
+    unsigned long long rank = (unsigned long long)std::ceil(
+            percentile / 100 * count);
+    if (rank == 0) {
+        rank = 1;
+    }
+    unsigned long long seen_count = 0;
+    for (size_t i = 0; i < buckets.size(); i++) {
+        seen_count += buckets[i];
+        if (seen_count >= rank) {
+            long long bucket_max = getBucketMax(i);
+            return (bucket_max < max_ns) ? bucket_max : max_ns;
+        }
+    }
+    return max_ns;
+}
+
+ShellStats::ShellStats()
+        : counters(nullptr), is_counters_shared(true),
+          curr_execution_path(EXEC_PATH_BUILTIN) {
+    size_t counters_size = sizeof(std::atomic<unsigned long long>)
+                           * STATS_COUNTERS_COUNT;
+    void* page = mmap(nullptr, counters_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (page == MAP_FAILED) {
+        // only smash's own counting is seen
+        page = new char[counters_size];
+        is_counters_shared = false;
+    }
+    counters = static_cast<std::atomic<unsigned long long>*>(page);
+    for (int i = 0; i < STATS_COUNTERS_COUNT; i++) {
+        new (&counters[i]) std::atomic<unsigned long long>(0);
+    }
+}
+
+ShellStats::~ShellStats() {
+    if (is_counters_shared) {
+        munmap(counters, sizeof(std::atomic<unsigned long long>)
+                         * STATS_COUNTERS_COUNT);
+    } else {
+        delete[] reinterpret_cast<char*>(counters);
+    }
+}
+
+void ShellStats::count(ShellCounter counter, unsigned long long amount) {
+    counters[counter].fetch_add(amount, std::memory_order_relaxed);
+}
+
+unsigned long long ShellStats::getCounter(ShellCounter counter) const {
+    return counters[counter].load(std::memory_order_relaxed);
+}
+
+void ShellStats::recordCommand(const std::string& command_name,
+                               ExecutionPath path, long long latency_ns) {
+    command_histograms[command_name].record(latency_ns);
+    path_histograms[path].record(latency_ns);
+}
+
+const std::map<std::string, LatencyHistogram>&
+ShellStats::getCommandHistograms() const {
+    return command_histograms;
+}
+
+const LatencyHistogram& ShellStats::getPathHistogram(
+        ExecutionPath path) const {
+    return path_histograms[path];
+}
+
+void ShellStats::reset() {
+    command_histograms.clear();
+    for (auto& histogram : path_histograms) {
+        histogram.reset();
+    }
+    for (int i = 0; i < STATS_COUNTERS_COUNT; i++) {
+        counters[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+const char* getExecutionPathName(ExecutionPath path) {
+    const char* names[EXEC_PATHS_COUNT] = {"builtin", "direct", "bash",
+                                           "pipe", "redirection"};
+    return names[path];
+}
+
+const char* getCounterName(ShellCounter counter) {
+    const char* names[STATS_COUNTERS_COUNT] = {"forks", "direct_execs",
+            "bash_execs", "reaped_jobs", "cp_bytes", "job_scans",
+            "scanned_jobs"};
+    return names[counter];
+}
@@ -0,0 +1,112 @@
+#ifndef HW1_SHELLSTATS_H
+#define HW1_SHELLSTATS_H
+
+#include <atomic>
+#include <map>
+#include <string>
+#include <vector>
+
+// each power of two of a latency is cut into this many buckets, so a
+// percentile is off by at most 1/16 of it
+const int histogram_sub_bucket_bits = 4;
+const int histogram_sub_buckets_count = 1 << histogram_sub_bucket_bits;
+
+// how smash ran a command
+typedef enum {
+    EXEC_PATH_BUILTIN = 0,
+    // exec'd right after smash's own expansion
+    EXEC_PATH_DIRECT = 1,
+    // through "bash -c"
+    EXEC_PATH_BASH = 2,
+    EXEC_PATH_PIPE = 3,
+    EXEC_PATH_REDIRECTION = 4,
+    EXEC_PATHS_COUNT = 5
+} ExecutionPath;
+
+typedef enum {
+    STATS_FORKS = 0,
+    STATS_DIRECT_EXECS = 1,
+    STATS_BASH_EXECS = 2,
+    STATS_REAPED_JOBS = 3,
+    STATS_CP_BYTES = 4,
+    // removeFinishedJobs calls, and the jobs they looked at
+    STATS_JOB_SCANS = 5,
+    STATS_SCANNED_JOBS = 6,
+    STATS_COUNTERS_COUNT = 7
+} ShellCounter;
+
+/* HDR style histogram of latencies in ns: log-linear buckets, exact below
+ * histogram_sub_buckets_count ns and within 1/16 above. Recording is a
+ * count leading zeros and an increment */
+class LatencyHistogram {
+    std::vector<unsigned long long> buckets;
+    unsigned long long count;
+    long long max_ns;
+
+    static int getBucketIndex(long long value_ns);
+    // the highest value that falls in the bucket
+    static long long getBucketMax(int index);
+
+public:
+    // constructor
+    LatencyHistogram();
+
+    void record(long long value_ns);
+
+    void reset();
+
+    unsigned long long getCount() const;
+
+    long long getMax() const;
+
+    // the value that percentile of the recorded ones are at or below, for
+    // percentile in (0, 100]
+    long long getPercentile(double percentile) const;
+};
+
+/* Latency histograms of the commands smash ran, by command name and by how
+ * they were run, and counters of what smash did to run them. The counters
+ * live in a page shared with the children, so what a son counts before it
+ * execs or exits, e.g. the bytes cp copied, is counted too */
+class ShellStats {
+    std::atomic<unsigned long long>* counters;
+    bool is_counters_shared;
+    std::map<std::string, LatencyHistogram> command_histograms;
+    LatencyHistogram path_histograms[EXEC_PATHS_COUNT];
+
+public:
+    // set by the command that runs, read once it is done
+    ExecutionPath curr_execution_path;
+
+    // constructor
+    ShellStats();
+
+    // destructor
+    ~ShellStats();
+
+    // disable copy ctor
+    ShellStats(ShellStats const&) = delete;
+
+    // disable = operator
+    void operator=(ShellStats const&) = delete;
+
+    void count(ShellCounter counter, unsigned long long amount = 1);
+
+    unsigned long long getCounter(ShellCounter counter) const;
+
+    void recordCommand(const std::string& command_name, ExecutionPath path,
+                       long long latency_ns);
+
+    const std::map<std::string, LatencyHistogram>& getCommandHistograms()
+            const;
+
+    const LatencyHistogram& getPathHistogram(ExecutionPath path) const;
+
+    void reset();
+};
+
+/* the name of the path or the counter, as the stats built-in prints it */
+const char* getExecutionPathName(ExecutionPath path);
+const char* getCounterName(ShellCounter counter);
+
+#endif //HW1_SHELLSTATS_H
@@ -8,7 +8,12 @@
 SmallShell::SmallShell()
         : curr_prompt_str("smash> "), prev_wd_path(""), fg_pid(NO_FG_PROCCESS),
           fg_cmd(nullptr), fg_cmd_prev_jobID(FG_COMMAND_WASNT_IN_JOBLIST_BEFORE),
-          smash_pid(getpid())
+          smash_pid(getpid()), last_exit_status(0), is_exit_status_set(false),
+          fg_got_signal(false), out(STDOUT_FILENO),
+          err(STDERR_FILENO, true),
+          last_bg_pid(0), next_job_timeout_ms(0),
+          next_job_kill_grace_ms(default_kill_grace_ms),
+          next_job_capture(nullptr)
 {}
 
 // SmallShell destructor
@@ -25,6 +30,8 @@ SmallShell& SmallShell::getInstance() {
 /* Creates and returns a pointer to Command class which matches the given
  * command line */
 Command* SmallShell::createCommand(std::string& cmd_line) {
+    TRACE_SPAN("SmallShell::createCommand");
+    long long parse_start_ns = monotonicTimeNs();
     auto cmd_args = _parseCommandLine(cmd_line);
     Command* cmd_obj = nullptr;
 
@@ -36,12 +43,30 @@ Command* SmallShell::createCommand(std::string& cmd_line) {
     _removeBackgroundSign(cmd_args[cmd_args.size()-1]);
     std::string& command_name = cmd_args[0];
 
-    if (isRedirectionCommand(cmd_line)){
+    std::vector<std::string> expanded_args;
+    bool is_expanded = isBuiltInCommand(cmd_line)
+                       && expandBuiltInArgs(cmd_line, expanded_args);
+    launch_timer.addPhase(LAUNCH_PARSE, parse_start_ns);
+    long long dispatch_start_ns = monotonicTimeNs();
+
+    if (isCommandList(cmd_line)){
+        cmd_obj = new ListCommand(cmd_line);
+    }
+    else if (command_name == "time"){
+        // times the whole pipe or redirection, like in bash
+        cmd_obj = new TimeCommand(cmd_line);
+    }
+    else if (isRedirectionCommand(cmd_line)){
         cmd_obj = new RedirectionCommand(cmd_line);
     }
     else if (isPipeCommand(cmd_line)){
         cmd_obj = new PipeCommand(cmd_line);
     }
+    else if (isInputToolCommand(command_name)
+             && hasInputRedirection(cmd_line)) {
+        // the system tool reads the redirected input and input sources
+        cmd_obj = new ExternalCommand(cmd_line);
+    }
     else if (command_name == "chprompt") {
         cmd_obj = new ChangePromptCommand(cmd_line);
     }
@@ -72,21 +97,163 @@ Command* SmallShell::createCommand(std::string& cmd_line) {
     else if (command_name == "cp"){
         cmd_obj = new CopyCommand(cmd_line);
     }
+    else if (command_name == "taskset"){
+        cmd_obj = new TaskSetCommand(cmd_line);
+    }
+    else if (command_name == "jobpolicy"){
+        cmd_obj = new JobPolicyCommand(cmd_line);
+    }
+    else if (command_name == "wait"){
+        cmd_obj = new WaitCommand(cmd_line);
+    }
+    else if (command_name == "every"){
+        cmd_obj = new EveryCommand(cmd_line);
+    }
+    else if (command_name == "at"){
+        cmd_obj = new AtCommand(cmd_line);
+    }
+    else if (command_name == "capture"){
+        cmd_obj = new CaptureCommand(cmd_line);
+    }
+    else if (command_name == "joblog"){
+        cmd_obj = new JobLogCommand(cmd_line);
+    }
+    else if (command_name == "wc"){
+        cmd_obj = new WordCountCommand(cmd_line);
+    }
+    else if (command_name == "grep"){
+        cmd_obj = new GrepCommand(cmd_line);
+    }
+    else if (command_name == "sort"){
+        cmd_obj = new SortCommand(cmd_line);
+    }
+    else if (command_name == "sum"){
+        cmd_obj = new SumCommand(cmd_line);
+    }
+    else if (command_name == "du"){
+        cmd_obj = new DiskUsageCommand(cmd_line);
+    }
+    else if (command_name == "find"){
+        cmd_obj = new FindCommand(cmd_line);
+    }
+    else if (command_name == "rm"){
+        cmd_obj = new RemoveCommand(cmd_line);
+    }
+    else if (command_name == "timeout"){
+        cmd_obj = new TimeoutCommand(cmd_line);
+    }
+    else if (command_name == "stats"){
+        cmd_obj = new StatsCommand(cmd_line);
+    }
+    else if (command_name == "trace"){
+        cmd_obj = new TraceCommand(cmd_line);
+    }
+    else if (command_name == "parallel"){
+        cmd_obj = new ParallelCommand(cmd_line);
+    }
+    else if (command_name == "export"){
+        cmd_obj = new ExportCommand(cmd_line);
+    }
+    else if (command_name == "unset"){
+        cmd_obj = new UnsetCommand(cmd_line);
+    }
+    else if (isAssignmentCommand(cmd_line)){
+        cmd_obj = new AssignCommand(cmd_line);
+    }
     else {
         cmd_obj = new ExternalCommand(cmd_line);
     }
+    if (is_expanded && cmd_obj != nullptr) {
+        cmd_obj->setExpandedArgs(expanded_args);
+    }
+    launch_timer.addPhase(LAUNCH_DISPATCH, dispatch_start_ns);
 
     return cmd_obj;
 }
 
+bool SmallShell::expandBuiltInArgs(const std::string& cmd_line,
+                                   std::vector<std::string>& args) {
+    if (cmd_line.find_first_of("$~*?[\\'\"") == std::string::npos) {
+        return false;
+    }
+    auto cmd_args = _parseCommandLine(cmd_line);
+    std::string& command_name = cmd_args[0];
+    if (command_name == "every" || command_name == "at"
+        || command_name == "timeout" || command_name == "time"
+        || command_name == "capture"
+        || command_name == "parallel" || command_name == "export"
+        || command_name == "grep" || command_name == "du"
+        || command_name == "find" || command_name == "rm") {
+        return false;
+    }
+
+    std::string line_to_expand = cmd_line;
+    _removeBackgroundSign(line_to_expand);
+
+    std::vector<std::string> assignments;
+    return expandCommandLine(line_to_expand, assignments, args)
+           && assignments.empty() && !args.empty();
+}
+
 SmallShellNextState SmallShell::executeCommand(std::string cmd_line) {
+    TRACE_SPAN("SmallShell::executeCommand");
+    long long start_ns = monotonicTimeNs();
     Command* cmd = createCommand(cmd_line);
     if (cmd == nullptr) {
         return CONTINUE_RUNNING;
     }
+    // the commands of a list run through here each, and are recorded each
+    ExecutionPath outer_execution_path = stats.curr_execution_path;
+    stats.curr_execution_path = EXEC_PATH_BUILTIN;
 
     jobs.removeFinishedJobs();
-    return cmd->execute();
+
+    // a fg proccess sets its own exit status when smash waits for it, bg
+    // jobs and built-ins get 0 or 1 if they failed. Until then, $? in the
+    // line still expands to the previous status
+    is_exit_status_set = false;
+    SmallShellNextState smash_next_state;
+    try {
+        smash_next_state = cmd->execute();
+    } catch (ExecutionFail& execution_fail) {
+        out.flush();
+        err.flush();
+        dropHereDocuments(cmd_line);
+        if (!is_exit_status_set) {
+            setExitStatus(1);
+        }
+        recordCommandStats(cmd_line, start_ns);
+        stats.curr_execution_path = outer_execution_path;
+        throw execution_fail;
+    }
+    out.flush();
+    err.flush();
+    dropHereDocuments(cmd_line);
+    if (!is_exit_status_set) {
+        setExitStatus(0);
+    }
+    recordCommandStats(cmd_line, start_ns);
+    stats.curr_execution_path = outer_execution_path;
+
+    return smash_next_state;
+}
+
+void SmallShell::recordCommandStats(std::string& cmd_line,
+                                    long long start_ns) {
+    if (isCommandList(cmd_line)) {
+        return;
+    }
+    long long latency_ns = monotonicTimeNs() - start_ns;
+    size_t name_start = cmd_line.find_first_not_of(" \t");
+    size_t name_end = cmd_line.find_first_of(" \t&|><;", name_start);
+    std::string command_name = cmd_line.substr(name_start,
+                                               name_end - name_start);
+    stats.recordCommand(command_name, stats.curr_execution_path, latency_ns);
+}
+
+void SmallShell::setExitStatus(int exit_status) {
+    last_exit_status = exit_status;
+    is_exit_status_set = true;
 }
 
 void SmallShell::stopFgProccess() {
@@ -101,6 +268,7 @@ void SmallShell::stopFgProccess() {
     }
 
     std::cout << "smash: process " << fg_pid << " was stopped" << std::endl;
+    fg_got_signal = true;
     jobs.addJob(fg_cmd, fg_pid, STOPPED, fg_cmd_prev_jobID);
 
     resetFgCommandInfo();
@@ -117,6 +285,7 @@ void SmallShell::killFgProccess() {
     }
 
     std::cout << "smash: process " << fg_pid << " was killed" << std::endl;
+    fg_got_signal = true;
     jobs.removeJobById(fg_cmd_prev_jobID);
 
     resetFgCommandInfo();
@@ -134,7 +303,7 @@ SmallShellResult SmallShell::updateFgCommand(Command* new_fg_cmd,
     }
 
     int status;
-    pid_t result = waitpid(fg_pid, &status, WUNTRACED);
+    pid_t result = waitForFgProccess(fg_pid, &status);
     if (result == -1) { // waitpid failed
         perror("smash error: waitpid failed");
         resetFgCommandInfo();
@@ -148,6 +317,7 @@ SmallShellResult SmallShell::updateFgCommand(Command* new_fg_cmd,
     }
 
     // otherwise, fg cmd completed
+    clearJobDeadline(fg_pid);
     resetFgCommandInfo();
 
     return FG_COMMAND_COMPLETED;
@@ -167,3 +337,233 @@ void SmallShell::updateFgCommandInfo(Command* new_cmd, pid_t new_pid,
     fg_cmd_prev_jobID = prev_jobID;
 }
 
+
+bool SmallShell::readCommandLine(std::string& cmd_line) {
+    // stdin is read directly instead of through std::cin, so poll knows if
+    // there is buffered input
+    while (true) {
+        size_t line_end = input_buff.find('\n');
+        if (line_end != std::string::npos) {
+            cmd_line = input_buff.substr(0, line_end);
+            input_buff.erase(0, line_end + 1);
+            return true;
+        }
+
+        if (events.waitForEvents(WAIT_FOREVER, STDIN_FILENO)
+            != EVENT_FD_READY) {
+            continue;
+        }
+
+        char buff[4096];
+        ssize_t bytes_read_count = read(STDIN_FILENO, buff, sizeof(buff));
+        if (bytes_read_count == -1) {
+            if (errno == EINTR || errno == EAGAIN) {
+                continue;
+            }
+            perror("smash error: read failed");
+            return false;
+        }
+        if (bytes_read_count == 0) {
+            // end of input, the last line may have no newline
+            cmd_line = input_buff;
+            input_buff.clear();
+            return !cmd_line.empty();
+        }
+        input_buff.append(buff, (size_t)bytes_read_count);
+    }
+}
+
+void SmallShell::readHereDocuments(const std::string& cmd_line) {
+    here_documents.clear();
+    std::vector<InputSource> sources;
+    if (cmd_line.find("<<") == std::string::npos
+        || !findInputSources(cmd_line, sources)) {
+        return;
+    }
+
+    for (auto& source : sources) {
+        if (source.type != InputSource::HERE_DOCUMENT) {
+            continue;
+        }
+        HereDocument here_doc;
+        here_doc.is_expanded = !source.is_delimiter_quoted;
+        std::string line;
+        while (readCommandLine(line)) {
+            if (source.is_tab_stripped) {
+                line.erase(0, line.find_first_not_of('\t'));
+            }
+            if (line == source.text) {
+                break;
+            }
+            here_doc.body += line;
+            here_doc.body += '\n';
+        }
+        here_documents.push_back(here_doc);
+    }
+}
+
+void SmallShell::dropHereDocuments(const std::string& cmd_line) {
+    if (here_documents.empty()) {
+        return;
+    }
+    std::vector<InputSource> sources;
+    if (!findInputSources(cmd_line, sources)) {
+        return;
+    }
+    for (auto& source : sources) {
+        if (source.type == InputSource::HERE_DOCUMENT
+            && !here_documents.empty()) {
+            here_documents.pop_front();
+        }
+    }
+}
+
+pid_t SmallShell::waitForFgProccess(pid_t pid, int* status) {
+    TRACE_SPAN("waitpid");
+    long long wait_start_ns = monotonicTimeNs();
+    // what was printed before the fg proccess runs comes first
+    out.flush();
+    err.flush();
+    while (true) {
+        // wait4 for the time built-in, which reports the usage
+        struct rusage usage;
+        pid_t result = wait4(pid, status, WUNTRACED | WNOHANG, &usage);
+        if (result != 0) {
+            if (result == -1 && errno == EINTR) {
+                continue;
+            }
+            if (result == pid) {
+                // the wait status stays the job's, only the exit status
+                // is timeout(1)'s
+                setExitStatus(takeExpiredDeadline(pid, *status)
+                              ? timeout_exit_status : getExitStatus(*status));
+                launch_timer.addChildUsage(usage);
+            }
+            launch_timer.addPhase(LAUNCH_WAIT, wait_start_ns);
+            return result;
+        }
+        // sleeps until SIGCHLD, running due timers meanwhile
+        events.waitForEvents(WAIT_FOREVER);
+    }
+}
+
+void SmallShell::armJobDeadline(pid_t job_pid) {
+    if (next_job_timeout_ms <= 0) {
+        return;
+    }
+
+    JobDeadline deadline;
+    deadline.deadline_ms = monotonicTimeMs() + next_job_timeout_ms;
+    deadline.kill_grace_ms = next_job_kill_grace_ms;
+    deadline.sigterm_sent = false;
+    deadline.timer_id = events.addTimer(deadline.deadline_ms,
+            [this, job_pid]() { onJobDeadline(job_pid); });
+    job_deadlines[job_pid] = deadline;
+    expired_job_pids.erase(job_pid);
+
+    // only the first proccess launched by the command is its job
+    next_job_timeout_ms = 0;
+}
+
+void SmallShell::clearJobDeadline(pid_t job_pid) {
+    auto it = job_deadlines.find(job_pid);
+    if (it == job_deadlines.end()) {
+        return;
+    }
+    events.cancelTimer(it->second.timer_id);
+    job_deadlines.erase(it);
+}
+
+long long SmallShell::getJobDeadline(pid_t job_pid) {
+    auto it = job_deadlines.find(job_pid);
+    return it == job_deadlines.end() ? 0 : it->second.deadline_ms;
+}
+
+bool SmallShell::takeExpiredDeadline(pid_t job_pid, int status) {
+    // a stopped job is still running toward its kill
+    if (WIFSTOPPED(status)) {
+        return false;
+    }
+    return expired_job_pids.erase(job_pid) == 1;
+}
+
+void SmallShell::onJobDeadline(pid_t job_pid) {
+    auto it = job_deadlines.find(job_pid);
+    if (it == job_deadlines.end()) {
+        return;
+    }
+
+    // the pid can't be reused before smash reaps it, so if it is still a
+    // child of smash the proccess group is still the job's
+    siginfo_t info;
+    if (waitid(P_PID, job_pid, &info,
+               WEXITED | WSTOPPED | WCONTINUED | WNOHANG | WNOWAIT) == -1) {
+        job_deadlines.erase(it);
+        return;
+    }
+
+    if (it->second.sigterm_sent) {
+        killpg(job_pid, SIGKILL);
+        job_deadlines.erase(it);
+        return;
+    }
+
+    // a stopped job must be continued to handle SIGTERM
+    expired_job_pids.insert(job_pid);
+    killpg(job_pid, SIGTERM);
+    killpg(job_pid, SIGCONT);
+    it->second.sigterm_sent = true;
+    it->second.timer_id = events.addTimer(
+            monotonicTimeMs() + it->second.kill_grace_ms,
+            [this, job_pid]() { onJobDeadline(job_pid); });
+}
+
+void SmallShell::prepareJobProccess(bool is_bg_job) {
+    // smash's buffered output is smash's to write, not the new job's
+    out.discard();
+    err.discard();
+    sched_policy.applyOnLaunch(is_bg_job);
+
+    if (next_job_capture == nullptr) {
+        return;
+    }
+    if (dup2(next_job_capture->pipe_fd[1], STDOUT_FILENO) == -1
+        || dup2(next_job_capture->pipe_fd[1], STDERR_FILENO) == -1) {
+        perror("smash error: dup2 failed");
+        _exit(DUP2_FAILED);
+    }
+}
+
+void SmallShell::dropJobCapture(int jobID) {
+    auto it = job_captures.find(jobID);
+    if (it == job_captures.end()) {
+        return;
+    }
+    if (it->second->isOpen()) {
+        events.removeFdWatch(it->second->pipe_fd[0]);
+    }
+    delete it->second;
+    job_captures.erase(it);
+}
+
+void SmallShell::attachJobCapture(int jobID) {
+    if (next_job_capture == nullptr) {
+        return;
+    }
+    OutputCapture* capture = next_job_capture;
+    next_job_capture = nullptr;
+
+    // only the job holds the write end now, so smash sees end of file
+    // when the job is done
+    close(capture->pipe_fd[1]);
+    capture->pipe_fd[1] = -1;
+
+    job_captures[jobID] = capture;
+
+    int read_fd = capture->pipe_fd[0];
+    events.addFdWatch(read_fd, [this, capture, read_fd]() {
+        if (!capture->drain()) {
+            events.removeFdWatch(read_fd);
+        }
+    });
+}
@@ -1,11 +1,26 @@
 #ifndef HW1_SMALLSHELL_H
 #define HW1_SMALLSHELL_H
 
+#include <deque>
+#include <set>
+
 #include "Command.h"
 #include "BuiltInCommand.h"
 #include "ExternalCommand.h"
 #include "SpecialCommand.h"
+#include "ListCommand.h"
 #include "JobList.h"
+#include "JobScheduling.h"
+#include "EventLoop.h"
+#include "Scheduler.h"
+#include "OutputCapture.h"
+#include "Environment.h"
+#include "Expansion.h"
+#include "OutputSink.h"
+#include "InputSources.h"
+#include "LaunchTiming.h"
+#include "ShellStats.h"
+#include "Tracing.h"
 
 const int NO_FG_PROCCESS = 0;
 const int FG_COMMAND_WASNT_IN_JOBLIST_BEFORE = 0;
@@ -44,19 +59,77 @@ public:
     CommandFail() {}
 };
 
+const long long default_kill_grace_ms = 5000;
+// the exit status of a job whose deadline expired, as in timeout(1)
+const int timeout_exit_status = 124;
+
 class SmallShell {
 private:
+    // deadline of a job started by the timeout built-in
+    struct JobDeadline {
+        long long deadline_ms;
+        int timer_id;
+        long long kill_grace_ms;
+        bool sigterm_sent;
+    };
+
+    std::string input_buff;
+    std::map<pid_t, JobDeadline> job_deadlines;
+    // jobs whose deadline expired, reported with timeout_exit_status
+    std::set<pid_t> expired_job_pids;
+
     // constructor
     SmallShell();
 
+    void onJobDeadline(pid_t job_pid);
+
+    // records the latency of a command that executeCommand ran, by its name
+    // and by how it was run
+    void recordCommandStats(std::string& cmd_line, long long start_ns);
+
 public:
     std::string curr_prompt_str;
     std::string prev_wd_path;
     JobList jobs;
+    SchedulingPolicy sched_policy;
+    EventLoop events;
+    Scheduler scheduler;
     pid_t fg_pid;
     Command* fg_cmd;
     int fg_cmd_prev_jobID;
     pid_t smash_pid;
+    // exit status of the last command, like $? in bash
+    int last_exit_status;
+    // set once the running command got its exit status
+    bool is_exit_status_set;
+    // set when ctrl-C or ctrl-Z hit the fg proccess
+    bool fg_got_signal;
+    // buffered stdout of built-ins and smash's messages, flushed once per
+    // command, and their stderr
+    OutputSink out;
+    OutputSink err;
+    // shell variables, the exported ones are smash's environ
+    Environment env;
+    // directory listings for globbing
+    DirectoryCache dir_cache;
+    // pid of the last job launched to the bg
+    pid_t last_bg_pid;
+    // set by the timeout built-in, the next job launched gets the deadline
+    long long next_job_timeout_ms;
+    long long next_job_kill_grace_ms;
+    // set by the capture built-in, the next bg job writes into it
+    OutputCapture* next_job_capture;
+    // output captures of bg jobs, by jobID
+    std::map<int, OutputCapture*> job_captures;
+    // bodies of the here documents of the command line, the first ones
+    // belong to the next command that runs
+    std::deque<HereDocument> here_documents;
+    // started by the time built-in, the code paths that launch its command
+    // time their phases into it
+    LaunchTimer launch_timer;
+    // latencies of the commands run, and counts of what it took, for the
+    // stats built-in
+    ShellStats stats;
 
     // disable copy ctor
     SmallShell(SmallShell const&) = delete;
@@ -72,8 +145,16 @@ public:
 
     Command* createCommand(std::string& cmd_line);
 
+    // expands the args of a built-in the way bash would before running it.
+    // Returns false if the line is left for the built-in to parse, e.g.
+    // when it wraps another command that expands its own line
+    bool expandBuiltInArgs(const std::string& cmd_line,
+                           std::vector<std::string>& args);
+
     SmallShellNextState executeCommand(std::string cmd_line);
 
+    void setExitStatus(int exit_status);
+
     void stopFgProccess();
 
     void killFgProccess();
@@ -86,6 +167,43 @@ public:
 
     void updateFgCommandInfo(Command* new_cmd, pid_t new_pid,
             int prev_jobID = FG_COMMAND_WASNT_IN_JOBLIST_BEFORE);
+
+    // reads the next command line from stdin, serving timers meanwhile.
+    // Returns false on end of input
+    bool readCommandLine(std::string& cmd_line);
+
+    // reads the bodies of the command line's here documents, from the lines
+    // that follow it
+    void readHereDocuments(const std::string& cmd_line);
+
+    // forgets the here documents of a command that ran or was skipped
+    void dropHereDocuments(const std::string& cmd_line);
+
+    // waitpid(pid, status, WUNTRACED) that serves timers while blocked
+    pid_t waitForFgProccess(pid_t pid, int* status);
+
+    // called in a new job's proccess before exec, places it and redirects
+    // its output into the pending capture, if any
+    void prepareJobProccess(bool is_bg_job);
+
+    // drops the capture of a previous job with the same ID, if any
+    void dropJobCapture(int jobID);
+
+    // hands the pending capture, if any, over to the new bg job
+    void attachJobCapture(int jobID);
+
+    // arms the deadline set by the timeout built-in for a new job, if any
+    void armJobDeadline(pid_t job_pid);
+
+    // forgets the deadline of a job that finished
+    void clearJobDeadline(pid_t job_pid);
+
+    // the deadline of the job, 0 if it has none
+    long long getJobDeadline(pid_t job_pid);
+
+    // checks if a job that ended with the wait status had its deadline
+    // expire, and forgets it
+    bool takeExpiredDeadline(pid_t job_pid, int status);
 };
 
 #endif //HW1_SMALLSHELL_H
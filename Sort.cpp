@@ -0,0 +1,343 @@
+#include "Sort.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <system_error>
+#include <thread>
+#include <unistd.h>
+
+void makeSortLine(const char* data, size_t size, SortLine& line) {
+    line.data = data;
+    line.size = size;
+    line.prefix = 0;
+    size_t prefix_size = std::min(size, sizeof(line.prefix));
+    for (size_t i = 0; i < prefix_size; i++) {
+        line.prefix |= static_cast<uint64_t>(
+                static_cast<unsigned char>(data[i])) << (56 - 8 * i);
+    }
+}
+
+int compareSortLines(const SortLine& first, const SortLine& second) {
+    if (first.prefix != second.prefix) {
+        return (first.prefix < second.prefix) ? -1 : 1;
+    }
+    // the bytes in the prefix of both are equal
+    size_t common_size = std::min(first.size, second.size);
+    size_t compared_size = std::min(common_size, sizeof(first.prefix));
+    int result = memcmp(first.data + compared_size,
+                        second.data + compared_size,
+                        common_size - compared_size);
+    if (result != 0) {
+        return (result < 0) ? -1 : 1;
+    }
+    if (first.size != second.size) {
+        return (first.size < second.size) ? -1 : 1;
+    }
+    return 0;
+}
+
+// the radix of the line at depth, 0 if the line ended before it, so a
+// shorter line goes first
+static inline size_t getRadix(const SortLine& line, size_t depth) {
+    if (depth >= line.size) {
+        return 0;
+    }
+    if (depth < sizeof(line.prefix)) {
+        return 1 + ((line.prefix >> (56 - 8 * depth)) & 0xff);
+    }
+    return 1 + static_cast<unsigned char>(line.data[depth]);
+}
+
+// the lines all have the same bytes before depth
+static void radixSortLinesFrom(SortLine* lines, size_t count,
+                               SortLine* scratch, size_t depth) {
+    const size_t radixes_count = 257;
+    while (count >= sort_radix_min_lines) {
+        size_t bucket_sizes[radixes_count] = {0};
+        for (size_t i = 0; i < count; i++) {
+            bucket_sizes[getRadix(lines[i], depth)]++;
+        }
+        size_t bucket_starts[radixes_count];
+        size_t largest_bucket = 0;
+        size_t start = 0;
+        for (size_t radix = 0; radix < radixes_count; radix++) {
+            bucket_starts[radix] = start;
+            start += bucket_sizes[radix];
+            if (bucket_sizes[radix] > bucket_sizes[largest_bucket]) {
+                largest_bucket = radix;
+            }
+        }
+
+        if (bucket_sizes[largest_bucket] != count) {
+            size_t next_positions[radixes_count];
+            memcpy(next_positions, bucket_starts, sizeof(bucket_starts));
+            for (size_t i = 0; i < count; i++) {
+                scratch[next_positions[getRadix(lines[i], depth)]++] =
+                        lines[i];
+            }
+            memcpy(lines, scratch, count * sizeof(SortLine));
+            // the lines that ended are equal, the rest go on by the next
+            // byte. The largest bucket is done by this loop, so recursion
+            // is only into the smaller ones and stays shallow
+            for (size_t radix = 1; radix < radixes_count; radix++) {
+                if (radix != largest_bucket && bucket_sizes[radix] > 1) {
+                    size_t bucket_start = bucket_starts[radix];
+                    radixSortLinesFrom(lines + bucket_start,
+                                       bucket_sizes[radix],
+                                       scratch + bucket_start, depth + 1);
+                }
+            }
+        }
+        if (largest_bucket == 0) {
+            return;
+        }
+        lines += bucket_starts[largest_bucket];
+        scratch += bucket_starts[largest_bucket];
+        count = bucket_sizes[largest_bucket];
+        depth++;
+    }
+    std::sort(lines, lines + count,
+              [](const SortLine& first, const SortLine& second) {
+                  return compareSortLines(first, second) < 0;
+              });
+}
+
+void radixSortLines(SortLine* lines, size_t count, SortLine* scratch) {
+    radixSortLinesFrom(lines, count, scratch, 0);
+}
+
+// runs the tasks on threads, and inline the ones no thread was made for
+template <typename Task>
+static void runTasks(std::vector<Task>& tasks) {
+    std::vector<std::thread> threads;
+    size_t started_count = 0;
+    try {
+        for (; started_count < tasks.size(); started_count++) {
+            threads.emplace_back(tasks[started_count]);
+        }
+    } catch (std::system_error& e) {
+        for (size_t i = started_count; i < tasks.size(); i++) {
+            tasks[i]();
+        }
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+void sortLinesInParallel(std::vector<SortLine>& lines,
+                         const SortOptions& options, int threads_count) {
+    bool is_reversed = options.is_reversed;
+    auto is_before = [is_reversed](const SortLine& first,
+                                   const SortLine& second) {
+        int result = compareSortLines(first, second);
+        return is_reversed ? result > 0 : result < 0;
+    };
+    // a part is radix sorted with its range of merged as scratch, and is
+    // reversed for -r. Lines that compare equal are the same bytes anyway
+    std::vector<SortLine> merged(lines.size());
+    auto sort_part = [&lines, &merged, is_reversed](size_t start, size_t end) {
+        radixSortLines(lines.data() + start, end - start,
+                       merged.data() + start);
+        if (is_reversed) {
+            std::reverse(lines.begin() + start, lines.begin() + end);
+        }
+    };
+    if (lines.size() < sort_parallel_min_lines || threads_count <= 1) {
+        sort_part(0, lines.size());
+        return;
+    }
+
+    // part i is lines[bounds[i], bounds[i + 1])
+    std::vector<size_t> bounds;
+    for (int i = 0; i <= threads_count; i++) {
+        bounds.push_back(lines.size() * i / threads_count);
+    }
+    std::vector<std::function<void()>> tasks;
+    for (int i = 0; i < threads_count; i++) {
+        size_t start = bounds[i];
+        size_t end = bounds[i + 1];
+        tasks.push_back([start, end, &sort_part]() {
+            sort_part(start, end);
+        });
+    }
+    runTasks(tasks);
+
+    // sorted parts are merged in pairs, from one buffer into the other,
+    // until a single part is left
+    std::vector<SortLine>* source = &lines;
+    std::vector<SortLine>* target = &merged;
+    while (bounds.size() > 2) {
+        std::vector<size_t> merged_bounds;
+        tasks.clear();
+        for (size_t i = 0; i + 1 < bounds.size(); i += 2) {
+            size_t start = bounds[i];
+            size_t middle = bounds[i + 1];
+            size_t end = (i + 2 < bounds.size()) ? bounds[i + 2] : middle;
+            merged_bounds.push_back(start);
+            tasks.push_back([source, target, start, middle, end,
+                             &is_before]() {
+                std::merge(source->begin() + start, source->begin() + middle,
+                           source->begin() + middle, source->begin() + end,
+                           target->begin() + start, is_before);
+            });
+        }
+        merged_bounds.push_back(lines.size());
+        runTasks(tasks);
+        bounds.swap(merged_bounds);
+        std::swap(source, target);
+    }
+    if (source != &lines) {
+        lines.swap(merged);
+    }
+}
+
+//----------------------------------------------------------------------------
+
+bool SortedRun::hasFailed() const {
+    return false;
+}
+
+MemoryRun::MemoryRun(const std::vector<SortLine>& lines)
+    : lines(lines), next_index(0) {}
+
+bool MemoryRun::next(SortLine& line) {
+    if (next_index == lines.size()) {
+        return false;
+    }
+    line = lines[next_index++];
+    return true;
+}
+
+FileRun::FileRun(int fd)
+    : fd(fd), pos(0), is_at_end(false), has_failed(false) {}
+
+FileRun::~FileRun() {
+    close(fd);
+}
+
+bool FileRun::next(SortLine& line) {
+    while (true) {
+        const void* newline = memchr(buff.data() + pos, '\n',
+                                     buff.size() - pos);
+        if (newline != nullptr) {
+            size_t line_end = static_cast<const char*>(newline) - buff.data();
+            makeSortLine(buff.data() + pos, line_end - pos, line);
+            pos = line_end + 1;
+            return true;
+        }
+        if (is_at_end) {
+            return false;
+        }
+        // the line returned before isn't needed anymore
+        buff.erase(0, pos);
+        pos = 0;
+        size_t used_size = buff.size();
+        buff.resize(used_size + sort_merge_read_size);
+        ssize_t bytes_read_count = read(fd, &buff[used_size],
+                                        sort_merge_read_size);
+        if (bytes_read_count == -1 && errno == EINTR) {
+            buff.resize(used_size);
+            continue;
+        }
+        if (bytes_read_count <= 0) {
+            is_at_end = true;
+            has_failed = (bytes_read_count == -1);
+            bytes_read_count = 0;
+        }
+        buff.resize(used_size + bytes_read_count);
+    }
+}
+
+bool FileRun::hasFailed() const {
+    return has_failed;
+}
+
+//----------------------------------------------------------------------------
+
+LoserTree::LoserTree(const std::vector<SortedRun*>& runs,
+                     const SortOptions& options)
+    : runs(runs), options(options), heads(runs.size()),
+      is_over(runs.size()), tree(runs.size()), is_winner_taken(false) {
+    size_t runs_count = runs.size();
+    for (size_t i = 0; i < runs_count; i++) {
+        is_over[i] = !runs[i]->next(heads[i]);
+    }
+    if (runs_count == 0) {
+        return;
+    }
+
+    // the matches are played bottom up, the leaves are winners[k, 2k)
+    std::vector<size_t> winners(2 * runs_count);
+    for (size_t i = 0; i < runs_count; i++) {
+        winners[runs_count + i] = i;
+    }
+    for (size_t node = runs_count - 1; node >= 1; node--) {
+        size_t left = winners[2 * node];
+        size_t right = winners[2 * node + 1];
+        bool is_left_winning = isBefore(left, right);
+        winners[node] = is_left_winning ? left : right;
+        tree[node] = is_left_winning ? right : left;
+    }
+    tree[0] = winners[1];
+}
+
+bool LoserTree::isBefore(size_t first, size_t second) const {
+    if (is_over[first] || is_over[second]) {
+        return !is_over[first];
+    }
+    int result = compareSortLines(heads[first], heads[second]);
+    if (options.is_reversed) {
+        result = -result;
+    }
+    // equal lines go out in the order of their runs
+    return (result != 0) ? result < 0 : first < second;
+}
+
+void LoserTree::replay(size_t run) {
+    size_t winner = run;
+    for (size_t node = (run + runs.size()) / 2; node >= 1; node /= 2) {
+        if (isBefore(tree[node], winner)) {
+            std::swap(tree[node], winner);
+        }
+    }
+    tree[0] = winner;
+}
+
+bool LoserTree::next(SortLine& line) {
+    if (runs.empty()) {
+        return false;
+    }
+    // the line taken before is valid up to now, so its run moves on only
+    // when the next one is asked for
+    if (is_winner_taken) {
+        size_t winner = tree[0];
+        is_over[winner] = !runs[winner]->next(heads[winner]);
+        replay(winner);
+    }
+    size_t winner = tree[0];
+    if (is_over[winner]) {
+        return false;
+    }
+    line = heads[winner];
+    is_winner_taken = true;
+    return true;
+}
+
+//----------------------------------------------------------------------------
+
+int openTemporaryFile(const std::string& dir) {
+    std::string path_template = dir + "/smash-sort-XXXXXX";
+    std::vector<char> path(path_template.begin(), path_template.end());
+    path.push_back('\0');
+    int fd = mkstemp(path.data());
+    if (fd == -1) {
+        return -1;
+    }
+    // gone once closed, even if smash dies
+    unlink(path.data());
+    return fd;
+}
@@ -0,0 +1,145 @@
+#ifndef HW1_SORT_H
+#define HW1_SORT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// memory for the lines of one run, when no budget is given
+const size_t sort_default_memory_budget = 256 * 1024 * 1024;
+const size_t sort_min_memory_budget = 1024 * 1024;
+const size_t sort_read_size = 1024 * 1024;
+// runs are read back this much at a time while merging
+const size_t sort_merge_read_size = 256 * 1024;
+// a run with fewer lines is sorted by a single thread
+const size_t sort_parallel_min_lines = 64 * 1024;
+const int sort_max_threads = 16;
+// a group of lines this small is not split by the radix sort any further
+const size_t sort_radix_min_lines = 64;
+
+/* A line of a run, pointing into the run's buffer. The first 8 bytes are
+ * kept as a big-endian number too, so most compares are one integer
+ * compare that touches no line data */
+struct SortLine {
+    const char* data;
+    size_t size;
+    uint64_t prefix;
+};
+
+struct SortOptions {
+    bool is_reversed;       // -r
+    bool is_unique;         // -u
+};
+
+struct SortStats {
+    unsigned long long lines_count;
+    unsigned long long bytes_count;
+    // runs spilled to temporary files
+    unsigned long long runs_count;
+    unsigned long long spilled_bytes_count;
+    long long read_ms;
+    long long sort_ms;
+    long long spill_ms;
+    long long merge_ms;
+};
+
+/* sets up the line and its key */
+void makeSortLine(const char* data, size_t size, SortLine& line);
+
+/* the byte order of LC_ALL=C sort(1), -1, 0 or 1 */
+int compareSortLines(const SortLine& first, const SortLine& second);
+
+/* sorts the lines in byte order with an MSD radix sort, a byte of the line
+ * per pass, down to small groups that are left to std::sort. scratch has
+ * room for count lines */
+void radixSortLines(SortLine* lines, size_t count, SortLine* scratch);
+
+/* sorts the lines, by threads_count threads that each radix sort a part and
+ * then merge the parts in pairs */
+void sortLinesInParallel(std::vector<SortLine>& lines,
+                         const SortOptions& options, int threads_count);
+
+/* A source of lines in sorted order, for the merge. The line it returns is
+ * valid until the next call */
+class SortedRun {
+public:
+    // destructor
+    virtual ~SortedRun() {}
+
+    // returns false when the run is over, or reading it failed
+    virtual bool next(SortLine& line) = 0;
+
+    virtual bool hasFailed() const;
+};
+
+/* A run that is still in memory, the last one read */
+class MemoryRun : public SortedRun {
+    const std::vector<SortLine>& lines;
+    size_t next_index;
+
+public:
+    // constructor
+    explicit MemoryRun(const std::vector<SortLine>& lines);
+
+    bool next(SortLine& line) override;
+};
+
+/* A run spilled to an unlinked temporary file, read back a block at a
+ * time. Owns the fd */
+class FileRun : public SortedRun {
+    int fd;
+    std::string buff;
+    size_t pos;
+    bool is_at_end;
+    bool has_failed;
+
+public:
+    // constructor
+    explicit FileRun(int fd);
+
+    // destructor
+    ~FileRun();
+
+    // disable copy ctor
+    FileRun(FileRun const&) = delete;
+
+    // disable = operator
+    void operator=(FileRun const&) = delete;
+
+    bool next(SortLine& line) override;
+
+    bool hasFailed() const override;
+};
+
+/* Merges k sorted runs with a tree of losers: every inner node keeps the
+ * run that lost the match played there, and the winner is above the root.
+ * Taking the next line replays only the matches on the winner's path to
+ * the root, log2(k) compares instead of k */
+class LoserTree {
+    std::vector<SortedRun*> runs;
+    SortOptions options;
+    std::vector<SortLine> heads;
+    std::vector<bool> is_over;
+    // tree[0] is the winner, tree[1..k) the losers
+    std::vector<size_t> tree;
+    // the winner's head went out, its run moves on at the next call
+    bool is_winner_taken;
+
+    // true if run first's head goes out before run second's
+    bool isBefore(size_t first, size_t second) const;
+    // replays the matches from the leaf of run up to the root
+    void replay(size_t run);
+
+public:
+    // constructor
+    LoserTree(const std::vector<SortedRun*>& runs, const SortOptions& options);
+
+    // returns false when all runs are over
+    bool next(SortLine& line);
+};
+
+/* a new unlinked temporary file in dir, -1 if it couldn't be made */
+int openTemporaryFile(const std::string& dir);
+
+#endif //HW1_SORT_H
@@ -1,29 +1,38 @@
 #include "SpecialCommand.h"
+#include "Compression.h"
 
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
 #include <fcntl.h>
 #include <cstring>
 
 SpecialCommand::SpecialCommand(std::string cmd_line)
-    : Command(cmd_line), isBgCommand(_isBackgroundCommand(cmd_line)),
-      bash_path("/bin/bash"), bash_flag("-c") {}
+    : Command(cmd_line), isBgCommand(_isBackgroundCommand(cmd_line)) {}
 
 void SpecialCommand::handleChildProccess(pid_t child_pid) {
     SmallShell& smash = SmallShell::getInstance();
     int status;
+
+    // the child also does it, whichever runs first. Otherwise a signal sent
+    // to the new job right away could miss its proccess group
+    setpgid(child_pid, child_pid);
+    smash.armJobDeadline(child_pid);
     if (isBgCommand) {
         if (waitpid(child_pid, &status, WNOHANG) == child_pid){
             // child proccess failed
             checkChildExitStatus(status);
         }
         // new job, never been in job list before
+        smash.last_bg_pid = child_pid;
         // putting the whole redirection cmd in list (so we have full cmd line)
-        smash.jobs.addJob(this, child_pid, BG);
+        int jobID = smash.jobs.addJob(this, child_pid, BG);
+        smash.attachJobCapture(jobID);
         return;
     }
     // otherwise the child runs in fg and smash waits
     smash.updateFgCommandInfo(this, child_pid);
-    int result = waitpid(smash.fg_pid, &status, WUNTRACED);
+    int result = smash.waitForFgProccess(smash.fg_pid, &status);
     if (result == -1){ // waitpid failed
         perror("smash error: waitpid failed");
         throw SystemCallFail();
@@ -37,6 +46,7 @@ void SpecialCommand::handleChildProccess(pid_t child_pid) {
     }
     // we get here if child and waitpid were successful
     // delete smash.fg_cmd;
+    smash.clearJobDeadline(child_pid);
     smash.resetFgCommandInfo();
 }
 
@@ -51,7 +61,7 @@ PipeCommand::PipeCommand(std::string cmd_line)
 
 RedirectionCommand::RedirectionCommand(std::string cmd_line)
     : SpecialCommand(cmd_line), file_name(""), cmd_line_to_run(""), flags(0),
-      fd_output_file(-1) {}
+      fd_output_file(-1), is_compressed(false) {}
 
 CopyCommand::CopyCommand(std::string cmd_line)
     : SpecialCommand(cmd_line), src_file_path(""), dest_file_path(""),
@@ -60,7 +70,8 @@ CopyCommand::CopyCommand(std::string cmd_line)
 //----------------------------------------------------------------------------
 
 std::string RedirectionCommand::getOutputFileName() {
-    size_t right_side_start_pos = cmd_line.find_last_of('>') + 1;
+    size_t right_side_start_pos =
+            _findOutsideSubstitutions(cmd_line, ">", true) + 1;
 
     std::string right_side = cmd_line.substr(right_side_start_pos);
 
@@ -74,12 +85,14 @@ std::string RedirectionCommand::getOutputFileName() {
 }
 
 std::string RedirectionCommand::getCmdLineToRun() {
-    std::string cmd_line_to_run = cmd_line.substr(0, cmd_line.find('>'));
+    std::string cmd_line_to_run =
+            cmd_line.substr(0, _findOutsideSubstitutions(cmd_line, ">"));
     return _trim(cmd_line_to_run);
 }
 
 int RedirectionCommand::getOpeningFileFlags() {
-    bool is_redirection_appending = (cmd_line.find(">>") != std::string::npos);
+    bool is_redirection_appending =
+            (_findOutsideSubstitutions(cmd_line, ">>") != std::string::npos);
 
     int flags;
     if (!is_redirection_appending) {
@@ -97,79 +110,176 @@ void RedirectionCommand::prepare() {
     file_name = getOutputFileName();
     cmd_line_to_run = getCmdLineToRun();
     flags = getOpeningFileFlags();
+
+    // ">> gz:file" appends a new gzip member, gunzip reads them all
+    if (file_name.compare(0, compressed_target_prefix.size(),
+                          compressed_target_prefix) == 0) {
+        is_compressed = true;
+        file_name = file_name.substr(compressed_target_prefix.size());
+    }
 }
 
-SmallShellNextState RedirectionCommand::doRedirectionInSmash() {
-    SmallShell& smash = SmallShell::getInstance();
-    Command* cmd = smash.createCommand(cmd_line_to_run);
+static void runCompressor(int in_fd, int out_fd) {
+    if (!compressStream(in_fd, out_fd)) {
+        perror("smash error: write failed");
+        _exit(WRITE_FAILED);
+    }
+    _exit(0);
+}
 
-    // saving STDOUT in another FTD entry, so we can recover it later
-    int std_out = dup(STDOUT_FILENO);
-    if (std_out == -1) {
-        perror("smash error: dup failed");
+static void waitForCompressor(pid_t compressor_pid) {
+    if (compressor_pid == -1) {
+        return;
+    }
+    TRACE_SPAN("waitpid");
+    int status;
+    if (waitpid(compressor_pid, &status, 0) == -1) {
+        perror("smash error: waitpid failed");
         throw SystemCallFail();
     }
-    fd_output_file = open(file_name.c_str(), flags, 0666);
-    if (fd_output_file == -1) {
-        perror("smash error: open failed");
-        close(std_out);
+    checkChildExitStatus(status);
+}
+
+pid_t RedirectionCommand::startCompressorProccess() {
+    int pipe_fd[2];
+    if (pipe2(pipe_fd, O_CLOEXEC) == -1) {
+        perror("smash error: pipe failed");
+        close(fd_output_file);
         throw SystemCallFail();
     }
-    // we want STDOUT entry to point to output file obj
-    if (dup2(fd_output_file, STDOUT_FILENO) == -1) {
-        perror("smash error: dup2 failed");
-        close(std_out);
+
+    SmallShell::getInstance().stats.count(STATS_FORKS);
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("smash error: fork failed");
+        close(pipe_fd[0]);
+        close(pipe_fd[1]);
         close(fd_output_file);
         throw SystemCallFail();
     }
-    // no need for the open entry of fd_output_file after duplication
-    if (close(fd_output_file) == -1) {
-        perror("smash error: close failed");
-        dup2(std_out, STDOUT_FILENO);
-        close(std_out);
+    if (pid == 0) { // compressor proccess
+        // out of the terminal's signals, it is done once the pipe is
+        changeGroupID();
+        close(pipe_fd[1]);
+        runCompressor(pipe_fd[0], fd_output_file);
+    }
+
+    close(pipe_fd[0]);
+    close(fd_output_file);
+    fd_output_file = pipe_fd[1];
+    return pid;
+}
+
+void RedirectionCommand::runCompressedFromSon() {
+    int pipe_fd[2];
+    if (pipe(pipe_fd) == -1) {
+        perror("smash error: pipe failed");
+        _exit(PIPE_FAILED);
+    }
+
+    SmallShell::getInstance().stats.count(STATS_FORKS);
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("smash error: fork failed");
+        _exit(FORK_FAILED);
+    }
+    if (pid == 0) { // grandchild, runs the cmd in the job's group
+        if (dup2(pipe_fd[1], STDOUT_FILENO) == -1) {
+            perror("smash error: dup2 failed");
+            _exit(DUP2_FAILED);
+        }
+        if (close(pipe_fd[0]) == -1 || close(pipe_fd[1]) == -1
+            || close(fd_output_file) == -1) {
+            perror("smash error: close failed");
+            _exit(CLOSE_FAILED);
+        }
+        execCommandLine(cmd_line_to_run);
+    }
+
+    // the son compresses, so smash sees the job done only once the file is
+    SmallShell::getInstance().launch_timer.closeExecReport();
+    close(pipe_fd[1]);
+    if (!compressStream(pipe_fd[0], fd_output_file)) {
+        perror("smash error: write failed");
+        _exit(WRITE_FAILED);
+    }
+    int status;
+    if (waitpid(pid, &status, 0) == -1) {
+        _exit(0);
+    }
+    checkGrandChildExitStatus(status);
+    _exit(getExitStatus(status));
+}
+
+SmallShellNextState RedirectionCommand::doRedirectionInSmash() {
+    SmallShell& smash = SmallShell::getInstance();
+    Command* cmd = smash.createCommand(cmd_line_to_run);
+    if (cmd == nullptr) {
+        return CONTINUE_RUNNING;
+    }
+
+    // the built-in is just given the file to print into, smash's own STDOUT
+    // is never touched
+    fd_output_file = open(file_name.c_str(), flags | O_CLOEXEC, 0666);
+    if (fd_output_file == -1) {
+        perror("smash error: open failed");
         throw SystemCallFail();
     }
+    pid_t compressor_pid = -1;
+    if (is_compressed) {
+        compressor_pid = startCompressorProccess();
+    }
+    OutputSink file_sink(fd_output_file);
+    cmd->out = &file_sink;
+    cmd->err = err;
 
     SmallShellNextState smash_next_state;
-
     try {
         smash_next_state = cmd->execute();
     } catch (ExecutionFail& execution_fail) {
-        dup2(std_out, STDOUT_FILENO);
-        close(std_out);
+        file_sink.flush();
+        close(fd_output_file);
+        cmd->out = out;
+        waitForCompressor(compressor_pid);
         throw execution_fail;
     }
 
-    // recover STDOUT entry original state
-    if (dup2(std_out, STDOUT_FILENO) == -1) {
-        perror("smash error: dup2 failed");
-        throw SystemCallFail();
-    }
-    if (close(std_out) == -1) {
+    // the cmd may live on as a job, after file_sink is gone
+    cmd->out = out;
+    file_sink.flush();
+    if (close(fd_output_file) == -1) {
         perror("smash error: close failed");
         throw SystemCallFail();
     }
+    // the file is complete once the next command runs
+    waitForCompressor(compressor_pid);
 
     return smash_next_state;
 }
 
 SmallShellNextState RedirectionCommand::doRedirectionOfExternalCmd() {
-    char* cmd_line_for_bash = const_cast<char*>(cmd_line_to_run.c_str());
-    char* const args[] = {bash_path, bash_flag, cmd_line_for_bash, NULL};
-
+    SmallShell& smash = SmallShell::getInstance();
+    smash.launch_timer.openExecReport();
+    long long fork_start_ns = monotonicTimeNs();
+    smash.stats.count(STATS_FORKS);
     pid_t pid = fork();
 
     if (pid == -1) {
+        smash.launch_timer.closeExecReport();
         perror("smash error: fork failed");
         throw SystemCallFail();
     }
     if (pid == 0){ // child proccess
         changeGroupID();
+        smash.prepareJobProccess(isBgCommand);
         fd_output_file = open(file_name.c_str(), flags, 0666);
         if (fd_output_file == -1) {
             perror("smash error: open failed");
             _exit(OPEN_FAILED);
         }
+        if (is_compressed) {
+            runCompressedFromSon();
+        }
         if (dup2(fd_output_file, STDOUT_FILENO) == -1){
             perror("smash error: dup2 failed");
             _exit(DUP2_FAILED);
@@ -177,10 +287,11 @@ SmallShellNextState RedirectionCommand::doRedirectionOfExternalCmd() {
         if (close(fd_output_file) == -1) {
             _exit(CLOSE_FAILED);
         }
-        execv(args[0], args);
-        perror("smash error: execv failed");
-        _exit(COMMAND_NOT_RUNNABLE);
+        execCommandLine(cmd_line_to_run);
     } else { // smash proccess
+        TRACE_SINCE("fork", fork_start_ns);
+        smash.launch_timer.addPhase(LAUNCH_FORK, fork_start_ns);
+        smash.launch_timer.waitForExecs(monotonicTimeNs());
         handleChildProccess(pid);
     }
 
@@ -188,7 +299,11 @@ SmallShellNextState RedirectionCommand::doRedirectionOfExternalCmd() {
 }
 
 SmallShellNextState RedirectionCommand::execute() {
+    SmallShell& smash = SmallShell::getInstance();
+    long long parse_start_ns = monotonicTimeNs();
     prepare();
+    smash.launch_timer.addPhase(LAUNCH_PARSE, parse_start_ns);
+    smash.stats.curr_execution_path = EXEC_PATH_REDIRECTION;
     if (file_name.empty() || cmd_line_to_run.empty()) {
         // file path or inner cmd don't appear in cmd_line
         return CONTINUE_RUNNING;
@@ -206,15 +321,17 @@ SmallShellNextState RedirectionCommand::execute() {
 //----------------------------------------------------------------------------
 
 std::string PipeCommand::getPipeLeftCommand() {
-    return _trim(cmd_line.substr(0,cmd_line.find('|')));
+    return _trim(cmd_line.substr(0,
+            _findOutsideSubstitutions(cmd_line, "|")));
 }
 
 std::string PipeCommand::getPipeRightCommand() {
     std::string right_cmd;
-    if (cmd_line.find("|&") != std::string::npos) {
-        right_cmd = cmd_line.substr(cmd_line.find('&')+1);
+    size_t pipe_pos = _findOutsideSubstitutions(cmd_line, "|");
+    if (cmd_line.compare(pipe_pos, 2, "|&") == 0) {
+        right_cmd = cmd_line.substr(pipe_pos + 2);
     } else {
-        right_cmd = cmd_line.substr(cmd_line.find('|')+1);
+        right_cmd = cmd_line.substr(pipe_pos + 1);
     }
 
     right_cmd = _trim(right_cmd);
@@ -226,14 +343,15 @@ void PipeCommand::prepare() {
     left_cmd_line = getPipeLeftCommand();
     right_cmd_line = getPipeRightCommand();
 
-    if (cmd_line.find("|&") != std::string::npos) {
+    size_t pipe_pos = _findOutsideSubstitutions(cmd_line, "|");
+    if (cmd_line.compare(pipe_pos, 2, "|&") == 0) {
         output_channel = STDERR_FILENO;
     } else {
         output_channel = STDOUT_FILENO;
     }
 }
 
-void PipeCommand::runPipeFromSon() {
+int PipeCommand::runPipeFromSon() {
     SmallShell& smash = SmallShell::getInstance();
 
     if (pipe(pipe_fd) == -1) {
@@ -241,6 +359,7 @@ void PipeCommand::runPipeFromSon() {
         _exit(PIPE_FAILED);
     }
 
+    smash.stats.count(STATS_FORKS);
     writing_proccess_pid = fork();
     if (writing_proccess_pid == -1) {
         perror("smash error: fork failed");
@@ -258,26 +377,27 @@ void PipeCommand::runPipeFromSon() {
             _exit(CLOSE_FAILED);
         }
         if (isBuiltInCommand(left_cmd_line)) {
+            smash.launch_timer.closeExecReport();
             Command* left_cmd = smash.createCommand(left_cmd_line);
-            if (left_cmd_line.find("cp ") == 0) {
-                left_cmd->execute_without_fork = true;
-            }
+            // forking built-ins run inside this son instead of forking again
+            left_cmd->execute_without_fork = true;
             try {
                 left_cmd->execute();
             } catch (ExecutionFail& e) {
+                left_cmd->out->flush();
+                left_cmd->err->flush();
                 _exit(0);
             }
+            left_cmd->out->flush();
+            left_cmd->err->flush();
             _exit(0);
         } else { // left cmd is external
-            char* cmd_line_for_bash = const_cast<char*>(left_cmd_line.c_str());
-            char* const args[] = {bash_path, bash_flag, cmd_line_for_bash, NULL};
-            execv(args[0], args);
-            perror("smash error: execv failed");
-            _exit(COMMAND_NOT_RUNNABLE);
+            execCommandLine(left_cmd_line);
         }
     }
     // first son
 
+    smash.stats.count(STATS_FORKS);
     reading_proccess_pid = fork();
     if (reading_proccess_pid == -1) {
         perror("smash error: fork failed");
@@ -294,51 +414,128 @@ void PipeCommand::runPipeFromSon() {
             _exit(CLOSE_FAILED);
         }
         if (isBuiltInCommand(right_cmd_line)) {
+            smash.launch_timer.closeExecReport();
             Command* right_cmd = smash.createCommand(right_cmd_line);
-            if (right_cmd_line.find("cp ") == 0) {
-                right_cmd->execute_without_fork = true;
-            }
+            // forking built-ins run inside this son instead of forking again
+            right_cmd->execute_without_fork = true;
             try {
                 right_cmd->execute();
             } catch (ExecutionFail& e) {
-                _exit(0);
+                right_cmd->out->flush();
+                right_cmd->err->flush();
+                _exit(smash.is_exit_status_set ? smash.last_exit_status : 1);
             }
-            _exit(0);
+            right_cmd->out->flush();
+            right_cmd->err->flush();
+            // e.g. grep's 1 when nothing matched
+            _exit(smash.is_exit_status_set ? smash.last_exit_status : 0);
         } else { // right cmd is external
-            char* cmd_line_for_bash = const_cast<char*>(right_cmd_line.c_str());
-            char* const args[] = {bash_path, bash_flag, cmd_line_for_bash, NULL};
-            execv(args[0], args);
-            perror("smash error: execv failed");
-            _exit(COMMAND_NOT_RUNNABLE);
+            execCommandLine(right_cmd_line);
         }
     }
     // first son
+    smash.launch_timer.closeExecReport();
     close(pipe_fd[1]);
     close(pipe_fd[0]);
 
+    TRACE_SPAN("waitpid");
     waitpid(writing_proccess_pid, NULL, WUNTRACED);
-    waitpid(reading_proccess_pid, NULL, WUNTRACED);
+    int status;
+    if (waitpid(reading_proccess_pid, &status, WUNTRACED) == -1) {
+        return 0;
+    }
+    // like in bash, the pipe's exit status is the one of its right side
+    return getExitStatus(status);
+}
+
+bool PipeCommand::runPipeInSmash() {
+    if (!isBuiltInCommand(left_cmd_line) || !isBuiltInCommand(right_cmd_line)) {
+        return false;
+    }
+    SmallShell& smash = SmallShell::getInstance();
+    // the sons expand the lines again if the pipe forks after all
+    std::string left_line = left_cmd_line;
+    std::string right_line = right_cmd_line;
+    Command* left_cmd = smash.createCommand(left_line);
+    Command* right_cmd = smash.createCommand(right_line);
+    if (left_cmd == nullptr || right_cmd == nullptr
+        || !left_cmd->hasNoSideEffects() || !right_cmd->hasNoSideEffects()) {
+        delete left_cmd;
+        delete right_cmd;
+        return false;
+    }
+
+    // the left side's output is kept in memory, where the right side reads
+    // it from as its stdin
+    int memfd = memfd_create("smash-pipe", MFD_CLOEXEC);
+    if (memfd == -1) {
+        perror("smash error: memfd_create failed");
+        delete left_cmd;
+        delete right_cmd;
+        throw SystemCallFail();
+    }
+    OutputSink pipe_sink(memfd);
+    left_cmd->out = (output_channel == STDOUT_FILENO) ? &pipe_sink : out;
+    left_cmd->err = (output_channel == STDERR_FILENO) ? &pipe_sink : err;
+    try {
+        left_cmd->execute();
+    } catch (ExecutionFail& execution_fail) {
+        // like in bash, only the right side's status counts
+    }
+    pipe_sink.flush();
+    lseek(memfd, 0, SEEK_SET);
+
+    right_cmd->out = out;
+    right_cmd->err = err;
+    right_cmd->in_fd = memfd;
+    try {
+        right_cmd->execute();
+    } catch (ExecutionFail& execution_fail) {
+        close(memfd);
+        delete left_cmd;
+        delete right_cmd;
+        throw execution_fail;
+    }
+    close(memfd);
+    delete left_cmd;
+    delete right_cmd;
+    return true;
 }
 
 SmallShellNextState PipeCommand::execute() {
+    SmallShell& smash = SmallShell::getInstance();
+    long long parse_start_ns = monotonicTimeNs();
     prepare();
+    smash.launch_timer.addPhase(LAUNCH_PARSE, parse_start_ns);
+    smash.stats.curr_execution_path = EXEC_PATH_PIPE;
     if (left_cmd_line.empty() || right_cmd_line.empty()) {
         return CONTINUE_RUNNING;
     }
+    if (!isBgCommand && runPipeInSmash()) {
+        return CONTINUE_RUNNING;
+    }
 
+    // the exec phase ends once both sides exec'd or exited
+    smash.launch_timer.openExecReport();
+    long long fork_start_ns = monotonicTimeNs();
+    smash.stats.count(STATS_FORKS);
     pid_t pid = fork();
 
     if (pid == -1) {
+        smash.launch_timer.closeExecReport();
         perror("smash error: fork failed");
         throw SystemCallFail();
     }
     if (pid == 0) { // first son proccess, runs pipe
         changeGroupID();
-        SmallShell& smash = SmallShell::getInstance();
+        smash.prepareJobProccess(isBgCommand);
+        useSinksAsStdio();
         smash.prev_wd_path = "";
-        runPipeFromSon();
-        _exit(0);
+        _exit(runPipeFromSon());
     } else { // original father
+        TRACE_SINCE("fork", fork_start_ns);
+        smash.launch_timer.addPhase(LAUNCH_FORK, fork_start_ns);
+        smash.launch_timer.waitForExecs(monotonicTimeNs());
         handleChildProccess(pid);
     }
 
@@ -348,7 +545,7 @@ SmallShellNextState PipeCommand::execute() {
 //----------------------------------------------------------------------------
 
 std::string CopyCommand::getSourceFilePath() {
-    auto args = _parseCommandLine(cmd_line);
+    auto args = getArgs();
     if (args.size() < 3) {
         perror("smash error: cp: invalid arguments");
         return "";
@@ -358,7 +555,7 @@ std::string CopyCommand::getSourceFilePath() {
 }
 
 std::string CopyCommand::getDestFilePath() {
-    auto args = _parseCommandLine(cmd_line);
+    auto args = getArgs();
     if (args.size() < 3) {
         return "";
     }
@@ -384,8 +581,8 @@ void CopyCommand::prepare() {
 }
 
 void CopyCommand::printCopyingMsg() {
-    std::cout << "smash: " << src_file_path << " was copied to "
-              << dest_file_path << std::endl;
+    *out << "smash: " << src_file_path << " was copied to " << dest_file_path
+         << '\n';
 }
 
 bool CopyCommand::doesFileExist(std::string& file_name) {
@@ -434,14 +631,22 @@ void CopyCommand::copySrcToDest() {
     ssize_t bytes_written_count;
     char buff[buff_size];
 
-    // zero indicates end of file
-    // -1 indicates error
-    while ((bytes_read_count = read(src_fd, buff, sizeof(buff))) > 0) {
+    while (true) {
+        TRACE_SPAN_VAR(chunk_span, "CopyCommand::copySrcToDest chunk");
+        // zero indicates end of file
+        // -1 indicates error
+        bytes_read_count = read(src_fd, buff, sizeof(buff));
+        if (bytes_read_count <= 0) {
+            break;
+        }
         bytes_written_count = write(dest_fd, buff, (size_t)bytes_read_count);
         if (bytes_written_count != bytes_read_count) {
             perror("smash error: write failed");
             _exit(WRITE_FAILED);
         }
+        TRACE_SPAN_ARG(chunk_span, bytes_written_count);
+        SmallShell::getInstance().stats.count(STATS_CP_BYTES,
+                                              bytes_written_count);
     }
 
     if (close(src_fd) == -1 || close(dest_fd) == -1) {
@@ -464,6 +669,9 @@ SmallShellNextState CopyCommand::execute() {
     }
 
     // otherwise, the copying is done in a child proccess
+    SmallShell& smash = SmallShell::getInstance();
+    smash.stats.count(STATS_FORKS);
+    long long fork_start_ns = monotonicTimeNs();
     pid_t pid = fork();
 
     if (pid == -1) {
@@ -472,10 +680,328 @@ SmallShellNextState CopyCommand::execute() {
     }
     if (pid == 0) { // child proccess
         changeGroupID();
+        smash.prepareJobProccess(isBgCommand);
         copySrcToDest();
         printCopyingMsg();
+        out->flush();
         _exit(0);
     } else { // smash proccess
+        TRACE_SINCE("fork", fork_start_ns);
+        smash.launch_timer.addPhase(LAUNCH_FORK, fork_start_ns);
+        handleChildProccess(pid);
+    }
+
+    return CONTINUE_RUNNING;
+}
+
+//----------------------------------------------------------------------------
+
+ParallelCommand::ParallelCommand(std::string cmd_line)
+    : SpecialCommand(cmd_line), max_in_flight(1), cmd_template(""),
+      are_items_raw(false), items_from_stdin(true), next_item_idx(0),
+      stdin_buff(""), stdin_buff_pos(0), stdin_eof(false),
+      failed_items_count(0) {}
+
+bool ParallelCommand::areArgsValid() {
+    auto args = _parseCommandLine(cmd_line);
+
+    long cpus_count = sysconf(_SC_NPROCESSORS_ONLN);
+    max_in_flight = cpus_count > 0 ? static_cast<int>(cpus_count) : 1;
+
+    // valid cmd format is "parallel [-j N] cmd {} [::: arg1 arg2 ...]"
+    size_t i = 1;
+    while (i < args.size() && (args[i] == "-j" || args[i] == "--jobs"
+                               || args[i].find("-j") == 0)) {
+        std::string jobs_str;
+        if (args[i] == "-j" || args[i] == "--jobs") {
+            if (i + 1 >= args.size()) {
+                return false;
+            }
+            jobs_str = args[i + 1];
+            i += 2;
+        } else {
+            jobs_str = args[i].substr(2);
+            i++;
+        }
+        if (jobs_str.empty() || !isStringOnlyDigits(jobs_str)) {
+            return false;
+        }
+        try {
+            max_in_flight = std::stoi(jobs_str, nullptr);
+        } catch (const std::out_of_range& oor) {
+            return false;
+        }
+        if (max_in_flight <= 0) {
+            return false;
+        }
+    }
+
+    for (; i < args.size() && args[i] != ":::"; i++) {
+        cmd_template += (cmd_template.empty() ? "" : " ") + args[i];
+    }
+    if (cmd_template.empty()) {
+        return false;
+    }
+
+    if (i < args.size()) {
+        // items are given after ":::" instead of being read from stdin.
+        // They are words like a command's args, "a b" is a single item
+        items_from_stdin = false;
+        std::string items_str = _removeFirstWords(cmd_line, i + 1);
+        std::vector<std::string> assignments, words;
+        if (expandCommandLine(items_str, assignments, words)) {
+            // "NAME=value" items are items too
+            items = assignments;
+            items.insert(items.end(), words.begin(), words.end());
+        } else {
+            // e.g. brace expansion, which is left for bash
+            items.assign(args.begin() + i + 1, args.end());
+            are_items_raw = true;
+        }
+    }
+
+    return true;
+}
+
+bool ParallelCommand::getNextItem(std::string& item) {
+    if (!items_from_stdin) {
+        if (next_item_idx >= items.size()) {
+            return false;
+        }
+        item = items[next_item_idx++];
+        return true;
+    }
+
+    // items are read from stdin one line at a time, so launching starts
+    // before the producer of the items finished
+    while (true) {
+        size_t line_end = stdin_buff.find('\n', stdin_buff_pos);
+        if (line_end != std::string::npos || (stdin_eof
+            && stdin_buff_pos < stdin_buff.size())) {
+            if (line_end == std::string::npos) {
+                line_end = stdin_buff.size();
+            }
+            item = _trim(stdin_buff.substr(stdin_buff_pos,
+                                           line_end - stdin_buff_pos));
+            stdin_buff_pos = line_end + 1;
+            if (item.empty()) {
+                continue;
+            }
+            return true;
+        }
+        if (stdin_eof) {
+            return false;
+        }
+
+        // drop the consumed lines before reading more
+        stdin_buff.erase(0, stdin_buff_pos);
+        stdin_buff_pos = 0;
+
+        char buff[buff_size];
+        ssize_t bytes_read_count = read(STDIN_FILENO, buff, sizeof(buff));
+        if (bytes_read_count == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("smash error: read failed");
+            stdin_eof = true;
+        } else if (bytes_read_count == 0) {
+            stdin_eof = true;
+        } else {
+            stdin_buff.append(buff, (size_t)bytes_read_count);
+        }
+    }
+}
+
+std::string ParallelCommand::buildItemCmdLine(const std::string& item) {
+    // every "{}" is replaced by the item, if there is none the item is
+    // appended as the last argument. Quoted, so it stays a single word
+    // whatever it contains
+    std::string quoted_item = are_items_raw ? item : quoteWord(item);
+    if (cmd_template.find("{}") == std::string::npos) {
+        return cmd_template + " " + quoted_item;
+    }
+
+    std::string item_cmd_line;
+    size_t pos = 0;
+    size_t placeholder_pos;
+    while ((placeholder_pos = cmd_template.find("{}", pos))
+           != std::string::npos) {
+        item_cmd_line.append(cmd_template, pos, placeholder_pos - pos);
+        item_cmd_line += quoted_item;
+        pos = placeholder_pos + 2;
+    }
+    item_cmd_line.append(cmd_template, pos, std::string::npos);
+
+    return item_cmd_line;
+}
+
+void ParallelCommand::launchItem(const std::string& item) {
+    std::string item_cmd_line = buildItemCmdLine(item);
+
+    RunningItem running_item;
+    running_item.out_fd = memfd_create("smash-parallel-out", MFD_CLOEXEC);
+    running_item.err_fd = memfd_create("smash-parallel-err", MFD_CLOEXEC);
+    if (running_item.out_fd == -1 || running_item.err_fd == -1) {
+        perror("smash error: memfd_create failed");
+        _exit(OPEN_FAILED);
+    }
+
+    SmallShell::getInstance().stats.count(STATS_FORKS);
+    running_item.pid = fork();
+    if (running_item.pid == -1) {
+        perror("smash error: fork failed");
+        _exit(FORK_FAILED);
+    }
+    if (running_item.pid == 0) {
+        // no changing of groupID, so the whole run is one job
+        if (items_from_stdin) {
+            // the items must not be consumed by the item commands
+            int null_fd = open("/dev/null", O_RDONLY);
+            if (null_fd == -1 || dup2(null_fd, STDIN_FILENO) == -1) {
+                perror("smash error: open failed");
+                _exit(OPEN_FAILED);
+            }
+            close(null_fd);
+        }
+        if (dup2(running_item.out_fd, STDOUT_FILENO) == -1
+            || dup2(running_item.err_fd, STDERR_FILENO) == -1) {
+            perror("smash error: dup2 failed");
+            _exit(DUP2_FAILED);
+        }
+        execCommandLine(item_cmd_line);
+    }
+
+    running_items.push_back(running_item);
+}
+
+void ParallelCommand::dumpItemOutput(int src_fd, int dest_fd) {
+    off_t offset = 0;
+    struct stat file_stat;
+    if (fstat(src_fd, &file_stat) == -1) {
+        perror("smash error: fstat failed");
+        return;
+    }
+
+    while (offset < file_stat.st_size) {
+        ssize_t bytes_sent_count = sendfile(dest_fd, src_fd, &offset,
+                (size_t)(file_stat.st_size - offset));
+        if (bytes_sent_count > 0) {
+            continue;
+        }
+        if (bytes_sent_count == -1 && errno == EINTR) {
+            continue;
+        }
+        if (bytes_sent_count == -1 && errno != EINVAL && errno != ENOSYS) {
+            perror("smash error: sendfile failed");
+            return;
+        }
+
+        // sendfile is not supported for the destination, copy by hand
+        char buff[buff_size];
+        ssize_t bytes_read_count;
+        while ((bytes_read_count = pread(src_fd, buff, sizeof(buff),
+                                         offset)) > 0) {
+            if (write(dest_fd, buff, (size_t)bytes_read_count)
+                != bytes_read_count) {
+                perror("smash error: write failed");
+                return;
+            }
+            offset += bytes_read_count;
+        }
+        return;
+    }
+}
+
+void ParallelCommand::reapItem() {
+    TRACE_SPAN("waitpid");
+    int status;
+    pid_t pid = waitpid(-1, &status, 0);
+    if (pid == -1) {
+        if (errno == EINTR) {
+            return;
+        }
+        perror("smash error: waitpid failed");
+        _exit(WAITPID_FAILED);
+    }
+
+    for (auto it = running_items.begin(); it != running_items.end(); ++it) {
+        if (it->pid != pid) {
+            continue;
+        }
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            failed_items_count++;
+        }
+        dumpItemOutput(it->out_fd, STDOUT_FILENO);
+        dumpItemOutput(it->err_fd, STDERR_FILENO);
+        close(it->out_fd);
+        close(it->err_fd);
+        running_items.erase(it);
+        return;
+    }
+}
+
+int ParallelCommand::runItems() {
+    std::string item;
+    bool has_more_items = true;
+
+    // keep exactly max_in_flight items running until the items run out
+    while (has_more_items || !running_items.empty()) {
+        while (has_more_items
+               && running_items.size() < (size_t)max_in_flight) {
+            has_more_items = getNextItem(item);
+            if (has_more_items) {
+                launchItem(item);
+            }
+        }
+        if (!running_items.empty()) {
+            reapItem();
+        }
+    }
+
+    // like GNU parallel, the exit value is the number of failed items
+    return failed_items_count > 101 ? 101 : failed_items_count;
+}
+
+void ParallelCommand::prepare() {
+    _removeBackgroundSign(cmd_line);
+}
+
+SmallShellNextState ParallelCommand::execute() {
+    prepare();
+    if (!areArgsValid()) {
+        *err << "smash error: parallel: invalid arguments" << '\n';
+        throw CommandFail();
+    }
+
+    // happens if the parallel is part of a pipe, whose son exits with the
+    // number of failed items like the forked run does
+    if (execute_without_fork) {
+        int exit_status = runItems();
+        out->flush();
+        err->flush();
+        _exit(exit_status);
+    }
+
+    // otherwise, the items are run from a child proccess, so the whole run
+    // is a single job in smash
+    SmallShell& smash = SmallShell::getInstance();
+    smash.stats.count(STATS_FORKS);
+    long long fork_start_ns = monotonicTimeNs();
+    pid_t pid = fork();
+
+    if (pid == -1) {
+        perror("smash error: fork failed");
+        throw SystemCallFail();
+    }
+    if (pid == 0) { // child proccess
+        changeGroupID();
+        smash.prepareJobProccess(isBgCommand);
+        useSinksAsStdio();
+        _exit(runItems());
+    } else { // smash proccess
+        TRACE_SINCE("fork", fork_start_ns);
+        smash.launch_timer.addPhase(LAUNCH_FORK, fork_start_ns);
         handleChildProccess(pid);
     }
 
@@ -9,8 +9,6 @@ const int buff_size = 4096;
 class SpecialCommand : public Command {
 protected:
     bool isBgCommand;
-    char bash_path[bash_path_length];
-    char bash_flag[bash_flag_length];
     void handleChildProccess(pid_t child_pid);
 
     virtual void prepare() = 0;
@@ -24,10 +22,18 @@ class RedirectionCommand : public SpecialCommand {
     std::string cmd_line_to_run;
     int flags;
     int fd_output_file;
+    // the target had the "gz:" prefix, output is written gzip compressed
+    bool is_compressed;
 
     std::string getOutputFileName();
     std::string getCmdLineToRun();
     int getOpeningFileFlags();
+    // forks a proccess compressing into fd_output_file, which is replaced
+    // by the write end of a pipe into it. Returns its pid
+    pid_t startCompressorProccess();
+    // in the child: runs the cmd in a grandchild and compresses its output
+    // into fd_output_file meanwhile. Exits with the cmd's exit status
+    void runCompressedFromSon();
     SmallShellNextState doRedirectionInSmash();
     SmallShellNextState doRedirectionOfExternalCmd();
 
@@ -49,7 +55,11 @@ class PipeCommand : public SpecialCommand {
 
     std::string getPipeLeftCommand();
     std::string getPipeRightCommand();
-    void runPipeFromSon();
+    // returns the exit status of the pipe
+    int runPipeFromSon();
+    // runs a pipe of built-ins that change nothing in smash inside smash,
+    // with no forks. Returns false if the pipe isn't such a pipe
+    bool runPipeInSmash();
 
     void prepare() override;
 public:
@@ -81,5 +91,41 @@ public:
     SmallShellNextState execute() override;
 };
 
+class ParallelCommand : public SpecialCommand {
+    struct RunningItem {
+        pid_t pid;
+        // per item anonymous files collecting its output, so lines of
+        // different items do not interleave
+        int out_fd;
+        int err_fd;
+    };
+
+    int max_in_flight;
+    std::string cmd_template;
+    std::vector<std::string> items;
+    // items the expander left for bash are pasted as typed, not quoted
+    bool are_items_raw;
+    bool items_from_stdin;
+    size_t next_item_idx;
+    std::string stdin_buff;
+    size_t stdin_buff_pos;
+    bool stdin_eof;
+    std::vector<RunningItem> running_items;
+    int failed_items_count;
+
+    bool areArgsValid();
+    bool getNextItem(std::string& item);
+    std::string buildItemCmdLine(const std::string& item);
+    void launchItem(const std::string& item);
+    void reapItem();
+    void dumpItemOutput(int src_fd, int dest_fd);
+    int runItems();
+
+    void prepare() override;
+public:
+    explicit ParallelCommand(std::string cmd_line);
+
+    SmallShellNextState execute() override;
+};
 
 #endif //HW1_SPECIALCOMMAND_H
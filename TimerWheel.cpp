@@ -0,0 +1,137 @@
+#include "TimerWheel.h"
+
+TimerWheel::TimerWheel(long long now_ms)
+        : current_tick(now_ms / timer_wheel_tick_ms), max_timer_id(0) {}
+
+void TimerWheel::insertTimer(Timer& timer) {
+    long long ticks_left = timer.expire_tick - current_tick;
+    long long slot_tick = timer.expire_tick;
+    int level = 0;
+    while (level < LEVELS_COUNT - 1
+           && ticks_left >= (1LL << (SLOT_BITS * (level + 1)))) {
+        level++;
+    }
+    if (ticks_left >= (1LL << (SLOT_BITS * LEVELS_COUNT))) {
+        // beyond the wheel's range, parked in the farthest slot and placed
+        // again once it cascades from there
+        slot_tick = current_tick + (1LL << (SLOT_BITS * LEVELS_COUNT)) - 1;
+    }
+
+    Slot& slot = slots[level][(slot_tick >> (SLOT_BITS * level)) & SLOT_MASK];
+    slot.push_back(timer);
+
+    TimerLocation location;
+    location.slot = &slot;
+    location.it = --slot.end();
+    timers_by_id[timer.timer_id] = location;
+}
+
+int TimerWheel::add(long long expire_ms, Callback callback) {
+    Timer timer;
+    timer.timer_id = ++max_timer_id;
+    // rounded up, so a timer never runs before expire_ms
+    timer.expire_tick = (expire_ms + timer_wheel_tick_ms - 1)
+                        / timer_wheel_tick_ms;
+    timer.callback = callback;
+    // the slot of the current tick was already run, a timer that is due
+    // runs on the next tick
+    if (timer.expire_tick <= current_tick) {
+        timer.expire_tick = current_tick + 1;
+    }
+
+    insertTimer(timer);
+    return timer.timer_id;
+}
+
+void TimerWheel::cancel(int timer_id) {
+    auto it = timers_by_id.find(timer_id);
+    if (it == timers_by_id.end()) {
+        return;
+    }
+    it->second.slot->erase(it->second.it);
+    timers_by_id.erase(it);
+}
+
+void TimerWheel::cascadeSlot(int level, long long slot_idx) {
+    Slot cascaded_timers;
+    cascaded_timers.swap(slots[level][slot_idx]);
+
+    for (auto& timer : cascaded_timers) {
+        insertTimer(timer);
+    }
+}
+
+void TimerWheel::expireTick(std::vector<Callback>& expired_callbacks) {
+    // when a level completes a turn, the next slot of the level above it
+    // moves down
+    for (int level = 1; level < LEVELS_COUNT; level++) {
+        long long lower_idx = (current_tick >> (SLOT_BITS * (level - 1)))
+                              & SLOT_MASK;
+        if (lower_idx != 0) {
+            break;
+        }
+        cascadeSlot(level, (current_tick >> (SLOT_BITS * level)) & SLOT_MASK);
+    }
+
+    Slot& slot = slots[0][current_tick & SLOT_MASK];
+    for (auto it = slot.begin(); it != slot.end(); ) {
+        if (it->expire_tick > current_tick) {
+            ++it;
+            continue;
+        }
+        expired_callbacks.push_back(it->callback);
+        timers_by_id.erase(it->timer_id);
+        it = slot.erase(it);
+    }
+}
+
+long long TimerWheel::nextEventTick() {
+    long long next_tick = -1;
+
+    // the first tick something has to be done at: a level 0 slot running,
+    // or an upper level slot cascading
+    for (int level = 0; level < LEVELS_COUNT; level++) {
+        long long level_base = current_tick >> (SLOT_BITS * level);
+        for (long long slot_idx = 0; slot_idx < SLOTS_COUNT; slot_idx++) {
+            if (slots[level][slot_idx].empty()) {
+                continue;
+            }
+            long long turns_ahead = (slot_idx - level_base) & SLOT_MASK;
+            if (turns_ahead == 0) {
+                turns_ahead = SLOTS_COUNT;
+            }
+            long long tick = (level_base + turns_ahead) << (SLOT_BITS * level);
+            if (next_tick == -1 || tick < next_tick) {
+                next_tick = tick;
+            }
+        }
+    }
+
+    return next_tick;
+}
+
+void TimerWheel::advance(long long now_ms,
+                         std::vector<Callback>& expired_callbacks) {
+    long long now_tick = now_ms / timer_wheel_tick_ms;
+
+    // jumps straight between ticks that have work, an idle wheel isn't
+    // turned tick by tick
+    while (current_tick < now_tick) {
+        long long next_tick = nextEventTick();
+        if (next_tick == -1 || next_tick > now_tick) {
+            current_tick = now_tick;
+            break;
+        }
+        current_tick = next_tick;
+        expireTick(expired_callbacks);
+    }
+}
+
+long long TimerWheel::nextWakeupMs() {
+    long long next_tick = nextEventTick();
+    return next_tick == -1 ? -1 : next_tick * timer_wheel_tick_ms;
+}
+
+bool TimerWheel::isEmpty() {
+    return timers_by_id.empty();
+}
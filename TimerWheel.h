@@ -0,0 +1,68 @@
+#ifndef HW1_TIMERWHEEL_H
+#define HW1_TIMERWHEEL_H
+
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+const long long timer_wheel_tick_ms = 10;
+
+/* Hierarchical timer wheel, like the one of the Linux kernel. Level 0 has a
+ * slot per tick, every upper level has a slot per a whole turn of the level
+ * below it, and its timers cascade down when their slot comes. Adding and
+ * cancelling a timer are O(1) no matter how many timers there are */
+class TimerWheel {
+public:
+    typedef std::function<void()> Callback;
+
+private:
+    static const int LEVELS_COUNT = 4;
+    static const int SLOT_BITS = 6;
+    static const int SLOTS_COUNT = 1 << SLOT_BITS;
+    static const long long SLOT_MASK = SLOTS_COUNT - 1;
+
+    struct Timer {
+        int timer_id;
+        long long expire_tick;
+        Callback callback;
+    };
+
+    typedef std::list<Timer> Slot;
+
+    struct TimerLocation {
+        Slot* slot;
+        Slot::iterator it;
+    };
+
+    Slot slots[LEVELS_COUNT][SLOTS_COUNT];
+    std::unordered_map<int, TimerLocation> timers_by_id;
+    long long current_tick;
+    int max_timer_id;
+
+    void insertTimer(Timer& timer);
+    void cascadeSlot(int level, long long slot_idx);
+    void expireTick(std::vector<Callback>& expired_callbacks);
+    long long nextEventTick();
+
+public:
+    // constructor
+    explicit TimerWheel(long long now_ms);
+
+    // callback should run once now_ms reaches expire_ms, returns an ID for
+    // cancel
+    int add(long long expire_ms, Callback callback);
+
+    void cancel(int timer_id);
+
+    // turns the wheel up to now_ms, collecting the callbacks of the expired
+    // timers in the order they expired
+    void advance(long long now_ms, std::vector<Callback>& expired_callbacks);
+
+    // the time the wheel should be turned at next, -1 if it has no timers
+    long long nextWakeupMs();
+
+    bool isEmpty();
+};
+
+#endif //HW1_TIMERWHEEL_H
@@ -0,0 +1,165 @@
+#include "Tracing.h"
+
+#include <cstdio>
+#include <new>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "OutputSink.h"
+#include "utilities.h"
+
+// ids of the calling thread, cached. A forked son drops them
+static thread_local TraceRing* thread_ring = nullptr;
+static thread_local int thread_pid = 0;
+static thread_local int thread_tid = 0;
+
+static void forgetIdsInSon() {
+    thread_pid = 0;
+    thread_tid = 0;
+}
+
+Tracer::Tracer() : is_enabled(false) {
+    pthread_atfork(nullptr, nullptr, forgetIdsInSon);
+}
+
+Tracer& Tracer::getInstance() {
+    static Tracer instance;
+    return instance;
+}
+
+TraceRing* Tracer::getThreadRing() {
+    if (thread_ring != nullptr) {
+        return thread_ring;
+    }
+    void* memory = mmap(nullptr, sizeof(TraceRing), PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        return nullptr;
+    }
+    // a new mapping is zeroed, every slot is empty
+    TraceRing* ring = new (memory) TraceRing;
+    ring->next_index.store(0, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> guard(rings_lock);
+    rings.push_back(ring);
+    thread_ring = ring;
+    return ring;
+}
+
+void Tracer::start() {
+    std::lock_guard<std::mutex> guard(rings_lock);
+    for (auto ring : rings) {
+        unsigned long long end = ring->next_index.load();
+        unsigned long long begin = (end > trace_ring_capacity)
+                                   ? end - trace_ring_capacity : 0;
+        for (unsigned long long i = begin; i < end; i++) {
+            ring->events[i % trace_ring_capacity].sequence.store(0);
+        }
+        ring->next_index.store(0);
+    }
+    is_enabled.store(true, std::memory_order_relaxed);
+}
+
+void Tracer::stop() {
+    is_enabled.store(false, std::memory_order_relaxed);
+}
+
+bool Tracer::isEnabled() const {
+    return is_enabled.load(std::memory_order_relaxed);
+}
+
+void Tracer::record(const char* name, long long start_ns,
+                    long long duration_ns, long long arg) {
+    TraceRing* ring = getThreadRing();
+    if (ring == nullptr) {
+        return;
+    }
+    if (thread_tid == 0) {
+        thread_pid = getpid();
+        thread_tid = syscall(SYS_gettid);
+    }
+    unsigned long long index = ring->next_index.fetch_add(
+            1, std::memory_order_relaxed);
+    TraceEvent& event = ring->events[index % trace_ring_capacity];
+    event.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    event.name = name;
+    event.start_ns = start_ns;
+    event.duration_ns = duration_ns;
+    event.arg = arg;
+    event.pid = thread_pid;
+    event.tid = thread_tid;
+    event.sequence.store(index + 1, std::memory_order_release);
+}
+
+bool Tracer::dump(int fd) {
+    OutputSink out(fd);
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool is_first = true;
+    std::lock_guard<std::mutex> guard(rings_lock);
+    for (auto ring : rings) {
+        unsigned long long end = ring->next_index.load();
+        unsigned long long begin = (end > trace_ring_capacity)
+                                   ? end - trace_ring_capacity : 0;
+        for (unsigned long long i = begin; i < end; i++) {
+            TraceEvent& event = ring->events[i % trace_ring_capacity];
+            if (event.sequence.load(std::memory_order_acquire) != i + 1) {
+                // being written, or already overwritten
+                continue;
+            }
+            TraceEvent copy_of_event;
+            copy_of_event.name = event.name;
+            copy_of_event.start_ns = event.start_ns;
+            copy_of_event.duration_ns = event.duration_ns;
+            copy_of_event.arg = event.arg;
+            copy_of_event.pid = event.pid;
+            copy_of_event.tid = event.tid;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (event.sequence.load(std::memory_order_relaxed) != i + 1) {
+                continue;
+            }
+
+            // ts and dur are in microseconds
+            bool is_instant = (copy_of_event.duration_ns == -1);
+            char times[96];
+            if (is_instant) {
+                snprintf(times, sizeof(times), "\"ph\":\"i\",\"s\":\"t\","
+                         "\"ts\":%lld.%03lld", copy_of_event.start_ns / 1000,
+                         copy_of_event.start_ns % 1000);
+            } else {
+                snprintf(times, sizeof(times),
+                         "\"ph\":\"X\",\"ts\":%lld.%03lld,"
+                         "\"dur\":%lld.%03lld", copy_of_event.start_ns / 1000,
+                         copy_of_event.start_ns % 1000,
+                         copy_of_event.duration_ns / 1000,
+                         copy_of_event.duration_ns % 1000);
+            }
+            out << (is_first ? "" : ",") << '\n' << "{\"name\":"
+                << toJsonString(copy_of_event.name) << "," << times
+                << ",\"pid\":" << copy_of_event.pid << ",\"tid\":"
+                << copy_of_event.tid;
+            if (copy_of_event.arg != -1) {
+                out << ",\"args\":{\"value\":" << copy_of_event.arg << "}";
+            }
+            out << "}";
+            is_first = false;
+        }
+    }
+    out << '\n' << "]}" << '\n';
+    return out.flush();
+}
+
+TraceSpan::TraceSpan(const char* name)
+        : name(name), start_ns(-1), arg(-1) {
+    if (Tracer::getInstance().isEnabled()) {
+        start_ns = monotonicTimeNs();
+    }
+}
+
+TraceSpan::~TraceSpan() {
+    if (start_ns != -1) {
+        Tracer::getInstance().record(name, start_ns,
+                                     monotonicTimeNs() - start_ns, arg);
+    }
+}
@@ -0,0 +1,125 @@
+#ifndef HW1_TRACING_H
+#define HW1_TRACING_H
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "LaunchTiming.h"
+
+// events each thread keeps, the oldest are overwritten
+const unsigned long long trace_ring_capacity = 1 << 15;
+
+/* A span, written into a ring by one thread of smash or of a son it forked.
+ * sequence is set last, so a reader can tell a slot that is complete from
+ * one being written */
+struct TraceEvent {
+    // the index the event was written at, plus 1. 0 while being written
+    std::atomic<unsigned long long> sequence;
+    // a string literal, still valid in a forked son
+    const char* name;
+    long long start_ns;
+    // -1 for an instant, e.g. an exec
+    long long duration_ns;
+    // e.g. the bytes of a cp chunk, -1 for none
+    long long arg;
+    int pid;
+    int tid;
+};
+
+/* The events of a thread. Slots are taken with a fetch_add, so the sons a
+ * thread forks write into the same ring with no locks */
+struct TraceRing {
+    std::atomic<unsigned long long> next_index;
+    TraceEvent events[trace_ring_capacity];
+};
+
+/* Records spans into a ring per thread, in memory shared with the sons
+ * forked after it was created, for dumping as Chrome trace-event JSON that
+ * Perfetto opens. A span that isn't traced costs a relaxed load */
+class Tracer {
+    std::atomic<bool> is_enabled;
+    // guards rings, a thread takes it once, to add its ring
+    std::mutex rings_lock;
+    std::vector<TraceRing*> rings;
+
+    TraceRing* getThreadRing();
+
+public:
+    // constructor
+    Tracer();
+
+    // disable copy ctor
+    Tracer(Tracer const&) = delete;
+
+    // disable = operator
+    void operator=(Tracer const&) = delete;
+
+    static Tracer& getInstance();
+
+    // drops the events recorded so far and starts recording
+    void start();
+
+    void stop();
+
+    bool isEnabled() const;
+
+    void record(const char* name, long long start_ns, long long duration_ns,
+                long long arg = -1);
+
+    // writes the events of all the rings into fd. Returns false if a write
+    // failed
+    bool dump(int fd);
+};
+
+/* Records a span from its construction until its destruction, if tracing is
+ * enabled when it starts */
+class TraceSpan {
+    const char* name;
+    long long start_ns;
+
+public:
+    long long arg;
+
+    // constructor
+    explicit TraceSpan(const char* name);
+
+    // destructor
+    ~TraceSpan();
+
+    // disable copy ctor
+    TraceSpan(TraceSpan const&) = delete;
+
+    // disable = operator
+    void operator=(TraceSpan const&) = delete;
+};
+
+// spans are compiled in only with SMASH_TRACING, see the Makefile
+#ifdef SMASH_TRACING
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+// traces the rest of the scope
+#define TRACE_SPAN(name) TraceSpan TRACE_CONCAT(trace_span_, __LINE__)(name)
+// traces the rest of the scope as span_var, whose arg may be set
+#define TRACE_SPAN_VAR(span_var, name) TraceSpan span_var(name)
+#define TRACE_SPAN_ARG(span_var, value) ((span_var).arg = (value))
+// traces from start_ns, of monotonicTimeNs, until now
+#define TRACE_SINCE(name, start_ns) \
+    (Tracer::getInstance().isEnabled() \
+     ? Tracer::getInstance().record(name, start_ns, \
+                                    monotonicTimeNs() - (start_ns)) \
+     : (void)0)
+// a point in time, e.g. an exec
+#define TRACE_INSTANT(name) \
+    (Tracer::getInstance().isEnabled() \
+     ? Tracer::getInstance().record(name, monotonicTimeNs(), -1) : (void)0)
+#else
+#define TRACE_SPAN(name) ((void)0)
+#define TRACE_SPAN_VAR(span_var, name) ((void)0)
+#define TRACE_SPAN_ARG(span_var, value) ((void)0)
+#define TRACE_SINCE(name, start_ns) ((void)0)
+#define TRACE_INSTANT(name) ((void)0)
+#endif
+
+#endif //HW1_TRACING_H
@@ -0,0 +1,300 @@
+#include "TreeWalk.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <system_error>
+#include <thread>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// the record getdents64 fills the buffer with, glibc has no header for it
+struct LinuxDirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+WalkDirectory::~WalkDirectory() {
+    if (fd != -1) {
+        close(fd);
+    }
+}
+
+std::string WalkEntry::getPath() const {
+    if (dir_path.empty()) {
+        return name;
+    }
+    if (dir_path.back() == '/') {
+        return dir_path + name;
+    }
+    return dir_path + "/" + name;
+}
+
+static unsigned char getTypeOfMode(mode_t mode) {
+    if (S_ISDIR(mode)) {
+        return DT_DIR;
+    }
+    if (S_ISREG(mode)) {
+        return DT_REG;
+    }
+    if (S_ISLNK(mode)) {
+        return DT_LNK;
+    }
+    return S_ISFIFO(mode) ? DT_FIFO : S_ISSOCK(mode) ? DT_SOCK
+           : S_ISCHR(mode) ? DT_CHR : S_ISBLK(mode) ? DT_BLK : DT_UNKNOWN;
+}
+
+TreeWalker::TreeWalker(unsigned int stat_mask, int threads_count,
+                       std::function<void(const std::string&)> write_output)
+    : stat_mask(stat_mask), threads_count(std::max(1, threads_count)),
+      queues(std::max(1, threads_count)), pending_directories_count(0),
+      write_output(write_output), entries_count(0), directories_count(0),
+      errors_count(0) {}
+
+void TreeWalker::reportError(const char* call_name) {
+    errors_count++;
+    std::lock_guard<std::mutex> guard(output_lock);
+    perror(call_name);
+}
+
+void TreeWalker::flushOutput(std::string& output) {
+    if (output.empty()) {
+        return;
+    }
+    std::lock_guard<std::mutex> guard(output_lock);
+    write_output(output);
+    output.clear();
+}
+
+void TreeWalker::push(int thread_index,
+                      std::shared_ptr<WalkDirectory> directory) {
+    pending_directories_count++;
+    {
+        std::lock_guard<std::mutex> guard(queues[thread_index].lock);
+        queues[thread_index].directories.push_back(std::move(directory));
+    }
+    has_work.notify_one();
+}
+
+bool TreeWalker::pop(int thread_index,
+                     std::shared_ptr<WalkDirectory>& directory) {
+    {
+        // the newest of its own, deepest in the tree
+        WorkQueue& own_queue = queues[thread_index];
+        std::lock_guard<std::mutex> guard(own_queue.lock);
+        if (!own_queue.directories.empty()) {
+            directory = std::move(own_queue.directories.back());
+            own_queue.directories.pop_back();
+            return true;
+        }
+    }
+    // the oldest of another, closest to the root with the most below it
+    for (int i = 1; i < threads_count; i++) {
+        WorkQueue& victim = queues[(thread_index + i) % threads_count];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (!victim.directories.empty()) {
+            directory = std::move(victim.directories.front());
+            victim.directories.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void TreeWalker::finishDirectory(WalkDirectory* directory,
+                                 std::string& output) {
+    while (directory != nullptr) {
+        if (on_directory_done && !(should_stop && should_stop())) {
+            on_directory_done(*directory, output);
+        }
+        WalkDirectory* parent = directory->parent.get();
+        if (parent == nullptr || --parent->pending_count != 0) {
+            break;
+        }
+        directory = parent;
+    }
+}
+
+void TreeWalker::listDirectory(const std::shared_ptr<WalkDirectory>& directory,
+                               int thread_index,
+                               std::vector<char>& dents_buff) {
+    std::string output;
+    int parent_fd = directory->parent ? directory->parent->fd : AT_FDCWD;
+    // a root that is a symlink to a directory is followed, nothing below it
+    int no_follow_flag = directory->parent ? O_NOFOLLOW : 0;
+    directory->fd = openat(parent_fd, directory->name.c_str(),
+            O_RDONLY | O_DIRECTORY | O_CLOEXEC | no_follow_flag);
+    if (directory->fd == -1) {
+        reportError("smash error: openat failed");
+    }
+    directories_count++;
+
+    while (directory->fd != -1) {
+        long bytes_read_count = syscall(SYS_getdents64, directory->fd,
+                                        dents_buff.data(), dents_buff.size());
+        if (bytes_read_count == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            reportError("smash error: getdents64 failed");
+            break;
+        }
+        if (bytes_read_count == 0) {
+            break;
+        }
+        for (long pos = 0; pos < bytes_read_count;) {
+            const LinuxDirent64* dent = reinterpret_cast<const LinuxDirent64*>(
+                    dents_buff.data() + pos);
+            pos += dent->d_reclen;
+            const char* name = dent->d_name;
+            if (name[0] == '.' && (name[1] == '\0'
+                                   || (name[1] == '.' && name[2] == '\0'))) {
+                continue;
+            }
+
+            unsigned char type = dent->d_type;
+            struct statx entry_stat;
+            bool is_stat_needed = (stat_mask != 0 || type == DT_UNKNOWN);
+            if (is_stat_needed) {
+                unsigned int mask = stat_mask
+                        | (type == DT_UNKNOWN ? STATX_TYPE : 0);
+                if (statx(directory->fd, name,
+                          AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT, mask,
+                          &entry_stat) == -1) {
+                    reportError("smash error: statx failed");
+                    continue;
+                }
+                if (type == DT_UNKNOWN) {
+                    type = getTypeOfMode(entry_stat.stx_mode);
+                }
+            }
+            entries_count++;
+
+            WalkEntry entry = {directory->fd, directory->path, name, type,
+                               stat_mask != 0 ? &entry_stat : nullptr,
+                               directory->depth + 1, directory.get(),
+                               output};
+            bool is_walked_into = on_entry(entry);
+            if (type == DT_DIR && is_walked_into) {
+                std::shared_ptr<WalkDirectory> subdirectory =
+                        std::make_shared<WalkDirectory>();
+                subdirectory->parent = directory;
+                subdirectory->path = entry.getPath();
+                subdirectory->name = name;
+                subdirectory->fd = -1;
+                subdirectory->depth = directory->depth + 1;
+                if (is_stat_needed) {
+                    subdirectory->stat = entry_stat;
+                } else {
+                    subdirectory->stat.stx_mask = 0;
+                }
+                subdirectory->pending_count = 1;
+                subdirectory->total = 0;
+                directory->pending_count++;
+                push(thread_index, std::move(subdirectory));
+            }
+        }
+    }
+
+    if (--directory->pending_count == 0) {
+        finishDirectory(directory.get(), output);
+    }
+    flushOutput(output);
+}
+
+void TreeWalker::workerLoop(int thread_index) {
+    std::vector<char> dents_buff(walk_dents_buffer_size);
+    while (true) {
+        std::shared_ptr<WalkDirectory> directory;
+        if (pop(thread_index, directory)) {
+            if (!(should_stop && should_stop())) {
+                listDirectory(directory, thread_index, dents_buff);
+            }
+            directory.reset();
+            if (--pending_directories_count == 0) {
+                has_work.notify_all();
+            }
+            continue;
+        }
+        if (pending_directories_count == 0) {
+            return;
+        }
+        // another thread is listing, and may queue more
+        std::unique_lock<std::mutex> guard(idle_lock);
+        has_work.wait_for(guard, std::chrono::milliseconds(1));
+    }
+}
+
+void TreeWalker::walk(const std::vector<std::string>& roots) {
+    std::string output;
+    const std::string no_dir_path;
+    for (auto& root : roots) {
+        struct statx root_stat;
+        if (statx(AT_FDCWD, root.c_str(), AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT,
+                  stat_mask | STATX_TYPE, &root_stat) == -1) {
+            reportError("smash error: statx failed");
+            continue;
+        }
+        unsigned char type = getTypeOfMode(root_stat.stx_mode);
+        entries_count++;
+        WalkEntry entry = {AT_FDCWD, no_dir_path, root.c_str(), type,
+                           stat_mask != 0 ? &root_stat : nullptr, 0, nullptr,
+                           output};
+        if (on_entry(entry) && type == DT_DIR) {
+            std::shared_ptr<WalkDirectory> directory =
+                    std::make_shared<WalkDirectory>();
+            directory->path = root;
+            directory->name = root;
+            directory->fd = -1;
+            directory->depth = 0;
+            directory->stat = root_stat;
+            directory->pending_count = 1;
+            directory->total = 0;
+            push(0, std::move(directory));
+        }
+    }
+    flushOutput(output);
+    if (pending_directories_count == 0) {
+        return;
+    }
+
+    std::vector<std::thread> workers;
+    try {
+        for (int i = 1; i < threads_count; i++) {
+            workers.emplace_back(&TreeWalker::workerLoop, this, i);
+        }
+    } catch (std::system_error& e) {
+        // the threads that started steal the work of those that didn't
+    }
+    workerLoop(0);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+unsigned long long TreeWalker::getEntriesCount() const {
+    return entries_count;
+}
+
+unsigned long long TreeWalker::getDirectoriesCount() const {
+    return directories_count;
+}
+
+unsigned long long TreeWalker::getErrorsCount() const {
+    return errors_count;
+}
+
+int TreeWalker::getThreadsCount() const {
+    return threads_count;
+}
+
+int getWalkThreadsCount() {
+    int cores_count = std::thread::hardware_concurrency();
+    return std::max(walk_min_threads,
+                    std::min(2 * cores_count, walk_max_threads));
+}
@@ -0,0 +1,136 @@
+#ifndef HW1_TREEWALK_H
+#define HW1_TREEWALK_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+// directory entries are read this much at a time
+const size_t walk_dents_buffer_size = 256 * 1024;
+// walking waits on the disk more than on the cpu, so there are more threads
+// than cores, between these two
+const int walk_min_threads = 4;
+const int walk_max_threads = 32;
+
+/* A directory being walked. It is done once it was listed and all of its
+ * subdirectories are done, so a visitor sees its children before it */
+struct WalkDirectory {
+    std::shared_ptr<WalkDirectory> parent;
+    std::string path;
+    // its name in the parent, the path for a root
+    std::string name;
+    // open from its listing until it is done
+    int fd;
+    int depth;
+    // the fields of the walker's mask and its type
+    struct statx stat;
+    // its listing and the subdirectories that aren't done
+    std::atomic<long> pending_count;
+    // summed up by the visitor, e.g. du's blocks
+    std::atomic<unsigned long long> total;
+
+    // destructor
+    ~WalkDirectory();
+};
+
+/* An entry found by the walker. Roots are entries too, with depth 0 */
+struct WalkEntry {
+    // the entry is name in dir_fd, whose path is dir_path. AT_FDCWD and ""
+    // for a root
+    int dir_fd;
+    const std::string& dir_path;
+    const char* name;
+    // DT_REG, DT_DIR, DT_LNK...
+    unsigned char type;
+    // the fields of the walker's mask, nullptr if the mask is empty
+    const struct statx* stat;
+    int depth;
+    // the directory the entry is in, nullptr for a root
+    WalkDirectory* directory;
+    // written into the walker's output after the directory is listed
+    std::string& output;
+
+    std::string getPath() const;
+};
+
+/* Walks trees on a pool of threads. Each thread lists directories from the
+ * back of its own queue, depth first, and steals from the front of the
+ * others' when it runs out, where the biggest subtrees are. Directories
+ * are opened with openat relative to their parent, listed with getdents64
+ * and their entries stat'ed with statx for the fields in the mask only,
+ * so a walk that needs none never stats what the listing already typed */
+class TreeWalker {
+    struct WorkQueue {
+        std::mutex lock;
+        std::deque<std::shared_ptr<WalkDirectory>> directories;
+    };
+
+    unsigned int stat_mask;
+    int threads_count;
+    std::vector<WorkQueue> queues;
+    // directories queued or being listed
+    std::atomic<long> pending_directories_count;
+    std::mutex idle_lock;
+    std::condition_variable has_work;
+    // the output of the threads is written in pieces under this
+    std::mutex output_lock;
+    std::function<void(const std::string&)> write_output;
+    std::atomic<unsigned long long> entries_count;
+    std::atomic<unsigned long long> directories_count;
+    std::atomic<unsigned long long> errors_count;
+
+    void push(int thread_index, std::shared_ptr<WalkDirectory> directory);
+    bool pop(int thread_index, std::shared_ptr<WalkDirectory>& directory);
+    void workerLoop(int thread_index);
+    void listDirectory(const std::shared_ptr<WalkDirectory>& directory,
+                       int thread_index, std::vector<char>& dents_buff);
+    // calls on_directory_done for it, and for its parents it was the last
+    // pending subdirectory of
+    void finishDirectory(WalkDirectory* directory, std::string& output);
+    void flushOutput(std::string& output);
+    void reportError(const char* call_name);
+
+public:
+    // returns whether to walk into the entry, if it is a directory
+    std::function<bool(const WalkEntry& entry)> on_entry;
+    // optional, called once a directory and all below it were walked
+    std::function<void(WalkDirectory& directory,
+                       std::string& output)> on_directory_done;
+    // polled between directories, a walk that should stop skips the rest
+    std::function<bool()> should_stop;
+
+    // constructor
+    TreeWalker(unsigned int stat_mask, int threads_count,
+               std::function<void(const std::string&)> write_output);
+
+    // disable copy ctor
+    TreeWalker(TreeWalker const&) = delete;
+
+    // disable = operator
+    void operator=(TreeWalker const&) = delete;
+
+    void walk(const std::vector<std::string>& roots);
+
+    unsigned long long getEntriesCount() const;
+
+    unsigned long long getDirectoriesCount() const;
+
+    // failed opens, listings and stats, reported with perror
+    unsigned long long getErrorsCount() const;
+
+    int getThreadsCount() const;
+};
+
+/* the number of threads to walk with, twice the cores between
+ * walk_min_threads and walk_max_threads */
+int getWalkThreadsCount();
+
+#endif //HW1_TREEWALK_H
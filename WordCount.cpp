@@ -0,0 +1,197 @@
+#include "WordCount.h"
+
+#include <cstdint>
+#include <algorithm>
+#include <thread>
+#include <system_error>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+// isspace() of the C locale: ' ', \t, \n, \v, \f and \r
+static inline bool isSpaceByte(unsigned char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+// isgraph() of the C locale
+static inline bool isPrintableByte(unsigned char c) {
+    return c > ' ' && c < 0x7f;
+}
+
+static void countWordsScalar(const unsigned char* data, size_t size,
+                             bool& is_in_word, WordCounts& counts) {
+    for (size_t i = 0; i < size; i++) {
+        unsigned char c = data[i];
+        counts.lines += (c == '\n');
+        // like wc(1), bytes that are neither start or end no word
+        if (isSpaceByte(c)) {
+            is_in_word = false;
+        } else if (isPrintableByte(c)) {
+            counts.words += !is_in_word;
+            is_in_word = true;
+        }
+    }
+}
+
+#if defined(__x86_64__)
+
+// the kernels compare a vector of bytes at a time and turn the results into
+// bit masks: newlines are popcounted, words start where a printable bit
+// follows a space bit, the last bit is carried into the next vector. A
+// vector with bytes that are neither, e.g. binary data, is left to the
+// scalar loop
+
+static size_t countWordsSse2(const unsigned char* data, size_t size,
+                             bool& is_in_word, WordCounts& counts) {
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    // \t..\r are the 5 bytes from tab on
+    const __m128i control_range = _mm_set1_epi8(4);
+    const __m128i printable_start = _mm_set1_epi8('!');
+    const __m128i printable_range = _mm_set1_epi8(0x7e - '!');
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m128i bytes = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(data + i));
+        __m128i from_tab = _mm_sub_epi8(bytes, tab);
+        __m128i is_control = _mm_cmpeq_epi8(
+                _mm_min_epu8(from_tab, control_range), from_tab);
+        uint32_t space_mask = _mm_movemask_epi8(
+                _mm_or_si128(_mm_cmpeq_epi8(bytes, space), is_control));
+        __m128i from_printable = _mm_sub_epi8(bytes, printable_start);
+        uint32_t printable_mask = _mm_movemask_epi8(_mm_cmpeq_epi8(
+                _mm_min_epu8(from_printable, printable_range),
+                from_printable));
+        if ((space_mask | printable_mask) != 0xffff) {
+            countWordsScalar(data + i, 16, is_in_word, counts);
+            continue;
+        }
+
+        uint32_t newline_mask = _mm_movemask_epi8(
+                _mm_cmpeq_epi8(bytes, newline));
+        uint32_t after_space_mask = (space_mask << 1) | !is_in_word;
+        counts.lines += __builtin_popcount(newline_mask);
+        counts.words += __builtin_popcount(printable_mask & after_space_mask);
+        is_in_word = !((space_mask >> 15) & 1);
+    }
+    return i;
+}
+
+__attribute__((target("avx2,popcnt")))
+static size_t countWordsAvx2(const unsigned char* data, size_t size,
+                             bool& is_in_word, WordCounts& counts) {
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i control_range = _mm256_set1_epi8(4);
+    const __m256i printable_start = _mm256_set1_epi8('!');
+    const __m256i printable_range = _mm256_set1_epi8(0x7e - '!');
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i bytes = _mm256_loadu_si256(
+                reinterpret_cast<const __m256i*>(data + i));
+        __m256i from_tab = _mm256_sub_epi8(bytes, tab);
+        __m256i is_control = _mm256_cmpeq_epi8(
+                _mm256_min_epu8(from_tab, control_range), from_tab);
+        uint32_t space_mask = _mm256_movemask_epi8(
+                _mm256_or_si256(_mm256_cmpeq_epi8(bytes, space), is_control));
+        __m256i from_printable = _mm256_sub_epi8(bytes, printable_start);
+        uint32_t printable_mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(
+                _mm256_min_epu8(from_printable, printable_range),
+                from_printable));
+        if ((space_mask | printable_mask) != 0xffffffffU) {
+            countWordsScalar(data + i, 32, is_in_word, counts);
+            continue;
+        }
+
+        uint32_t newline_mask = _mm256_movemask_epi8(
+                _mm256_cmpeq_epi8(bytes, newline));
+        uint32_t after_space_mask = (space_mask << 1) | !is_in_word;
+        counts.lines += _mm_popcnt_u32(newline_mask);
+        counts.words += _mm_popcnt_u32(printable_mask & after_space_mask);
+        is_in_word = !(space_mask >> 31);
+    }
+    return i;
+}
+
+static bool hasAvx2() {
+    static const bool has_avx2 = __builtin_cpu_supports("avx2")
+                                 && __builtin_cpu_supports("popcnt");
+    return has_avx2;
+}
+
+#endif
+
+void countWords(const char* data, size_t size, bool& is_in_word,
+                WordCounts& counts) {
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+    size_t counted = 0;
+#if defined(__x86_64__)
+    if (hasAvx2()) {
+        counted = countWordsAvx2(bytes, size, is_in_word, counts);
+    } else {
+        // SSE2 is always there on x86-64
+        counted = countWordsSse2(bytes, size, is_in_word, counts);
+    }
+#endif
+    countWordsScalar(bytes + counted, size - counted, is_in_word, counts);
+    counts.bytes += size;
+}
+
+// whether data[pos] continues a word, decided by the last byte before it
+// that is a space or a printable one
+static bool isInWordAt(const char* data, size_t pos) {
+    while (pos > 0) {
+        unsigned char c = data[--pos];
+        if (isSpaceByte(c)) {
+            return false;
+        }
+        if (isPrintableByte(c)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void countWordsInParallel(const char* data, size_t size, WordCounts& counts) {
+    int threads_count = std::thread::hardware_concurrency();
+    threads_count = std::min(threads_count, wc_max_threads);
+    threads_count = std::min<size_t>(threads_count, size / wc_bytes_per_thread);
+    if (threads_count <= 1) {
+        bool is_in_word = false;
+        countWords(data, size, is_in_word, counts);
+        return;
+    }
+
+    std::vector<WordCounts> part_counts(threads_count, WordCounts{0, 0, 0});
+    std::vector<std::thread> threads;
+    size_t part_size = size / threads_count;
+    for (int i = 0; i < threads_count; i++) {
+        size_t part_start = i * part_size;
+        size_t part_end = (i == threads_count - 1) ? size
+                                                   : part_start + part_size;
+        WordCounts* part_count = &part_counts[i];
+        auto count_part = [=] {
+            bool is_in_word = isInWordAt(data, part_start);
+            countWords(data + part_start, part_end - part_start, is_in_word,
+                       *part_count);
+        };
+        try {
+            threads.push_back(std::thread(count_part));
+        } catch (std::system_error& error) {
+            // out of threads, this part is counted here
+            count_part();
+        }
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (auto& part_count : part_counts) {
+        counts.lines += part_count.lines;
+        counts.words += part_count.words;
+        counts.bytes += part_count.bytes;
+    }
+}
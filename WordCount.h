@@ -0,0 +1,32 @@
+#ifndef HW1_WORDCOUNT_H
+#define HW1_WORDCOUNT_H
+
+#include <cstddef>
+
+// files at least this big are mapped instead of read
+const size_t wc_map_min_size = 1024 * 1024;
+// a mapped file gets one more thread per this many bytes
+const size_t wc_bytes_per_thread = 32 * 1024 * 1024;
+const int wc_max_threads = 16;
+const size_t wc_read_size = 1024 * 1024;
+
+struct WordCounts {
+    unsigned long long lines;
+    unsigned long long words;
+    unsigned long long bytes;
+};
+
+/* counting the lines, words and bytes of a buffer into counts, like wc(1)
+ * in the C locale: a word is printable chars between whitespace, other
+ * bytes neither start nor end one. is_in_word tells if the input before
+ * data ended inside a word (false at its start) and is updated, so the
+ * buffers of a stream are counted one after the other.
+ * Uses AVX2 or SSE2 kernels when the cpu has them */
+void countWords(const char* data, size_t size, bool& is_in_word,
+                WordCounts& counts);
+
+/* counting a mapped file, split across threads when it is big. Each part
+ * looks back before its start, so a word cut between parts counts once */
+void countWordsInParallel(const char* data, size_t size, WordCounts& counts);
+
+#endif //HW1_WORDCOUNT_H
@@ -0,0 +1,516 @@
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <pty.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+#include <sys/wait.h>
+
+/* End to end load generator. Starts smash under a pseudo-terminal, so it
+ * gets ctrl-Z and ctrl-C from the line discipline like in a real terminal,
+ * and replays scripted workloads: built-ins and external commands, thousands
+ * of bg jobs, bursts of fg/bg/kill among them, ctrl-Z and ctrl-C storms and
+ * long pipelines. It measures the prompt-to-prompt latency of every command,
+ * the latency from a ctrl-Z or ctrl-C to smash reporting the process as
+ * stopped or killed, and commands/sec per workload. The results are written
+ * as JSON into the file given last. Run with "make load" */
+
+const char* const prompt = "smash> ";
+// smash must answer within this long, or the run is failed
+const int response_timeout_ms = 30 * 1000;
+// the signal handler reports the process right after "got ctrl-Z", so if
+// nothing follows for this long there was no process in the fg yet
+const int signal_report_timeout_ms = 20;
+const int max_signal_retries = 50;
+// lets smash get to waiting for the line it just got before it is
+// signaled, a user never types ctrl-Z faster than that
+const int signal_settle_us = 2000;
+
+const char ctrl_c = 3;
+const char ctrl_z = 26;
+
+static long long monotonicTimeNs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+class LoadFail {
+public:
+    std::string reason;
+
+    // constructor
+    explicit LoadFail(const std::string& reason) : reason(reason) {}
+};
+
+/* smash running on the slave side of a pty, driven from the master side */
+class PtySmash {
+    int master_fd;
+    pid_t smash_pid;
+    // output read and not matched yet
+    std::string output;
+
+    typedef enum {
+        READ_DATA = 1,
+        READ_TIMEOUT = 2,
+        READ_EOF = 3
+    } ReadResult;
+
+    // reads what is available within timeout_ms
+    ReadResult readSome(int timeout_ms) {
+        struct pollfd poll_fd = {master_fd, POLLIN, 0};
+        int ready_count = poll(&poll_fd, 1, timeout_ms);
+        if (ready_count == -1 && errno == EINTR) {
+            return READ_DATA;
+        }
+        if (ready_count == 0) {
+            return READ_TIMEOUT;
+        }
+        char buff[65536];
+        ssize_t bytes_read_count = ready_count == -1 ? -1
+                : read(master_fd, buff, sizeof(buff));
+        if (bytes_read_count <= 0) {
+            // EIO once smash and its jobs closed the slave
+            return READ_EOF;
+        }
+        output.append(buff, (size_t)bytes_read_count);
+        return READ_DATA;
+    }
+
+public:
+    // constructor
+    PtySmash() : master_fd(-1), smash_pid(-1) {}
+
+    void start(const std::string& smash_path) {
+        // a canonical terminal with ctrl-C and ctrl-Z, but no echo and no
+        // output processing, so the master reads exactly what smash writes.
+        // The signals don't flush the input, a line sent right before them
+        // still reaches smash
+        struct termios term;
+        memset(&term, 0, sizeof(term));
+        term.c_iflag = ICRNL;
+        term.c_oflag = 0;
+        term.c_cflag = CS8 | CREAD;
+        term.c_lflag = ICANON | ISIG | NOFLSH;
+        term.c_cc[VINTR] = ctrl_c;
+        term.c_cc[VSUSP] = ctrl_z;
+        term.c_cc[VQUIT] = 034;
+        term.c_cc[VERASE] = 0177;
+        term.c_cc[VKILL] = 025;
+        term.c_cc[VEOF] = 4;
+        term.c_cc[VMIN] = 1;
+        term.c_cc[VTIME] = 0;
+        cfsetispeed(&term, B38400);
+        cfsetospeed(&term, B38400);
+        struct winsize window_size = {24, 80, 0, 0};
+
+        smash_pid = forkpty(&master_fd, nullptr, &term, &window_size);
+        if (smash_pid == -1) {
+            perror("smash load: forkpty failed");
+            throw LoadFail("forkpty failed");
+        }
+        if (smash_pid == 0) {
+            execl(smash_path.c_str(), smash_path.c_str(), (char*)nullptr);
+            perror("smash load: execl failed");
+            _exit(127);
+        }
+        waitFor(prompt);
+    }
+
+    // waits until text shows up in the output, and drops the output up to
+    // its end. Returns when it was read, or -1 after timeout_ms
+    long long waitFor(const std::string& text,
+                      int timeout_ms = response_timeout_ms) {
+        long long deadline_ns = monotonicTimeNs() + timeout_ms * 1000000LL;
+        size_t search_start = 0;
+        while (true) {
+            size_t pos = output.find(text, search_start);
+            if (pos != std::string::npos) {
+                long long found_ns = monotonicTimeNs();
+                output.erase(0, pos + text.size());
+                return found_ns;
+            }
+            // the text may start in what was already read
+            search_start = output.size() >= text.size()
+                           ? output.size() - text.size() + 1 : 0;
+            long long left_ms = (deadline_ns - monotonicTimeNs()) / 1000000;
+            ReadResult read_result = left_ms <= 0 ? READ_TIMEOUT
+                    : readSome(static_cast<int>(left_ms));
+            if (read_result == READ_TIMEOUT) {
+                return -1;
+            }
+            if (read_result == READ_EOF) {
+                throw LoadFail("smash's output ended while waiting for \""
+                               + text + "\"");
+            }
+        }
+    }
+
+    // waits for text, failing the run if it doesn't show up
+    long long expect(const std::string& text) {
+        long long found_ns = waitFor(text);
+        if (found_ns == -1) {
+            throw LoadFail("timed out waiting for \"" + text + "\"");
+        }
+        return found_ns;
+    }
+
+    // writes raw bytes into the terminal, returns when they were sent
+    long long send(const std::string& data) {
+        long long sent_ns = monotonicTimeNs();
+        size_t written = 0;
+        while (written < data.size()) {
+            ssize_t bytes_written = write(master_fd, data.data() + written,
+                                          data.size() - written);
+            if (bytes_written == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                perror("smash load: write failed");
+                throw LoadFail("write failed");
+            }
+            written += (size_t)bytes_written;
+        }
+        return sent_ns;
+    }
+
+    // runs the command line and returns its prompt-to-prompt latency
+    long long runCommand(const std::string& cmd_line) {
+        long long sent_ns = send(cmd_line + "\n");
+        return expect(prompt) - sent_ns;
+    }
+
+    /* sends ctrl-Z or ctrl-C to the fg process, and returns how long smash
+     * took to report it as "stopped" or "killed". The line that started
+     * the process may not have reached fork yet, then the signal is sent
+     * again. retries_count counts those */
+    long long signalFgProccess(char control_char, const std::string& report,
+                               int& retries_count) {
+        std::string handler_msg = control_char == ctrl_z
+                                  ? "smash: got ctrl-Z\n"
+                                  : "smash: got ctrl-C\n";
+        usleep(signal_settle_us);
+        for (int i = 0; i < max_signal_retries; i++) {
+            long long sent_ns = send(std::string(1, control_char));
+            expect(handler_msg);
+            long long reported_ns = waitFor(report, signal_report_timeout_ms);
+            if (reported_ns != -1) {
+                expect(prompt);
+                return reported_ns - sent_ns;
+            }
+            retries_count++;
+        }
+        throw LoadFail("no process was in the fg for \"" + report + "\"");
+    }
+
+    // quits, killing the jobs, and waits for smash to exit
+    long long quit() {
+        long long sent_ns = send("quit kill\n");
+        while (readSome(response_timeout_ms) == READ_DATA) {
+            output.clear();
+        }
+        int status;
+        if (waitpid(smash_pid, &status, 0) == -1) {
+            perror("smash load: waitpid failed");
+        }
+        long long exited_ns = monotonicTimeNs();
+        smash_pid = -1;
+        return exited_ns - sent_ns;
+    }
+
+    // destructor
+    ~PtySmash() {
+        if (smash_pid > 0) {
+            kill(smash_pid, SIGKILL);
+            waitpid(smash_pid, nullptr, 0);
+        }
+        if (master_fd != -1) {
+            close(master_fd);
+        }
+    }
+};
+
+// ----------------------------------------------------------------------------
+
+struct LoadResult {
+    std::string name;
+    // "prompt" for prompt-to-prompt, "signal" for ctrl-Z/ctrl-C to report
+    std::string metric;
+    std::vector<long long> latencies_ns;
+    long long elapsed_ns;
+    int retries_count;
+};
+
+static std::vector<LoadResult> results;
+
+static double getPercentileUs(std::vector<long long>& sorted_latencies_ns,
+                              double percentile) {
+    if (sorted_latencies_ns.empty()) {
+        return 0;
+    }
+    size_t idx = static_cast<size_t>(percentile * sorted_latencies_ns.size());
+    idx = std::min(idx, sorted_latencies_ns.size() - 1);
+    return sorted_latencies_ns[idx] / 1000.0;
+}
+
+static double getCommandsPerSec(LoadResult& result) {
+    return result.elapsed_ns == 0 ? 0
+           : result.latencies_ns.size() * 1e9 / result.elapsed_ns;
+}
+
+static void printResult(LoadResult& result) {
+    std::vector<long long> sorted = result.latencies_ns;
+    std::sort(sorted.begin(), sorted.end());
+    char line[256];
+    snprintf(line, sizeof(line), "%-28s %-7s %7zu %10.1f/s %10.1f %10.1f"
+             " %10.1f us", result.name.c_str(), result.metric.c_str(),
+             sorted.size(), getCommandsPerSec(result),
+             getPercentileUs(sorted, 0.5), getPercentileUs(sorted, 0.99),
+             sorted.empty() ? 0 : sorted.back() / 1000.0);
+    std::cout << line;
+    if (result.retries_count != 0) {
+        std::cout << " (" << result.retries_count << " retries)";
+    }
+    std::cout << std::endl;
+}
+
+static std::string toJsonString(const std::string& str) {
+    std::string json_str = "\"";
+    for (char c : str) {
+        if (c == '"' || c == '\\') {
+            json_str += '\\';
+        }
+        json_str += c;
+    }
+    return json_str + "\"";
+}
+
+static bool writeResults(const char* file_name) {
+    std::ofstream file(file_name);
+    if (!file) {
+        return false;
+    }
+    file << "{\"results\":[";
+    for (size_t i = 0; i < results.size(); i++) {
+        LoadResult& result = results[i];
+        std::vector<long long> sorted = result.latencies_ns;
+        std::sort(sorted.begin(), sorted.end());
+        char numbers[256];
+        snprintf(numbers, sizeof(numbers), "\"count\":%zu,\"per_sec\":%.1f,"
+                 "\"p50_us\":%.1f,\"p99_us\":%.1f,\"max_us\":%.1f,"
+                 "\"retries\":%d", sorted.size(), getCommandsPerSec(result),
+                 getPercentileUs(sorted, 0.5), getPercentileUs(sorted, 0.99),
+                 sorted.empty() ? 0 : sorted.back() / 1000.0,
+                 result.retries_count);
+        file << (i == 0 ? "" : ",") << "\n  {\"name\":"
+             << toJsonString(result.name) << ",\"metric\":"
+             << toJsonString(result.metric) << ',' << numbers << '}';
+    }
+    file << "\n]}\n";
+    return static_cast<bool>(file);
+}
+
+/* a workload being measured, added to the results when it is done */
+class Workload {
+    LoadResult result;
+    long long start_ns;
+
+public:
+    // constructor
+    Workload(const std::string& name, const std::string& metric)
+            : start_ns(monotonicTimeNs()) {
+        result.name = name;
+        result.metric = metric;
+        result.elapsed_ns = 0;
+        result.retries_count = 0;
+    }
+
+    void add(long long latency_ns) {
+        result.latencies_ns.push_back(latency_ns);
+    }
+
+    int& retries() {
+        return result.retries_count;
+    }
+
+    void finish() {
+        result.elapsed_ns = monotonicTimeNs() - start_ns;
+        printResult(result);
+        results.push_back(result);
+    }
+};
+
+// ----------------------------------------------------------------------------
+
+struct LoadConfig {
+    std::string smash_path;
+    // bg jobs kept running while the job control workloads run
+    int jobs_count;
+    // commands per REPL workload
+    int commands_count;
+    // rounds of every signal and fg/bg/kill burst
+    int rounds_count;
+    int pipelines_count;
+};
+
+static void runReplWorkloads(PtySmash& smash, LoadConfig& config) {
+    Workload builtins("builtin", "prompt");
+    for (int i = 0; i < config.commands_count; i++) {
+        builtins.add(smash.runCommand(i % 2 == 0 ? "pwd" : "showpid"));
+    }
+    builtins.finish();
+
+    Workload externals("external", "prompt");
+    for (int i = 0; i < config.commands_count / 4; i++) {
+        externals.add(smash.runCommand("/bin/true"));
+    }
+    externals.finish();
+
+    Workload pipelines("pipeline", "prompt");
+    for (int i = 0; i < config.pipelines_count; i++) {
+        pipelines.add(smash.runCommand("head -c 16777216 /dev/zero | cat"
+                                       " | cat | cat | wc -c"));
+    }
+    pipelines.finish();
+}
+
+// jobIDs of the bg jobs are 1..jobs_count, started first
+static void runJobWorkloads(PtySmash& smash, LoadConfig& config) {
+    Workload launches("bg_launch", "prompt");
+    for (int i = 0; i < config.jobs_count; i++) {
+        launches.add(smash.runCommand("sleep 1000&"));
+    }
+    launches.finish();
+
+    Workload jobs_lists("jobs_list", "prompt");
+    for (int i = 0; i < 10; i++) {
+        jobs_lists.add(smash.runCommand("jobs"));
+    }
+    jobs_lists.finish();
+
+    // a bg job brought to the fg and stopped again, then resumed in the bg
+    Workload fg_stops("fg_ctrl_z", "signal");
+    Workload bg_resumes("bg_resume", "prompt");
+    for (int i = 0; i < config.rounds_count; i++) {
+        int jobID = 1 + (i * 7919) % config.jobs_count;
+        std::string job_spec = "%" + std::to_string(jobID);
+        smash.send("fg " + job_spec + "\n");
+        // fg prints the job's line right before it waits for it
+        smash.expect("sleep 1000& : ");
+        fg_stops.add(smash.signalFgProccess(ctrl_z, " was stopped\n",
+                                            fg_stops.retries()));
+        bg_resumes.add(smash.runCommand("bg " + job_spec));
+    }
+    fg_stops.finish();
+    bg_resumes.finish();
+
+    Workload ctrl_z_storm("ctrl_z_storm", "signal");
+    for (int i = 0; i < config.rounds_count; i++) {
+        smash.send("sleep 1000\n");
+        ctrl_z_storm.add(smash.signalFgProccess(ctrl_z, " was stopped\n",
+                                                ctrl_z_storm.retries()));
+    }
+    ctrl_z_storm.finish();
+
+    Workload ctrl_c_storm("ctrl_c_storm", "signal");
+    for (int i = 0; i < config.rounds_count; i++) {
+        smash.send("sleep 1000\n");
+        ctrl_c_storm.add(smash.signalFgProccess(ctrl_c, " was killed\n",
+                                                ctrl_c_storm.retries()));
+    }
+    ctrl_c_storm.finish();
+
+    // kills the jobs from the newest, the stopped ones of the storm first
+    Workload kills("kill_burst", "prompt");
+    int kills_count = std::min(config.jobs_count, config.rounds_count * 4);
+    for (int i = 0; i < kills_count; i++) {
+        int jobID = config.jobs_count + config.rounds_count - i;
+        kills.add(smash.runCommand("kill -9 " + std::to_string(jobID)));
+    }
+    kills.finish();
+
+    Workload quits("quit_kill", "prompt");
+    quits.add(smash.quit());
+    quits.finish();
+}
+
+static bool parsePositive(const char* str, int& number) {
+    char* end;
+    long value = strtol(str, &end, 10);
+    if (*str == '\0' || *end != '\0' || value <= 0 || value > 1000000) {
+        return false;
+    }
+    number = static_cast<int>(value);
+    return true;
+}
+
+static void printUsage() {
+    std::cerr << "usage: smash_load [-s smash] [-j bg_jobs] [-n commands]"
+                 " [-r rounds] [-p pipelines] results.json" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    LoadConfig config;
+    config.smash_path = "./smash";
+    config.jobs_count = 2000;
+    config.commands_count = 2000;
+    config.rounds_count = 200;
+    config.pipelines_count = 20;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "s:j:n:r:p:")) != -1) {
+        bool is_valid = true;
+        switch (opt) {
+            case 's':
+                config.smash_path = optarg;
+                break;
+            case 'j':
+                is_valid = parsePositive(optarg, config.jobs_count);
+                break;
+            case 'n':
+                is_valid = parsePositive(optarg, config.commands_count);
+                break;
+            case 'r':
+                is_valid = parsePositive(optarg, config.rounds_count);
+                break;
+            case 'p':
+                is_valid = parsePositive(optarg, config.pipelines_count);
+                break;
+            default:
+                is_valid = false;
+        }
+        if (!is_valid) {
+            printUsage();
+            return 1;
+        }
+    }
+    if (optind != argc - 1) {
+        printUsage();
+        return 1;
+    }
+
+    try {
+        PtySmash smash;
+        smash.start(config.smash_path);
+        runReplWorkloads(smash, config);
+        runJobWorkloads(smash, config);
+    } catch (LoadFail& load_fail) {
+        std::cerr << "smash load: " << load_fail.reason << std::endl;
+        return 1;
+    }
+
+    if (!writeResults(argv[argc - 1])) {
+        perror("smash load: write failed");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,320 @@
+#include <iostream>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+
+#include "signals.h"
+#include "SmallShell.h"
+
+/* Microbenchmarks of smash's hot paths. Every benchmark runs its body in
+ * rounds of doubling iterations until a round takes long enough to time,
+ * and the results are written as JSON into the file given as argv[1], so
+ * runs can be compared by numbers. Run with "make bench" */
+
+// a round must take at least this long to be timed
+const long long min_round_ns = 200 * 1000 * 1000LL;
+const long long max_iterations = 1LL << 30;
+
+struct BenchResult {
+    std::string name;
+    long long iterations;
+    double ns_per_op;
+    // only for benchmarks that move data, 0 otherwise
+    double bytes_per_sec;
+};
+
+static std::vector<BenchResult> results;
+// keeps the compiler from dropping the work of a benchmark
+static volatile size_t bench_sink;
+
+/* runs body(iterations) until a round is long enough, and records the time
+ * per op. bytes_per_op is what a single op moves, if anything */
+static void runBench(const std::string& name,
+                     std::function<void(long long)> body,
+                     size_t bytes_per_op = 0) {
+    long long iterations = 1;
+    long long elapsed_ns = 0;
+    while (true) {
+        long long start_ns = monotonicTimeNs();
+        body(iterations);
+        elapsed_ns = monotonicTimeNs() - start_ns;
+        if (elapsed_ns >= min_round_ns || iterations >= max_iterations) {
+            break;
+        }
+        // aim straight for the round time, at most 10 times more per round
+        long long next_iterations = elapsed_ns <= 0 ? iterations * 10
+                : iterations * min_round_ns * 3 / (elapsed_ns * 2);
+        if (next_iterations > iterations * 10) {
+            next_iterations = iterations * 10;
+        }
+        iterations = next_iterations > iterations ? next_iterations
+                                                  : iterations + 1;
+    }
+
+    BenchResult result;
+    result.name = name;
+    result.iterations = iterations;
+    result.ns_per_op = static_cast<double>(elapsed_ns) / iterations;
+    result.bytes_per_sec = bytes_per_op == 0 ? 0
+            : bytes_per_op * 1e9 / result.ns_per_op;
+    results.push_back(result);
+
+    char line[256];
+    snprintf(line, sizeof(line), "%-40s %12lld %14.1f ns/op", name.c_str(),
+             iterations, result.ns_per_op);
+    std::cout << line;
+    if (bytes_per_op != 0) {
+        snprintf(line, sizeof(line), " %10.1f MiB/s",
+                 result.bytes_per_sec / (1024 * 1024));
+        std::cout << line;
+    }
+    std::cout << std::endl;
+}
+
+static bool writeResults(const char* file_name) {
+    std::ofstream file(file_name);
+    if (!file) {
+        return false;
+    }
+    file << "{\"results\":[";
+    for (size_t i = 0; i < results.size(); i++) {
+        BenchResult& result = results[i];
+        char numbers[128];
+        snprintf(numbers, sizeof(numbers), "%.1f", result.ns_per_op);
+        file << (i == 0 ? "" : ",") << "\n  {\"name\":"
+             << toJsonString(result.name) << ",\"iterations\":"
+             << result.iterations << ",\"ns_per_op\":" << numbers;
+        if (result.bytes_per_sec != 0) {
+            snprintf(numbers, sizeof(numbers), "%.0f", result.bytes_per_sec);
+            file << ",\"bytes_per_sec\":" << numbers;
+        }
+        file << '}';
+    }
+    file << "\n]}\n";
+    return static_cast<bool>(file);
+}
+
+// ----------------------------------------------------------------------------
+
+static void benchParsing() {
+    std::string padded_line = "   \t  sleep 100   \t ";
+    runBench("trim", [&](long long iterations) {
+        for (long long i = 0; i < iterations; i++) {
+            bench_sink = _trim(padded_line).size();
+        }
+    });
+
+    std::string short_line = "ls -l /tmp";
+    runBench("parseCommandLine/short", [&](long long iterations) {
+        for (long long i = 0; i < iterations; i++) {
+            bench_sink = _parseCommandLine(short_line).size();
+        }
+    });
+
+    std::string long_line = "grep -n -i pattern";
+    for (int i = 0; i < 60; i++) {
+        long_line += " file" + std::to_string(i) + ".txt";
+    }
+    runBench("parseCommandLine/64_args", [&](long long iterations) {
+        for (long long i = 0; i < iterations; i++) {
+            bench_sink = _parseCommandLine(long_line).size();
+        }
+    });
+}
+
+static void benchCreateCommand() {
+    SmallShell& smash = SmallShell::getInstance();
+    const char* cmd_lines[][2] = {
+        {"builtin", "pwd"},
+        {"external", "ls -l /tmp"},
+        {"jobs", "jobs"},
+        {"redirection", "echo hello > /dev/null"},
+        {"pipe", "cat file | grep pattern"},
+        {"bg", "sleep 100&"},
+        {"assignment", "NAME=value"},
+    };
+
+    for (auto& cmd_line : cmd_lines) {
+        std::string line = cmd_line[1];
+        runBench(std::string("createCommand/") + cmd_line[0],
+                 [&](long long iterations) {
+            for (long long i = 0; i < iterations; i++) {
+                // createCommand takes the line by non-const reference
+                std::string curr_line = line;
+                Command* cmd = smash.createCommand(curr_line);
+                bench_sink = cmd != nullptr;
+                delete cmd;
+            }
+        });
+    }
+}
+
+// fake pids no proccess of smash has, so the job scans find nothing
+const pid_t fake_pids_base = 4000000;
+
+static void benchJobList(int jobs_count, Command* job_cmd) {
+    JobList jobs;
+    for (int i = 0; i < jobs_count; i++) {
+        jobs.addJob(job_cmd, fake_pids_base + i, i % 2 == 0 ? BG : STOPPED);
+    }
+    std::string suffix = "/" + std::to_string(jobs_count);
+
+    // a new job and its removal keep the list at jobs_count
+    runBench("JobList/add_remove" + suffix, [&](long long iterations) {
+        for (long long i = 0; i < iterations; i++) {
+            int jobID = jobs.addJob(job_cmd, fake_pids_base + jobs_count, BG);
+            jobs.removeJobById(jobID);
+        }
+    });
+
+    runBench("JobList/lookup" + suffix, [&](long long iterations) {
+        for (long long i = 0; i < iterations; i++) {
+            int jobID = static_cast<int>(i % jobs_count) + 1;
+            bench_sink = jobs.getJobById(jobID) != nullptr;
+        }
+    });
+
+    runBench("JobList/last_stopped" + suffix, [&](long long iterations) {
+        for (long long i = 0; i < iterations; i++) {
+            bench_sink = jobs.getLastStoppedJob() != nullptr;
+        }
+    });
+
+    // as before every jobs listing, each job is checked with waitpid
+    runBench("JobList/full_scan" + suffix, [&](long long iterations) {
+        for (long long i = 0; i < iterations; i++) {
+            jobs.removeFinishedJobs();
+        }
+    });
+
+    // the jobs are not smash's, nothing to free
+    for (int jobID = 1; jobID <= jobs_count; jobID++) {
+        jobs.removeJobById(jobID);
+    }
+}
+
+static bool writeFile(const std::string& path, size_t size) {
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        return false;
+    }
+    std::string block(64 * 1024, 'x');
+    size_t written = 0;
+    while (written < size) {
+        size_t chunk = std::min(block.size(), size - written);
+        if (write(fd, block.data(), chunk) != static_cast<ssize_t>(chunk)) {
+            close(fd);
+            return false;
+        }
+        written += chunk;
+    }
+    return close(fd) == 0;
+}
+
+/* runs the command line like smash does in the fg, with its output into
+ * null_sink */
+static void runCommand(const std::string& cmd_line, OutputSink& null_sink) {
+    SmallShell& smash = SmallShell::getInstance();
+    std::string line = cmd_line;
+    Command* cmd = smash.createCommand(line);
+    cmd->out = &null_sink;
+    cmd->err = &null_sink;
+    try {
+        cmd->execute();
+    } catch (ExecutionFail& execution_fail) {
+        std::cerr << "smash bench: " << cmd_line << " failed" << std::endl;
+    }
+    null_sink.discard();
+    delete cmd;
+}
+
+static void benchCopy(const std::string& dir_path, OutputSink& null_sink) {
+    size_t file_sizes[] = {4 * 1024, 1024 * 1024, 16 * 1024 * 1024};
+    std::string src_path = dir_path + "/src";
+    std::string dest_path = dir_path + "/dest";
+
+    for (size_t file_size : file_sizes) {
+        if (!writeFile(src_path, file_size)) {
+            perror("smash bench: write failed");
+            continue;
+        }
+        std::string cmd_line = "cp " + src_path + " " + dest_path;
+        runBench("cp/" + std::to_string(file_size / 1024) + "KiB",
+                 [&](long long iterations) {
+            for (long long i = 0; i < iterations; i++) {
+                runCommand(cmd_line, null_sink);
+            }
+        }, file_size);
+    }
+    unlink(src_path.c_str());
+    unlink(dest_path.c_str());
+}
+
+static void benchSpawn(OutputSink& null_sink) {
+    runBench("spawn/direct_exec", [&](long long iterations) {
+        for (long long i = 0; i < iterations; i++) {
+            runCommand("/bin/true", null_sink);
+        }
+    });
+
+    // smash leaves brace expansion to bash
+    runBench("spawn/bash", [&](long long iterations) {
+        for (long long i = 0; i < iterations; i++) {
+            runCommand("/bin/true {a,b}", null_sink);
+        }
+    });
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 2) {
+        std::cerr << "usage: smash_bench results.json" << std::endl;
+        return 1;
+    }
+    if (signal(SIGCHLD, chldHandler) == SIG_ERR) {
+        perror("smash error: failed to set SIGCHLD handler");
+    }
+
+    SmallShell& smash = SmallShell::getInstance();
+
+    int null_fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    if (null_fd == -1) {
+        perror("smash bench: open failed");
+        return 1;
+    }
+    OutputSink null_sink(null_fd);
+
+    char dir_template[] = "/tmp/smash_bench.XXXXXX";
+    if (mkdtemp(dir_template) == nullptr) {
+        perror("smash bench: mkdtemp failed");
+        return 1;
+    }
+    std::string dir_path = dir_template;
+
+    benchParsing();
+    benchCreateCommand();
+
+    std::string job_line = "sleep 100&";
+    Command* job_cmd = smash.createCommand(job_line);
+    for (int jobs_count : {10, 1000, 10000}) {
+        benchJobList(jobs_count, job_cmd);
+    }
+    delete job_cmd;
+
+    benchCopy(dir_path, null_sink);
+    benchSpawn(null_sink);
+
+    rmdir(dir_path.c_str());
+    close(null_fd);
+
+    if (!writeResults(argv[1])) {
+        perror("smash bench: write failed");
+        return 1;
+    }
+    return 0;
+}
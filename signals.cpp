@@ -15,6 +15,12 @@ void ctrlZHandler(int sig_num) {
 void ctrlCHandler(int sig_num) {
     std::cout << "smash: got ctrl-C"<< std::endl;
     SmallShell& smash = SmallShell::getInstance();
+    smash.events.notifyInterrupt();
     smash.killFgProccess();
 }
 
+void chldHandler(int sig_num) {
+    SmallShell& smash = SmallShell::getInstance();
+    smash.events.notifyChildChanged();
+}
+
@@ -14,15 +14,23 @@ int main(int argc, char* argv[]) {
     if(signal(SIGINT , ctrlCHandler) == SIG_ERR) {
         perror("smash error: failed to set ctrl-C handler");
     }
+    if(signal(SIGCHLD , chldHandler) == SIG_ERR) {
+        perror("smash error: failed to set SIGCHLD handler");
+    }
 
     SmallShell& smash = SmallShell::getInstance();
 
     SmallShellNextState smash_next_state = CONTINUE_RUNNING;
 
     while(smash_next_state == CONTINUE_RUNNING) {
-        std::cout << smash.curr_prompt_str;
+        std::cout << smash.curr_prompt_str << std::flush;
         std::string cmd_line;
-        std::getline(std::cin, cmd_line);
+        if (!smash.readCommandLine(cmd_line)) {
+            // end of input, exit like quit does
+            smash.jobs.freeJobsCmdObj();
+            break;
+        }
+        smash.readHereDocuments(cmd_line);
         try {
             smash_next_state = smash.executeCommand(cmd_line);
         } catch (ExecutionFail& e) {
@@ -30,6 +30,18 @@ std::vector<std::string> _parseCommandLine(std::string cmd_line) {
     return args;
 }
 
+std::string _removeFirstWords(const std::string& cmd_line, size_t words_count) {
+    std::string WHITESPACE = " \n\r\t\f\v";
+
+    size_t pos = 0;
+    for (size_t i = 0; i < words_count && pos != std::string::npos; i++) {
+        pos = cmd_line.find_first_not_of(WHITESPACE, pos);
+        pos = cmd_line.find_first_of(WHITESPACE, pos);
+    }
+
+    return (pos == std::string::npos) ? "" : _trim(cmd_line.substr(pos));
+}
+
 bool _isBackgroundCommand(std::string& cmd_line) {
     std::string WHITESPACE = " \n\r\t\f\v";
 
@@ -54,12 +66,167 @@ void _removeBackgroundSign(std::string& cmd_line) {
     cmd_line.erase(idx);
 }
 
+size_t _findOutsideSubstitutions(const std::string& cmd_line,
+                                 const std::string& str, bool is_last) {
+    size_t found_pos = std::string::npos;
+    int depth = 0;
+    char quote = '\0';
+    for (size_t i = 0; i < cmd_line.size(); i++) {
+        if (quote != '\0') {
+            // e.g. the "|" of grep -E 'a|b' is the pattern's
+            if (cmd_line[i] == quote) {
+                quote = '\0';
+            } else if (quote == '"' && cmd_line[i] == '\\') {
+                i++;
+            }
+        } else if (cmd_line[i] == '\'' || cmd_line[i] == '"') {
+            quote = cmd_line[i];
+        } else if (cmd_line[i] == '\\') {
+            i++;
+        } else if (cmd_line.compare(i, 2, "<(") == 0) {
+            depth++;
+            i++;
+        } else if (depth > 0 && cmd_line[i] == '(') {
+            depth++;
+        } else if (depth > 0 && cmd_line[i] == ')') {
+            depth--;
+        } else if (depth == 0 && cmd_line.compare(i, str.size(), str) == 0) {
+            found_pos = i;
+            if (!is_last) {
+                break;
+            }
+        }
+    }
+    return found_pos;
+}
+
 bool isRedirectionCommand(std::string& cmd_line){
-    return cmd_line.find('>') != std::string::npos;
+    return _findOutsideSubstitutions(cmd_line, ">") != std::string::npos;
 }
 
 bool isPipeCommand(std::string& cmd_line){
-    return cmd_line.find('|') != std::string::npos;
+    return _findOutsideSubstitutions(cmd_line, "|") != std::string::npos;
+}
+
+static bool isShellKeyword(const std::string& word) {
+    static const char* keywords[] = {"if", "then", "else", "elif", "fi",
+                                     "for", "while", "until", "do", "done",
+                                     "case", "esac", "function", "!"};
+    for (const char* keyword : keywords) {
+        if (word == keyword) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool _splitCommandList(const std::string& cmd_line,
+                       std::vector<std::string>& elements,
+                       std::vector<std::string>& operators) {
+    elements.clear();
+    operators.clear();
+
+    std::string element;
+    char quote = '\0';
+    for (size_t i = 0; i < cmd_line.size(); i++) {
+        char c = cmd_line[i];
+        char next = (i + 1 < cmd_line.size()) ? cmd_line[i + 1] : '\0';
+        bool is_word_start = (i == 0 || isspace(cmd_line[i - 1])
+                              || cmd_line[i - 1] == ';');
+
+        if (quote != '\0') {
+            if (c == '\\' && quote == '"' && next != '\0') {
+                element += c;
+                c = cmd_line[++i];
+            } else if (c == quote) {
+                quote = '\0';
+            }
+            element += c;
+            continue;
+        }
+
+        if (c == '\\' && next != '\0') {
+            element += c;
+            element += cmd_line[++i];
+            continue;
+        }
+        if (c == '\'' || c == '"') {
+            quote = c;
+            element += c;
+            continue;
+        }
+        // subshells, command substitution, groups and comments are bash's
+        if (c == '(' || c == ')' || c == '`'
+            || (is_word_start && c == '#')
+            || (is_word_start && (c == '{' || c == '}')
+                && (next == '\0' || isspace(next) || next == ';'))) {
+            return false;
+        }
+
+        std::string op;
+        if ((c == '&' && next == '&') || (c == '|' && next == '|')) {
+            op = std::string(2, c);
+        } else if (c == ';') {
+            op = ";";
+        } else if (c == '&' && i > 0 && cmd_line[i - 1] != '>'
+                   && cmd_line[i - 1] != '|' && next != '>') {
+            // a lone "&" in the middle starts a bg job, in the end the
+            // whole list is a bg job
+            return false;
+        }
+        if (op.empty()) {
+            element += c;
+            continue;
+        }
+
+        elements.push_back(_trim(element));
+        operators.push_back(op);
+        element.clear();
+        i += op.size() - 1;
+    }
+    if (quote != '\0') {
+        return false;
+    }
+
+    // a ";" may end the list
+    std::string last_element = _trim(element);
+    if (last_element.empty() && !operators.empty()
+        && operators.back() == ";") {
+        operators.pop_back();
+    } else {
+        elements.push_back(last_element);
+    }
+    if (operators.empty()) {
+        return false;
+    }
+
+    for (auto& list_element : elements) {
+        auto args = _parseCommandLine(list_element);
+        if (args.empty() || isShellKeyword(args[0])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool isCommandList(std::string& cmd_line) {
+    if (cmd_line.find_first_of(";&|") == std::string::npos) {
+        return false;
+    }
+    std::vector<std::string> elements, operators;
+    return _splitCommandList(cmd_line, elements, operators);
+}
+
+bool isInputToolCommand(const std::string& command_name) {
+    return command_name == "wc" || command_name == "grep"
+           || command_name == "sort" || command_name == "sum";
+}
+
+bool hasInputRedirection(const std::string& cmd_line) {
+    // "<(" starts a substitution, so it is not found as "<". A quoted "<("
+    // only sends the line to the system tool, which handles it the same
+    return _findOutsideSubstitutions(cmd_line, "<") != std::string::npos
+           || cmd_line.find("<(") != std::string::npos;
 }
 
 bool isBuiltInCommand(std::string& cmd_line) {
@@ -72,6 +239,10 @@ bool isBuiltInCommand(std::string& cmd_line) {
 
     std::string& command_name = cmd_args[0];
 
+    if (isInputToolCommand(command_name) && hasInputRedirection(cmd_line)) {
+        return false;
+    }
+
     if (command_name == "chprompt") {
         return true;
     }
@@ -99,6 +270,66 @@ bool isBuiltInCommand(std::string& cmd_line) {
     else if (command_name == "quit"){
         return true;
     }
+    else if (command_name == "taskset"){
+        return true;
+    }
+    else if (command_name == "jobpolicy"){
+        return true;
+    }
+    else if (command_name == "wait"){
+        return true;
+    }
+    else if (command_name == "timeout"){
+        return true;
+    }
+    else if (command_name == "time"){
+        return true;
+    }
+    else if (command_name == "stats"){
+        return true;
+    }
+    else if (command_name == "trace"){
+        return true;
+    }
+    else if (command_name == "capture"){
+        return true;
+    }
+    else if (command_name == "joblog"){
+        return true;
+    }
+    else if (command_name == "wc"){
+        return true;
+    }
+    else if (command_name == "grep"){
+        return true;
+    }
+    else if (command_name == "sort"){
+        return true;
+    }
+    else if (command_name == "sum"){
+        return true;
+    }
+    else if (command_name == "du"){
+        return true;
+    }
+    else if (command_name == "find"){
+        return true;
+    }
+    else if (command_name == "rm"){
+        return true;
+    }
+    else if (command_name == "export"){
+        return true;
+    }
+    else if (command_name == "unset"){
+        return true;
+    }
+    else if (command_name == "every"){
+        return true;
+    }
+    else if (command_name == "at"){
+        return true;
+    }
     else if (isPipeCommand(cmd_line)){
         return false;
     }
@@ -108,6 +339,9 @@ bool isBuiltInCommand(std::string& cmd_line) {
     else if (command_name == "cp") {
         return true;
     }
+    else if (command_name == "parallel") {
+        return true;
+    }
     else {
         // external command
         return false;
@@ -129,6 +363,19 @@ void checkChildExitStatus(int status) {
     }
 }
 
+int getExitStatus(int status) {
+    if (WIFEXITED(status)) {
+        return WEXITSTATUS(status);
+    }
+    if (WIFSIGNALED(status)) {
+        return 128 + WTERMSIG(status);
+    }
+    if (WIFSTOPPED(status)) {
+        return 128 + WSTOPSIG(status);
+    }
+    return 0;
+}
+
 void checkGrandChildExitStatus(int status) {
     // checking if grandchild failed and exited. If so, the first son should
     // exit too so the original father will throw the exception
@@ -169,3 +416,116 @@ void changeGroupID(){
 
 
 
+
+bool isChildRunning(pid_t pid) {
+    // WNOWAIT leaves a finished child to be reaped by whoever waits for it
+    siginfo_t info;
+    info.si_pid = 0;
+    if (waitid(P_PID, pid, &info, WEXITED | WNOHANG | WNOWAIT) == -1) {
+        // not a child anymore, it was reaped
+        return false;
+    }
+    return info.si_pid == 0;
+}
+
+std::string toJsonString(const std::string& str) {
+    std::string json_str = "\"";
+    for (char c : str) {
+        if (c == '"' || c == '\\') {
+            json_str += '\\';
+            json_str += c;
+        } else if ((unsigned char)c < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            json_str += escaped;
+        } else {
+            json_str += c;
+        }
+    }
+    return json_str + "\"";
+}
+
+void execCommandLine(std::string& cmd_line) {
+    // "<(cmd)", here-strings and here documents are set up by smash
+    substituteInputSources(cmd_line);
+
+    std::vector<std::string> assignments, words;
+    if (expandCommandLine(cmd_line, assignments, words)) {
+        execExpandedCommand(assignments, words);
+    }
+
+    SmallShell& smash = SmallShell::getInstance();
+    smash.stats.count(STATS_BASH_EXECS);
+    TRACE_INSTANT("execv bash -c");
+    smash.launch_timer.reportBashExec();
+    char bash_path[] = "/bin/bash";
+    char bash_flag[] = "-c";
+    char* cmd_line_for_bash = const_cast<char*>(cmd_line.c_str());
+    char* const args[] = {bash_path, bash_flag, cmd_line_for_bash, NULL};
+    execv(args[0], args);
+    perror("smash error: execv failed");
+    _exit(COMMAND_NOT_RUNNABLE);
+}
+
+bool parseDuration(const std::string& duration_str, long long& duration_ms) {
+    size_t number_end = duration_str.find_first_not_of("0123456789.");
+    std::string number_str = duration_str.substr(0, number_end);
+    std::string suffix = (number_end == std::string::npos)
+                         ? "" : duration_str.substr(number_end);
+
+    double multiplier;
+    if (suffix.empty() || suffix == "s") {
+        multiplier = 1000;
+    } else if (suffix == "m") {
+        multiplier = 60 * 1000;
+    } else if (suffix == "h") {
+        multiplier = 60 * 60 * 1000;
+    } else if (suffix == "d") {
+        multiplier = 24 * 60 * 60 * 1000;
+    } else {
+        return false;
+    }
+
+    double number;
+    size_t number_size;
+    try {
+        number = std::stod(number_str, &number_size);
+    } catch (const std::exception& e) {
+        return false;
+    }
+    // e.g. "1.2.3" would be read as 1.2
+    if (number_size != number_str.size()) {
+        return false;
+    }
+    duration_ms = static_cast<long long>(number * multiplier);
+    return true;
+}
+
+bool parseSize(const std::string& size_str, size_t& size) {
+    size_t number_end = size_str.find_first_not_of("0123456789");
+    std::string number_str = size_str.substr(0, number_end);
+    std::string suffix = (number_end == std::string::npos)
+                         ? "" : size_str.substr(number_end);
+
+    unsigned long long multiplier;
+    if (suffix.empty() || suffix == "b") {
+        multiplier = 1;
+    } else if (suffix == "K" || suffix == "k") {
+        multiplier = 1024;
+    } else if (suffix == "M" || suffix == "m") {
+        multiplier = 1024 * 1024;
+    } else if (suffix == "G" || suffix == "g") {
+        multiplier = 1024 * 1024 * 1024;
+    } else if (suffix == "%") {
+        multiplier = sysconf(_SC_PHYS_PAGES) * sysconf(_SC_PAGE_SIZE) / 100;
+    } else {
+        return false;
+    }
+
+    try {
+        size = std::stoull(number_str) * multiplier;
+    } catch (const std::exception& e) {
+        return false;
+    }
+    return true;
+}
@@ -24,12 +24,21 @@ std::string _trim(const std::string& s);
  * them. Every string in the returned vector is a word */
 std::vector<std::string> _parseCommandLine(std::string cmd_line);
 
+/* returning the string without its first words_count words, the rest is
+ * kept as is */
+std::string _removeFirstWords(const std::string& cmd_line, size_t words_count);
+
 /* checking if the string ends with a '&' */
 bool _isBackgroundCommand(std::string& cmd_line);
 
 /* removing the '&' from the end of the string, if exist */
 void _removeBackgroundSign(std::string& cmd_line);
 
+/* finding str in the string outside of quotes and "<(...)", whose ">" and
+ * "|" are its cmd's. The first or the last match, npos if there is none */
+size_t _findOutsideSubstitutions(const std::string& cmd_line,
+                                 const std::string& str, bool is_last = false);
+
 /* searching for ">" or ">>" in the string (doesn't have to be a separate
  * word) */
 bool isRedirectionCommand(std::string& cmd_line);
@@ -38,6 +47,25 @@ bool isRedirectionCommand(std::string& cmd_line);
  * word) */
 bool isPipeCommand(std::string& cmd_line);
 
+/* splitting the string on its top level ";", "&&" and "||" operators.
+ * operators[i] is the one between elements[i] and elements[i+1]. Returns
+ * false if there are no such operators, or if the string has constructs
+ * left for bash, like subshells, groups, keywords or a lone "&" */
+bool _splitCommandList(const std::string& cmd_line,
+                       std::vector<std::string>& elements,
+                       std::vector<std::string>& operators);
+
+/* searching for top level ";", "&&" or "||" in the string */
+bool isCommandList(std::string& cmd_line);
+
+/* determining if the command is one of the built-ins that read files or the
+ * standard input in place of a system tool, like wc */
+bool isInputToolCommand(const std::string& command_name);
+
+/* searching for "<", "<<", "<<<" or "<(" in the string, which the input tool
+ * built-ins leave to the system tools */
+bool hasInputRedirection(const std::string& cmd_line);
+
 /* determining if the string if a built-in command by inspecting the first
  * word and searching for redirection/pipe characters */
 bool isBuiltInCommand(std::string& cmd_line);
@@ -57,5 +85,28 @@ void checkGrandChildExitStatus(int status);
 
 void changeGroupID();
 
+/* converting a waitpid status to a shell exit status, 128+N for a proccess
+ * that was killed or stopped by signal N */
+int getExitStatus(int status);
+
+/* parsing a duration given in seconds, optionally with an s/m/h/d suffix like
+ * in timeout(1), fractions are allowed. e.g. "2.5", "30s", "5m" */
+bool parseDuration(const std::string& duration_str, long long& duration_ms);
+
+/* parsing a size in bytes, optionally with a K/M/G suffix like in sort(1)'s
+ * -S, or a % of the memory. e.g. "4096", "64K", "2G", "50%" */
+bool parseSize(const std::string& size_str, size_t& size);
+
+/* quoting the string as a JSON string, e.g. a "b" into "a \"b\"" */
+std::string toJsonString(const std::string& str);
+
+/* determining if pid is a child of this proccess that didn't finish yet */
+bool isChildRunning(pid_t pid);
+
+/* replacing the current proccess image with the command line. Lines smash
+ * can expand by itself are exec'd directly, the rest are run by "bash -c".
+ * Never returns, exits with COMMAND_NOT_RUNNABLE if exec failed */
+void execCommandLine(std::string& cmd_line);
+
 #endif //HW1_UTILITIES_H
 